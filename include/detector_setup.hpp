@@ -0,0 +1,91 @@
+#ifndef DETECTOR_SETUP_HPP
+#define DETECTOR_SETUP_HPP
+
+#include <CL/opencl.h>
+
+#include <CL/cl2.hpp>
+#include <string>
+
+#include "motion_detector.hpp"
+
+#define MEM_ALIGN 8                                       // Bytes buffers and work sizes are rounded up to for raspi compatability
+#define OPEN_CL_COMPILE_FLAGS "-cl-fast-relaxed-math -w"  // Options every kernel is compiled with, before any -D options
+#define MAX_WORK_GROUP_SIZE 1024                          // Largest work group kernels are launched with
+#define MAX_PIXEL_VALUE 255U                              // Largest value of a pixel
+
+/**
+ * DetectorSizes - Sizes of one stream's frames and buffers, the same for MotionDetector and every stream of MotionDetectorBatch
+ *
+ * scaled_width:                            width of scaled frames
+ * scaled_height:                           height of scaled frames
+ * input_frame_buffer_size:                 size of input frame (multiple of MEM_ALIGN)
+ * intermediate_scaled_frame_buffer_size:   size of intermediate scaling step (multiple of MEM_ALIGN)
+ * scaled_frame_buffer_size:                size of scaled frame (multiple of MEM_ALIGN)
+ * stabilized_element_size:                 bytes per pixel of stabilized background and movement (float, or sum with MotionConfig::integer_sums)
+ * history_length:                          number of scaled frames kept for the background and movement averages (1 with BackgroundModel::kExponential)
+ */
+struct DetectorSizes {
+  unsigned int scaled_width;
+  unsigned int scaled_height;
+  unsigned int input_frame_buffer_size;
+  unsigned int intermediate_scaled_frame_buffer_size;
+  unsigned int scaled_frame_buffer_size;
+  unsigned int stabilized_element_size;
+  unsigned int history_length;
+};
+
+/**
+ * ValidateMotionConfig() - Validates settings every motion detector needs and throws std::invalid_argument if they are invalid
+ *
+ * input_vid_settings:  Metadata about the MJPEG stream coming in (after decode scaling)
+ * motion_config:       Settings for how exactly to run motion detection
+ */
+void ValidateMotionConfig(const InputVideoSettings& input_vid_settings, const MotionConfig& motion_config);
+
+/**
+ * CalculateDetectorSizes() - Calculates sizes of frames and buffers of one stream
+ *
+ * input_vid_settings:  Metadata about the MJPEG stream coming in (after decode scaling)
+ * motion_config:       Settings for how exactly to run motion detection
+ * scaled_width:        Width of frames that are already scaled, such as DC images (0 removes the gaussian margin and scales by scale_denominator)
+ * scaled_height:       Height of frames that are already scaled
+ * returns:             DetectorSizes - sizes of frames and buffers
+ */
+DetectorSizes CalculateDetectorSizes(const InputVideoSettings& input_vid_settings, const MotionConfig& motion_config, unsigned int scaled_width = 0,
+                                     unsigned int scaled_height = 0);
+
+/**
+ * MakeKernelDefines() - Creates the -D options kernels are compiled with
+ *
+ * Configuration constants are only compiled in with MotionConfig::specialize_kernels, options that change the type or math of buffers always are.
+ *
+ * input_vid_settings:  Metadata about the MJPEG stream coming in (after decode scaling)
+ * motion_config:       Settings for how exactly to run motion detection
+ * sizes:               Sizes of frames and buffers
+ * returns:             std::string - -D options, each starting with a space
+ */
+std::string MakeKernelDefines(const InputVideoSettings& input_vid_settings, const MotionConfig& motion_config, const DetectorSizes& sizes);
+
+/**
+ * CreateIntBuffer() - Creates a read only OpenCL buffer holding one int
+ *
+ * context:   OpenCL context to create buffer in
+ * queue:     OpenCL command queue to write buffer with
+ * value:     value of buffer
+ * name:      name of buffer for error messages
+ * returns:   cl::Buffer - OpenCL buffer (2 ints long for raspi compatability)
+ */
+cl::Buffer CreateIntBuffer(const cl::Context& context, const cl::CommandQueue& queue, int value, const std::string& name);
+
+/**
+ * CreateFloatBuffer() - Creates a read only OpenCL buffer holding one float
+ *
+ * context:   OpenCL context to create buffer in
+ * queue:     OpenCL command queue to write buffer with
+ * value:     value of buffer
+ * name:      name of buffer for error messages
+ * returns:   cl::Buffer - OpenCL buffer (2 floats long for raspi compatability)
+ */
+cl::Buffer CreateFloatBuffer(const cl::Context& context, const cl::CommandQueue& queue, float value, const std::string& name);
+
+#endif
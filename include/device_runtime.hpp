@@ -0,0 +1,111 @@
+#ifndef DEVICE_RUNTIME_HPP
+#define DEVICE_RUNTIME_HPP
+
+#include <CL/opencl.h>
+
+#include <CL/cl2.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+
+#include "open_cl_interface.hpp"
+#include "program_cache.hpp"
+
+/**
+ * DeviceRuntime - OpenCL context, command queues and built programs for one device, shared by any number of MotionDetectors
+ *
+ * Detectors sharing a runtime only keep their own buffers and kernels. Their work goes through the runtime's in order queues,
+ * so the device runs one detector's kernels at a time in the order they were queued. Safe to share between threads.
+ */
+class DeviceRuntime {
+ public:
+  /**
+   * DeviceRuntime() - Constructor for DeviceRuntime
+   *
+   * device_config:       Settings for which device to use (DeviceType::kNative is not an OpenCL device and throws std::invalid_argument)
+   * output:              Output stream for info messages
+   * program_cache_dir:   directory to keep built program binaries in ("" compiles every program from source)
+   */
+  DeviceRuntime(DeviceConfig device_config, std::ostream* output, const std::string& program_cache_dir = "");
+
+  DeviceRuntime(const DeviceRuntime&) = delete;
+  DeviceRuntime& operator=(const DeviceRuntime&) = delete;
+
+  /**
+   * GetProgram() - Gets a program built from a kernel file, building it the first time it is asked for
+   *
+   * filename:  OpenCL kernel file
+   * options:   build options
+   * returns:   cl::Program - built OpenCL program (the same program for every call with the same file and options)
+   */
+  cl::Program GetProgram(const std::string& filename, const std::string& options);
+
+  /**
+   * GetProgramCount() - Gets the number of programs built so far
+   *
+   * returns:   size_t - number of distinct kernel file and build option pairs
+   */
+  size_t GetProgramCount();
+
+  /**
+   * GetDeviceConfig() - Gets the settings the device was selected with
+   *
+   * returns:   DeviceConfig - device settings
+   */
+  DeviceConfig GetDeviceConfig() const;
+
+  /**
+   * GetDevice() - Gets the OpenCL device
+   *
+   * returns:   const cl::Device& - OpenCL device
+   */
+  const cl::Device& GetDevice() const;
+
+  /**
+   * GetContext() - Gets the OpenCL context for the device
+   *
+   * returns:   const cl::Context& - OpenCL context
+   */
+  const cl::Context& GetContext() const;
+
+  /**
+   * GetCommandQueue() - Gets the queue kernels run on
+   *
+   * returns:   const cl::CommandQueue& - in order command queue
+   */
+  const cl::CommandQueue& GetCommandQueue() const;
+
+  /**
+   * GetTransferQueue() - Gets the queue asynchronous frames are uploaded on
+   *
+   * returns:   const cl::CommandQueue& - in order command queue
+   */
+  const cl::CommandQueue& GetTransferQueue() const;
+
+ private:
+  /**
+   * BuildProgram() - Builds a program from a kernel file, using the program cache if there is one
+   *
+   * filename:  OpenCL kernel file
+   * options:   build options
+   * returns:   cl::Program - built OpenCL program
+   */
+  cl::Program BuildProgram(const std::string& filename, const std::string& options);
+
+  DeviceConfig device_config_;       // Settings device was selected with
+  cl::Device device_;                // OpenCL device
+  cl::Context context_;              // OpenCL context for device
+  cl::CommandQueue cmd_queue_;       // OpenCL command queue kernels run on
+  cl::CommandQueue transfer_queue_;  // OpenCL command queue for uploading asynchronous frames
+
+  std::mutex programs_mutex_;                                              // Guards programs_ and builds
+  std::map<std::pair<std::string, std::string>, cl::Program> programs_;  // Built programs by kernel file and build options
+  std::unique_ptr<ProgramCache> program_cache_;                           // Built program binaries on disk (program_cache_dir only)
+
+  std::ostream* info;  // Output stream for info messages
+};
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef FRAME_BUFFER_POOL_HPP
+#define FRAME_BUFFER_POOL_HPP
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * FrameBufferPool - Reusable frame buffers keyed by size, so decompressing frames does not allocate once the pool is warm
+ *
+ * Safe to use from any number of threads, detectors share one pool through FrameBufferPool::Shared().
+ */
+class FrameBufferPool {
+ public:
+  /**
+   * Buffer - Frame buffer borrowed from a pool, goes back to the pool when destroyed
+   */
+  class Buffer {
+   public:
+    /**
+     * Buffer() - Constructor for an empty Buffer
+     */
+    Buffer() = default;
+
+    /**
+     * ~Buffer() - Deconstructor for Buffer, returns memory to its pool
+     */
+    ~Buffer();
+
+    Buffer(Buffer&& other) noexcept;
+    Buffer& operator=(Buffer&& other) noexcept;
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+
+    /**
+     * GetData() - Gets memory of buffer
+     *
+     * returns:   unsigned char* - memory of buffer (nullptr if empty)
+     */
+    unsigned char* GetData() const;
+
+    /**
+     * GetSize() - Gets size of buffer
+     *
+     * returns:   size_t - size of buffer in bytes
+     */
+    size_t GetSize() const;
+
+   private:
+    friend class FrameBufferPool;
+
+    /**
+     * Buffer() - Constructor for Buffer borrowed from pool
+     *
+     * pool:      pool to return memory to
+     * data:      memory of buffer
+     * size:      size of memory in bytes
+     */
+    Buffer(FrameBufferPool* pool, std::unique_ptr<unsigned char[]> data, size_t size);
+
+    /**
+     * Release() - Returns memory to pool and empties buffer
+     */
+    void Release();
+
+    FrameBufferPool* pool_ = nullptr;        // Pool memory came from
+    std::unique_ptr<unsigned char[]> data_;  // Memory of buffer
+    size_t size_ = 0;                        // Size of memory in bytes
+  };
+
+  /**
+   * FrameBufferPool() - Constructor for FrameBufferPool
+   *
+   * max_free_per_size:   most unused buffers of one size to keep around, extras are freed
+   */
+  explicit FrameBufferPool(unsigned int max_free_per_size = 8);
+
+  FrameBufferPool(const FrameBufferPool&) = delete;
+  FrameBufferPool& operator=(const FrameBufferPool&) = delete;
+
+  /**
+   * Shared() - Gets the pool shared by every detector in the process
+   *
+   * returns:   FrameBufferPool& - shared pool
+   */
+  static FrameBufferPool& Shared();
+
+  /**
+   * Acquire() - Borrows a buffer of exactly size bytes, only allocating if no buffer of that size is free
+   *
+   * size:      size of buffer in bytes
+   * returns:   Buffer - borrowed buffer (contents are left over from its last user)
+   */
+  Buffer Acquire(size_t size);
+
+  /**
+   * GetFreeBuffers() - Gets the number of unused buffers held by the pool
+   *
+   * returns:   size_t - number of unused buffers
+   */
+  size_t GetFreeBuffers();
+
+ private:
+  /**
+   * Return() - Takes back memory of a buffer
+   *
+   * data:      memory of buffer
+   * size:      size of memory in bytes
+   */
+  void Return(std::unique_ptr<unsigned char[]> data, size_t size);
+
+  std::mutex mutex_;                                                      // Guards free_
+  std::map<size_t, std::vector<std::unique_ptr<unsigned char[]>>> free_;  // Unused buffers by size
+  unsigned int max_free_per_size_;                                        // Most unused buffers of one size to keep
+};
+
+#endif
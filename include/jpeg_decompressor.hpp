@@ -3,11 +3,14 @@
 
 #include <turbojpeg.h>
 
+#include <memory>
+
 /**
  * DecompVideoFormat - Selector for what format images should be decompressed into
  *
  * kRGB:  < Row: < Pixel: <Red Byte, Green Byte, Blue Byte> ...> ...>
  * kGray: < Row: < Pixel: <Grayscale Byte> ...> ...>
+ *          (luma plane only, libjpeg-turbo skips the chroma IDCT, upsampling and color conversion, and frames upload a third of the bytes of kRGB)
  */
 enum class DecompFrameFormat { kRGB, kGray };
 
@@ -31,14 +34,20 @@ class JpegDecompressor {
    * height:        Height of image to decompress
    * frame_format:  Format to decompress images into
    * decomp_method: Method to use to decompress images
+   * decode_scale:  Amount to scale images down by while decompressing using IDCT scaling (1, 2, 4 or 8)
+   * strip_threads: Threads to decompress strips between restart markers on at the same time (1 means one thread, 0 means one per core)
    */
-  JpegDecompressor(unsigned int width, unsigned int height, DecompFrameFormat frame_format, DecompFrameMethod decomp_method);
+  JpegDecompressor(unsigned int width, unsigned int height, DecompFrameFormat frame_format, DecompFrameMethod decomp_method, unsigned int decode_scale = 1,
+                   unsigned int strip_threads = 1);
 
   /**
    * ~JpegDecompressor - Deconstructor for JpegDecompressor
    */
   ~JpegDecompressor();
 
+  JpegDecompressor(const JpegDecompressor&) = delete;
+  JpegDecompressor& operator=(const JpegDecompressor&) = delete;
+
   /**
    * DecompressImage() - Decompresses a JPEG image
    *
@@ -48,6 +57,55 @@ class JpegDecompressor {
    */
   unsigned char* DecompressImage(const unsigned char* compressed_image, unsigned long jpeg_size) const;
 
+  /**
+   * DecompressImage() - Decompresses a JPEG image into a buffer
+   *
+   * Baseline JPEGs with restart markers are split into strips of MCU rows that are decompressed on strip_threads threads at the same time.
+   * Other JPEGs are decompressed on the calling thread. Grayscale strips match decompressing on one thread exactly, with kRGB the chroma
+   * of the rows either side of a split is upsampled without the neighbouring strip and can be off slightly.
+   *
+   * compressed_image:  JPEG image to decompress
+   * jpeg_size:         Size of JPEG image to decompress in bytes
+   * destination:       Buffer to decompress into (for example a mapped OpenCL buffer)
+   * destination_size:  Size of destination in bytes, must be at least GetDecompressedSize()
+   */
+  void DecompressImage(const unsigned char* compressed_image, unsigned long jpeg_size, unsigned char* destination, unsigned long destination_size) const;
+
+  /**
+   * SetDecodeWindow() - Only decompresses a window of later images, the rest of the destination is not written
+   *
+   * Rows above the window are skipped without the IDCT (jpeg_skip_scanlines()), rows below are never decoded and columns either side are
+   * cropped off (jpeg_crop_scanline()), which widens the window out to whole MCU columns. Images are decompressed on the calling thread with
+   * the libjpeg API instead of in strips. Grayscale windows match decompressing the whole image exactly, with kRGB the chroma at the edges
+   * of the window is upsampled without its neighbours and can be off slightly. Destinations have to be initialized once and reused, a mapped
+   * OpenCL buffer has to be mapped with CL_MAP_WRITE instead of CL_MAP_WRITE_INVALIDATE_REGION so it keeps its contents.
+   *
+   * x:         first column of window in decompressed pixels (after decode scaling)
+   * y:         first row of window in decompressed pixels
+   * width:     width of window (0 decompresses whole images again)
+   * height:    height of window
+   */
+  void SetDecodeWindow(unsigned int x, unsigned int y, unsigned int width, unsigned int height);
+
+  /**
+   * DecompressDCImage() - Reads the average of every 8x8 luma block of a JPEG image from its DC coefficients (no IDCT, upsampling or color conversion)
+   *
+   * compressed_image:  JPEG image to read
+   * jpeg_size:         Size of JPEG image to read in bytes
+   * returns:           unsigned char* - char array of block averages, GetDCWidth() x GetDCHeight() (GetDCSize() bytes)
+   */
+  unsigned char* DecompressDCImage(const unsigned char* compressed_image, unsigned long jpeg_size) const;
+
+  /**
+   * DecompressDCImage() - Reads the average of every 8x8 luma block of a JPEG image into a buffer
+   *
+   * compressed_image:  JPEG image to read
+   * jpeg_size:         Size of JPEG image to read in bytes
+   * destination:       Buffer to write block averages into
+   * destination_size:  Size of destination in bytes, must be at least GetDCSize()
+   */
+  void DecompressDCImage(const unsigned char* compressed_image, unsigned long jpeg_size, unsigned char* destination, unsigned long destination_size) const;
+
   /**
    * GetDecompressedSize() - Get the size of a decompressed image
    *
@@ -55,19 +113,104 @@ class JpegDecompressor {
    */
   unsigned int GetDecompressedSize() const;
 
+  /**
+   * GetDecompressedWidth() - Get the width of a decompressed image
+   *
+   * returns:   unsigned int - width of decompressed image after decode scaling
+   */
+  unsigned int GetDecompressedWidth() const;
+
+  /**
+   * GetDecompressedHeight() - Get the height of a decompressed image
+   *
+   * returns:   unsigned int - height of decompressed image after decode scaling
+   */
+  unsigned int GetDecompressedHeight() const;
+
+  /**
+   * LargestDecodeScale() - Finds the largest IDCT scale down (8, 4 or 2) that evenly divides a scale denominator
+   *
+   * scale_denominator:   total amount images will be scaled down by
+   * returns:             unsigned int - amount to scale down by while decompressing (1 if none divide it)
+   */
+  static unsigned int LargestDecodeScale(unsigned int scale_denominator);
+
+  /**
+   * GetDCWidth() - Get the width of a DC image
+   *
+   * returns:   unsigned int - number of 8x8 blocks across image
+   */
+  unsigned int GetDCWidth() const;
+
+  /**
+   * GetDCHeight() - Get the height of a DC image
+   *
+   * returns:   unsigned int - number of 8x8 blocks down image
+   */
+  unsigned int GetDCHeight() const;
+
+  /**
+   * GetDCSize() - Get the size of a DC image
+   *
+   * returns:   unsigned int - size of DC image buffer (padded to a multiple of 8 bytes)
+   */
+  unsigned int GetDCSize() const;
+
  private:
   /**
    * DestroyDecompressor() - Destroys the decompressor for JpegDecompressor
    */
   void DestroyDecompressor();
 
+  /**
+   * CoefficientReader - libjpeg decompressor and error handler for reading DCT coefficients and decompressing windows (defined in jpeg_decompressor.cc)
+   */
+  struct CoefficientReader;
+
+  /**
+   * StripDecoder - Thread pool, TurboJPEG handles and scratch memory for decompressing strips (defined in jpeg_decompressor.cc)
+   */
+  struct StripDecoder;
+
+  /**
+   * DecompressStrips() - Decompresses a JPEG in strips split at restart markers, one strip per thread
+   *
+   * compressed_image:  JPEG image to decompress
+   * jpeg_size:         Size of JPEG image to decompress in bytes
+   * destination:       Buffer to decompress into
+   * returns:           bool - false if JPEG can not be split into strips (nothing is decompressed)
+   */
+  bool DecompressStrips(const unsigned char* compressed_image, unsigned long jpeg_size, unsigned char* destination) const;
+
+  /**
+   * DecompressWindow() - Decompresses the decode window of a JPEG into the same place it would be in the whole image
+   *
+   * compressed_image:  JPEG image to decompress
+   * jpeg_size:         Size of JPEG image to decompress in bytes
+   * destination:       Buffer to decompress into
+   */
+  void DecompressWindow(const unsigned char* compressed_image, unsigned long jpeg_size, unsigned char* destination) const;
+
   unsigned int width_;              // Width of image
   unsigned int height_;             // Height of image
+  unsigned int scaled_width_;       // Width of decompressed image
+  unsigned int scaled_height_;      // Height of decompressed image
   unsigned int decompressed_size_;  // Size of decompressed image buffer
+  unsigned int dc_width_;           // Width of DC image
+  unsigned int dc_height_;          // Height of DC image
+  unsigned int dc_size_;            // Size of DC image buffer
+  unsigned int decode_scale_;       // Amount image is scaled down by while decompressing
+  unsigned int window_x_ = 0;       // First column of decode window
+  unsigned int window_y_ = 0;       // First row of decode window
+  unsigned int window_width_ = 0;   // Width of decode window (0 decompresses whole images)
+  unsigned int window_height_ = 0;  // Height of decode window
 
   tjhandle tj_decompressor_;  // TurboJPEG image decompressor handle
   TJPF pixel_format_;         // TurboJPEG pixel format to decompress jpeg images into
   int decomp_flags_;          // TurboJPEG flags for decompressor
+
+  std::unique_ptr<CoefficientReader> coefficient_reader_;  // libjpeg decompressor for reading DCT coefficients
+  std::unique_ptr<StripDecoder> strip_decoder_;            // Strip decompression threads (strip_threads other than 1 only)
 };
 
 #endif
\ No newline at end of file
@@ -4,11 +4,22 @@
 #include <CL/opencl.h>
 
 #include <CL/cl2.hpp>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <ostream>
+#include <string>
 #include <vector>
 
+#include "device_runtime.hpp"
 #include "jpeg_decompressor.hpp"
+#include "motion_region.hpp"
+#include "native_pipeline.hpp"
 #include "open_cl_interface.hpp"
+#include "parallel_decoder.hpp"
+#include "roi_mask.hpp"
 
 /**
  * InputVideoSettings - Metadata of decompressed video stream
@@ -23,6 +34,28 @@ struct InputVideoSettings {
   DecompFrameFormat frame_format;
 };
 
+/**
+ * ProcessingMode - Selector for how frames are processed on the device
+ *
+ * kSeparable:  blur and scale vertically, then horizontally, then stabilize and compare (one kernel each)
+ * kFused:      blur, scale, stabilize and compare in a single kernel using tiles in local memory
+ * kTiled:      same steps as kSeparable, but blur and scale kernels stage input rows and columns in local memory and use vector loads
+ *                (kSeparable kernels stay the reference, kTiled pays off at large gaussian_size and scale_denominator)
+ * kDCBlocks:   use the DC coefficient (average) of every 8x8 luma block of the JPEG as the scaled frame, then stabilize and compare
+ *                (no IDCT, blur or scale, so gaussian_size, scale_denominator and dct_scaling are ignored)
+ */
+enum class ProcessingMode { kSeparable, kFused, kDCBlocks, kTiled };
+
+/**
+ * BackgroundModel - Selector for how the stabilized background and movement are kept
+ *
+ * kWindow:       averages of the last motion_stabil_length frames and of the bg_stabil_length frames before them
+ *                  (every frame in either window is kept in the frame history so it can be removed again)
+ * kExponential:  exponential moving averages with alpha 2 / (length + 1), the same average age as windows of those lengths
+ *                  (movement follows frames and background follows movement, only the newest scaled frame is kept so memory does not grow with the lengths)
+ */
+enum class BackgroundModel { kWindow, kExponential };
+
 /**
  * MotionConfig - Configuration for motion detection
  *
@@ -33,11 +66,36 @@ struct InputVideoSettings {
  * min_pixel_diff:        minimum difference between pixels to count as different
  * min_changed_pixels:    minimum pecentage of pixels that need to change in a frame to count as a different frame
  * decomp_method:         decompression method to use for jpeg
+ * processing_mode:       how frames are processed on the device (DeviceType::kNative treats kFused and kTiled as kSeparable)
+ * dct_scaling:           scale down by the largest of 8, 4 or 2 dividing scale_denominator while decompressing (IDCT scaling), rest is done on the device
+ * decode_threads:        threads DetectOnFrameAsync() decompresses frames on in parallel (0 decompresses on the calling thread)
+ * strip_threads:         threads each frame is split across while decompressing if it has restart markers (1 means one thread, 0 means one per core)
+ * specialize_kernels:    compile sizes, lengths and gaussian weights into the kernels with -D so loops can be unrolled
+ *                          (false reads them from argument buffers instead, so one compiled kernel works for any configuration)
+ * program_cache_dir:     directory to keep built kernel binaries in so later detectors skip compiling them ("" compiles every time)
+ *                          (detectors given a DeviceRuntime use the runtime's cache instead)
+ * integer_sums:          keep exact integer sums of the background and movement windows instead of float averages
+ *                          (16 bit sums when 255 times the longer length fits, otherwise 32 bit, no divides and no drift over long uptimes)
+ * packed_mask:           store the difference frame as 1 bit per pixel in 32 bit words and count it with popcount (read it with GetDifferenceMask())
+ * background_model:      how the stabilized background and movement are kept (kExponential can not be used with integer_sums)
+ * max_regions:           most motion regions DetectRegionsOnFrame() returns, the ones with the most pixels (0 does not build the labeling kernels)
+ * min_region_pixels:     fewest changed scaled pixels a motion region needs to be returned
+ * roi:                   pixels of the input frames watched for motion, only tiles with watched pixels are processed (empty watches the whole frame)
+ *                          (a scaled pixel is watched if the input pixel at its center is, min_changed_pixels is a percentage of watched pixels)
+ *                          (only the bounding rows and columns the watched pixels blur from are decompressed, except with kDCBlocks)
  *
  * kBlurScaleVerticalFile:      Locations of OpenCL kernels
  * kBlurScaleHorizontalFile
  * kStabilizeFile
  * kCalculateDifferenceFile
+ * kCountDifferenceFile
+ * kFusedFile
+ * kBlurScaleVerticalTiledFile
+ * kBlurScaleHorizontalTiledFile
+ * kBlurScaleVerticalBatchFile
+ * kBlurScaleHorizontalBatchFile
+ * kCountDifferenceBatchFile
+ * kLabelRegionsFile
  */
 struct MotionConfig {
   unsigned int gaussian_size;
@@ -47,10 +105,30 @@ struct MotionConfig {
   unsigned int min_pixel_diff;
   float min_changed_pixels;
   DecompFrameMethod decomp_method;
+  ProcessingMode processing_mode = ProcessingMode::kSeparable;
+  bool dct_scaling = false;
+  unsigned int decode_threads = 0;
+  unsigned int strip_threads = 1;
+  bool specialize_kernels = true;
+  std::string program_cache_dir;
+  bool integer_sums = false;
+  bool packed_mask = false;
+  BackgroundModel background_model = BackgroundModel::kWindow;
+  unsigned int max_regions = 0;
+  unsigned int min_region_pixels = 1;
+  RoiMask roi;
   std::string kBlurScaleVerticalFile = "blur_and_scale_vertical.cl";
   std::string kBlurScaleHorizontalFile = "blur_and_scale_horizontal.cl";
   std::string kStabilizeFile = "stabilize_bg_mvt.cl";
   std::string kCalculateDifferenceFile = "calculate_difference.cl";
+  std::string kCountDifferenceFile = "count_difference.cl";
+  std::string kFusedFile = "blur_scale_stabilize_fused.cl";
+  std::string kBlurScaleVerticalTiledFile = "blur_and_scale_vertical_tiled.cl";
+  std::string kBlurScaleHorizontalTiledFile = "blur_and_scale_horizontal_tiled.cl";
+  std::string kBlurScaleVerticalBatchFile = "blur_and_scale_vertical_batch.cl";
+  std::string kBlurScaleHorizontalBatchFile = "blur_and_scale_horizontal_batch.cl";
+  std::string kCountDifferenceBatchFile = "count_difference_batch.cl";
+  std::string kLabelRegionsFile = "label_regions.cl";
 };
 
 /**
@@ -67,6 +145,15 @@ class MotionDetector {
    */
   MotionDetector(InputVideoSettings input_vid_settings, MotionConfig motion_config, DeviceConfig device_config, std::ostream* output);
 
+  /**
+   * DetectMotion() - Constructor for DetectMotion sharing a device's context, queues and programs with other detectors
+   *
+   * input_vid_settings:   Metadata about MJPEG stream coming in
+   * motion_config:        Settings for how exactly to run motion detection
+   * runtime:              OpenCL device to run motion detection on, programs are only built once per runtime
+   */
+  MotionDetector(InputVideoSettings input_vid_settings, MotionConfig motion_config, std::shared_ptr<DeviceRuntime> runtime, std::ostream* output);
+
   /**
    * ~DetectMotion() - Deconstructor for DetectMotion
    */
@@ -85,13 +172,35 @@ class MotionDetector {
    * DetectOnDecompressedFrame() - Processes a decompressed frame for motion detection
    *
    * frame:     image in the format used to construct DetectMotion
-   *              (note: image format will not be checked)
+   *              (note: image format will not be checked, with dct_scaling it must already be scaled down by GetDecodeScale(),
+   *               with ProcessingMode::kDCBlocks it must be a DC image from JpegDecompressor::DecompressDCImage())
    * returns:   bool - if motion is detected or not
    */
   bool DetectOnDecompressedFrame(const unsigned char* frame);
 
   /**
-   * BlurAndScale() - Blurs and scales an image using selected gaussian size
+   * DetectOnFrameAsync() - Processes a MJPEG frame for motion detection without waiting for the device
+   *                         (frame is decompressed before returning, so the JPEG buffer can be reused right away)
+   *
+   * Frames are decompressed straight into mapped input buffers and processed in the order this is called while the caller decompresses the next frame.
+   * Up to 3 frames can be in flight before this waits for the device to finish reading the oldest one.
+   * Not safe to call from more than one thread at a time.
+   *
+   * With MotionConfig::decode_threads the frame is instead copied into a queue and decompressed on one of the decode threads.
+   * Frames are then processed one at a time on a delivery thread in the order they were given, and this only waits once
+   * 2 frames per decode thread are queued.
+   *
+   * GetChangedPixels() and GetMotionScore() follow the newest frame whose count has arrived, so they are for this frame once its future is ready
+   * unless a later frame has finished too.
+   *
+   * frame:     JPEG image
+   * size:      Size of JPEG image buffer
+   * returns:   std::future<bool> - if motion is detected or not
+   */
+  std::future<bool> DetectOnFrameAsync(const unsigned char* frame, unsigned long size);
+
+  /**
+   * BlurAndScale() - Blurs and scales an image using selected gaussian size (not avaliable with DeviceType::kNative)
    *
    * image:     image to be blurred and scaled
    * returns:   cl::Buffer& - blurred and scaled image
@@ -99,23 +208,125 @@ class MotionDetector {
   cl::Buffer& BlurAndScale(const unsigned char* frame);
 
   /**
-   * StabilizeAndCompareFrames() - Averages background and motion frames and compares them
+   * StabilizeAndCompareFrames() - Averages background and motion frames and compares them (not avaliable with DeviceType::kNative)
    *
    * returns:   cl::Buffer& - image of differences
    */
   cl::Buffer& StabilizeAndCompareFrames();
 
+  /**
+   * BlurScaleAndCompareFused() - Blurs, scales, stabilizes and compares a frame in a single kernel (ProcessingMode::kFused only, not avaliable with DeviceType::kNative)
+   *
+   * image:     image to be processed
+   * returns:   cl::Buffer& - image of differences
+   */
+  cl::Buffer& BlurScaleAndCompareFused(const unsigned char* frame);
+
+  /**
+   * CountDifferences() - Counts the changed pixels in the difference frame on the device
+   *
+   * returns:   unsigned int - number of pixels that are different
+   */
+  unsigned int CountDifferences();
+
+  /**
+   * GetChangedPixels() - Gets the number of changed pixels in the last processed frame
+   *
+   * returns:   unsigned int - number of pixels that were different
+   */
+  unsigned int GetChangedPixels() const;
+
+  /**
+   * GetMotionScore() - Gets the fraction of pixels that changed in the last processed frame
+   *
+   * returns:   float - changed pixels divided by watched pixels in scaled frame (0.0 - 1.0)
+   */
+  float GetMotionScore() const;
+
+  /**
+   * GetDecodeScale() - Gets the amount frames are scaled down by while decompressing
+   *
+   * returns:   unsigned int - decode scale (1 unless dct_scaling is on)
+   */
+  unsigned int GetDecodeScale() const;
+
+  /**
+   * GetDifferenceMask() - Reads back the difference mask of the last processed frame (MotionConfig::packed_mask only)
+   *
+   * With DetectOnFrameAsync() this is the last frame queued, and with MotionConfig::decode_threads it is only meaningful once every future has been collected.
+   *
+   * returns:   std::vector<uint32_t> - bit i % 32 of word i / 32 is set if scaled pixel i (row by row) changed, bits past the last pixel are 0
+   */
+  std::vector<uint32_t> GetDifferenceMask();
+
+  /**
+   * DetectRegionsOnFrame() - Processes a MJPEG frame for motion detection and finds where the motion is (MotionConfig::max_regions only)
+   *
+   * frame:     JPEG image
+   * size:      Size of JPEG image buffer
+   * returns:   MotionResult - if motion is detected or not, and its regions when it is
+   */
+  MotionResult DetectRegionsOnFrame(const unsigned char* frame, unsigned long size);
+
+  /**
+   * DetectRegionsOnDecompressedFrame() - Processes a decompressed frame for motion detection and finds where the motion is (MotionConfig::max_regions only)
+   *
+   * frame:     image in the format used to construct DetectMotion (same as DetectOnDecompressedFrame())
+   * returns:   MotionResult - if motion is detected or not, and its regions when it is
+   */
+  MotionResult DetectRegionsOnDecompressedFrame(const unsigned char* frame);
+
+  /**
+   * FindMotionRegions() - Labels connected changed pixels of the last processed frame on the device and measures them (MotionConfig::max_regions only)
+   *
+   * Boxes and centroids are mapped back through the scale and gaussian margin, so they are in pixels of the JPEG frames.
+   * With DetectOnFrameAsync() this is the last frame queued, and with MotionConfig::decode_threads it is only meaningful once every future has been collected.
+   *
+   * returns:   std::vector<MotionRegion> - regions with at least min_region_pixels pixels, most pixels first (at most max_regions)
+   */
+  std::vector<MotionRegion> FindMotionRegions();
+
  private:
+  struct InputSlot;
+
   /**
    * ValidateSettings() - Validates settings for motion detector
    */
   void ValidateSettings() const;
 
   /**
-   * InitOpenCL() - Sets up OpenCL opbjects
+   * MotionDetector() - Constructor both public constructors delegate to
+   *
+   * runtime:   OpenCL device to share (nullptr creates one for this detector from device_config)
+   */
+  MotionDetector(InputVideoSettings input_vid_settings, MotionConfig motion_config, DeviceConfig device_config, std::shared_ptr<DeviceRuntime> runtime,
+                 std::ostream* output);
+
+  /**
+   * InitOpenCL() - Sets up OpenCL opbjects, creating a DeviceRuntime if one was not given
    */
   void InitOpenCL();
 
+  /**
+   * InitNative() - Sets up CPU pipeline used instead of OpenCL
+   */
+  void InitNative();
+
+  /**
+   * InitDecoder() - Sets up parallel decode threads for DetectOnFrameAsync() (MotionConfig::decode_threads only)
+   *
+   * jpeg_settings:   Metadata about JPEG frames before any decode scaling
+   */
+  void InitDecoder(const InputVideoSettings& jpeg_settings);
+
+  /**
+   * OnFrameDecoded() - Processes a frame decompressed by the decode threads and fulfills its future
+   *
+   * frame:     decompressed frame (nullptr if decompressing failed)
+   * error:     exception thrown while decompressing
+   */
+  void OnFrameDecoded(const unsigned char* frame, std::exception_ptr error);
+
   /**
    * InitWorkSizes() - Calculates and creates OpenCL device work sizes
    */
@@ -136,6 +347,11 @@ class MotionDetector {
    */
   void LoadBlurAndScaleKernels();
 
+  /**
+   * LoadTiledKernelArgs() - Picks work group sizes for the tiled blur and scale kernels and sets their extra arguments (ProcessingMode::kTiled only)
+   */
+  void LoadTiledKernelArgs();
+
   /**
    * LoadStabilizeAndCompareBuffer() - Loads OpenCL buffers for stabilizing background and movement and comparing them
    */
@@ -147,26 +363,237 @@ class MotionDetector {
   void LoadStabilizeAndCompareKernel();
 
   /**
-   * LoadProgram() - Loads OpenCL program from given filename
+   * LoadFusedKernel() - Loads OpenCL kernel for blurring, scaling, stabilizing and comparing in one pass
+   */
+  void LoadFusedKernel();
+
+  /**
+   * LoadCountDifferenceBuffers() - Loads OpenCL buffers for counting changed pixels
+   */
+  void LoadCountDifferenceBuffers();
+
+  /**
+   * LoadCountDifferenceKernel() - Loads OpenCL kernel for counting changed pixels
+   */
+  void LoadCountDifferenceKernel();
+
+  /**
+   * DecompressFrame() - Decompresses a JPEG into the frame format processing mode expects
+   *
+   * frame:             JPEG image
+   * size:              Size of JPEG image buffer
+   * destination:       Buffer to decompress into
+   * destination_size:  Size of destination in bytes
+   */
+  void DecompressFrame(const unsigned char* frame, unsigned long size, unsigned char* destination, unsigned long destination_size) const;
+
+  /**
+   * DecompressIntoSlot() - Maps an input slot, decompresses a JPEG straight into it and unmaps it
+   *
+   * slot:      input slot to decompress into (slot.uploaded is set to the unmap)
+   * queue:     OpenCL command queue to map and unmap on
+   * wait_for:  events that have to finish before slot can be mapped (nullptr for none)
+   * frame:     JPEG image
+   * size:      Size of JPEG image buffer
+   */
+  void DecompressIntoSlot(InputSlot& slot, cl::CommandQueue& queue, const std::vector<cl::Event>* wait_for, const unsigned char* frame, unsigned long size);
+
+  /**
+   * WriteInputFrame() - Writes a frame to the first input slot, blocking until it is written
+   *
+   * frame:     image in the format used to construct DetectMotion
+   */
+  void WriteInputFrame(const unsigned char* frame);
+
+  /**
+   * EnqueueProcessing() - Queues the kernels that turn an input frame into a difference frame
+   *
+   * input:           OpenCL buffer of frame to process
+   * wait_for:        events to wait for before reading input (may be nullptr)
+   * input_released:  set to event for when input is no longer being read (may be nullptr)
+   */
+  void EnqueueProcessing(const cl::Buffer& input, const std::vector<cl::Event>* wait_for, cl::Event* input_released);
+
+  /**
+   * EnqueueBlurAndScale() - Queues the vertical and horizontal blur and scale kernels
+   *
+   * input:           OpenCL buffer of frame to process
+   * wait_for:        events to wait for before reading input (may be nullptr)
+   * input_released:  set to event for when input is no longer being read (may be nullptr)
+   */
+  void EnqueueBlurAndScale(const cl::Buffer& input, const std::vector<cl::Event>* wait_for, cl::Event* input_released);
+
+  /**
+   * EnqueueDCFrame() - Queues copying a DC image straight into the frame history (ProcessingMode::kDCBlocks only)
+   *
+   * input:           OpenCL buffer of DC image
+   * wait_for:        events to wait for before reading input (may be nullptr)
+   * input_released:  set to event for when input is no longer being read (may be nullptr)
+   */
+  void EnqueueDCFrame(const cl::Buffer& input, const std::vector<cl::Event>* wait_for, cl::Event* input_released);
+
+  /**
+   * EnqueueStabilizeAndCompare() - Queues the stabilize and compare kernel
+   */
+  void EnqueueStabilizeAndCompare();
+
+  /**
+   * EnqueueFused() - Queues the fused blur, scale, stabilize and compare kernel
+   *
+   * input:           OpenCL buffer of frame to process
+   * wait_for:        events to wait for before reading input (may be nullptr)
+   * input_released:  set to event for when input is no longer being read (may be nullptr)
+   */
+  void EnqueueFused(const cl::Buffer& input, const std::vector<cl::Event>* wait_for, cl::Event* input_released);
+
+  /**
+   * EnqueueCountDifferences() - Queues resetting and counting changed pixels
+   */
+  void EnqueueCountDifferences();
+
+  /**
+   * OnChangedPixelsRead() - OpenCL callback for when an asynchronous changed pixel count has been read back
+   *
+   * event:       read event
+   * status:      execution status of read
+   * user_data:   AsyncCount to fulfill (deleted by callback)
+   */
+  static void CL_CALLBACK OnChangedPixelsRead(cl_event event, cl_int status, void* user_data);
+
+  /**
+   * QueueFrame() - Gives the next frame its sequence number
+   *
+   * returns:   unsigned long - sequence number of frame
+   */
+  unsigned long QueueFrame();
+
+  struct ChangedPixels;
+
+  /**
+   * PublishChangedPixels() - Sets the changed pixels returned by GetChangedPixels() unless a later frame has already set them
+   *
+   * last_changed:    detector's last changed pixels
+   * frame:           sequence number of frame
+   * changed_pixels:  number of pixels that were different in frame
+   */
+  static void PublishChangedPixels(ChangedPixels& last_changed, unsigned long frame, unsigned int changed_pixels);
+
+  /**
+   * InitKernelDefines() - Creates the -D options kernels are compiled with (configuration constants with MotionConfig::specialize_kernels only)
+   */
+  void InitKernelDefines();
+
+  /**
+   * LoadRegionBuffers() - Loads OpenCL buffers for labeling and measuring motion regions (MotionConfig::max_regions only)
+   */
+  void LoadRegionBuffers();
+
+  /**
+   * LoadRegionKernels() - Loads OpenCL kernels for labeling and measuring motion regions and picks their tile size (MotionConfig::max_regions only)
+   */
+  void LoadRegionKernels();
+
+  /**
+   * EnqueueLabelRegions() - Queues resetting, labeling and measuring motion regions of the difference frame
+   */
+  void EnqueueLabelRegions();
+
+  /**
+   * MakeMotionResult() - Fills in a motion result for the last processed frame, finding its regions if there is motion
+   *
+   * motion:    if motion was detected
+   * returns:   MotionResult - result of last processed frame
+   */
+  MotionResult MakeMotionResult(bool motion);
+
+  /**
+   * MapRegions() - Orders regions by size, keeps the first max_regions and maps them from scaled pixels to input pixels
+   *
+   * stats:     measured regions in scaled pixels
+   * returns:   std::vector<MotionRegion> - regions in input pixels, most pixels first
+   */
+  std::vector<MotionRegion> MapRegions(std::vector<RegionStats> stats) const;
+
+  /**
+   * GetInputMapping() - Gets how scaled pixels map onto input pixels
+   *
+   * scale:     set to width and height of a scaled pixel in input pixels
+   * margin:    set to input pixels skipped before the first scaled pixel
+   */
+  void GetInputMapping(unsigned int* scale, unsigned int* margin) const;
+
+  /**
+   * RasterizeRoi() - Maps MotionConfig::roi onto scaled pixels and counts the watched pixels
+   */
+  void RasterizeRoi();
+
+  /**
+   * InitDecodeWindow() - Limits decompression to the rows and columns the watched scaled pixels blur from (MotionConfig::roi only)
+   */
+  void InitDecodeWindow();
+
+  /**
+   * LoadRoiTiles() - Builds the lists of tiles with watched pixels and sets the kernels' region of interest arguments (MotionConfig::roi only)
+   */
+  void LoadRoiTiles();
+
+  /**
+   * LoadProgram() - Gets OpenCL program built from given filename with kernel_defines_ from the runtime
    *
    * returns:  cl::Program - built OpenCL program
    */
   cl::Program LoadProgram(const std::string& filename);
 
+  /**
+   * InputSlot - OpenCL buffer that frames are uploaded into and the events guarding it
+   */
+  struct InputSlot {
+    cl::Buffer frame;    // OpenCL buffer for incoming frame to be processed (host mappable, frames are decompressed straight into it)
+    cl::Event uploaded;  // Event for when frame has been unmapped and is visible to kernels
+    cl::Event released;  // Event for when kernels are done reading frame
+  };
+
+  /**
+   * ChangedPixels - Changed pixel count of the newest finished frame, shared with read back callbacks that can outlive a frame's turn
+   */
+  struct ChangedPixels {
+    std::mutex mutex;                 // Guards members below, callbacks publish from an OpenCL thread
+    unsigned long queued_frames = 0;  // Sequence number of the last frame queued
+    unsigned long counted_frame = 0;  // Sequence number of the frame count belongs to
+    unsigned int count = 0;           // Number of pixels that were different in counted_frame
+  };
+
+  /**
+   * AsyncCount - Changed pixel count being read back for an asynchronous frame
+   */
+  struct AsyncCount {
+    unsigned int changed_pixels = 0;              // Destination of read back
+    unsigned int diff_threshold = 0;              // Number of pixels that need to be different for the frame to be counted as motion
+    unsigned long frame = 0;                      // Sequence number of frame
+    std::shared_ptr<ChangedPixels> last_changed;  // Detector's last changed pixels to publish count to
+    std::promise<bool> motion;                    // Fulfilled once changed pixels have been read back
+  };
+
   JpegDecompressor decompressor_;  // Jpeg decompressor
 
-  cl::Device device_;           // OpenCL device motion detection will run on
-  cl::Context context_;         // OpenCL context for device
-  cl::CommandQueue cmd_queue_;  // OpenCL command queue for device
+  std::unique_ptr<NativePipeline> native_;  // CPU pipeline used instead of OpenCL (DeviceType::kNative only)
+
+  std::shared_ptr<DeviceRuntime> runtime_;  // OpenCL context, queues and programs, possibly shared with other detectors
+  cl::Device device_;                       // OpenCL device motion detection will run on
+  cl::Context context_;                     // OpenCL context for device
+  cl::CommandQueue cmd_queue_;              // OpenCL command queue for device (runtime's queue)
+  cl::CommandQueue transfer_queue_;         // OpenCL command queue for uploading asynchronous frames (runtime's queue)
 
   // Inputs
-  cl::Buffer gaussian_;       // OpenCL buffer of gaussian kernel
-  cl::Buffer gaussian_size_;  // OpenCL buffer of gaussian kernel size
-  cl::Buffer scale_;          // OpenCL buffer of scale factor
-  cl::Buffer colors_;         // OpenCL buffer of number of colors
-  cl::Buffer input_width_;    // OpenCL buffer of width of input frame
-  cl::Buffer output_width_;   // OpenCL buffer of width of scaled frame
-  cl::Buffer input_frame_;    // OpenCL buffer for incoming frame to be processed
+  cl::Buffer gaussian_;                 // OpenCL buffer of gaussian kernel
+  cl::Buffer gaussian_size_;            // OpenCL buffer of gaussian kernel size
+  cl::Buffer scale_;                    // OpenCL buffer of scale factor
+  cl::Buffer colors_;                   // OpenCL buffer of number of colors
+  cl::Buffer input_width_;              // OpenCL buffer of width of input frame
+  cl::Buffer output_width_;             // OpenCL buffer of width of scaled frame
+  cl::Buffer output_height_;            // OpenCL buffer of height of scaled frame (ProcessingMode::kFused and kTiled, MotionConfig::max_regions or roi only)
+  std::vector<InputSlot> input_slots_;  // OpenCL buffers for incoming frames to be processed
+  unsigned int next_input_slot_ = 0;    // Index of input slot the next asynchronous frame will use
 
   // Kernel
   cl::Kernel bs_vertical_kernel_;  // OpenCL kernel for blurring and scaling frame vertically
@@ -176,45 +603,112 @@ class MotionDetector {
   // Kernel
   cl::Kernel bs_horizontal_kernel_;  // OpenCL kernel for blurring and scaling frame horizontally
   // Output
-  cl::Buffer scaled_frame_;  // OpenCL buffer for scaled frame
+  cl::Buffer frame_history_;                // OpenCL buffer holding every scaled frame still in use by the background and movement averages
+  std::vector<cl::Buffer> history_frames_;  // OpenCL sub-buffers of frame_history_, one per scaled frame slot
 
   // Inputs
   cl::Buffer bg_length_;             // OpenCL buffer for length of background
   cl::Buffer mvt_length_;            // OpenCL buffer for length of movement
-  cl::Buffer bg_frame_to_remove_;    // OpenCL buffer for background frame to be removed from average
-  cl::Buffer mvt_frame_to_remove_;   // OpenCL buffer for movement frame to be removed from average
   cl::Buffer pixel_diff_threshold_;  // OpenCL buffer for amount pixel needs to be different by to be different
   // Kernel
   cl::Kernel stabilize_kernel_;  // OpenCL kernel for stabilizing background and forground
   // Outputs
   cl::Buffer stabilized_background_;  // OpenCL buffer for stabilzed background
   cl::Buffer stabilized_movement_;    // OpenCL buffer for stabilzied movement
-  cl::Buffer difference_frame_;       // OpenCL buffer for difference between background and movement
+  cl::Buffer difference_frame_;       // OpenCL buffer for difference between background and movement (words of 32 pixels with MotionConfig::packed_mask)
+
+  // Kernel
+  cl::Kernel fused_kernel_;  // OpenCL kernel for blurring, scaling, stabilizing and comparing in one pass (ProcessingMode::kFused only)
+
+  // Inputs
+  cl::Buffer pixel_count_;  // OpenCL buffer for number of pixels in scaled frame
+  // Kernel
+  cl::Kernel count_kernel_;  // OpenCL kernel for counting changed pixels
+  // Output
+  cl::Buffer changed_pixels_;  // OpenCL buffer for number of changed pixels
+
+  // Inputs
+  cl::Buffer min_region_pixels_;  // OpenCL buffer for fewest pixels a region needs (MotionConfig::max_regions only)
+  cl::Buffer max_regions_;        // OpenCL buffer for number of regions there is room for, region_capacity_ (MotionConfig::max_regions only)
+  // Kernels
+  cl::Kernel label_tiles_kernel_;          // OpenCL kernel for labeling regions inside every tile
+  cl::Kernel merge_tiles_kernel_;          // OpenCL kernel for joining regions across tile edges
+  cl::Kernel compress_labels_kernel_;      // OpenCL kernel for pointing every pixel at the root of its region
+  cl::Kernel count_region_pixels_kernel_;  // OpenCL kernel for counting pixels of every region
+  cl::Kernel number_regions_kernel_;       // OpenCL kernel for giving regions with enough pixels a slot
+  cl::Kernel measure_regions_kernel_;      // OpenCL kernel for measuring bounding boxes and coordinate sums of regions
+  // Outputs
+  cl::Buffer labels_;         // OpenCL buffer for location of the root of every changed pixel's region (-1 for unchanged pixels)
+  cl::Buffer region_pixels_;  // OpenCL buffer for pixels of every root, then its slot in regions_ (reset before every labeling)
+  cl::Buffer region_count_;   // OpenCL buffer for number of regions with enough pixels (reset before every labeling)
+  cl::Buffer regions_;        // OpenCL buffer for pixels, bounding box and coordinate sums of every region
+
+  // Inputs (MotionConfig::roi only)
+  cl::Buffer roi_mask_;            // OpenCL buffer for watched scaled pixels, 1 byte per pixel
+  cl::Buffer roi_tiles_;           // OpenCL buffer for column and row of every scaled tile with a watched pixel
+  cl::Buffer roi_vertical_tiles_;  // OpenCL buffer for column and row of every vertically scaled tile read by a watched tile (ProcessingMode::kSeparable only)
 
   cl::NDRange scaled_global_work_size_2d_;               // 2D Work size of fully scaled down frame
   cl::NDRange intermediate_scaled_global_work_size_2d_;  // 2D Work size of vertically scaled down frame
   cl::NDRange motion_thread_block_size_2d_;              // 2D Work size of thread for motion detection
   cl::NDRange scaled_global_work_size_1d_;               // 1D Work size of fully scaled down frame
   cl::NDRange motion_thread_block_size_1d_;              // 1D Work size of thread for motion detection
-
-  unsigned int newest_frame_loc_ = 0;   // Index of the newest frame in the list of all frames
-  unsigned int bg_remove_loc_;          // Index of background frame to remove in the list of all frames
-  unsigned int mvt_remove_loc_;         // Index of movement frame to remove in the list of all frames
-  std::vector<unsigned char*> frames_;  // List of all frames
-
-  unsigned int diff_threshold_;  // Number of pixels that need to be different for the frame to be counted as motion
+  cl::NDRange fused_global_work_size_2d_;                // 2D Work size of fused kernel (multiple of fused_thread_block_size_2d_)
+  cl::NDRange fused_thread_block_size_2d_;               // 2D Work size of thread block (tile) for fused kernel
+  unsigned int fused_tile_size_;                         // Width and height of fused kernel tiles in scaled pixels
+  cl::NDRange tiled_vertical_global_work_size_2d_;       // 2D Work size of tiled vertical kernel (4 columns per work item, multiple of thread block)
+  cl::NDRange tiled_vertical_thread_block_size_2d_;      // 2D Work size of thread block for tiled vertical kernel
+  cl::NDRange tiled_horizontal_global_work_size_2d_;     // 2D Work size of tiled horizontal kernel (multiple of thread block)
+  cl::NDRange tiled_horizontal_thread_block_size_2d_;    // 2D Work size of thread block for tiled horizontal kernel
+  cl::NDRange count_global_work_size_1d_;                // 1D Work size of counting changed pixels (multiple of count_thread_block_size_1d_)
+  cl::NDRange count_thread_block_size_1d_;               // 1D Work size of thread block for counting changed pixels
+  unsigned int count_block_size_;                        // Number of work items in a thread block for counting changed pixels
+  cl::NDRange stabilize_thread_block_size_1d_;           // 1D Work size of thread block for stabilizing (MotionConfig::packed_mask only)
+  unsigned int stabilize_block_size_ = 0;                // Number of work items in a thread block for stabilizing (MotionConfig::packed_mask only)
+  cl::NDRange region_global_work_size_2d_;               // 2D Work size of labeling regions (multiple of region_thread_block_size_2d_)
+  cl::NDRange region_thread_block_size_2d_;              // 2D Work size of thread block (tile) for labeling regions
+  unsigned int region_tile_size_ = 0;                    // Width and height of region labeling tiles in scaled pixels (MotionConfig::max_regions only)
+  unsigned int region_capacity_ = 0;                     // Slots in regions_, enough for every region the difference frame can hold (MotionConfig::max_regions only)
+  cl::NDRange roi_global_work_size_2d_;                  // 2D Work size of one thread block per watched tile (MotionConfig::roi only)
+  cl::NDRange roi_vertical_global_work_size_2d_;         // 2D Work size of one thread block per vertically scaled tile read by a watched tile
+  cl::NDRange roi_thread_block_size_2d_;                 // 2D Work size of thread block (tile) for watched tiles
+  unsigned int roi_tile_size_ = 0;                       // Width and height of watched tiles in pixels (MotionConfig::roi only)
+  unsigned int roi_tile_count_ = 0;                      // Number of scaled tiles with a watched pixel
+  unsigned int roi_vertical_tile_count_ = 0;             // Number of vertically scaled tiles read by a watched tile (ProcessingMode::kSeparable only)
+
+  unsigned int newest_frame_loc_ = 0;  // Index of the newest frame in the frame history
+  unsigned int bg_remove_loc_;         // Index of background frame to remove in the frame history
+  unsigned int mvt_remove_loc_;        // Index of movement frame to remove in the frame history
+
+  unsigned int decode_scale_ = 1;  // Amount frames are scaled down by while decompressing (MotionConfig::dct_scaling only)
+  unsigned int diff_threshold_;    // Number of pixels that need to be different for the frame to be counted as motion
+  unsigned int watched_pixels_;    // Number of scaled pixels watched for motion (every pixel unless MotionConfig::roi)
+
+  std::shared_ptr<ChangedPixels> last_changed_pixels_ = std::make_shared<ChangedPixels>();  // Changed pixels of the newest finished frame
 
   unsigned int input_frame_buffer_size_;                // Size of frame input
   unsigned int intermediate_scaled_frame_buffer_size_;  // Size of intermediate scaling step
   unsigned int scaled_frame_buffer_size_;               // Size of scaled frame for motion detection (no color data)
+  unsigned int stabilized_element_size_;                // Bytes per pixel of stabilized background and movement (float, or sum with MotionConfig::integer_sums)
+  unsigned int mask_words_;                             // Number of words in packed difference mask (covers every stabilize work item, MotionConfig::packed_mask only)
+  unsigned int history_length_;                         // Number of scaled frames kept in the frame history (1 with BackgroundModel::kExponential)
+  unsigned int history_frame_stride_;                   // Distance between scaled frames in the frame history (aligned for sub-buffers)
   unsigned int scaled_width_;                           // Width of scaled frames
   unsigned int scaled_height_;                          // Height of scaled frames
+  std::vector<unsigned char> roi_scaled_;               // 1 for every watched scaled pixel (empty unless MotionConfig::roi)
+  std::vector<unsigned char> window_frame_;             // Frame native device decompresses decode windows into, input slots keep their contents (empty without a window)
 
   InputVideoSettings input_vid_;  // Metadata about MJPEG stream coming in
   MotionConfig motion_config_;    // Settings for how exactly to run motion detection
   DeviceConfig device_config_;    // Settings for which device to run motion detection on
 
+  std::string kernel_defines_;  // -D options every kernel is compiled with (empty unless MotionConfig::specialize_kernels, integer_sums or packed_mask)
+
   std::ostream* info;  // Output stream for info messages
+
+  std::mutex pending_mutex_;                       // Guards pending_motion_
+  std::deque<std::promise<bool>> pending_motion_;  // Futures of frames queued on decoder_, oldest first
+  std::unique_ptr<ParallelDecoder> decoder_;       // Decode threads (MotionConfig::decode_threads only, destroyed first so queued frames finish)
 };
 
 #endif
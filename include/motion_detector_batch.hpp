@@ -0,0 +1,228 @@
+#ifndef MOTION_DETECTOR_BATCH_HPP
+#define MOTION_DETECTOR_BATCH_HPP
+
+#include <CL/opencl.h>
+
+#include <CL/cl2.hpp>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "device_runtime.hpp"
+#include "jpeg_decompressor.hpp"
+#include "motion_detector.hpp"
+#include "open_cl_interface.hpp"
+#include "thread_pool.hpp"
+
+/**
+ * MotionDetectorBatch - Detects motion on several MJPEG streams with the same resolution and configuration at once
+ *
+ * State of every stream is stacked in the same OpenCL buffers, so each step runs as one kernel launch over all streams
+ * and one read brings back every stream's changed pixels. Gives the same results as a MotionDetector per stream.
+ * Always runs the kSeparable steps (processing_mode kFused and kTiled are treated as kSeparable, kDCBlocks, packed_mask and max_regions are not supported).
+ */
+class MotionDetectorBatch {
+ public:
+  /**
+   * MotionDetectorBatch() - Constructor for MotionDetectorBatch
+   *
+   * input_vid_settings:   Metadata about the MJPEG streams coming in
+   * motion_config:        Settings for how exactly to run motion detection (decode_threads splits a batch across threads, 0 decompresses on the calling thread
+   *                       and splits frames across strip_threads)
+   * streams:              Number of streams, every batch has one frame per stream
+   * device_config:        Settings for which device to run motion detection on (not DeviceType::kNative)
+   * output:               Output stream for info messages
+   */
+  MotionDetectorBatch(InputVideoSettings input_vid_settings, MotionConfig motion_config, unsigned int streams, DeviceConfig device_config, std::ostream* output);
+
+  /**
+   * MotionDetectorBatch() - Constructor for MotionDetectorBatch sharing a device's context, queues and programs
+   *
+   * input_vid_settings:   Metadata about the MJPEG streams coming in
+   * motion_config:        Settings for how exactly to run motion detection
+   * streams:              Number of streams, every batch has one frame per stream
+   * runtime:              OpenCL device to run motion detection on
+   * output:               Output stream for info messages
+   */
+  MotionDetectorBatch(InputVideoSettings input_vid_settings, MotionConfig motion_config, unsigned int streams, std::shared_ptr<DeviceRuntime> runtime,
+                      std::ostream* output);
+
+  /**
+   * ~MotionDetectorBatch() - Deconstructor for MotionDetectorBatch
+   */
+  ~MotionDetectorBatch();
+
+  MotionDetectorBatch(const MotionDetectorBatch&) = delete;
+  MotionDetectorBatch& operator=(const MotionDetectorBatch&) = delete;
+
+  /**
+   * DetectOnFrames() - Processes one MJPEG frame of every stream for motion detection
+   *
+   * If any frame fails to decompress the exception is rethrown and no stream's state changes.
+   *
+   * frames:    JPEG image and size of JPEG image buffer of every stream, in stream order
+   * returns:   std::vector<bool> - if motion is detected or not on every stream
+   */
+  std::vector<bool> DetectOnFrames(const std::vector<std::pair<const unsigned char*, unsigned long>>& frames);
+
+  /**
+   * DetectOnDecompressedFrames() - Processes one decompressed frame of every stream for motion detection
+   *
+   * frames:    images in the format used to construct MotionDetectorBatch, in stream order
+   *              (note: image format will not be checked, with dct_scaling they must already be scaled down by GetDecodeScale())
+   * returns:   std::vector<bool> - if motion is detected or not on every stream
+   */
+  std::vector<bool> DetectOnDecompressedFrames(const std::vector<const unsigned char*>& frames);
+
+  /**
+   * GetStreamCount() - Gets the number of streams
+   *
+   * returns:   unsigned int - number of streams
+   */
+  unsigned int GetStreamCount() const;
+
+  /**
+   * GetChangedPixels() - Gets the number of pixels that were different in a stream's last frame
+   *
+   * stream:    index of stream
+   * returns:   unsigned int - number of changed pixels
+   */
+  unsigned int GetChangedPixels(unsigned int stream) const;
+
+  /**
+   * GetMotionScore() - Gets the fraction of pixels that were different in a stream's last frame
+   *
+   * stream:    index of stream
+   * returns:   float - changed pixels divided by pixels in a scaled frame (0.0 - 1.0)
+   */
+  float GetMotionScore(unsigned int stream) const;
+
+  /**
+   * GetDecodeScale() - Gets amount frames are scaled down by while decompressing
+   *
+   * returns:   unsigned int - decode scale (1 unless MotionConfig::dct_scaling)
+   */
+  unsigned int GetDecodeScale() const;
+
+ private:
+  /**
+   * MotionDetectorBatch() - Constructor both public constructors delegate to
+   *
+   * runtime:   OpenCL device to share (nullptr creates one from device_config)
+   */
+  MotionDetectorBatch(InputVideoSettings input_vid_settings, MotionConfig motion_config, unsigned int streams, DeviceConfig device_config,
+                      std::shared_ptr<DeviceRuntime> runtime, std::ostream* output);
+
+  /**
+   * ValidateSettings() - Validates settings for batch
+   */
+  void ValidateSettings() const;
+
+  /**
+   * CalculateBufferSizes() - Calculates sizes of one stream's part of every buffer
+   */
+  void CalculateBufferSizes();
+
+  /**
+   * LoadBuffers() - Creates stacked OpenCL buffers and configuration buffers
+   */
+  void LoadBuffers();
+
+  /**
+   * InitKernelDefines() - Creates the -D options that compile configuration constants into the kernels (MotionConfig::specialize_kernels only)
+   */
+  void InitKernelDefines();
+
+  /**
+   * LoadKernels() - Builds kernels and sets their arguments
+   */
+  void LoadKernels();
+
+  /**
+   * InitWorkSizes() - Creates work sizes covering every stream
+   */
+  void InitWorkSizes();
+
+  /**
+   * ProcessBatch() - Queues blur and scale, stabilize and compare, and count kernels over every stream, then reads back changed pixels
+   *
+   * returns:   std::vector<bool> - if motion is detected or not on every stream
+   */
+  std::vector<bool> ProcessBatch();
+
+  unsigned int streams_;  // Number of streams
+
+  std::vector<std::unique_ptr<JpegDecompressor>> decompressors_;  // Jpeg decompressor of every stream, or one shared by all of them without decode_threads
+  std::unique_ptr<ThreadPool> decode_pool_;                       // Threads a batch is decompressed on (MotionConfig::decode_threads only)
+
+  std::shared_ptr<DeviceRuntime> runtime_;  // OpenCL context, queues and programs, possibly shared with other detectors
+  cl::Device device_;                       // OpenCL device motion detection will run on
+  cl::Context context_;                     // OpenCL context for device
+  cl::CommandQueue cmd_queue_;              // OpenCL command queue for device (runtime's queue)
+
+  // Configuration
+  cl::Buffer gaussian_;              // OpenCL buffer of gaussian kernel
+  cl::Buffer gaussian_size_;         // OpenCL buffer of gaussian kernel size
+  cl::Buffer scale_;                 // OpenCL buffer of scale factor
+  cl::Buffer colors_;                // OpenCL buffer of number of colors in input frames
+  cl::Buffer input_width_;           // OpenCL buffer of input frame width
+  cl::Buffer output_width_;          // OpenCL buffer of scaled frame width
+  cl::Buffer input_stride_;          // OpenCL buffer of distance between streams in input_frames_
+  cl::Buffer intermediate_stride_;   // OpenCL buffer of distance between streams in intermediate_scaled_frames_
+  cl::Buffer scaled_stride_;         // OpenCL buffer of distance between streams in scaled, stabilized and difference frames
+  cl::Buffer bg_length_;             // OpenCL buffer for length of background
+  cl::Buffer mvt_length_;            // OpenCL buffer for length of movement
+  cl::Buffer pixel_diff_threshold_;  // OpenCL buffer for amount pixel needs to be different by to be different
+  cl::Buffer pixel_count_;           // OpenCL buffer for number of pixels in scaled frame
+
+  // Stacked state of every stream
+  cl::Buffer input_frames_;                 // OpenCL buffer of every stream's input frame
+  cl::Buffer intermediate_scaled_frames_;   // OpenCL buffer of every stream's vertically scaled frame
+  cl::Buffer frame_history_;                // OpenCL buffer of every stream's scaled frames still in use by the background and movement averages
+  std::vector<cl::Buffer> history_frames_;  // OpenCL sub-buffers of frame_history_, one per history slot holding a scaled frame of every stream
+  cl::Buffer stabilized_background_;        // OpenCL buffer for every stream's stabilzed background
+  cl::Buffer stabilized_movement_;          // OpenCL buffer for every stream's stabilzied movement
+  cl::Buffer difference_frames_;            // OpenCL buffer for every stream's difference between background and movement
+  cl::Buffer changed_pixels_;               // OpenCL buffer for every stream's number of changed pixels
+
+  cl::Kernel bs_vertical_kernel_;    // OpenCL kernel for blurring and scaling frames vertically
+  cl::Kernel bs_horizontal_kernel_;  // OpenCL kernel for blurring and scaling frames horizontally
+  cl::Kernel stabilize_kernel_;      // OpenCL kernel for stabilizing background and forground
+  cl::Kernel count_kernel_;          // OpenCL kernel for counting changed pixels of every stream
+
+  cl::NDRange vertical_global_work_size_3d_;    // 3D Work size of vertically scaled frames of every stream
+  cl::NDRange horizontal_global_work_size_3d_;  // 3D Work size of fully scaled frames of every stream
+  cl::NDRange stabilize_global_work_size_1d_;   // 1D Work size of scaled frames of every stream (padding included)
+  cl::NDRange count_global_work_size_2d_;       // 2D Work size of counting changed pixels of every stream (multiple of count_thread_block_size_2d_)
+  cl::NDRange count_thread_block_size_2d_;      // 2D Work size of thread block for counting changed pixels (one stream per block)
+  unsigned int count_block_size_;               // Number of work items in a thread block for counting changed pixels
+
+  unsigned int newest_frame_loc_ = 0;  // Index of the newest history slot
+  unsigned int bg_remove_loc_;         // Index of background history slot to remove
+  unsigned int mvt_remove_loc_;        // Index of movement history slot to remove
+
+  unsigned int decode_scale_ = 1;                  // Amount frames are scaled down by while decompressing (MotionConfig::dct_scaling only)
+  unsigned int diff_threshold_;                    // Number of pixels that need to be different for a frame to be counted as motion
+  std::vector<unsigned int> last_changed_pixels_;  // Number of pixels that were different in every stream's last frame
+
+  unsigned int input_frame_buffer_size_;                // Size of one stream's input frame
+  unsigned int intermediate_scaled_frame_buffer_size_;  // Size of one stream's intermediate scaling step
+  unsigned int scaled_frame_buffer_size_;               // Size of one stream's scaled frame
+  unsigned int stabilized_element_size_;                // Bytes per pixel of stabilized background and movement (float, or sum with MotionConfig::integer_sums)
+  unsigned int history_length_;                         // Number of history slots (1 with BackgroundModel::kExponential)
+  unsigned int history_slot_stride_;                    // Distance between history slots in frame_history_ (aligned for sub-buffers)
+  unsigned int scaled_width_;                           // Width of scaled frames
+  unsigned int scaled_height_;                          // Height of scaled frames
+
+  InputVideoSettings input_vid_;  // Metadata about MJPEG streams coming in (after decode scaling)
+  MotionConfig motion_config_;    // Settings for how exactly to run motion detection
+  DeviceConfig device_config_;    // Settings for which device to run motion detection on
+
+  std::string kernel_defines_;  // -D options every kernel is compiled with (empty unless MotionConfig::specialize_kernels or MotionConfig::integer_sums)
+
+  std::ostream* info;  // Output stream for info messages
+};
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef MOTION_DETECTOR_CASCADE_HPP
+#define MOTION_DETECTOR_CASCADE_HPP
+
+#include <memory>
+#include <ostream>
+
+#include "device_runtime.hpp"
+#include "motion_detector.hpp"
+
+/**
+ * CascadeConfig - Settings for how a MotionDetectorCascade escalates from its coarse model to its fine model
+ *
+ * coarse_scale_denominator:  amount coarse model scales down input by (decompressed with IDCT scaling as far as it goes, must be more than the fine scale)
+ * pre_trigger:               percentage of coarse pixels that need to change to run the fine model (lower than min_changed_pixels so motion is not missed)
+ * warm_interval:             fine model is given every warm_interval'th frame while idle so its averages stay recent (1 gives it every frame)
+ * hold_frames:               frames the fine model keeps running for after the coarse model drops below the pre-trigger
+ */
+struct CascadeConfig {
+  unsigned int coarse_scale_denominator = 16;
+  float pre_trigger = 0.0F;
+  unsigned int warm_interval = 8;
+  unsigned int hold_frames = 4;
+};
+
+/**
+ * MotionDetectorCascade - Detects motion on MJPEG stream with a cheap coarse model, only running the full resolution model when the coarse one suspects motion
+ *
+ * Coarse model is a MotionDetector with the same settings at coarse_scale_denominator that sees every frame. Fine model is a MotionDetector with
+ * the given settings that sees frames while the coarse model is over the pre-trigger (and hold_frames after), plus every warm_interval'th frame
+ * otherwise. Frames the fine model does not see never have motion. Both models share one DeviceRuntime on OpenCL devices.
+ */
+class MotionDetectorCascade {
+ public:
+  /**
+   * MotionDetectorCascade() - Constructor for MotionDetectorCascade
+   *
+   * input_vid_settings:   Metadata about MJPEG stream coming in
+   * motion_config:        Settings for fine model (decode_threads is not used, max_regions and min_region_pixels are left out of coarse model)
+   * cascade_config:       Settings for coarse model and escalating to fine model
+   * device_config:        Settings for which device to run both models on
+   * output:               Output stream for info messages
+   */
+  MotionDetectorCascade(InputVideoSettings input_vid_settings, MotionConfig motion_config, CascadeConfig cascade_config, DeviceConfig device_config,
+                        std::ostream* output);
+
+  /**
+   * MotionDetectorCascade() - Constructor for MotionDetectorCascade sharing a device's context, queues and programs with other detectors
+   *
+   * input_vid_settings:   Metadata about MJPEG stream coming in
+   * motion_config:        Settings for fine model
+   * cascade_config:       Settings for coarse model and escalating to fine model
+   * runtime:              OpenCL device to run both models on
+   * output:               Output stream for info messages
+   */
+  MotionDetectorCascade(InputVideoSettings input_vid_settings, MotionConfig motion_config, CascadeConfig cascade_config, std::shared_ptr<DeviceRuntime> runtime,
+                        std::ostream* output);
+
+  /**
+   * DetectOnFrame() - Processes a MJPEG frame with the coarse model and the fine model if needed
+   *
+   * frame:     JPEG image
+   * size:      Size of JPEG image buffer
+   * returns:   bool - if fine model saw the frame and detected motion
+   */
+  bool DetectOnFrame(const unsigned char* frame, unsigned long size);
+
+  /**
+   * WasEscalated() - Checks if the last frame was given to the fine model because the coarse model suspected motion (or was holding)
+   *
+   * returns:   bool - if last frame was escalated (false for frames only given to the fine model to keep it warm)
+   */
+  bool WasEscalated() const;
+
+  /**
+   * GetMotionScore() - Gets the fraction of fine pixels that changed in the last frame the fine model saw
+   *
+   * returns:   float - changed pixels divided by watched pixels in fine scaled frame (0.0 - 1.0)
+   */
+  float GetMotionScore() const;
+
+  /**
+   * GetCoarseMotionScore() - Gets the fraction of coarse pixels that changed in the last frame
+   *
+   * returns:   float - changed pixels divided by watched pixels in coarse scaled frame (0.0 - 1.0)
+   */
+  float GetCoarseMotionScore() const;
+
+  /**
+   * GetFrameCount() - Gets the number of frames processed
+   *
+   * returns:   unsigned long - frames seen by the coarse model
+   */
+  unsigned long GetFrameCount() const;
+
+  /**
+   * GetFineFrameCount() - Gets the number of frames the fine model processed
+   *
+   * returns:   unsigned long - frames seen by the fine model, escalated or to keep it warm
+   */
+  unsigned long GetFineFrameCount() const;
+
+ private:
+  /**
+   * MotionDetectorCascade() - Constructor both public constructors delegate to
+   */
+  MotionDetectorCascade(InputVideoSettings input_vid_settings, MotionConfig motion_config, CascadeConfig cascade_config, DeviceConfig device_config,
+                        std::shared_ptr<DeviceRuntime> runtime, std::ostream* output);
+
+  /**
+   * ValidateSettings() - Validates cascade settings against fine model settings and throws std::invalid_argument if they are invalid
+   */
+  void ValidateSettings(const MotionConfig& motion_config) const;
+
+  CascadeConfig cascade_config_;  // Settings for coarse model and escalating
+
+  std::unique_ptr<MotionDetector> coarse_;  // Model that sees every frame
+  std::unique_ptr<MotionDetector> fine_;    // Model that sees escalated frames and every warm_interval'th frame
+
+  bool escalated_ = false;              // If last frame was escalated to fine model
+  unsigned int hold_remaining_ = 0;     // Frames left to escalate after coarse model dropped below pre-trigger
+  unsigned int frames_since_fine_ = 0;  // Frames since fine model last saw a frame
+  unsigned long frame_count_ = 0;       // Frames processed
+  unsigned long fine_frame_count_ = 0;  // Frames fine model processed
+};
+
+#endif
@@ -0,0 +1,193 @@
+#ifndef MOTION_DETECTOR_GOVERNOR_HPP
+#define MOTION_DETECTOR_GOVERNOR_HPP
+
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "device_runtime.hpp"
+#include "motion_detector.hpp"
+
+/**
+ * GovernorConfig - Settings for how a MotionDetectorGovernor sheds load
+ *
+ * latency_budget_ms:  average time in milliseconds each incoming frame may take, usually the frame interval of the stream
+ * max_decimation:     most frames that share one processed frame under load (1 never skips frames)
+ * recover_ratio:      fraction of the budget the next lower decimation has to fit in before stepping down to it (0.0 - 1.0, lower recovers later)
+ */
+struct GovernorConfig {
+  float latency_budget_ms = 33.0F;
+  unsigned int max_decimation = 8;
+  float recover_ratio = 0.5F;
+};
+
+/**
+ * MotionDetectorGovernor - Detects motion on MJPEG stream within a latency budget, processing every k-th frame when frames take longer than the budget
+ *
+ * Decimation steps through 1, 2, 4, ... up to max_decimation. Every decimation has its own MotionDetector with bg_stabil_length and
+ * motion_stabil_length divided by the decimation, so averages cover the same time whatever the decimation. The next decimation up is also given
+ * its share of the processed frames, so stepping up under load switches to a detector with recent averages. Stepping down switches to a detector
+ * that has to refill its averages first, and frames processed while it settles are suppressed (never have motion, see IsSettling()). Skipped
+ * frames never have motion either, so load shedding is bounded by max_decimation instead of growing a queue.
+ */
+class MotionDetectorGovernor {
+ public:
+  /**
+   * MotionDetectorGovernor() - Constructor for MotionDetectorGovernor
+   *
+   * input_vid_settings:   Metadata about MJPEG stream coming in
+   * motion_config:        Settings for motion detection without decimation (decode_threads is not used)
+   * governor_config:      Settings for latency budget and decimation
+   * device_config:        Settings for which device to run on
+   * output:               Output stream for info messages
+   */
+  MotionDetectorGovernor(InputVideoSettings input_vid_settings, MotionConfig motion_config, GovernorConfig governor_config, DeviceConfig device_config,
+                         std::ostream* output);
+
+  /**
+   * MotionDetectorGovernor() - Constructor for MotionDetectorGovernor sharing a device's context, queues and programs with other detectors
+   *
+   * input_vid_settings:   Metadata about MJPEG stream coming in
+   * motion_config:        Settings for motion detection without decimation
+   * governor_config:      Settings for latency budget and decimation
+   * runtime:              OpenCL device to run on
+   * output:               Output stream for info messages
+   */
+  MotionDetectorGovernor(InputVideoSettings input_vid_settings, MotionConfig motion_config, GovernorConfig governor_config,
+                         std::shared_ptr<DeviceRuntime> runtime, std::ostream* output);
+
+  /**
+   * DetectOnFrame() - Processes a MJPEG frame unless it is skipped by the current decimation
+   *
+   * frame:     JPEG image
+   * size:      Size of JPEG image buffer
+   * returns:   bool - if frame was processed and motion was detected
+   */
+  bool DetectOnFrame(const unsigned char* frame, unsigned long size);
+
+  /**
+   * SetLatencyBudget() - Changes the latency budget, decimation follows on the next processed frames
+   *
+   * latency_budget_ms:   average time in milliseconds each incoming frame may take
+   */
+  void SetLatencyBudget(float latency_budget_ms);
+
+  /**
+   * WasProcessed() - Checks if the last frame was processed
+   *
+   * returns:   bool - if last frame was processed (false if it was skipped)
+   */
+  bool WasProcessed() const;
+
+  /**
+   * IsSettling() - Checks if the current detector is still refilling its averages after a step, and its results are suppressed
+   *
+   * returns:   bool - if processed frames are suppressed
+   */
+  bool IsSettling() const;
+
+  /**
+   * GetDecimation() - Gets how many incoming frames currently share one processed frame
+   *
+   * returns:   unsigned int - current decimation (1 processes every frame)
+   */
+  unsigned int GetDecimation() const;
+
+  /**
+   * GetAverageProcessingTime() - Gets the smoothed time processed frames took
+   *
+   * returns:   float - milliseconds per processed frame
+   */
+  float GetAverageProcessingTime() const;
+
+  /**
+   * GetMotionScore() - Gets the fraction of pixels that changed in the last processed frame
+   *
+   * returns:   float - changed pixels divided by watched pixels in scaled frame (0.0 - 1.0)
+   */
+  float GetMotionScore() const;
+
+  /**
+   * GetProcessedFrames() - Gets the number of frames processed
+   *
+   * returns:   unsigned long - frames given to a MotionDetector
+   */
+  unsigned long GetProcessedFrames() const;
+
+  /**
+   * GetDroppedFrames() - Gets the number of frames skipped to stay within the latency budget
+   *
+   * returns:   unsigned long - frames skipped without being decompressed
+   */
+  unsigned long GetDroppedFrames() const;
+
+  /**
+   * GetSuppressedFrames() - Gets the number of processed frames whose result was suppressed while a detector settled
+   *
+   * returns:   unsigned long - processed frames reported as no motion because the detector's averages were being refilled
+   */
+  unsigned long GetSuppressedFrames() const;
+
+ private:
+  /**
+   * MotionDetectorGovernor() - Constructor both public constructors delegate to
+   */
+  MotionDetectorGovernor(InputVideoSettings input_vid_settings, MotionConfig motion_config, GovernorConfig governor_config, DeviceConfig device_config,
+                         std::shared_ptr<DeviceRuntime> runtime, std::ostream* output);
+
+  /**
+   * ValidateSettings() - Validates governor settings and throws std::invalid_argument if they are invalid
+   */
+  void ValidateSettings() const;
+
+  /**
+   * AdjustDecimation() - Steps decimation up when the average time per incoming frame is over the budget, or down when the lower one fits
+   */
+  void AdjustDecimation();
+
+  /**
+   * SelectLevel() - Switches to another decimation, letting its detector refill whatever its averages are missing before reporting motion
+   *
+   * level:     index of decimation to switch to
+   */
+  void SelectLevel(unsigned int level);
+
+  /**
+   * FeedLevel() - Gives the current frame to a decimation's detector
+   *
+   * level:     index of decimation
+   * frame:     JPEG image
+   * size:      Size of JPEG image buffer
+   * returns:   bool - if detector detected motion
+   */
+  bool FeedLevel(unsigned int level, const unsigned char* frame, unsigned long size);
+
+  /**
+   * GetWarmFrames() - Gets how many frames in a row a decimation's detector has been given at its decimation
+   *
+   * level:     index of decimation
+   * returns:   unsigned int - frames in its averages (0 if it has missed frames since)
+   */
+  unsigned int GetWarmFrames(unsigned int level) const;
+
+  GovernorConfig governor_config_;  // Settings for latency budget and decimation
+  std::ostream* info;               // Output stream for info messages
+
+  std::vector<unsigned int> decimations_;                   // Decimation of every level, doubling up to max_decimation
+  std::vector<unsigned int> settle_lengths_;                // Frames every level's detector needs to refill its averages
+  std::vector<std::unique_ptr<MotionDetector>> detectors_;  // Detector of every level with stabilization lengths scaled to its decimation
+  std::vector<unsigned long> last_fed_;                     // Incoming frame every level's detector was last given
+  std::vector<unsigned int> warm_frames_;                   // Frames in a row every level's detector has been given at its decimation
+
+  unsigned int level_ = 0;               // Index of current decimation
+  unsigned int skip_remaining_ = 0;      // Frames left to skip before the next processed frame
+  unsigned int settle_remaining_ = 0;    // Processed frames left before current detector's averages are refilled
+  float average_ms_ = 0.0F;              // Smoothed milliseconds per processed frame, including keeping the next decimation warm
+  bool processed_ = false;               // If last frame was processed
+  unsigned long frame_count_ = 0;        // Incoming frames
+  unsigned long processed_frames_ = 0;   // Frames processed
+  unsigned long dropped_frames_ = 0;     // Frames skipped
+  unsigned long suppressed_frames_ = 0;  // Processed frames suppressed while settling
+};
+
+#endif
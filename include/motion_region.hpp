@@ -0,0 +1,64 @@
+#ifndef MOTION_REGION_HPP
+#define MOTION_REGION_HPP
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * MotionRegion - Connected changed pixels of a frame (8 connected), in input frame pixels
+ *
+ * x:           left edge of bounding box
+ * y:           top edge of bounding box
+ * width:       width of bounding box
+ * height:      height of bounding box
+ * pixels:      number of changed scaled pixels in region
+ * centroid_x:  horizontal center of the changed pixels
+ * centroid_y:  vertical center of the changed pixels
+ */
+struct MotionRegion {
+  unsigned int x;
+  unsigned int y;
+  unsigned int width;
+  unsigned int height;
+  unsigned int pixels;
+  float centroid_x;
+  float centroid_y;
+};
+
+/**
+ * MotionResult - Result of motion detection on a frame along with where the motion is
+ *
+ * motion:          if motion is detected or not
+ * changed_pixels:  number of pixels that were different
+ * motion_score:    changed pixels divided by pixels in scaled frame (0.0 - 1.0)
+ * regions:         regions of changed pixels, most pixels first (empty unless motion is detected)
+ */
+struct MotionResult {
+  bool motion = false;
+  unsigned int changed_pixels = 0;
+  float motion_score = 0;
+  std::vector<MotionRegion> regions;
+};
+
+/**
+ * RegionStats - Connected changed pixels of a frame as they are measured, in scaled frame pixels
+ *
+ * pixels:  number of changed pixels in region
+ * min_x:   leftmost column of region
+ * max_x:   rightmost column of region
+ * min_y:   top row of region
+ * max_y:   bottom row of region
+ * sum_x:   columns of every pixel in region added together
+ * sum_y:   rows of every pixel in region added together
+ */
+struct RegionStats {
+  unsigned int pixels;
+  unsigned int min_x;
+  unsigned int max_x;
+  unsigned int min_y;
+  unsigned int max_y;
+  uint64_t sum_x;
+  uint64_t sum_y;
+};
+
+#endif
@@ -0,0 +1,178 @@
+#ifndef NATIVE_PIPELINE_HPP
+#define NATIVE_PIPELINE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "motion_region.hpp"
+#include "thread_pool.hpp"
+
+/**
+ * NativePipeline - Blurs, scales, stabilizes and compares frames on the CPU without OpenCL
+ *
+ * Does the same math in the same order as the OpenCL kernels, so results match the OpenCL path.
+ * Rows are split into bands across a thread pool and each band is vectorized with AVX2, SSE4.1 or NEON when compiled for them.
+ */
+class NativePipeline {
+ public:
+  /**
+   * NativePipeline() - Constructor for NativePipeline
+   *
+   * gaussian:              gaussian kernel, already scaled to scale
+   * scale:                 amount to scale down input by
+   * colors:                number of color channels in input frames
+   * input_width:           width of input frames in pixels
+   * scaled_width:          width of scaled frames in pixels
+   * scaled_height:         height of scaled frames in pixels
+   * bg_length:             number of frames in stabilized background
+   * mvt_length:            number of frames in stabilized movement
+   * pixel_diff_threshold:  amount pixel needs to be different by to be different
+   * threads:               number of threads to run on (0 means one per core)
+   * integer_sums:          keep exact window sums instead of float averages (MotionConfig::integer_sums)
+   * exponential_average:   keep exponential moving averages and only the newest frame instead of windows (BackgroundModel::kExponential)
+   */
+  NativePipeline(const std::vector<float>& gaussian, unsigned int scale, unsigned int colors, unsigned int input_width, unsigned int scaled_width,
+                 unsigned int scaled_height, unsigned int bg_length, unsigned int mvt_length, unsigned int pixel_diff_threshold, unsigned int threads,
+                 bool integer_sums = false, bool exponential_average = false);
+
+  /**
+   * BlurAndScale() - Blurs and scales a frame into the newest slot of the frame history
+   *
+   * frame:     input frame
+   * returns:   const unsigned char* - blurred and scaled frame (scaled_width x scaled_height)
+   */
+  const unsigned char* BlurAndScale(const unsigned char* frame);
+
+  /**
+   * SetScaledFrame() - Copies a frame that is already scaled into the newest slot of the frame history
+   *
+   * scaled:    scaled frame (scaled_width x scaled_height)
+   * returns:   const unsigned char* - newest frame in frame history
+   */
+  const unsigned char* SetScaledFrame(const unsigned char* scaled);
+
+  /**
+   * StabilizeAndCompareFrames() - Averages background and motion frames and compares them
+   *
+   * returns:   const bool* - frame of differences (scaled_width x scaled_height)
+   */
+  const bool* StabilizeAndCompareFrames();
+
+  /**
+   * CountDifferences() - Counts the changed pixels in the difference frame
+   *
+   * returns:   unsigned int - number of pixels that are different
+   */
+  unsigned int CountDifferences();
+
+  /**
+   * PackDifferenceMask() - Packs the difference frame into 32 bit words, 1 bit per pixel (same layout as MotionConfig::packed_mask)
+   *
+   * mask:      destination, (scaled_width x scaled_height + 31) / 32 words
+   */
+  void PackDifferenceMask(uint32_t* mask) const;
+
+  /**
+   * FindRegions() - Labels 8 connected changed pixels in the difference frame and measures every region
+   *
+   * min_pixels:  smallest number of pixels a region needs to be returned
+   * returns:     std::vector<RegionStats> - every region with at least min_pixels pixels, in order of their first pixel
+   */
+  std::vector<RegionStats> FindRegions(unsigned int min_pixels) const;
+
+  /**
+   * SetRoiMask() - Only watches some scaled pixels, rows without any are not blurred and scaled (MotionConfig::roi)
+   *
+   * mask:      one byte per scaled pixel, 1 if watched (scaled_width x scaled_height)
+   */
+  void SetRoiMask(const std::vector<unsigned char>& mask);
+
+  /**
+   * GetThreadCount() - Gets the number of threads the pipeline runs on
+   *
+   * returns:   unsigned int - number of threads
+   */
+  unsigned int GetThreadCount() const;
+
+ private:
+  /**
+   * BlurAndScaleRows() - Blurs and scales a band of scaled rows
+   *
+   * frame:       input frame
+   * band:        index of band (selects scratch memory)
+   * start_row:   first scaled row of band
+   * end_row:     one past the last scaled row of band
+   */
+  void BlurAndScaleRows(const unsigned char* frame, unsigned int band, unsigned int start_row, unsigned int end_row);
+
+  /**
+   * StabilizeAndCompareRange() - Stabilizes and compares a range of pixels
+   *
+   * start:   first pixel of range
+   * end:     one past the last pixel of range
+   */
+  void StabilizeAndCompareRange(unsigned int start, unsigned int end);
+
+  /**
+   * StabilizeAndCompareModel() - Stabilizes and compares a range of pixels with the background model in use
+   *
+   * start:   first pixel of range
+   * end:     one past the last pixel of range
+   */
+  void StabilizeAndCompareModel(unsigned int start, unsigned int end);
+
+  /**
+   * BandRange() - Finds the range of a band when count items are split into bands
+   *
+   * band:      index of band
+   * count:     number of items to split
+   * start:     set to first item of band
+   * end:       set to one past the last item of band
+   */
+  void BandRange(unsigned int band, unsigned int count, unsigned int* start, unsigned int* end) const;
+
+  /**
+   * BandScratch - Per band memory so bands never share intermediate rows
+   */
+  struct BandScratch {
+    std::vector<float> color_totals;      // Colors of one input row added together
+    std::vector<float> vertical_sum;      // Vertical gaussian sum of one row
+    std::vector<unsigned char> vertical;  // Vertically scaled row
+    std::vector<float> phases;            // Vertically scaled row split into every scale'th pixel, one run per offset
+    std::vector<float> horizontal_sum;    // Horizontal gaussian sum of one row
+  };
+
+  std::vector<float> gaussian_;  // Gaussian kernel
+  unsigned int scale_;           // Scale factor
+  unsigned int colors_;          // Number of colors
+  unsigned int input_width_;     // Width of input frame
+  unsigned int scaled_width_;    // Width of scaled frame
+  unsigned int scaled_height_;   // Height of scaled frame
+  unsigned int phase_length_;    // Length of each run in BandScratch::phases
+  float bg_length_;              // Length of background
+  float mvt_length_;             // Length of movement
+  float pixel_diff_threshold_;   // Amount pixel needs to be different by to be different
+  bool integer_sums_;            // If window sums are kept instead of averages
+  bool exponential_average_;     // If exponential moving averages are kept instead of window averages
+
+  std::vector<std::vector<unsigned char>> history_;  // Scaled frames still in use by the background and movement averages
+  std::vector<float> stabilized_background_;         // Stabilized background
+  std::vector<float> stabilized_movement_;           // Stabilized movement
+  std::vector<uint32_t> background_sum_;             // Sum of frames in background (integer_sums only)
+  std::vector<uint32_t> movement_sum_;               // Sum of frames in movement (integer_sums only)
+  std::unique_ptr<bool[]> difference_frame_;         // Difference between background and movement
+  std::vector<unsigned char> roi_;                   // Watched scaled pixels, empty watches all (MotionConfig::roi only)
+  std::vector<bool> roi_rows_;                       // If each scaled row has a watched pixel (MotionConfig::roi only)
+
+  unsigned int newest_frame_loc_ = 0;  // Index of the newest frame in the frame history
+  unsigned int bg_remove_loc_;         // Index of background frame to remove in the frame history
+  unsigned int mvt_remove_loc_;        // Index of movement frame to remove in the frame history
+
+  ThreadPool pool_;                        // Threads bands run on
+  unsigned int bands_;                     // Number of bands work is split into
+  std::vector<BandScratch> scratch_;       // Scratch memory for each band
+  std::vector<unsigned int> band_counts_;  // Changed pixels counted by each band
+};
+
+#endif
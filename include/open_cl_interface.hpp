@@ -11,14 +11,15 @@
  * kCPU:      Select first CPU device
  * kGPU:      Select first GPU device
  * kSpecific: Select a specific device ID
+ * kNative:   Run on the CPU without OpenCL
  */
-enum class DeviceType { kCPU, kGPU, kSpecific };
+enum class DeviceType { kCPU, kGPU, kSpecific, kNative };
 
 /**
  * DeviceConfig - Selector for which OpenCL device to run motion detection on
  *
  * device_type:   how to select device
- * device_choice: device id
+ * device_choice: device id (kSpecific), or number of threads (kNative, 0 means one per core)
  */
 struct DeviceConfig {
   DeviceType device_type;
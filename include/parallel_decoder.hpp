@@ -0,0 +1,133 @@
+#ifndef PARALLEL_DECODER_HPP
+#define PARALLEL_DECODER_HPP
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "jpeg_decompressor.hpp"
+
+/**
+ * ParallelDecoder - Decompresses frames of a stream on several threads and hands them on in the order they arrived
+ *
+ * Every thread has its own JpegDecompressor (and so its own TurboJPEG handle).
+ * Decompressed frames are given to the frame sink one at a time, on a single delivery thread, in the order they were submitted.
+ */
+class ParallelDecoder {
+ public:
+  /**
+   * FrameSink - Receives decompressed frames in order
+   *
+   * frame:     decompressed frame (only valid until the sink returns, nullptr if decompressing failed)
+   * error:     exception thrown while decompressing (nullptr if frame was decompressed)
+   */
+  using FrameSink = std::function<void(const unsigned char* frame, std::exception_ptr error)>;
+
+  /**
+   * ParallelDecoder() - Constructor for ParallelDecoder
+   *
+   * width:         Width of frames to decompress
+   * height:        Height of frames to decompress
+   * frame_format:  Format to decompress frames into
+   * decomp_method: Method to use to decompress frames
+   * decode_scale:  Amount to scale frames down by while decompressing (1, 2, 4 or 8)
+   * dc_image:      If frames should be read as DC images (JpegDecompressor::DecompressDCImage()) instead of decompressed
+   * frame_size:    Size of buffer each frame is decompressed into in bytes
+   * threads:       Number of decode threads (0 means one per core)
+   * queue_depth:   Most frames that can be submitted but not yet delivered before Submit() waits
+   * sink:          Function given each decompressed frame in order
+   */
+  ParallelDecoder(unsigned int width, unsigned int height, DecompFrameFormat frame_format, DecompFrameMethod decomp_method, unsigned int decode_scale,
+                  bool dc_image, unsigned long frame_size, unsigned int threads, unsigned int queue_depth, FrameSink sink);
+
+  /**
+   * ~ParallelDecoder() - Deconstructor for ParallelDecoder, delivers every submitted frame before returning
+   */
+  ~ParallelDecoder();
+
+  ParallelDecoder(const ParallelDecoder&) = delete;
+  ParallelDecoder& operator=(const ParallelDecoder&) = delete;
+
+  /**
+   * Submit() - Queues a JPEG frame to be decompressed, waiting if queue_depth frames are already queued
+   *            (frame is copied, so the JPEG buffer can be reused right away)
+   *
+   * frame:     JPEG image
+   * size:      Size of JPEG image buffer
+   */
+  void Submit(const unsigned char* frame, unsigned long size);
+
+  /**
+   * Finish() - Waits until every submitted frame has been given to the sink
+   *            (must not be called from the sink)
+   */
+  void Finish();
+
+  /**
+   * SetDecodeWindow() - Only decompresses a window of frames submitted after this (see JpegDecompressor::SetDecodeWindow())
+   *
+   * x:         first column of window in decompressed pixels
+   * y:         first row of window in decompressed pixels
+   * width:     width of window (0 decompresses whole frames again)
+   * height:    height of window
+   */
+  void SetDecodeWindow(unsigned int x, unsigned int y, unsigned int width, unsigned int height);
+
+  /**
+   * GetThreadCount() - Gets the number of decode threads
+   *
+   * returns:   unsigned int - number of decode threads
+   */
+  unsigned int GetThreadCount() const;
+
+ private:
+  /**
+   * SlotState - Where a queued frame is in the decoder
+   */
+  enum class SlotState { kFree, kQueued, kDecoding, kDecoded };
+
+  /**
+   * Slot - Space for one frame in the queue (reused, so frames do not allocate once every slot has held a frame)
+   */
+  struct Slot {
+    SlotState state = SlotState::kFree;  // Where frame is in the decoder
+    std::vector<unsigned char> jpeg;     // Copy of submitted JPEG image
+    std::vector<unsigned char> frame;    // Decompressed frame
+    std::exception_ptr error;            // Exception thrown while decompressing
+  };
+
+  /**
+   * DecodeLoop() - Decompresses queued frames on a decode thread until the decoder is destroyed
+   *
+   * decompressor:  decompressor owned by this thread
+   */
+  void DecodeLoop(JpegDecompressor* decompressor);
+
+  /**
+   * DeliverLoop() - Gives decompressed frames to the sink in order until the decoder is destroyed
+   */
+  void DeliverLoop();
+
+  bool dc_image_;   // If frames are read as DC images
+  FrameSink sink_;  // Receives decompressed frames
+
+  std::vector<std::unique_ptr<JpegDecompressor>> decompressors_;  // One decompressor per decode thread
+  std::vector<std::thread> decoders_;                             // Decode threads
+  std::thread deliverer_;                                         // Delivery thread
+
+  std::mutex mutex_;                       // Guards everything below
+  std::condition_variable slot_freed_;     // Signals Submit() and Finish() that a frame was delivered
+  std::condition_variable frame_queued_;   // Signals decode threads that a frame was queued or decoder is stopping
+  std::condition_variable frame_decoded_;  // Signals delivery thread that a frame was decompressed or decoder is stopping
+  std::vector<Slot> slots_;                // Queue of frames, frame n uses slot n % queue depth
+  unsigned long next_submit_ = 0;          // Number of next frame to be submitted
+  unsigned long next_decode_ = 0;          // Number of next frame to be decompressed
+  unsigned long next_deliver_ = 0;         // Number of next frame to be delivered
+  bool stopping_ = false;                  // If threads should exit
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef PROGRAM_CACHE_HPP
+#define PROGRAM_CACHE_HPP
+
+#include <CL/opencl.h>
+
+#include <CL/cl2.hpp>
+#include <string>
+
+/**
+ * ProgramCache - Keeps built OpenCL program binaries on disk so detectors can skip compiling kernels from source
+ *
+ * Entries are keyed by device name, device and driver version, kernel source and build options, so a new driver or changed kernel
+ * gets a new entry instead of a stale binary. Entries that are corrupt, truncated or rejected by the driver are deleted and rebuilt.
+ * Entries are written to a temporary file and renamed into place, so any number of detectors and processes can share a directory.
+ */
+class ProgramCache {
+ public:
+  /**
+   * ProgramCache() - Constructor for ProgramCache
+   *
+   * directory:   directory to keep program binaries in (created when the first binary is stored)
+   */
+  explicit ProgramCache(std::string directory);
+
+  /**
+   * Find() - Loads and builds a cached program binary
+   *
+   * context:     OpenCL context to create program in
+   * device:      OpenCL device to build program for
+   * source:      source code of program
+   * options:     build options of program
+   * program:     set to the built program if found
+   * returns:     bool - if a usable binary was found (false if not cached, or the entry was bad and has been deleted)
+   */
+  bool Find(const cl::Context& context, const cl::Device& device, const std::string& source, const std::string& options, cl::Program* program) const;
+
+  /**
+   * Store() - Saves the binary of a built program
+   *
+   * device:      OpenCL device program was built for
+   * source:      source code of program
+   * options:     build options of program
+   * program:     program built from source for only device
+   * returns:     bool - if the binary was saved (caching is best effort, errors are not thrown)
+   */
+  bool Store(const cl::Device& device, const std::string& source, const std::string& options, const cl::Program& program) const;
+
+  /**
+   * GetEntryPath() - Gets the file a program binary is kept in
+   *
+   * device:      OpenCL device program is built for
+   * source:      source code of program
+   * options:     build options of program
+   * returns:     std::string - path of cache entry (may not exist)
+   */
+  std::string GetEntryPath(const cl::Device& device, const std::string& source, const std::string& options) const;
+
+ private:
+  /**
+   * Identity() - Creates the text that identifies a program binary, stored in its entry to catch hash collisions
+   *
+   * device:      OpenCL device program is built for
+   * source:      source code of program
+   * options:     build options of program
+   * returns:     std::string - device name, device version, driver version, build options and source hash
+   */
+  static std::string Identity(const cl::Device& device, const std::string& source, const std::string& options);
+
+  std::string directory_;  // Directory program binaries are kept in
+};
+
+#endif
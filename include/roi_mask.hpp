@@ -0,0 +1,89 @@
+#ifndef ROI_MASK_HPP
+#define ROI_MASK_HPP
+
+#include <vector>
+
+/**
+ * RoiPoint - Corner of a region of interest polygon, in input frame pixels (0, 0 is the top left corner of the frame)
+ */
+struct RoiPoint {
+  float x;
+  float y;
+};
+
+/**
+ * RoiMask - Which pixels of the input frames are watched for motion (region of interest)
+ *
+ * Built from a bitmap, or by adding watched and excluded polygons in order on top of a fully watched or fully excluded frame.
+ * An empty mask (default) watches the whole frame.
+ */
+class RoiMask {
+ public:
+  /**
+   * RoiMask() - Constructor for an empty RoiMask that watches the whole frame
+   */
+  RoiMask() = default;
+
+  /**
+   * RoiMask() - Constructor for RoiMask with every pixel watched or excluded
+   *
+   * width:     width of input frames in pixels
+   * height:    height of input frames in pixels
+   * watched:   if pixels start out watched or excluded
+   */
+  RoiMask(unsigned int width, unsigned int height, bool watched);
+
+  /**
+   * RoiMask() - Constructor for RoiMask from a bitmap
+   *
+   * width:     width of input frames in pixels
+   * height:    height of input frames in pixels
+   * bitmap:    one byte per pixel row by row, non zero pixels are watched
+   */
+  RoiMask(unsigned int width, unsigned int height, const unsigned char* bitmap);
+
+  /**
+   * AddPolygon() - Marks every pixel whose center is inside a polygon as watched or excluded (even-odd rule)
+   *
+   * polygon:   corners of polygon in order, at least 3
+   * watched:   if pixels inside are watched or excluded
+   */
+  void AddPolygon(const std::vector<RoiPoint>& polygon, bool watched);
+
+  /**
+   * IsEmpty() - Checks if mask is empty and watches the whole frame
+   *
+   * returns:   bool - if mask is empty
+   */
+  bool IsEmpty() const;
+
+  /**
+   * IsWatched() - Checks if a pixel is watched
+   *
+   * x:         column of pixel
+   * y:         row of pixel
+   * returns:   bool - if pixel is watched (always true for an empty mask)
+   */
+  bool IsWatched(unsigned int x, unsigned int y) const;
+
+  /**
+   * GetWidth() - Gets the width of the mask
+   *
+   * returns:   unsigned int - width in pixels (0 for an empty mask)
+   */
+  unsigned int GetWidth() const;
+
+  /**
+   * GetHeight() - Gets the height of the mask
+   *
+   * returns:   unsigned int - height in pixels (0 for an empty mask)
+   */
+  unsigned int GetHeight() const;
+
+ private:
+  unsigned int width_ = 0;           // Width of mask
+  unsigned int height_ = 0;          // Height of mask
+  std::vector<unsigned char> mask_;  // One byte per pixel, 1 if watched
+};
+
+#endif
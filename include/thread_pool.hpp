@@ -0,0 +1,74 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * ThreadPool - Fixed set of threads that split a batch of tasks between them
+ */
+class ThreadPool {
+ public:
+  /**
+   * ThreadPool() - Constructor for ThreadPool
+   *
+   * threads:   total number of threads to run tasks on, including the thread calling RunTasks() (0 means one per core)
+   */
+  explicit ThreadPool(unsigned int threads);
+
+  /**
+   * ~ThreadPool() - Deconstructor for ThreadPool
+   */
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /**
+   * RunTasks() - Runs task once for every index in [0, tasks) and waits for all of them to finish
+   *
+   * tasks:     number of tasks to run
+   * task:      function to run, given the index of the task
+   * throws:    first exception thrown by a task
+   */
+  void RunTasks(unsigned int tasks, const std::function<void(unsigned int)>& task);
+
+  /**
+   * GetThreadCount() - Gets the number of threads tasks run on
+   *
+   * returns:   unsigned int - number of threads, including the thread calling RunTasks()
+   */
+  unsigned int GetThreadCount() const;
+
+ private:
+  /**
+   * WorkerLoop() - Runs tasks on a worker thread until the pool is destroyed
+   */
+  void WorkerLoop();
+
+  /**
+   * RunAvailableTasks() - Runs tasks from the current batch until none are left to start
+   *
+   * lock:      held lock on mutex_ (released while a task runs)
+   */
+  void RunAvailableTasks(std::unique_lock<std::mutex>& lock);
+
+  std::vector<std::thread> workers_;  // Worker threads
+
+  std::mutex mutex_;                                          // Guards everything below
+  std::condition_variable work_ready_;                        // Signals workers that a batch started or pool is stopping
+  std::condition_variable work_done_;                         // Signals RunTasks() that a batch finished
+  const std::function<void(unsigned int)>* task_ = nullptr;  // Function of current batch
+  unsigned int task_count_ = 0;                               // Number of tasks in current batch
+  unsigned int next_task_ = 0;                                // Index of next task to start
+  unsigned int tasks_done_ = 0;                               // Number of tasks that have finished
+  unsigned long batch_ = 0;                                   // Incremented for every batch
+  bool stopping_ = false;                                     // If workers should exit
+  std::exception_ptr error_;                                  // First exception thrown by a task in current batch
+};
+
+#endif
@@ -0,0 +1,54 @@
+// Configuration is compiled in with -D when kernels are specialized, otherwise it is read from the argument buffers
+#ifndef GAUSSIAN_SIZE
+#define GAUSSIAN_SIZE gaussian_size[0]
+#endif
+#ifndef SCALE
+#define SCALE scale[0]
+#endif
+#ifndef INPUT_WIDTH
+#define INPUT_WIDTH width[0]
+#endif
+#ifndef OUTPUT_WIDTH
+#define OUTPUT_WIDTH scaled_width[0]
+#endif
+#ifndef INTERMEDIATE_STRIDE
+#define INTERMEDIATE_STRIDE intermediate_stride[0]
+#endif
+#ifndef SCALED_STRIDE
+#define SCALED_STRIDE scaled_stride[0]
+#endif
+#ifdef GAUSSIAN_WEIGHTS
+constant float kGaussianWeights[] = {GAUSSIAN_WEIGHTS};
+#define GAUSSIAN_WEIGHT(i) kGaussianWeights[i]
+#else
+#define GAUSSIAN_WEIGHT(i) gaussian[i]
+#endif
+
+kernel void blur_and_scale_horizontal_batch(global const float* gaussian, global const int* gaussian_size, global const int* scale,
+                                            global const unsigned char* intermediate_scaled, global const int* width, global const int* scaled_width,
+                                            global unsigned char* scaled, global const int* intermediate_stride, global const int* scaled_stride) {
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  const int stream = get_global_id(2);
+
+  if (x >= OUTPUT_WIDTH) return;
+
+  // Get the x start location of input frame (y is the same since this is just a horizontal scale down)
+  const int input_frame_x_start = SCALE * x;
+
+  float sum = 0;
+  // Iterate through the gaussian
+  for (int i = 0; i < GAUSSIAN_SIZE; i++) {
+    // Find corresponding location in input frame
+    const int input_frame_x = input_frame_x_start + i;
+    // Calculate the location in the buffer this coordinate is
+    const int loc = stream * INTERMEDIATE_STRIDE + y * INPUT_WIDTH + input_frame_x;
+
+    // Multiply by gaussian
+    sum += (intermediate_scaled[loc]) * GAUSSIAN_WEIGHT(i);
+  }
+
+  // Calculate location in scaled buffer of the coordinate
+  const int scaled_loc = stream * SCALED_STRIDE + y * OUTPUT_WIDTH + x;
+  scaled[scaled_loc] = sum;
+}
\ No newline at end of file
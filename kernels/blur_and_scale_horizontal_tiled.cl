@@ -0,0 +1,63 @@
+// Configuration is compiled in with -D when kernels are specialized, otherwise it is read from the argument buffers
+#ifndef GAUSSIAN_SIZE
+#define GAUSSIAN_SIZE gaussian_size[0]
+#endif
+#ifndef SCALE
+#define SCALE scale[0]
+#endif
+#ifndef INPUT_WIDTH
+#define INPUT_WIDTH width[0]
+#endif
+#ifndef OUTPUT_WIDTH
+#define OUTPUT_WIDTH scaled_width[0]
+#endif
+#ifndef OUTPUT_HEIGHT
+#define OUTPUT_HEIGHT scaled_height[0]
+#endif
+#ifdef GAUSSIAN_WEIGHTS
+constant float kGaussianWeights[] = {GAUSSIAN_WEIGHTS};
+#define GAUSSIAN_WEIGHT(i) kGaussianWeights[i]
+#else
+#define GAUSSIAN_WEIGHT(i) gaussian[i]
+#endif
+
+kernel void blur_and_scale_horizontal_tiled(constant float* gaussian, global const int* gaussian_size, global const int* scale, global const unsigned char* intermediate_scaled,
+                                            global const int* width, global const int* scaled_width, global unsigned char* scaled, global const int* scaled_height,
+                                            local unsigned char* row_tile) {
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  const int local_x = get_local_id(0);
+  const int local_y = get_local_id(1);
+  const int group_width = get_local_size(0);
+
+  // Input columns needed by the work group's part of this row
+  const int tile_x_start = get_group_id(0) * group_width * SCALE;
+  const int tile_columns = (group_width - 1) * SCALE + GAUSSIAN_SIZE;
+  local unsigned char* tile_row = row_tile + local_y * tile_columns;
+
+  // Copy input columns of this row into local memory 16 at a time, stopping at the right edge of the frame
+  if (y < OUTPUT_HEIGHT) {
+    const int row_loc = y * INPUT_WIDTH + tile_x_start;
+    const int columns = min(tile_columns, INPUT_WIDTH - tile_x_start);
+    for (int column = local_x * 16; column < columns; column += group_width * 16) {
+      if (column + 16 <= columns) {
+        vstore16(vload16(0, intermediate_scaled + row_loc + column), 0, tile_row + column);
+      } else {
+        for (int i = column; i < columns; i++) tile_row[i] = intermediate_scaled[row_loc + i];
+      }
+    }
+  }
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  if (x >= OUTPUT_WIDTH || y >= OUTPUT_HEIGHT) return;
+
+  // Multiply by gaussian out of local memory (same math as blur_and_scale_horizontal)
+  float sum = 0;
+  for (int i = 0; i < GAUSSIAN_SIZE; i++) {
+    sum += tile_row[local_x * SCALE + i] * GAUSSIAN_WEIGHT(i);
+  }
+
+  // Calculate location in scaled buffer of the coordinate
+  const int scaled_loc = y * OUTPUT_WIDTH + x;
+  scaled[scaled_loc] = sum;
+}
\ No newline at end of file
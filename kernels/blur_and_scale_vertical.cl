@@ -1,32 +1,68 @@
+// Configuration is compiled in with -D when kernels are specialized, otherwise it is read from the argument buffers
+#ifndef GAUSSIAN_SIZE
+#define GAUSSIAN_SIZE gaussian_size[0]
+#endif
+#ifndef SCALE
+#define SCALE scale[0]
+#endif
+#ifndef COLORS
+#define COLORS colors[0]
+#endif
+#ifndef INPUT_WIDTH
+#define INPUT_WIDTH width[0]
+#endif
+#ifdef ROI_TILES
+#ifndef OUTPUT_HEIGHT
+#define OUTPUT_HEIGHT scaled_height[0]
+#endif
+#endif
+#ifdef GAUSSIAN_WEIGHTS
+constant float kGaussianWeights[] = {GAUSSIAN_WEIGHTS};
+#define GAUSSIAN_WEIGHT(i) kGaussianWeights[i]
+#else
+#define GAUSSIAN_WEIGHT(i) gaussian[i]
+#endif
+
 kernel void blur_and_scale_vertical(global const float* gaussian, global const int* gaussian_size, global const int* scale, global const int* colors,
-                                    global const unsigned char* frame, global const int* width, global unsigned char* scaled) {
+                                    global const unsigned char* frame, global const int* width, global unsigned char* scaled
+#ifdef ROI_TILES
+                                    , global const int* roi_tiles, global const int* scaled_height
+#endif
+) {
+#ifdef ROI_TILES
+  // Every work group looks up which block of columns and rows it is, only the columns watched tiles blur from are launched
+  const int x = roi_tiles[2 * get_group_id(1)] * get_local_size(0) + get_local_id(0);
+  const int y = roi_tiles[2 * get_group_id(1) + 1] * get_local_size(1) + get_local_id(1);
+  if (y >= OUTPUT_HEIGHT) return;
+#else
   const int x = get_global_id(0);
   const int y = get_global_id(1);
+#endif
 
-  if (x >= width[0]) return;
+  if (x >= INPUT_WIDTH) return;
 
   // Get the y start location of input frame (x is the same since this is just a vertical scale down)
-  const int input_frame_y_start = scale[0] * y;
+  const int input_frame_y_start = SCALE * y;
 
   float sum = 0;
   // Iterate through the gaussian
-  for (int i = 0; i < gaussian_size[0]; i++) {
+  for (int i = 0; i < GAUSSIAN_SIZE; i++) {
     // Find corresponding location in input frame
     const int input_frame_y = input_frame_y_start + i;
     // Calculate the location in the buffer this coordinate is
-    const int loc = (input_frame_y * width[0] + x) * colors[0];
+    const int loc = (input_frame_y * INPUT_WIDTH + x) * COLORS;
 
     // Add up all the colors
     int color_total = 0;
-    for (int c = 0; c < colors[0]; c++) {
+    for (int c = 0; c < COLORS; c++) {
       color_total += frame[loc + c];
     }
 
     // Multiply by gaussian
-    sum += color_total * gaussian[i];
+    sum += color_total * GAUSSIAN_WEIGHT(i);
   }
 
   // Calculate location in scaled buffer of the coordinate
-  const int scaled_loc = y * width[0] + x;
-  scaled[scaled_loc] = sum / colors[0];  // Divide by the number of colors to normalize
+  const int scaled_loc = y * INPUT_WIDTH + x;
+  scaled[scaled_loc] = sum / COLORS;  // Divide by the number of colors to normalize
 }
\ No newline at end of file
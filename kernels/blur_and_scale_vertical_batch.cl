@@ -0,0 +1,63 @@
+// Configuration is compiled in with -D when kernels are specialized, otherwise it is read from the argument buffers
+#ifndef GAUSSIAN_SIZE
+#define GAUSSIAN_SIZE gaussian_size[0]
+#endif
+#ifndef SCALE
+#define SCALE scale[0]
+#endif
+#ifndef COLORS
+#define COLORS colors[0]
+#endif
+#ifndef INPUT_WIDTH
+#define INPUT_WIDTH width[0]
+#endif
+#ifndef INPUT_STRIDE
+#define INPUT_STRIDE input_stride[0]
+#endif
+#ifndef INTERMEDIATE_STRIDE
+#define INTERMEDIATE_STRIDE intermediate_stride[0]
+#endif
+#ifdef GAUSSIAN_WEIGHTS
+constant float kGaussianWeights[] = {GAUSSIAN_WEIGHTS};
+#define GAUSSIAN_WEIGHT(i) kGaussianWeights[i]
+#else
+#define GAUSSIAN_WEIGHT(i) gaussian[i]
+#endif
+
+kernel void blur_and_scale_vertical_batch(global const float* gaussian, global const int* gaussian_size, global const int* scale, global const int* colors,
+                                          global const unsigned char* frames, global const int* width, global unsigned char* scaled, global const int* input_stride,
+                                          global const int* intermediate_stride) {
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  const int stream = get_global_id(2);
+
+  if (x >= INPUT_WIDTH) return;
+
+  // Frames of every stream are stacked one after another
+  global const unsigned char* frame = frames + stream * INPUT_STRIDE;
+
+  // Get the y start location of input frame (x is the same since this is just a vertical scale down)
+  const int input_frame_y_start = SCALE * y;
+
+  float sum = 0;
+  // Iterate through the gaussian
+  for (int i = 0; i < GAUSSIAN_SIZE; i++) {
+    // Find corresponding location in input frame
+    const int input_frame_y = input_frame_y_start + i;
+    // Calculate the location in the buffer this coordinate is
+    const int loc = (input_frame_y * INPUT_WIDTH + x) * COLORS;
+
+    // Add up all the colors
+    int color_total = 0;
+    for (int c = 0; c < COLORS; c++) {
+      color_total += frame[loc + c];
+    }
+
+    // Multiply by gaussian
+    sum += color_total * GAUSSIAN_WEIGHT(i);
+  }
+
+  // Calculate location in scaled buffer of the coordinate
+  const int scaled_loc = stream * INTERMEDIATE_STRIDE + y * INPUT_WIDTH + x;
+  scaled[scaled_loc] = sum / COLORS;  // Divide by the number of colors to normalize
+}
\ No newline at end of file
@@ -0,0 +1,88 @@
+// Configuration is compiled in with -D when kernels are specialized, otherwise it is read from the argument buffers
+#ifndef GAUSSIAN_SIZE
+#define GAUSSIAN_SIZE gaussian_size[0]
+#endif
+#ifndef SCALE
+#define SCALE scale[0]
+#endif
+#ifndef COLORS
+#define COLORS colors[0]
+#endif
+#ifndef INPUT_WIDTH
+#define INPUT_WIDTH width[0]
+#endif
+#ifndef OUTPUT_HEIGHT
+#define OUTPUT_HEIGHT scaled_height[0]
+#endif
+#ifdef GAUSSIAN_WEIGHTS
+constant float kGaussianWeights[] = {GAUSSIAN_WEIGHTS};
+#define GAUSSIAN_WEIGHT(i) kGaussianWeights[i]
+#else
+#define GAUSSIAN_WEIGHT(i) gaussian[i]
+#endif
+
+kernel void blur_and_scale_vertical_tiled(constant float* gaussian, global const int* gaussian_size, global const int* scale, global const int* colors,
+                                          global const unsigned char* frame, global const int* width, global unsigned char* scaled, global const int* scaled_height,
+                                          local ushort4* column_totals) {
+  // Each work item makes 4 neighbouring columns of one row
+  const int x = get_global_id(0) * 4;
+  const int y = get_global_id(1);
+  const int local_x = get_local_id(0);
+  const int local_y = get_local_id(1);
+  const int group_width = get_local_size(0);
+  const int group_height = get_local_size(1);
+
+  // Input rows needed by the whole work group, and one past the last input row any output row needs
+  const int tile_y_start = get_group_id(1) * group_height * SCALE;
+  const int tile_rows = (group_height - 1) * SCALE + GAUSSIAN_SIZE;
+  const int input_rows_end = (OUTPUT_HEIGHT - 1) * SCALE + GAUSSIAN_SIZE;
+
+  // Add up colors of this work item's 4 columns once for every tile row, instead of once per tap per output row
+  for (int row = local_y; row < tile_rows; row += group_height) {
+    const int input_frame_y = tile_y_start + row;
+    ushort4 totals = (ushort4)(0);
+    if (input_frame_y < input_rows_end && x < INPUT_WIDTH) {
+      const int loc = (input_frame_y * INPUT_WIDTH + x) * COLORS;
+      if (x + 3 < INPUT_WIDTH) {
+        if (COLORS == 3) {
+          // 4 RGB pixels are 12 bytes
+          const uchar8 first = vload8(0, frame + loc);
+          const uchar4 last = vload4(0, frame + loc + 8);
+          totals = (ushort4)(first.s0 + first.s1 + first.s2, first.s3 + first.s4 + first.s5, first.s6 + first.s7 + last.s0, last.s1 + last.s2 + last.s3);
+        } else {
+          totals = convert_ushort4(vload4(0, frame + loc));
+        }
+      } else {
+        // Right edge of frame, columns past it stay 0
+        ushort edge[4] = {0, 0, 0, 0};
+        for (int i = 0; i < 4 && x + i < INPUT_WIDTH; i++) {
+          for (int c = 0; c < COLORS; c++) {
+            edge[i] += frame[loc + i * COLORS + c];
+          }
+        }
+        totals = vload4(0, edge);
+      }
+    }
+    column_totals[row * group_width + local_x] = totals;
+  }
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  if (x >= INPUT_WIDTH || y >= OUTPUT_HEIGHT) return;
+
+  // Multiply by gaussian out of local memory (same math as blur_and_scale_vertical)
+  float4 sum = (float4)(0);
+  for (int i = 0; i < GAUSSIAN_SIZE; i++) {
+    sum += convert_float4(column_totals[(local_y * SCALE + i) * group_width + local_x]) * GAUSSIAN_WEIGHT(i);
+  }
+  const uchar4 result = convert_uchar4_sat(sum / (float)COLORS);  // Divide by the number of colors to normalize
+
+  // Calculate location in scaled buffer of the coordinate
+  const int scaled_loc = y * INPUT_WIDTH + x;
+  if (x + 3 < INPUT_WIDTH) {
+    vstore4(result, 0, scaled + scaled_loc);
+  } else {
+    scaled[scaled_loc] = result.s0;
+    if (x + 1 < INPUT_WIDTH) scaled[scaled_loc + 1] = result.s1;
+    if (x + 2 < INPUT_WIDTH) scaled[scaled_loc + 2] = result.s2;
+  }
+}
\ No newline at end of file
@@ -0,0 +1,154 @@
+// Configuration is compiled in with -D when kernels are specialized, otherwise it is read from the argument buffers
+#ifndef GAUSSIAN_SIZE
+#define GAUSSIAN_SIZE gaussian_size[0]
+#endif
+#ifndef SCALE
+#define SCALE scale[0]
+#endif
+#ifndef COLORS
+#define COLORS colors[0]
+#endif
+#ifndef INPUT_WIDTH
+#define INPUT_WIDTH width[0]
+#endif
+#ifndef OUTPUT_WIDTH
+#define OUTPUT_WIDTH scaled_width[0]
+#endif
+#ifndef OUTPUT_HEIGHT
+#define OUTPUT_HEIGHT scaled_height[0]
+#endif
+#ifndef BG_LENGTH
+#define BG_LENGTH bg_length[0]
+#endif
+#ifndef MVT_LENGTH
+#define MVT_LENGTH mvt_length[0]
+#endif
+#ifndef DIFFERENCE_THRESHOLD
+#define DIFFERENCE_THRESHOLD difference_threshold[0]
+#endif
+#ifdef INTEGER_SUMS
+#ifndef SUM_TYPE
+#define SUM_TYPE uint
+#endif
+#define STABILIZED_TYPE SUM_TYPE
+#else
+#define STABILIZED_TYPE float
+#endif
+#ifdef PACKED_MASK
+#define DIFFERENCE_TYPE uint
+#else
+#define DIFFERENCE_TYPE unsigned char
+#endif
+#ifdef GAUSSIAN_WEIGHTS
+constant float kGaussianWeights[] = {GAUSSIAN_WEIGHTS};
+#define GAUSSIAN_WEIGHT(i) kGaussianWeights[i]
+#else
+#define GAUSSIAN_WEIGHT(i) gaussian[i]
+#endif
+
+kernel void blur_scale_stabilize_fused(global const float* gaussian, global const int* gaussian_size, global const int* scale, global const int* colors,
+                                       global const unsigned char* frame, global const int* width, global const int* scaled_width, global const int* scaled_height,
+                                       global unsigned char* scaled_frame, global const unsigned char* bg_frame_to_remove, global const unsigned char* mvt_frame_to_remove,
+                                       global float* bg_length, global float* mvt_length, global STABILIZED_TYPE* stabilized_background, global STABILIZED_TYPE* stabilized_movement,
+                                       global int* difference_threshold, global DIFFERENCE_TYPE* difference_frame, local unsigned char* vertical_tile
+#ifdef ROI_TILES
+                                       , global const int* roi_tiles, global const unsigned char* roi_mask
+#endif
+) {
+#ifdef ROI_TILES
+  // Every work group looks up which tile it is, tiles without watched pixels are never launched
+  const int tile_x = roi_tiles[2 * get_group_id(1)];
+  const int tile_y = roi_tiles[2 * get_group_id(1) + 1];
+#else
+  const int tile_x = get_group_id(0);
+  const int tile_y = get_group_id(1);
+#endif
+  const int local_x = get_local_id(0);
+  const int local_y = get_local_id(1);
+  const int x = tile_x * get_local_size(0) + local_x;
+  const int y = tile_y * get_local_size(1) + local_y;
+
+  // Input columns needed by the horizontal pass of this tile
+  const int tile_x_start = tile_x * get_local_size(0) * SCALE;
+  const int tile_columns = (get_local_size(0) - 1) * SCALE + GAUSSIAN_SIZE;
+
+  // Vertical blur and scale every input column of the tile for this work item's row (same math as blur_and_scale_vertical)
+  const int input_frame_y_start = SCALE * y;
+  for (int column = local_x; column < tile_columns; column += get_local_size(0)) {
+    const int input_frame_x = tile_x_start + column;
+
+    float sum = 0;
+    if (y < OUTPUT_HEIGHT && input_frame_x < INPUT_WIDTH) {
+      // Iterate through the gaussian
+      for (int i = 0; i < GAUSSIAN_SIZE; i++) {
+        // Calculate the location in the buffer this coordinate is
+        const int loc = ((input_frame_y_start + i) * INPUT_WIDTH + input_frame_x) * COLORS;
+
+        // Add up all the colors
+        int color_total = 0;
+        for (int c = 0; c < COLORS; c++) {
+          color_total += frame[loc + c];
+        }
+
+        // Multiply by gaussian
+        sum += color_total * GAUSSIAN_WEIGHT(i);
+      }
+    }
+    vertical_tile[local_y * tile_columns + column] = sum / COLORS;  // Divide by the number of colors to normalize
+  }
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  if (x >= OUTPUT_WIDTH || y >= OUTPUT_HEIGHT) return;
+
+  // Horizontal blur and scale out of local memory (same math as blur_and_scale_horizontal)
+  float sum = 0;
+  for (int i = 0; i < GAUSSIAN_SIZE; i++) {
+    sum += vertical_tile[local_y * tile_columns + local_x * SCALE + i] * GAUSSIAN_WEIGHT(i);
+  }
+
+  // Store scaled frame in frame history so it can be removed from the averages later
+  const int loc = y * OUTPUT_WIDTH + x;
+  const unsigned char scaled = sum;
+  scaled_frame[loc] = scaled;
+
+  // Stabilize and compare (same math as stabilize_bg_mvt)
+#ifdef INTEGER_SUMS
+  const SUM_TYPE bg_sum = stabilized_background[loc] + mvt_frame_to_remove[loc] - bg_frame_to_remove[loc];
+  const SUM_TYPE mvt_sum = stabilized_movement[loc] + scaled - mvt_frame_to_remove[loc];
+  stabilized_background[loc] = bg_sum;
+  stabilized_movement[loc] = mvt_sum;
+
+  const int bg_len = BG_LENGTH;
+  const int mvt_len = MVT_LENGTH;
+  bool changed = abs((int)bg_sum * mvt_len - (int)mvt_sum * bg_len) >= DIFFERENCE_THRESHOLD * bg_len * mvt_len;
+#elif defined(EXPONENTIAL_AVERAGE)
+  const float bg_alpha = 2.0f / (BG_LENGTH + 1.0f);
+  const float mvt_alpha = 2.0f / (MVT_LENGTH + 1.0f);
+
+  const float movement = stabilized_movement[loc];
+  stabilized_background[loc] += (movement - stabilized_background[loc]) * bg_alpha;
+  stabilized_movement[loc] = movement + (scaled - movement) * mvt_alpha;
+
+  bool changed = fabs((stabilized_background[loc] - stabilized_movement[loc])) >= DIFFERENCE_THRESHOLD;
+#else
+  const float bg_change = (mvt_frame_to_remove[loc] / BG_LENGTH) - (bg_frame_to_remove[loc] / BG_LENGTH);
+  const float mvt_change = (scaled / MVT_LENGTH) - (mvt_frame_to_remove[loc] / MVT_LENGTH);
+
+  stabilized_background[loc] += bg_change;
+  stabilized_movement[loc] += mvt_change;
+
+  bool changed = fabs((stabilized_background[loc] - stabilized_movement[loc])) >= DIFFERENCE_THRESHOLD;
+#endif
+
+#ifdef ROI_TILES
+  // Pixels outside the region of interest never count as changed
+  changed = changed && roi_mask[loc];
+#endif
+
+#ifdef PACKED_MASK
+  // Tiles do not line up with words, so bits are ORed into the mask (mask is cleared before every frame)
+  if (changed) atomic_or(&difference_frame[loc / 32], 1U << (loc % 32));
+#else
+  difference_frame[loc] = changed;
+#endif
+}
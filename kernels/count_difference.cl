@@ -0,0 +1,33 @@
+// Configuration is compiled in with -D when kernels are specialized, otherwise it is read from the argument buffers
+#ifndef PIXEL_COUNT
+#define PIXEL_COUNT pixel_count[0]
+#endif
+// Packed masks hold 32 pixels in every uint word
+#ifdef PACKED_MASK
+#define DIFFERENCE_TYPE uint
+#else
+#define DIFFERENCE_TYPE unsigned char
+#endif
+
+kernel void count_difference(global const DIFFERENCE_TYPE* difference_frame, global const int* pixel_count, global unsigned int* changed_pixels, local unsigned int* partial_counts) {
+  const int loc = get_global_id(0);
+  const int local_loc = get_local_id(0);
+
+#ifdef PACKED_MASK
+  // Load the number of changed pixels in this word into local memory (bits past the end of the frame are always 0)
+  partial_counts[local_loc] = loc < (PIXEL_COUNT + 31) / 32 ? popcount(difference_frame[loc]) : 0;
+#else
+  // Load whether this pixel changed into local memory (locations past the end of the frame are padding and never count)
+  partial_counts[local_loc] = (loc < PIXEL_COUNT && difference_frame[loc]) ? 1 : 0;
+#endif
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Sum the work group's pixels by halving the number of active work items each step (work group size is a power of 2)
+  for (int stride = get_local_size(0) / 2; stride > 0; stride /= 2) {
+    if (local_loc < stride) partial_counts[local_loc] += partial_counts[local_loc + stride];
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+
+  // Add work group's total to the frame's total
+  if (local_loc == 0) atomic_add(changed_pixels, partial_counts[0]);
+}
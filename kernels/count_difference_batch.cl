@@ -0,0 +1,27 @@
+// Configuration is compiled in with -D when kernels are specialized, otherwise it is read from the argument buffers
+#ifndef PIXEL_COUNT
+#define PIXEL_COUNT pixel_count[0]
+#endif
+#ifndef SCALED_STRIDE
+#define SCALED_STRIDE scaled_stride[0]
+#endif
+
+kernel void count_difference_batch(global const unsigned char* difference_frames, global const int* pixel_count, global unsigned int* changed_pixels,
+                                   local unsigned int* partial_counts, global const int* scaled_stride) {
+  const int loc = get_global_id(0);
+  const int stream = get_global_id(1);
+  const int local_loc = get_local_id(0);
+
+  // Load whether this pixel of the stream changed into local memory (locations past the end of the frame are padding and never count)
+  partial_counts[local_loc] = (loc < PIXEL_COUNT && difference_frames[stream * SCALED_STRIDE + loc]) ? 1 : 0;
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Sum the work group's pixels by halving the number of active work items each step (work group size is a power of 2)
+  for (int stride = get_local_size(0) / 2; stride > 0; stride /= 2) {
+    if (local_loc < stride) partial_counts[local_loc] += partial_counts[local_loc + stride];
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+
+  // Add work group's total to the stream's total (work groups never span streams)
+  if (local_loc == 0) atomic_add(changed_pixels + stream, partial_counts[0]);
+}
\ No newline at end of file
@@ -0,0 +1,210 @@
+// Configuration is compiled in with -D when kernels are specialized, otherwise it is read from the argument buffers
+#ifndef OUTPUT_WIDTH
+#define OUTPUT_WIDTH scaled_width[0]
+#endif
+#ifndef OUTPUT_HEIGHT
+#define OUTPUT_HEIGHT scaled_height[0]
+#endif
+#ifdef PACKED_MASK
+#define DIFFERENCE_TYPE uint
+#define CHANGED(loc) ((difference_frame[(loc) / 32] >> ((loc) % 32)) & 1)
+#else
+#define DIFFERENCE_TYPE unsigned char
+#define CHANGED(loc) (difference_frame[loc] != 0)
+#endif
+
+#define NO_LABEL -1          // Label of pixels that did not change
+#define NO_REGION UINT_MAX   // Region of roots that are too small or did not fit in regions
+#define REGION_FIELDS 9      // Pixels, min x, max x, min y, max y, sum of x (low, high), sum of y (low, high)
+
+// Labels form trees where every parent has a smaller index than its child, the root (smallest index) labels the whole region
+int find_root(volatile global int* labels, int loc) {
+  int parent = labels[loc];
+  while (parent != loc) {
+    loc = parent;
+    parent = labels[loc];
+  }
+  return loc;
+}
+
+// Joins the trees of a and b by pointing the larger root at the smaller one, atomic_min makes this safe to run from every work item at once
+void join_regions(volatile global int* labels, int a, int b) {
+  while (true) {
+    a = find_root(labels, a);
+    b = find_root(labels, b);
+    if (a == b) return;
+    if (a < b) {
+      const int swap = a;
+      a = b;
+      b = swap;
+    }
+    // If a was still a root it now points at b, otherwise something joined it first so carry on from where it points now
+    const int old = atomic_min(&labels[a], b);
+    if (old == a) return;
+    a = old;
+  }
+}
+
+// Same as find_root on a tile in local memory
+int find_local_root(volatile local int* labels, int loc) {
+  int parent = labels[loc];
+  while (parent != loc) {
+    loc = parent;
+    parent = labels[loc];
+  }
+  return loc;
+}
+
+// Same as join_regions on a tile in local memory
+void join_local_regions(volatile local int* labels, int a, int b) {
+  while (true) {
+    a = find_local_root(labels, a);
+    b = find_local_root(labels, b);
+    if (a == b) return;
+    if (a < b) {
+      const int swap = a;
+      a = b;
+      b = swap;
+    }
+    const int old = atomic_min(&labels[a], b);
+    if (old == a) return;
+    a = old;
+  }
+}
+
+// Labels changed pixels 8 connected to each other inside every work group sized tile
+kernel void label_tiles(global const DIFFERENCE_TYPE* difference_frame, global const int* scaled_width, global const int* scaled_height, global int* labels,
+                        local int* tile_labels) {
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  const int local_x = get_local_id(0);
+  const int local_y = get_local_id(1);
+  const int tile_width = get_local_size(0);
+  const int local_loc = local_y * tile_width + local_x;
+
+  const bool inside = x < OUTPUT_WIDTH && y < OUTPUT_HEIGHT;
+  const bool changed = inside && CHANGED(y * OUTPUT_WIDTH + x);
+
+  // Every changed pixel starts as a tree of its own
+  tile_labels[local_loc] = changed ? local_loc : NO_LABEL;
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Join changed neighbours before this pixel inside the tile, so every pair is joined once
+  if (changed) {
+    if (local_x > 0 && tile_labels[local_loc - 1] != NO_LABEL) join_local_regions(tile_labels, local_loc, local_loc - 1);
+    if (local_y > 0) {
+      const int up = local_loc - tile_width;
+      if (local_x > 0 && tile_labels[up - 1] != NO_LABEL) join_local_regions(tile_labels, local_loc, up - 1);
+      if (tile_labels[up] != NO_LABEL) join_local_regions(tile_labels, local_loc, up);
+      if (local_x < tile_width - 1 && tile_labels[up + 1] != NO_LABEL) join_local_regions(tile_labels, local_loc, up + 1);
+    }
+  }
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  if (!inside) return;
+
+  // Point straight at the tile's root as a location in the whole frame, order inside a tile is the same as in the frame so parents stay before children
+  int label = NO_LABEL;
+  if (changed) {
+    const int root = find_local_root(tile_labels, local_loc);
+    label = (get_group_id(1) * get_local_size(1) + root / tile_width) * OUTPUT_WIDTH + get_group_id(0) * tile_width + root % tile_width;
+  }
+  labels[y * OUTPUT_WIDTH + x] = label;
+}
+
+// Joins regions of neighbouring tiles along tile edges (run with the same work group size as label_tiles)
+kernel void merge_tiles(global const int* scaled_width, global const int* scaled_height, global int* labels) {
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if (x >= OUTPUT_WIDTH || y >= OUTPUT_HEIGHT) return;
+
+  const int loc = y * OUTPUT_WIDTH + x;
+  if (labels[loc] == NO_LABEL) return;
+
+  const bool left_edge = get_local_id(0) == 0;
+  const bool right_edge = get_local_id(0) == get_local_size(0) - 1;
+  const bool top_edge = get_local_id(1) == 0;
+
+  // Only neighbours in another tile, the ones inside this tile were joined by label_tiles
+  if (x > 0 && left_edge && labels[loc - 1] != NO_LABEL) join_regions(labels, loc, loc - 1);
+  if (y > 0) {
+    const int up = loc - OUTPUT_WIDTH;
+    if (x > 0 && (left_edge || top_edge) && labels[up - 1] != NO_LABEL) join_regions(labels, loc, up - 1);
+    if (top_edge && labels[up] != NO_LABEL) join_regions(labels, loc, up);
+    if (x < OUTPUT_WIDTH - 1 && (right_edge || top_edge) && labels[up + 1] != NO_LABEL) join_regions(labels, loc, up + 1);
+  }
+}
+
+// Points every changed pixel straight at the root of its region
+kernel void compress_labels(global const int* scaled_width, global const int* scaled_height, global int* labels) {
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if (x >= OUTPUT_WIDTH || y >= OUTPUT_HEIGHT) return;
+
+  const int loc = y * OUTPUT_WIDTH + x;
+  if (labels[loc] != NO_LABEL) labels[loc] = find_root(labels, loc);
+}
+
+// Counts pixels of every region at its root (region_pixels is cleared before every labeling)
+kernel void count_region_pixels(global const int* scaled_width, global const int* scaled_height, global const int* labels, global uint* region_pixels) {
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if (x >= OUTPUT_WIDTH || y >= OUTPUT_HEIGHT) return;
+
+  const int label = labels[y * OUTPUT_WIDTH + x];
+  if (label != NO_LABEL) atomic_inc(&region_pixels[label]);
+}
+
+// Gives every root with enough pixels a slot in regions and swaps its pixel count for the slot (region_count is cleared before every labeling)
+kernel void number_regions(global const int* scaled_width, global const int* scaled_height, global const int* labels, global uint* region_pixels,
+                           global const uint* min_region_pixels, global const uint* max_regions, global uint* region_count, global uint* regions) {
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if (x >= OUTPUT_WIDTH || y >= OUTPUT_HEIGHT) return;
+
+  const int loc = y * OUTPUT_WIDTH + x;
+  if (labels[loc] != loc) return;
+
+  const uint pixels = region_pixels[loc];
+  uint region = NO_REGION;
+  if (pixels >= min_region_pixels[0]) region = atomic_inc(region_count);
+  // Host makes room for every region, regions past the end are only counted in case it runs out
+  if (region >= max_regions[0]) {
+    region_pixels[loc] = NO_REGION;
+    return;
+  }
+
+  global uint* stats = regions + region * REGION_FIELDS;
+  stats[0] = pixels;
+  stats[1] = UINT_MAX;
+  stats[2] = 0;
+  stats[3] = UINT_MAX;
+  stats[4] = 0;
+  stats[5] = 0;
+  stats[6] = 0;
+  stats[7] = 0;
+  stats[8] = 0;
+  region_pixels[loc] = region;
+}
+
+// Adds every changed pixel to the bounding box and coordinate sums of its region
+kernel void measure_regions(global const int* scaled_width, global const int* scaled_height, global const int* labels, global const uint* region_pixels,
+                            global uint* regions) {
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+  if (x >= OUTPUT_WIDTH || y >= OUTPUT_HEIGHT) return;
+
+  const int label = labels[y * OUTPUT_WIDTH + x];
+  if (label == NO_LABEL) return;
+  const uint region = region_pixels[label];
+  if (region == NO_REGION) return;
+
+  global uint* stats = regions + region * REGION_FIELDS;
+  atomic_min(&stats[1], (uint)x);
+  atomic_max(&stats[2], (uint)x);
+  atomic_min(&stats[3], (uint)y);
+  atomic_max(&stats[4], (uint)y);
+  // 64 bit sums out of 32 bit atomics, whichever add wraps the low word carries into the high word
+  if (atomic_add(&stats[5], (uint)x) > UINT_MAX - x) atomic_inc(&stats[6]);
+  if (atomic_add(&stats[7], (uint)y) > UINT_MAX - y) atomic_inc(&stats[8]);
+}
@@ -1,16 +1,135 @@
-kernel void stabilize_bg_mvt(global unsigned char* bg_frame_to_remove, global unsigned char* mvt_frame_to_remove, global unsigned char* scaled_frame, global float* bg_length,
-                             global float* mvt_length, global float* stabilized_background, global float* stabilized_movement, global int* difference_threshold,
-                             global bool* difference_frame_) {
-  const int loc = get_global_id(0);
+// Configuration is compiled in with -D when kernels are specialized, otherwise it is read from the argument buffers
+#ifndef BG_LENGTH
+#define BG_LENGTH bg_length[0]
+#endif
+#ifndef MVT_LENGTH
+#define MVT_LENGTH mvt_length[0]
+#endif
+#ifndef DIFFERENCE_THRESHOLD
+#define DIFFERENCE_THRESHOLD difference_threshold[0]
+#endif
+// Integer sums keep the window sums of raw bytes instead of float averages (SUM_TYPE is ushort when the sums fit)
+#ifdef INTEGER_SUMS
+#ifndef SUM_TYPE
+#define SUM_TYPE uint
+#endif
+#define STABILIZED_TYPE SUM_TYPE
+#else
+#define STABILIZED_TYPE float
+#endif
+
+// Packed masks store 1 bit per pixel in uint words instead of a bool per pixel
+#ifdef PACKED_MASK
+#ifndef PIXEL_COUNT
+#define PIXEL_COUNT pixel_count[0]
+#endif
+#endif
+
+// Regions of interest run 2D work groups over a list of tiles with watched pixels instead of over every pixel
+#ifdef ROI_TILES
+#ifndef OUTPUT_WIDTH
+#define OUTPUT_WIDTH scaled_width[0]
+#endif
+#ifndef OUTPUT_HEIGHT
+#define OUTPUT_HEIGHT scaled_height[0]
+#endif
+#endif
 
+// Stabilizes one pixel and returns whether its background and movement are different
+bool stabilize_pixel(const int loc, global unsigned char* bg_frame_to_remove, global unsigned char* mvt_frame_to_remove, global unsigned char* scaled_frame,
+                     global float* bg_length, global float* mvt_length, global STABILIZED_TYPE* stabilized_background, global STABILIZED_TYPE* stabilized_movement,
+                     global int* difference_threshold) {
+#ifdef INTEGER_SUMS
+  // Add and remove raw bytes, frames leaving a window cancel the frames that entered it exactly so the sums never drift
+  const SUM_TYPE bg_sum = stabilized_background[loc] + mvt_frame_to_remove[loc] - bg_frame_to_remove[loc];
+  const SUM_TYPE mvt_sum = stabilized_movement[loc] + scaled_frame[loc] - mvt_frame_to_remove[loc];
+  stabilized_background[loc] = bg_sum;
+  stabilized_movement[loc] = mvt_sum;
+
+  // Same comparison as the averages, multiplied through by both lengths so nothing is divided
+  const int bg_len = BG_LENGTH;
+  const int mvt_len = MVT_LENGTH;
+  return abs((int)bg_sum * mvt_len - (int)mvt_sum * bg_len) >= DIFFERENCE_THRESHOLD * bg_len * mvt_len;
+#elif defined(EXPONENTIAL_AVERAGE)
+  // Exponential averages with the same average age as the windows, no frame ever has to be removed
+  const float bg_alpha = 2.0f / (BG_LENGTH + 1.0f);
+  const float mvt_alpha = 2.0f / (MVT_LENGTH + 1.0f);
+
+  // Background follows movement from before this frame, like frames leaving the movement window join the background
+  const float movement = stabilized_movement[loc];
+  stabilized_background[loc] += (movement - stabilized_background[loc]) * bg_alpha;
+  stabilized_movement[loc] = movement + (scaled_frame[loc] - movement) * mvt_alpha;
+
+  // Check if the difference is above the threshold
+  return fabs((stabilized_background[loc] - stabilized_movement[loc])) >= DIFFERENCE_THRESHOLD;
+#else
   // Calculate the change in average
-  const float bg_change = (mvt_frame_to_remove[loc] / bg_length[0]) - (bg_frame_to_remove[loc] / bg_length[0]);
-  const float mvt_change = (scaled_frame[loc] / mvt_length[0]) - (mvt_frame_to_remove[loc] / mvt_length[0]);
+  const float bg_change = (mvt_frame_to_remove[loc] / BG_LENGTH) - (bg_frame_to_remove[loc] / BG_LENGTH);
+  const float mvt_change = (scaled_frame[loc] / MVT_LENGTH) - (mvt_frame_to_remove[loc] / MVT_LENGTH);
 
   // Change average
   stabilized_background[loc] += bg_change;
   stabilized_movement[loc] += mvt_change;
 
   // Check if the difference is above the threshold
-  difference_frame_[loc] = fabs((stabilized_background[loc] - stabilized_movement[loc])) >= difference_threshold[0];
+  return fabs((stabilized_background[loc] - stabilized_movement[loc])) >= DIFFERENCE_THRESHOLD;
+#endif
+}
+
+kernel void stabilize_bg_mvt(global unsigned char* bg_frame_to_remove, global unsigned char* mvt_frame_to_remove, global unsigned char* scaled_frame, global float* bg_length,
+                             global float* mvt_length, global STABILIZED_TYPE* stabilized_background, global STABILIZED_TYPE* stabilized_movement, global int* difference_threshold,
+#ifdef PACKED_MASK
+                             global uint* difference_mask, global const int* pixel_count, local uint* mask_words
+#else
+                             global bool* difference_frame_
+#endif
+#ifdef ROI_TILES
+                             , global const int* roi_tiles, global const unsigned char* roi_mask, global const int* scaled_width, global const int* scaled_height
+#endif
+) {
+#ifdef ROI_TILES
+  // Every work group looks up which tile it is, tiles without watched pixels are never launched
+  const int x = roi_tiles[2 * get_group_id(1)] * get_local_size(0) + get_local_id(0);
+  const int y = roi_tiles[2 * get_group_id(1) + 1] * get_local_size(1) + get_local_id(1);
+  if (x >= OUTPUT_WIDTH || y >= OUTPUT_HEIGHT) return;
+  const int loc = y * OUTPUT_WIDTH + x;
+
+  // Pixels outside the region of interest are not stabilized and never count as changed
+  const bool changed = roi_mask[loc] && stabilize_pixel(loc, bg_frame_to_remove, mvt_frame_to_remove, scaled_frame, bg_length, mvt_length, stabilized_background,
+                                                        stabilized_movement, difference_threshold);
+#ifdef PACKED_MASK
+  // Tiles do not line up with words, so bits are ORed into the mask (mask is cleared before every frame)
+  if (changed) atomic_or(&difference_mask[loc / 32], 1U << (loc % 32));
+#else
+  difference_frame_[loc] = changed;
+#endif
+#elif defined(PACKED_MASK)
+  const int loc = get_global_id(0);
+
+  // Work items past the end of the frame only pad out the last word with zero bits
+  const bool changed = loc < PIXEL_COUNT && stabilize_pixel(loc, bg_frame_to_remove, mvt_frame_to_remove, scaled_frame, bg_length, mvt_length, stabilized_background,
+                                                            stabilized_movement, difference_threshold);
+
+  // Ballot the work group's bits into local words, 32 pixels to a word
+  const int local_loc = get_local_id(0);
+  const int group_words = (get_local_size(0) + 31) / 32;
+  if (local_loc < group_words) mask_words[local_loc] = 0;
+  barrier(CLK_LOCAL_MEM_FENCE);
+  if (changed) atomic_or(&mask_words[local_loc / 32], 1U << (loc % 32));
+  barrier(CLK_LOCAL_MEM_FENCE);
+
+  // Work groups of 32 or more own their words, smaller work groups share a word and OR their part into it (mask is cleared before every frame)
+  if (local_loc < group_words) {
+    const int word = get_group_id(0) * get_local_size(0) / 32 + local_loc;
+    if (get_local_size(0) >= 32) {
+      difference_mask[word] = mask_words[local_loc];
+    } else if (mask_words[0] != 0) {
+      atomic_or(&difference_mask[word], mask_words[0]);
+    }
+  }
+#else
+  const int loc = get_global_id(0);
+  difference_frame_[loc] = stabilize_pixel(loc, bg_frame_to_remove, mvt_frame_to_remove, scaled_frame, bg_length, mvt_length, stabilized_background, stabilized_movement,
+                                           difference_threshold);
+#endif
 }
\ No newline at end of file
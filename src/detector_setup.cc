@@ -0,0 +1,144 @@
+#include "detector_setup.hpp"
+
+#include <CL/opencl.h>
+
+#include <CL/cl2.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "generate_gaussian.hpp"
+#include "motion_detector.hpp"
+
+void ValidateMotionConfig(const InputVideoSettings& input_vid_settings, const MotionConfig& motion_config) {
+  // Check if scale denominator is 0 and throw error if it is
+  if (motion_config.scale_denominator == 0) throw std::invalid_argument("Scale denominator cannot be 0");
+
+  // Check if stabilize background and movement is 0 and throw error if it is
+  if (motion_config.bg_stabil_length == 0) throw std::invalid_argument("Background stabilization length cannot be 0");
+  if (motion_config.motion_stabil_length == 0) throw std::invalid_argument("Movement stabilization length cannot be 0");
+
+  // Check if miniumn changed pixels is not negative and also not greater than 1
+  if (motion_config.min_changed_pixels < 0) throw std::invalid_argument("Minimum changed pixels cannot be negative");
+  if (motion_config.min_changed_pixels > 1) throw std::invalid_argument("Minimum changed pixels cannot be gretaer than 1");
+
+  // Integer sums are compared multiplied by both lengths, which has to fit in an int on the device
+  if (motion_config.integer_sums) {
+    const uint64_t largest_product =
+        static_cast<uint64_t>(std::max(MAX_PIXEL_VALUE, motion_config.min_pixel_diff)) * motion_config.bg_stabil_length * motion_config.motion_stabil_length;
+    if (largest_product > INT32_MAX) throw std::invalid_argument("Stabilization lengths are too long for integer sums");
+  }
+
+  // Exponential averages are not sums of whole frames
+  if (motion_config.integer_sums && motion_config.background_model == BackgroundModel::kExponential) {
+    throw std::invalid_argument("Integer sums can only be used with BackgroundModel::kWindow");
+  }
+
+  // Check height and width of input video and throw error if too small
+  std::vector<double> gaussian = GenerateGaussian(motion_config.gaussian_size);
+  gaussian = ScaleGaussian(gaussian, motion_config.scale_denominator);
+  if (input_vid_settings.width < gaussian.size()) throw std::invalid_argument("Input video width is too small!");
+  if (input_vid_settings.height < gaussian.size()) throw std::invalid_argument("Input video height is too small!");
+}
+
+DetectorSizes CalculateDetectorSizes(const InputVideoSettings& input_vid_settings, const MotionConfig& motion_config, unsigned int scaled_width,
+                                     unsigned int scaled_height) {
+  DetectorSizes sizes;
+  // Remove margin from image for gaussian blur
+  unsigned int width_margin_removed = input_vid_settings.width - (2 * motion_config.gaussian_size * motion_config.scale_denominator);
+  unsigned int height_margin_removed = input_vid_settings.height - (2 * motion_config.gaussian_size * motion_config.scale_denominator);
+  // Calculate scaled width and height, unless frames are already scaled some other way
+  sizes.scaled_width = width_margin_removed / motion_config.scale_denominator;
+  sizes.scaled_height = height_margin_removed / motion_config.scale_denominator;
+  if (scaled_width > 0 && scaled_height > 0) {
+    sizes.scaled_width = scaled_width;
+    sizes.scaled_height = scaled_height;
+  }
+
+  // Calculate buffer sizes
+  sizes.input_frame_buffer_size =
+      (input_vid_settings.width + 1) * (input_vid_settings.height + 1);  // Add one just so there is room for the possible extra height needed to ensure raspi compatibility
+  if (input_vid_settings.frame_format == DecompFrameFormat::kRGB) sizes.input_frame_buffer_size *= 3;  // If RGB frames, need 3 times the bytes
+  sizes.intermediate_scaled_frame_buffer_size = (input_vid_settings.width + 1) * (sizes.scaled_height + 1);
+  sizes.scaled_frame_buffer_size = (sizes.scaled_width + 1) * (sizes.scaled_height + 1);
+
+  // Make divisible by MEM_ALIGN to ensure aligned memory access for raspi compatability
+  sizes.input_frame_buffer_size += MEM_ALIGN - (sizes.input_frame_buffer_size % MEM_ALIGN);
+  sizes.intermediate_scaled_frame_buffer_size += MEM_ALIGN - (sizes.intermediate_scaled_frame_buffer_size % MEM_ALIGN);
+  sizes.scaled_frame_buffer_size += MEM_ALIGN - (sizes.scaled_frame_buffer_size % MEM_ALIGN);
+
+  // Stabilized buffers hold float averages, or window sums in the smallest integer they fit in
+  sizes.stabilized_element_size = sizeof(float);
+  if (motion_config.integer_sums) {
+    const unsigned int longest = std::max(motion_config.bg_stabil_length, motion_config.motion_stabil_length);
+    sizes.stabilized_element_size = MAX_PIXEL_VALUE * longest <= UINT16_MAX ? sizeof(cl_ushort) : sizeof(cl_uint);
+  }
+
+  // Frame history holds enough frames to remove the oldest from both the background and movement averages
+  sizes.history_length = motion_config.bg_stabil_length + motion_config.motion_stabil_length + 1;
+  // Exponential averages never remove a frame, so only the newest one is kept
+  if (motion_config.background_model == BackgroundModel::kExponential) sizes.history_length = 1;
+  return sizes;
+}
+
+std::string MakeKernelDefines(const InputVideoSettings& input_vid_settings, const MotionConfig& motion_config, const DetectorSizes& sizes) {
+  std::ostringstream defines;
+  // Kernels are compiled with the configuration built in unless argument buffers were asked for
+  if (motion_config.specialize_kernels) {
+    std::vector<double> gaussian = GenerateGaussian(motion_config.gaussian_size);
+    gaussian = ScaleGaussian(gaussian, motion_config.scale_denominator);
+    const int colors = input_vid_settings.frame_format == DecompFrameFormat::kRGB ? 3 : 1;
+
+    // Same values that are written to the argument buffers, kernels fall back to the buffers for anything not defined
+    defines << " -DGAUSSIAN_SIZE=" << gaussian.size();
+    defines << " -DSCALE=" << motion_config.scale_denominator;
+    defines << " -DCOLORS=" << colors;
+    defines << " -DINPUT_WIDTH=" << input_vid_settings.width;
+    defines << " -DOUTPUT_WIDTH=" << sizes.scaled_width;
+    defines << " -DOUTPUT_HEIGHT=" << sizes.scaled_height;
+    defines << " -DBG_LENGTH=" << motion_config.bg_stabil_length << ".0f";
+    defines << " -DMVT_LENGTH=" << motion_config.motion_stabil_length << ".0f";
+    defines << " -DDIFFERENCE_THRESHOLD=" << motion_config.min_pixel_diff;
+    defines << " -DPIXEL_COUNT=" << sizes.scaled_width * sizes.scaled_height;
+
+    // Gaussian weights as hex floats so the kernels see exactly the floats in the gaussian buffer
+    defines << " -DGAUSSIAN_WEIGHTS=" << std::hexfloat;
+    for (int i = 0; i < gaussian.size(); i++) {
+      if (i > 0) defines << ",";
+      defines << static_cast<float>(gaussian.at(i)) << "f";
+    }
+    defines << std::defaultfloat;
+  }
+  // Integer sums change the type of the stabilized buffers, so they are compiled in either way
+  if (motion_config.integer_sums) defines << " -DINTEGER_SUMS -DSUM_TYPE=" << (sizes.stabilized_element_size == sizeof(cl_ushort) ? "ushort" : "uint");
+  // Exponential averages replace the window math of the stabilize kernels
+  if (motion_config.background_model == BackgroundModel::kExponential) defines << " -DEXPONENTIAL_AVERAGE";
+  return defines.str();
+}
+
+cl::Buffer CreateIntBuffer(const cl::Context& context, const cl::CommandQueue& queue, int value, const std::string& name) {
+  int error = CL_SUCCESS;
+  int host_value[2] = {value, 0};  // 2 instead of 1 to ensure aligned memory access for raspi compatability
+  // create buffer object
+  cl::Buffer buffer = cl::Buffer(context, CL_MEM_READ_ONLY, 2 * sizeof(int), nullptr, &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error creating " + name + " buffer with error code: " + std::to_string(error));
+  // write to OpenCL device
+  error = queue.enqueueWriteBuffer(buffer, CL_TRUE, 0, 2 * sizeof(int), static_cast<void*>(host_value));
+  if (error != CL_SUCCESS) throw std::runtime_error("Error writing " + name + " buffer with error code: " + std::to_string(error));
+  return buffer;
+}
+
+cl::Buffer CreateFloatBuffer(const cl::Context& context, const cl::CommandQueue& queue, float value, const std::string& name) {
+  int error = CL_SUCCESS;
+  float host_value[2] = {value, 0.0F};  // 2 instead of 1 to ensure aligned memory access for raspi compatability
+  // create buffer object
+  cl::Buffer buffer = cl::Buffer(context, CL_MEM_READ_ONLY, 2 * sizeof(float), nullptr, &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error creating " + name + " buffer with error code: " + std::to_string(error));
+  // write to OpenCL device
+  error = queue.enqueueWriteBuffer(buffer, CL_TRUE, 0, 2 * sizeof(float), static_cast<void*>(host_value));
+  if (error != CL_SUCCESS) throw std::runtime_error("Error writing " + name + " buffer with error code: " + std::to_string(error));
+  return buffer;
+}
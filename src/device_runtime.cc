@@ -0,0 +1,96 @@
+#include "device_runtime.hpp"
+
+#include <CL/opencl.h>
+
+#include <CL/cl2.hpp>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "open_cl_interface.hpp"
+#include "program_cache.hpp"
+
+DeviceRuntime::DeviceRuntime(DeviceConfig device_config, std::ostream* output, const std::string& program_cache_dir) : device_config_(device_config) {
+  info = output;
+  if (device_config_.device_type == DeviceType::kNative) throw std::invalid_argument("DeviceRuntime needs an OpenCL device, DeviceType::kNative has none");
+
+  // Select device
+  device_ = OpenCLInterface::GetDevice(device_config_);
+  *info << "Selected device: " + device_.getInfo<CL_DEVICE_NAME>() << std::endl;
+  // Create context and command queues
+  int error = CL_SUCCESS;
+  context_ = cl::Context(device_, nullptr, nullptr, nullptr, &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to create OpenCL context with error code: " + std::to_string(error));
+  cmd_queue_ = cl::CommandQueue(context_, device_, 0, &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error creating OpenCL command queue with error code: " + std::to_string(error));
+  // Separate queue so asynchronous frames can upload while the command queue runs kernels
+  transfer_queue_ = cl::CommandQueue(context_, device_, 0, &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error creating OpenCL transfer queue with error code: " + std::to_string(error));
+
+  // Reuse program binaries built by earlier runs
+  if (!program_cache_dir.empty()) program_cache_ = std::make_unique<ProgramCache>(program_cache_dir);
+}
+
+cl::Program DeviceRuntime::GetProgram(const std::string& filename, const std::string& options) {
+  // Detectors are often created together on many threads, holding the lock while building means each program is only built once
+  std::lock_guard<std::mutex> lock(programs_mutex_);
+  auto built = programs_.find({filename, options});
+  if (built != programs_.end()) return built->second;
+
+  cl::Program program = BuildProgram(filename, options);
+  programs_.emplace(std::make_pair(filename, options), program);
+  return program;
+}
+
+size_t DeviceRuntime::GetProgramCount() {
+  std::lock_guard<std::mutex> lock(programs_mutex_);
+  return programs_.size();
+}
+
+DeviceConfig DeviceRuntime::GetDeviceConfig() const { return device_config_; }
+
+const cl::Device& DeviceRuntime::GetDevice() const { return device_; }
+
+const cl::Context& DeviceRuntime::GetContext() const { return context_; }
+
+const cl::CommandQueue& DeviceRuntime::GetCommandQueue() const { return cmd_queue_; }
+
+const cl::CommandQueue& DeviceRuntime::GetTransferQueue() const { return transfer_queue_; }
+
+cl::Program DeviceRuntime::BuildProgram(const std::string& filename, const std::string& options) {
+  // Read the program source
+  std::ifstream ifs(filename);
+  if (!ifs.good()) throw std::runtime_error("Error while opening OpenCL kernel file: " + filename);
+  std::string source_code(std::istreambuf_iterator<char>(ifs), (std::istreambuf_iterator<char>()));
+
+  // Use binary built earlier for this device, source and options if there is one
+  cl::Program program;
+  if (program_cache_ && program_cache_->Find(context_, device_, source_code, options, &program)) {
+    *info << "Loaded cached OpenCL kernel file: " + filename << std::endl;
+    return program;
+  }
+
+  // Create OpenCL program
+  cl::Program::Sources source;
+  source.push_back({source_code.c_str(), source_code.length()});
+  int error = CL_SUCCESS;
+  program = cl::Program(context_, source, &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to create OpenCL program from kernel file: " + filename);
+
+  // Build program and throw errors if fails
+  error = program.build(options.c_str());
+  if (error != CL_SUCCESS) {
+    *info << "OpenCL build failed! Build Log:\n" << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device_) << std::endl;
+    throw std::runtime_error("Failed to compile OpenCL kernel file: " + filename);
+  }
+  *info << "Successfully compiled OpenCL kernel file: " + filename << std::endl;
+
+  // Caching is best effort, a runtime that can not write the cache still works
+  if (program_cache_ && !program_cache_->Store(device_, source_code, options, program)) *info << "Could not cache OpenCL kernel file: " + filename << std::endl;
+  return program;
+}
@@ -0,0 +1,80 @@
+#include "frame_buffer_pool.hpp"
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+FrameBufferPool::FrameBufferPool(unsigned int max_free_per_size) : max_free_per_size_(max_free_per_size) {}
+
+FrameBufferPool& FrameBufferPool::Shared() {
+  static FrameBufferPool pool;
+  return pool;
+}
+
+FrameBufferPool::Buffer FrameBufferPool::Acquire(size_t size) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto free = free_.find(size);
+    if (free != free_.end() && !free->second.empty()) {
+      std::unique_ptr<unsigned char[]> data = std::move(free->second.back());
+      free->second.pop_back();
+      return Buffer(this, std::move(data), size);
+    }
+  }
+  // Allocate outside of lock so other threads are not held up
+  return Buffer(this, std::unique_ptr<unsigned char[]>(new unsigned char[size]), size);
+}
+
+size_t FrameBufferPool::GetFreeBuffers() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t buffers = 0;
+  for (auto& free : free_) buffers += free.second.size();
+  return buffers;
+}
+
+void FrameBufferPool::Return(std::unique_ptr<unsigned char[]> data, size_t size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<std::unique_ptr<unsigned char[]>>& free = free_[size];
+  if (free.size() < max_free_per_size_) free.push_back(std::move(data));
+}
+
+FrameBufferPool::Buffer::Buffer(FrameBufferPool* pool, std::unique_ptr<unsigned char[]> data, size_t size) : pool_(pool), data_(std::move(data)), size_(size) {}
+
+FrameBufferPool::Buffer::~Buffer() { Release(); }
+
+FrameBufferPool::Buffer::Buffer(Buffer&& other) noexcept : pool_(other.pool_), data_(std::move(other.data_)), size_(other.size_) {
+  other.pool_ = nullptr;
+  other.size_ = 0;
+}
+
+FrameBufferPool::Buffer& FrameBufferPool::Buffer::operator=(Buffer&& other) noexcept {
+  if (this != &other) {
+    Release();
+    pool_ = other.pool_;
+    data_ = std::move(other.data_);
+    size_ = other.size_;
+    other.pool_ = nullptr;
+    other.size_ = 0;
+  }
+  return *this;
+}
+
+unsigned char* FrameBufferPool::Buffer::GetData() const { return data_.get(); }
+
+size_t FrameBufferPool::Buffer::GetSize() const { return size_; }
+
+void FrameBufferPool::Buffer::Release() {
+  if (pool_ != nullptr && data_) {
+    // Returning only fails if memory runs out, in which case buffer is just freed
+    try {
+      pool_->Return(std::move(data_), size_);
+    } catch (...) {
+    }
+  }
+  pool_ = nullptr;
+  data_.reset();
+  size_ = 0;
+}
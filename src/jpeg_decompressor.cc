@@ -2,24 +2,219 @@
 
 #include <turbojpeg.h>
 
+// clang-format off
+#include <cstdio>  // jpeglib.h needs FILE and size_t declared first
+#include <jpeglib.h>
+// clang-format on
+#include <csetjmp>
+#include <cstring>
+#include <memory>
 #include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+#define DCT_BLOCK_SIZE 8
+#define JPEG_MARKER 0xFF
+#define JPEG_RST0 0xD0
+#define JPEG_RST7 0xD7
+#define JPEG_EOI 0xD9
+#define JPEG_SOS 0xDA
+#define JPEG_DRI 0xDD
+#define JPEG_SOF0 0xC0
+#define JPEG_SOF1 0xC1
+#define SEGMENT_LENGTH_SIZE 2  // Bytes of segment length field, counted in the length
+#define SOF_HEADER_LENGTH 8    // Length of start of frame segment before its components
+#define SOF_COMPONENT_SIZE 3   // Bytes per component in start of frame segment
+#define DRI_LENGTH 4           // Length of define restart interval segment
+#define SOS_MIN_LENGTH 3       // Length of start of scan segment up to its component count
+
+namespace {
+/**
+ * ErrorManager - libjpeg error handler that jumps back to the caller instead of exiting the program
+ */
+struct ErrorManager {
+  jpeg_error_mgr manager;         // libjpeg error handler (must be first)
+  std::jmp_buf jump;              // Where to return to when libjpeg hits an error
+  char message[JMSG_LENGTH_MAX];  // Message of last libjpeg error
+};
+
+/**
+ * ExitOnError() - libjpeg error_exit handler for ErrorManager
+ *
+ * info:      libjpeg object that hit the error
+ */
+void ExitOnError(j_common_ptr info) {
+  ErrorManager* error = reinterpret_cast<ErrorManager*>(info->err);
+  (*info->err->format_message)(info, error->message);
+  std::longjmp(error->jump, 1);
+}
+
+/**
+ * IgnoreMessage() - libjpeg output_message handler that keeps warnings off stderr
+ *
+ * info:      libjpeg object with the message
+ */
+void IgnoreMessage(j_common_ptr) {}
+
+/**
+ * JpegLayout - Where the parts of a baseline JPEG needed to split it into strips are
+ */
+struct JpegLayout {
+  unsigned long sof_height;       // Offset of image height in start of frame segment
+  unsigned long sos;              // Offset of start of scan marker
+  unsigned long scan_start;       // Offset of first byte of entropy coded data
+  unsigned long scan_end;         // Offset of end of image marker
+  unsigned int restart_interval;  // MCUs between restart markers
+  unsigned int mcu_width;         // Width of MCU in pixels
+  unsigned int mcu_height;        // Height of MCU in pixels
+};
+
+/**
+ * ReadLayout() - Finds the layout of a single scan baseline JPEG with restart markers
+ *
+ * jpeg:      JPEG image
+ * size:      size of JPEG image in bytes
+ * layout:    set to layout of JPEG
+ * restarts:  set to the offset of every restart marker in the entropy coded data
+ * returns:   bool - false if JPEG is not a single scan baseline JPEG with restart markers
+ */
+bool ReadLayout(const unsigned char* jpeg, unsigned long size, JpegLayout* layout, std::vector<unsigned long>* restarts) {
+  layout->restart_interval = 0;
+  layout->mcu_width = 0;
+  unsigned int components = 0;
+  restarts->clear();
+
+  // Walk marker segments up to start of scan
+  unsigned long pos = 2;  // Past start of image marker
+  while (true) {
+    if (pos + 4 > size || jpeg[pos] != JPEG_MARKER) return false;
+    unsigned char marker = jpeg[pos + 1];
+    unsigned int length = jpeg[pos + 2] << 8 | jpeg[pos + 3];
+    unsigned long segment_end = pos + 2 + length;
+    if (length < SEGMENT_LENGTH_SIZE || segment_end > size) return false;
+
+    // Segments are only read within their length, so truncated and corrupted frames fall back instead of reading past them
+    if (marker == JPEG_SOF0 || marker == JPEG_SOF1) {
+      if (length < SOF_HEADER_LENGTH) return false;
+      layout->sof_height = pos + 5;
+      components = jpeg[pos + 9];
+      if (length < SOF_HEADER_LENGTH + SOF_COMPONENT_SIZE * components) return false;
+      unsigned int max_h = 1;
+      unsigned int max_v = 1;
+      for (unsigned int i = 0; i < components; i++) {
+        unsigned char sampling = jpeg[pos + 11 + 3 * i];
+        if ((sampling >> 4) > max_h) max_h = sampling >> 4;
+        if ((sampling & 0x0F) > max_v) max_v = sampling & 0x0F;  // NOLINT(readability-magic-numbers)
+      }
+      // Single component scans are not interleaved, so MCUs are one block
+      layout->mcu_width = components == 1 ? DCT_BLOCK_SIZE : DCT_BLOCK_SIZE * max_h;
+      layout->mcu_height = components == 1 ? DCT_BLOCK_SIZE : DCT_BLOCK_SIZE * max_v;
+    } else if (marker > JPEG_SOF1 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {  // NOLINT(readability-magic-numbers)
+      return false;                                                                                           // Progressive, lossless and arithmetic coded JPEGs (DHT, JPG and DAC share the range)
+    } else if (marker == JPEG_DRI) {
+      if (length < DRI_LENGTH) return false;
+      layout->restart_interval = jpeg[pos + 4] << 8 | jpeg[pos + 5];
+    } else if (marker == JPEG_SOS) {
+      // Every component has to be in the one scan
+      if (length < SOS_MIN_LENGTH || layout->mcu_width == 0 || jpeg[pos + 4] != components) return false;
+      layout->sos = pos;
+      layout->scan_start = segment_end;
+      break;
+    }
+    pos = segment_end;
+  }
+  if (layout->restart_interval == 0) return false;
+
+  // Find restart markers and end of image in entropy coded data, markers are the only place 0xFF is not followed by 0x00
+  pos = layout->scan_start;
+  while (pos + 1 < size) {
+    const void* next = std::memchr(jpeg + pos, JPEG_MARKER, size - pos - 1);
+    if (next == nullptr) return false;
+    pos = static_cast<const unsigned char*>(next) - jpeg;
+    unsigned char marker = jpeg[pos + 1];
+    if (marker == 0x00) {
+      pos += 2;
+    } else if (marker >= JPEG_RST0 && marker <= JPEG_RST7) {
+      restarts->push_back(pos);
+      pos += 2;
+    } else if (marker == JPEG_MARKER) {
+      pos++;  // Fill byte
+    } else if (marker == JPEG_EOI) {
+      layout->scan_end = pos;
+      return true;
+    } else {
+      return false;  // More scans or other markers
+    }
+  }
+  return false;
+}
+}  // namespace
+
+struct JpegDecompressor::CoefficientReader {
+  jpeg_decompress_struct info;  // libjpeg decompressor
+  ErrorManager error;           // Error handler for info
+};
+
+struct JpegDecompressor::StripDecoder {
+  explicit StripDecoder(unsigned int threads) : pool(threads) {}
+
+  ThreadPool pool;                                // Threads strips are decompressed on
+  std::vector<tjhandle> handles;                  // TurboJPEG handle for each strip
+  std::vector<std::vector<unsigned char>> jpegs;  // Standalone JPEG built for each strip
+  std::vector<unsigned long> restarts;            // Offsets of restart markers in current JPEG
+  std::vector<unsigned int> strip_rows;           // First MCU row of each strip, then number of MCU rows
+};
+
+JpegDecompressor::JpegDecompressor(unsigned int width, unsigned int height, DecompFrameFormat frame_format, DecompFrameMethod decomp_method, unsigned int decode_scale,
+                                   unsigned int strip_threads)
+    : width_(width), height_(height), decode_scale_(decode_scale) {
+  // Find IDCT scaling factor for decode scale and throw error if libjpeg-turbo does not support it
+  int num_scaling_factors = 0;
+  tjscalingfactor* scaling_factors = tjGetScalingFactors(&num_scaling_factors);
+  bool supported = false;
+  for (int i = 0; i < num_scaling_factors; i++) {
+    if (scaling_factors[i].num == 1 && scaling_factors[i].denom == static_cast<int>(decode_scale)) supported = true;
+  }
+  if (!supported && decode_scale != 1) throw std::invalid_argument("Decode scale is not a supported IDCT scaling factor");
+  tjscalingfactor scaling_factor = {1, static_cast<int>(decode_scale)};
+  scaled_width_ = TJSCALED(static_cast<int>(width_), scaling_factor);
+  scaled_height_ = TJSCALED(static_cast<int>(height_), scaling_factor);
+
+  // DC images have one pixel per 8x8 luma block
+  dc_width_ = (width_ + DCT_BLOCK_SIZE - 1) / DCT_BLOCK_SIZE;
+  dc_height_ = (height_ + DCT_BLOCK_SIZE - 1) / DCT_BLOCK_SIZE;
+  dc_size_ = (dc_width_ * dc_height_ + DCT_BLOCK_SIZE - 1) / DCT_BLOCK_SIZE * DCT_BLOCK_SIZE;
 
-JpegDecompressor::JpegDecompressor(unsigned int width, unsigned int height, DecompFrameFormat frame_format, DecompFrameMethod decomp_method) : width_(width), height_(height) {
   // Create decompressor and throw error if it fails
   tj_decompressor_ = tjInitDecompress();
   if (tj_decompressor_ == NULL) throw std::runtime_error("Failed to initialize JPEG decompressor");
 
+  // Create coefficient reader and throw error if it fails
+  coefficient_reader_ = std::make_unique<CoefficientReader>();
+  coefficient_reader_->info.err = jpeg_std_error(&coefficient_reader_->error.manager);
+  coefficient_reader_->error.manager.error_exit = ExitOnError;
+  coefficient_reader_->error.manager.output_message = IgnoreMessage;
+  if (setjmp(coefficient_reader_->error.jump) != 0) {
+    coefficient_reader_.reset();
+    tjDestroy(tj_decompressor_);
+    throw std::runtime_error("Failed to initialize JPEG coefficient reader");
+  }
+  jpeg_create_decompress(&coefficient_reader_->info);
+
   // Set pixel_format_ flag and decompressed_size appropriately based on frame_format
   switch (frame_format) {
     case (DecompFrameFormat::kGray): {
+      // Grayscale output from a YCbCr JPEG is just the Y plane, chroma components are never decoded
       pixel_format_ = TJPF::TJPF_GRAY;
-      decompressed_size_ = (width_ + 1) * (height_ + 1);
+      decompressed_size_ = (scaled_width_ + 1) * (scaled_height_ + 1);
       break;
     }
     case (DecompFrameFormat::kRGB):
     default: {
       pixel_format_ = TJPF::TJPF_RGB;
-      decompressed_size_ = (width_ + 1) * (height_ + 1) * 3;
+      decompressed_size_ = (scaled_width_ + 1) * (scaled_height_ + 1) * 3;
       break;
     }
   }
@@ -34,6 +229,24 @@ JpegDecompressor::JpegDecompressor(unsigned int width, unsigned int height, Deco
       decomp_flags_ = TJFLAG_ACCURATEDCT;
     }
   }
+
+  // Create strip decoder with a TurboJPEG handle per thread, not worth it with only one thread
+  if (strip_threads != 1) {
+    strip_decoder_ = std::make_unique<StripDecoder>(strip_threads);
+    if (strip_decoder_->pool.GetThreadCount() == 1) {
+      strip_decoder_.reset();
+      return;
+    }
+    for (int i = 0; i < strip_decoder_->pool.GetThreadCount(); i++) {
+      tjhandle handle = tjInitDecompress();
+      if (handle == NULL) {
+        DestroyDecompressor();
+        throw std::runtime_error("Failed to initialize JPEG strip decompressor");
+      }
+      strip_decoder_->handles.push_back(handle);
+    }
+    strip_decoder_->jpegs = std::vector<std::vector<unsigned char>>(strip_decoder_->handles.size());
+  }
 }
 
 JpegDecompressor::~JpegDecompressor() {
@@ -44,9 +257,24 @@ JpegDecompressor::~JpegDecompressor() {
 }
 
 unsigned char* JpegDecompressor::DecompressImage(const unsigned char* compressed_image, unsigned long jpeg_size) const {
+  // Create destination for image
+  unsigned char* decompressed_image = new unsigned char[decompressed_size_];
+  try {
+    DecompressImage(compressed_image, jpeg_size, decompressed_image, decompressed_size_);
+  } catch (...) {
+    delete[] decompressed_image;
+    throw;
+  }
+  return decompressed_image;
+}
+
+void JpegDecompressor::DecompressImage(const unsigned char* compressed_image, unsigned long jpeg_size, unsigned char* destination, unsigned long destination_size) const {
+  // Throw error if destination is too small
+  if (destination_size < decompressed_size_) throw std::length_error("Destination is too small for decompressed image");
+
   // Decompress header of JPEG for metadata
-  int width;
-  int height;
+  int width = 0;
+  int height = 0;
   int jpeg_subsampling;
   int jpeg_colorspace;
   tjDecompressHeader3(tj_decompressor_, compressed_image, jpeg_size, &width, &height, &jpeg_subsampling, &jpeg_colorspace);
@@ -55,20 +283,217 @@ unsigned char* JpegDecompressor::DecompressImage(const unsigned char* compressed
   if (width != width_) throw std::out_of_range("Width of compressed JPEG image did not match expected value");
   if (height != height_) throw std::out_of_range("Height of compressed JPEG image did not match expected value");
 
-  // Create destination for image
-  unsigned char* decompressed_image = new unsigned char[decompressed_size_];
+  // Only decompress the window when there is one
+  if (window_width_ > 0) {
+    DecompressWindow(compressed_image, jpeg_size, destination);
+    return;
+  }
 
-  // Decompress image and throw error if fails
+  // Decompress strips at the same time if JPEG has restart markers
+  if (strip_decoder_ != nullptr && DecompressStrips(compressed_image, jpeg_size, destination)) return;
+
+  // Decompress image and throw error if fails (asking for the scaled size makes TurboJPEG scale down in the IDCT)
   int pitch = 0;  // bytes per line in destination image, should be 0 for normal decompression
-  int success = tjDecompress2(tj_decompressor_, compressed_image, jpeg_size, decompressed_image, width, pitch, height, pixel_format_, decomp_flags_);
+  int success = tjDecompress2(tj_decompressor_, compressed_image, jpeg_size, destination, static_cast<int>(scaled_width_), pitch, static_cast<int>(scaled_height_),
+                              pixel_format_, decomp_flags_);
   if (success != 0) throw std::runtime_error("Failed to decompresss image");
+}
 
-  return decompressed_image;
+void JpegDecompressor::SetDecodeWindow(unsigned int x, unsigned int y, unsigned int width, unsigned int height) {
+  if (width > 0 && (height == 0 || x + width > scaled_width_ || y + height > scaled_height_)) throw std::invalid_argument("Decode window must be inside the image");
+  window_x_ = x;
+  window_y_ = y;
+  window_width_ = width;
+  window_height_ = height;
+}
+
+unsigned char* JpegDecompressor::DecompressDCImage(const unsigned char* compressed_image, unsigned long jpeg_size) const {
+  // Create destination for image
+  unsigned char* dc_image = new unsigned char[dc_size_];
+  try {
+    DecompressDCImage(compressed_image, jpeg_size, dc_image, dc_size_);
+  } catch (...) {
+    delete[] dc_image;
+    throw;
+  }
+  return dc_image;
+}
+
+void JpegDecompressor::DecompressDCImage(const unsigned char* compressed_image, unsigned long jpeg_size, unsigned char* destination, unsigned long destination_size) const {
+  // Throw error if destination is too small
+  if (destination_size < dc_size_) throw std::length_error("Destination is too small for DC image");
+
+  jpeg_decompress_struct* info = &coefficient_reader_->info;
+  // Come back here if libjpeg hits an error
+  if (setjmp(coefficient_reader_->error.jump) != 0) {
+    jpeg_abort_decompress(info);
+    throw std::runtime_error(std::string("Failed to read JPEG coefficients: ") + coefficient_reader_->error.message);
+  }
+
+  // Decompress header of JPEG for metadata
+  jpeg_mem_src(info, compressed_image, jpeg_size);
+  jpeg_read_header(info, TRUE);
+
+  // If height or width don't match, throw error
+  if (info->image_width != width_ || info->image_height != height_) {
+    jpeg_abort_decompress(info);
+    throw std::out_of_range("Size of compressed JPEG image did not match expected value");
+  }
+
+  // Entropy decode coefficients without running the IDCT
+  jvirt_barray_ptr* coefficients = jpeg_read_coefficients(info);
+  jpeg_component_info* luma = &info->comp_info[0];
+  if (luma->width_in_blocks < dc_width_ || luma->height_in_blocks < dc_height_) {
+    jpeg_abort_decompress(info);
+    throw std::runtime_error("JPEG luma component is subsampled");
+  }
+  const int dc_quant = luma->quant_table->quantval[0];
+
+  // DC coefficient is 8 times the average of the block minus 128
+  for (JDIMENSION row = 0; row < dc_height_; row++) {
+    JBLOCKARRAY blocks = (*info->mem->access_virt_barray)(reinterpret_cast<j_common_ptr>(info), coefficients[0], row, 1, FALSE);
+    for (JDIMENSION col = 0; col < dc_width_; col++) {
+      const int dc = blocks[0][col][0] * dc_quant;
+      int average = (dc >= 0 ? dc + DCT_BLOCK_SIZE / 2 : dc - DCT_BLOCK_SIZE / 2) / DCT_BLOCK_SIZE + 128;  // NOLINT(readability-magic-numbers)
+      if (average < 0) average = 0;
+      if (average > 255) average = 255;  // NOLINT(readability-magic-numbers)
+      destination[row * dc_width_ + col] = static_cast<unsigned char>(average);
+    }
+  }
+  jpeg_finish_decompress(info);
 }
 
 unsigned int JpegDecompressor::GetDecompressedSize() const { return decompressed_size_; }
 
+unsigned int JpegDecompressor::GetDecompressedWidth() const { return scaled_width_; }
+
+unsigned int JpegDecompressor::GetDecompressedHeight() const { return scaled_height_; }
+
+unsigned int JpegDecompressor::GetDCWidth() const { return dc_width_; }
+
+unsigned int JpegDecompressor::GetDCHeight() const { return dc_height_; }
+
+unsigned int JpegDecompressor::GetDCSize() const { return dc_size_; }
+
+unsigned int JpegDecompressor::LargestDecodeScale(unsigned int scale_denominator) {
+  if (scale_denominator == 0) return 1;
+  // NOLINTBEGIN(readability-magic-numbers)
+  if (scale_denominator % 8 == 0) return 8;
+  if (scale_denominator % 4 == 0) return 4;
+  if (scale_denominator % 2 == 0) return 2;
+  // NOLINTEND(readability-magic-numbers)
+  return 1;
+}
+
+bool JpegDecompressor::DecompressStrips(const unsigned char* compressed_image, unsigned long jpeg_size, unsigned char* destination) const {
+  JpegLayout layout;
+  if (!ReadLayout(compressed_image, jpeg_size, &layout, &strip_decoder_->restarts)) return false;
+  const std::vector<unsigned long>& restarts = strip_decoder_->restarts;
+
+  // Every restart interval has to be there
+  unsigned int mcus_per_row = (width_ + layout.mcu_width - 1) / layout.mcu_width;
+  unsigned int mcu_rows = (height_ + layout.mcu_height - 1) / layout.mcu_height;
+  unsigned int intervals = (mcus_per_row * mcu_rows + layout.restart_interval - 1) / layout.restart_interval;
+  if (restarts.size() + 1 != intervals) return false;
+
+  // Split into even strips, moving each split down to the next MCU row that starts on a restart marker
+  std::vector<unsigned int>& strip_rows = strip_decoder_->strip_rows;
+  strip_rows.clear();
+  strip_rows.push_back(0);
+  unsigned int strips = strip_decoder_->handles.size();
+  for (unsigned int i = 1; i < strips; i++) {
+    unsigned int row = mcu_rows * i / strips;
+    if (row <= strip_rows.back()) row = strip_rows.back() + 1;
+    while (row < mcu_rows && (row * mcus_per_row) % layout.restart_interval != 0) row++;
+    if (row >= mcu_rows) break;
+    strip_rows.push_back(row);
+  }
+  if (strip_rows.size() == 1) return false;
+  strip_rows.push_back(mcu_rows);
+
+  // Each strip is a standalone JPEG: headers with the strip's height, its restart intervals renumbered from 0, then end of image
+  const unsigned int pixel_size = pixel_format_ == TJPF::TJPF_GRAY ? 1 : 3;
+  const int pitch = static_cast<int>(scaled_width_ * pixel_size);
+  tjscalingfactor scaling_factor = {1, static_cast<int>(decode_scale_)};
+  strip_decoder_->pool.RunTasks(strip_rows.size() - 1, [&](unsigned int strip) {
+    unsigned int first_row = strip_rows.at(strip) * layout.mcu_height;
+    unsigned int end_row = strip_rows.at(strip + 1) * layout.mcu_height;
+    if (end_row > height_) end_row = height_;
+    unsigned int first_interval = strip_rows.at(strip) * mcus_per_row / layout.restart_interval;
+    unsigned int end_interval = strip + 2 == strip_rows.size() ? intervals : strip_rows.at(strip + 1) * mcus_per_row / layout.restart_interval;
+    unsigned long data_start = first_interval == 0 ? layout.scan_start : restarts.at(first_interval - 1) + 2;
+    unsigned long data_end = end_interval == intervals ? layout.scan_end : restarts.at(end_interval - 1);
+
+    std::vector<unsigned char>& jpeg = strip_decoder_->jpegs.at(strip);
+    jpeg.assign(compressed_image, compressed_image + layout.sos);
+    jpeg.at(layout.sof_height) = static_cast<unsigned char>((end_row - first_row) >> 8);
+    jpeg.at(layout.sof_height + 1) = static_cast<unsigned char>((end_row - first_row) & 0xFF);  // NOLINT(readability-magic-numbers)
+    jpeg.insert(jpeg.end(), compressed_image + layout.sos, compressed_image + layout.scan_start);
+    unsigned long data_offset = jpeg.size();
+    jpeg.insert(jpeg.end(), compressed_image + data_start, compressed_image + data_end);
+    for (unsigned int i = first_interval; i + 1 < end_interval; i++) {
+      jpeg.at(data_offset + restarts.at(i) - data_start + 1) = static_cast<unsigned char>(JPEG_RST0 + (i - first_interval) % 8);  // NOLINT(readability-magic-numbers)
+    }
+    jpeg.push_back(JPEG_MARKER);
+    jpeg.push_back(JPEG_EOI);
+
+    // Strips start on MCU rows, so their scaled rows line up with the scaled image
+    unsigned char* strip_destination = destination + TJSCALED(static_cast<int>(first_row), scaling_factor) * pitch;
+    int success = tjDecompress2(strip_decoder_->handles.at(strip), jpeg.data(), jpeg.size(), strip_destination, static_cast<int>(scaled_width_), pitch,
+                                TJSCALED(static_cast<int>(end_row - first_row), scaling_factor), pixel_format_, decomp_flags_);
+    if (success != 0) throw std::runtime_error("Failed to decompresss image strip");
+  });
+  return true;
+}
+
+void JpegDecompressor::DecompressWindow(const unsigned char* compressed_image, unsigned long jpeg_size, unsigned char* destination) const {
+  jpeg_decompress_struct* info = &coefficient_reader_->info;
+  // Come back here if libjpeg hits an error
+  if (setjmp(coefficient_reader_->error.jump) != 0) {
+    jpeg_abort_decompress(info);
+    throw std::runtime_error(std::string("Failed to decompress image window: ") + coefficient_reader_->error.message);
+  }
+
+  // Ask for the same output TurboJPEG gives for pixel_format_ and decomp_flags_
+  jpeg_mem_src(info, compressed_image, jpeg_size);
+  jpeg_read_header(info, TRUE);
+  info->out_color_space = pixel_format_ == TJPF::TJPF_GRAY ? JCS_GRAYSCALE : JCS_RGB;
+  info->scale_num = 1;
+  info->scale_denom = decode_scale_;
+  info->dct_method = (decomp_flags_ & TJFLAG_FASTDCT) != 0 ? JDCT_IFAST : JDCT_ISLOW;
+  info->do_fancy_upsampling = (decomp_flags_ & TJFLAG_FASTUPSAMPLE) != 0 ? FALSE : TRUE;
+  jpeg_start_decompress(info);
+
+  // Crop columns first (libjpeg moves the start back to an MCU column), then skip rows above the window
+  JDIMENSION x = window_x_;
+  JDIMENSION width = window_width_;
+  jpeg_crop_scanline(info, &x, &width);
+  jpeg_skip_scanlines(info, window_y_);
+
+  // Cropped rows go where they would be in the whole image
+  const unsigned int pixel_size = pixel_format_ == TJPF::TJPF_GRAY ? 1 : 3;
+  while (info->output_scanline < window_y_ + window_height_) {
+    JSAMPROW row = destination + (static_cast<size_t>(info->output_scanline) * scaled_width_ + x) * pixel_size;
+    jpeg_read_scanlines(info, &row, 1);
+  }
+
+  // Rows below the window are never decoded
+  jpeg_abort_decompress(info);
+}
+
 void JpegDecompressor::DestroyDecompressor() {
+  // Destroy coefficient reader
+  if (coefficient_reader_ != nullptr) {
+    jpeg_destroy_decompress(&coefficient_reader_->info);
+    coefficient_reader_.reset();
+  }
+
+  // Destroy strip decoder
+  if (strip_decoder_ != nullptr) {
+    for (int i = 0; i < strip_decoder_->handles.size(); i++) tjDestroy(strip_decoder_->handles.at(i));
+    strip_decoder_.reset();
+  }
+
   // Destroy decompressor and throw error if it fails
   int success = tjDestroy(tj_decompressor_);
   if (success != 0) throw std::runtime_error("Failed to destroy JPEG decompressor");
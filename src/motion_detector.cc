@@ -3,165 +3,686 @@
 #include <CL/opencl.h>
 
 #include <CL/cl2.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <exception>
 #include <fstream>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <ostream>
 #include <stdexcept>
 
+#include "detector_setup.hpp"
+#include "device_runtime.hpp"
+#include "frame_buffer_pool.hpp"
 #include "generate_gaussian.hpp"
 #include "jpeg_decompressor.hpp"
+#include "native_pipeline.hpp"
 #include "open_cl_interface.hpp"
+#include "parallel_decoder.hpp"
 
-#define MEM_ALIGN 8
-#define OPEN_CL_COMPILE_FLAGS "-cl-fast-relaxed-math -w"
-#define MAX_WORK_GROUP_SIZE 1024
+#define MASK_WORD_BITS 32      // Pixels in every word of a packed difference mask
+#define REGION_FIELDS 9        // Pixels, min x, max x, min y, max y, sum of x (low, high), sum of y (low, high) of every region in label_regions.cl
+#define DC_BLOCK_SIZE 8        // Input pixels covered by every DC image pixel in each direction
+#define INPUT_FRAME_BUFFERS 3  // Frames that can be uploading while earlier frames are processed
+#define DECODE_QUEUE_DEPTH 2   // Frames queued per decode thread before DetectOnFrameAsync() waits
 
 MotionDetector::MotionDetector(InputVideoSettings input_vid_settings, MotionConfig motion_config, DeviceConfig device_config, std::ostream* output)
-    : input_vid_(input_vid_settings),
+    : MotionDetector(input_vid_settings, motion_config, device_config, nullptr, output) {}
+
+MotionDetector::MotionDetector(InputVideoSettings input_vid_settings, MotionConfig motion_config, std::shared_ptr<DeviceRuntime> runtime, std::ostream* output)
+    : MotionDetector(input_vid_settings, motion_config, runtime ? runtime->GetDeviceConfig() : throw std::invalid_argument("DeviceRuntime can not be null"), runtime,
+                     output) {}
+
+MotionDetector::MotionDetector(InputVideoSettings input_vid_settings, MotionConfig motion_config, DeviceConfig device_config, std::shared_ptr<DeviceRuntime> runtime,
+                               std::ostream* output)
+    : runtime_(std::move(runtime)),
+      input_vid_(input_vid_settings),
       motion_config_(motion_config),
       device_config_(device_config),
-      decompressor_(JpegDecompressor(input_vid_settings.width, input_vid_settings.height, input_vid_settings.frame_format, motion_config.decomp_method)) {
+      decompressor_(JpegDecompressor(input_vid_settings.width, input_vid_settings.height, input_vid_settings.frame_format, motion_config.decomp_method,
+                                     motion_config.dct_scaling && motion_config.processing_mode != ProcessingMode::kDCBlocks
+                                         ? JpegDecompressor::LargestDecodeScale(motion_config.scale_denominator)
+                                         : 1,
+                                     motion_config.strip_threads)) {
   info = output;
 
   // Check settings
   ValidateSettings();
+  // Decompressor scales frames down by the decode scale, the device only does the rest
+  if (motion_config_.dct_scaling && motion_config_.processing_mode != ProcessingMode::kDCBlocks) {
+    decode_scale_ = JpegDecompressor::LargestDecodeScale(motion_config_.scale_denominator);
+    input_vid_.width = decompressor_.GetDecompressedWidth();
+    input_vid_.height = decompressor_.GetDecompressedHeight();
+    motion_config_.scale_denominator /= decode_scale_;
+    *info << "Decode scale: 1/" << decode_scale_ << std::endl;
+  }
   // Calculate Buffer Sizes
   CalculateBufferSizes();
 
+  // Decode threads only hand frames on once they are submitted, so they can start before the device is ready
+  if (motion_config_.decode_threads > 0) InitDecoder(input_vid_settings);
+  // Only the part of the frames the region of interest blurs from is decompressed
+  if (!motion_config_.roi.IsEmpty()) InitDecodeWindow();
+
+  // Native device runs everything on the CPU and needs no OpenCL objects
+  if (device_config_.device_type == DeviceType::kNative) {
+    InitNative();
+    return;
+  }
+
   // Setup OpenCL device
   InitOpenCL();
 
   // Load Buffers
   LoadBlurAndScaleBuffers();
   LoadStabilizeAndCompareBuffers();
+  LoadCountDifferenceBuffers();
+  if (motion_config_.max_regions > 0) LoadRegionBuffers();
+  // Fills run on the command queue, wait for them so the transfer queue can not map an input slot before it is cleared
+  int error = cmd_queue_.finish();
+  if (error != CL_SUCCESS) throw std::runtime_error("Error initializing buffers with error code: " + std::to_string(error));
+  // -D options for the kernels, with the configuration built in unless argument buffers were asked for
+  InitKernelDefines();
   //  Load kernels
-  LoadBlurAndScaleKernels();
-  LoadStabilizeAndCompareKernel();
+  if (motion_config_.processing_mode == ProcessingMode::kFused) {
+    LoadFusedKernel();
+  } else if (motion_config_.processing_mode == ProcessingMode::kDCBlocks) {
+    LoadStabilizeAndCompareKernel();  // DC images are already scaled
+  } else {
+    LoadBlurAndScaleKernels();
+    LoadStabilizeAndCompareKernel();
+  }
+  LoadCountDifferenceKernel();
+  if (motion_config_.max_regions > 0) LoadRegionKernels();
+  if (!motion_config_.roi.IsEmpty()) LoadRoiTiles();
 
   // Create work sizes
   InitWorkSizes();
 }
 
 MotionDetector::~MotionDetector() {
-  for (int i = 0; i < frames_.size(); i++) {
-    delete[] frames_.at(i);
+  // Process frames still queued for decoding while everything they need is still around
+  decoder_.reset();
+  if (native_) return;
+  // Let outstanding asynchronous frames finish before their input slots are released
+  try {
+    cmd_queue_.finish();
+    transfer_queue_.finish();
+  } catch (...) {
   }
-  frames_.clear();
 }
 
 bool MotionDetector::DetectOnFrame(const unsigned char* frame, unsigned long size) {
-  unsigned char* decompressed = decompressor_.DecompressImage(frame, size);
+  // Frames queued for decoding go first, so frames stay in order
+  if (decoder_) decoder_->Finish();
+
+  if (native_) {
+    // Decode windows leave the rest of the frame as it was, so they need a frame no other detector writes to
+    if (!window_frame_.empty()) {
+      DecompressFrame(frame, size, window_frame_.data(), window_frame_.size());
+      return DetectOnDecompressedFrame(window_frame_.data());
+    }
+
+    // Borrowed buffer goes back to the shared pool on return, so steady state decompression does not allocate
+    FrameBufferPool::Buffer decompressed = FrameBufferPool::Shared().Acquire(input_frame_buffer_size_);
+    DecompressFrame(frame, size, decompressed.GetData(), decompressed.GetSize());
+    return DetectOnDecompressedFrame(decompressed.GetData());
+  }
 
-  bool motion = DetectOnDecompressedFrame(decompressed);
+  // Decompress straight into the first input slot, the in order queue only maps it once earlier kernels are done with it
+  DecompressIntoSlot(input_slots_.at(0), cmd_queue_, nullptr, frame, size);
 
-  delete[] decompressed;
+  // Queue processing kernels, the in order queue keeps them after the unmap
+  EnqueueProcessing(input_slots_.at(0).frame, nullptr, nullptr);
 
-  return motion;
+  // Only the total difference comes back from the device
+  unsigned int total_diff = CountDifferences();
+
+  return total_diff > diff_threshold_;
 }
 
 bool MotionDetector::DetectOnDecompressedFrame(const unsigned char* frame) {
-  // Run processing kernels
-  BlurAndScale(frame);
-  StabilizeAndCompareFrames();
+  if (native_) {
+    if (motion_config_.processing_mode == ProcessingMode::kDCBlocks) {
+      native_->SetScaledFrame(frame);
+    } else {
+      native_->BlurAndScale(frame);
+    }
+    native_->StabilizeAndCompareFrames();
+    return CountDifferences() > diff_threshold_;
+  }
 
-  // Pull difference frame from memory
-  bool* difference = new bool[scaled_frame_buffer_size_];
-  int error = cmd_queue_.enqueueReadBuffer(difference_frame_, CL_TRUE, 0, scaled_frame_buffer_size_ * sizeof(bool), static_cast<void*>(difference));
-  if (error != CL_SUCCESS) throw std::runtime_error("Failed to read difference frame from memory with error code: " + std::to_string(error));
+  // Write new frame to OpenCL device
+  WriteInputFrame(frame);
 
-  // Sum the total difference
-  unsigned int total_diff = 0;
-  for (int i = 0; i < scaled_frame_buffer_size_; i++) {
-    if (difference[i]) total_diff++;
-  }
+  // Queue processing kernels, the in order queue keeps them in order without waiting on each one
+  EnqueueProcessing(input_slots_.at(0).frame, nullptr, nullptr);
+
+  // Only the total difference comes back from the device
+  unsigned int total_diff = CountDifferences();
 
   return total_diff > diff_threshold_;
 }
 
-cl::Buffer& MotionDetector::BlurAndScale(const unsigned char* frame) {
+std::future<bool> MotionDetector::DetectOnFrameAsync(const unsigned char* frame, unsigned long size) {
+  // Decode threads decompress and process the frame, fulfilling the future in OnFrameDecoded()
+  if (decoder_) {
+    std::future<bool> motion;
+    {
+      std::lock_guard<std::mutex> lock(pending_mutex_);
+      pending_motion_.emplace_back();
+      motion = pending_motion_.back().get_future();
+    }
+    try {
+      decoder_->Submit(frame, size);
+    } catch (...) {
+      // Frame never made it into the queue, so its future is still the newest
+      std::lock_guard<std::mutex> lock(pending_mutex_);
+      pending_motion_.pop_back();
+      throw;
+    }
+    return motion;
+  }
+
+  // Native device has no queue to run ahead on, so the frame is processed before returning
+  if (native_) {
+    std::promise<bool> motion;
+    motion.set_value(DetectOnFrame(frame, size));
+    return motion.get_future();
+  }
+
   int error = CL_SUCCESS;
+  // Take the next input slot
+  InputSlot& slot = input_slots_.at(next_input_slot_);
+  next_input_slot_ = (next_input_slot_ + 1) % input_slots_.size();
+
+  // Decompress straight into the slot once the kernels reading its last frame are done, while the device works on earlier frames
+  std::vector<cl::Event> map_wait;
+  if (slot.released() != nullptr) map_wait.push_back(slot.released);
+  DecompressIntoSlot(slot, transfer_queue_, &map_wait, frame, size);
+  error = transfer_queue_.flush();
+  if (error != CL_SUCCESS) throw std::runtime_error("Error submitting frame upload with error code: " + std::to_string(error));
+
+  // Process once uploaded
+  std::vector<cl::Event> process_wait = {slot.uploaded};
+  EnqueueProcessing(slot.frame, &process_wait, &slot.released);
+  EnqueueCountDifferences();
+
+  // Read back count without blocking, the callback fulfills the future once it arrives
+  AsyncCount* count = new AsyncCount();
+  count->diff_threshold = diff_threshold_;
+  count->frame = QueueFrame();
+  count->last_changed = last_changed_pixels_;
+  std::future<bool> motion = count->motion.get_future();
+  cl::Event read;
+  error = cmd_queue_.enqueueReadBuffer(changed_pixels_, CL_FALSE, 0, sizeof(unsigned int), static_cast<void*>(&count->changed_pixels), nullptr, &read);
+  if (error != CL_SUCCESS) {
+    delete count;
+    throw std::runtime_error("Failed to queue changed pixel count read with error code: " + std::to_string(error));
+  }
+  error = read.setCallback(CL_COMPLETE, OnChangedPixelsRead, static_cast<void*>(count));
+  if (error != CL_SUCCESS) {
+    cmd_queue_.finish();
+    delete count;
+    throw std::runtime_error("Failed to set changed pixel count callback with error code: " + std::to_string(error));
+  }
+  error = cmd_queue_.flush();
+  if (error != CL_SUCCESS) throw std::runtime_error("Error submitting frame processing with error code: " + std::to_string(error));
+
+  return motion;
+}
+
+cl::Buffer& MotionDetector::BlurAndScale(const unsigned char* frame) {
+  if (native_) throw std::logic_error("Blur and scale buffer is not avaliable with native device");
   // Write new frame to OpenCL device
-  error = cmd_queue_.enqueueWriteBuffer(input_frame_, CL_TRUE, 0, input_frame_buffer_size_ * sizeof(unsigned char), static_cast<const void*>(frame));
+  WriteInputFrame(frame);
 
   // Queue kernels
+  EnqueueBlurAndScale(input_slots_.at(0).frame, nullptr, nullptr);
+  int error = cmd_queue_.finish();
+  if (error != CL_SUCCESS) throw std::runtime_error("Error while running blur and scale kernels with error code: " + std::to_string(error));
+
+  return history_frames_.at(newest_frame_loc_);
+}
+
+cl::Buffer& MotionDetector::StabilizeAndCompareFrames() {
+  if (native_) throw std::logic_error("Difference buffer is not avaliable with native device");
+  // Queue kernel
+  EnqueueStabilizeAndCompare();
+  int error = cmd_queue_.finish();
+  if (error != CL_SUCCESS) throw std::runtime_error("Error while running stabilize and compare kernel with error code: " + std::to_string(error));
+
+  return difference_frame_;
+}
+
+cl::Buffer& MotionDetector::BlurScaleAndCompareFused(const unsigned char* frame) {
+  if (native_) throw std::logic_error("Fused kernel is not avaliable with native device");
+  // Write new frame to OpenCL device
+  WriteInputFrame(frame);
+
+  // Queue kernel, nothing waits on it until the changed pixels are counted
+  EnqueueFused(input_slots_.at(0).frame, nullptr, nullptr);
+
+  return difference_frame_;
+}
+
+unsigned int MotionDetector::CountDifferences() {
+  if (native_) {
+    unsigned int changed_pixels = native_->CountDifferences();
+    PublishChangedPixels(*last_changed_pixels_, QueueFrame(), changed_pixels);
+    return changed_pixels;
+  }
+
+  // Asynchronous frames queued before this one can not overwrite its count once they arrive
+  const unsigned long frame = QueueFrame();
+
+  // Queue count
+  EnqueueCountDifferences();
+
+  // Read back count
+  unsigned int changed_pixels = 0;
+  int error = cmd_queue_.enqueueReadBuffer(changed_pixels_, CL_TRUE, 0, sizeof(unsigned int), static_cast<void*>(&changed_pixels));
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to read changed pixel count from memory with error code: " + std::to_string(error));
+
+  PublishChangedPixels(*last_changed_pixels_, frame, changed_pixels);
+  return changed_pixels;
+}
+
+unsigned int MotionDetector::GetChangedPixels() const {
+  std::lock_guard<std::mutex> lock(last_changed_pixels_->mutex);
+  return last_changed_pixels_->count;
+}
+
+float MotionDetector::GetMotionScore() const { return static_cast<float>(GetChangedPixels()) / static_cast<float>(watched_pixels_); }
+
+unsigned int MotionDetector::GetDecodeScale() const { return decode_scale_; }
+
+std::vector<uint32_t> MotionDetector::GetDifferenceMask() {
+  if (!motion_config_.packed_mask) throw std::logic_error("Difference mask is only avaliable with MotionConfig::packed_mask");
+  std::vector<uint32_t> mask((scaled_width_ * scaled_height_ + MASK_WORD_BITS - 1) / MASK_WORD_BITS);
+  if (native_) {
+    native_->PackDifferenceMask(mask.data());
+    return mask;
+  }
+
+  // In order queue reads the mask once the last queued frame has written it
+  int error = cmd_queue_.enqueueReadBuffer(difference_frame_, CL_TRUE, 0, mask.size() * sizeof(uint32_t), static_cast<void*>(mask.data()));
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to read difference mask from memory with error code: " + std::to_string(error));
+  return mask;
+}
+
+MotionResult MotionDetector::DetectRegionsOnFrame(const unsigned char* frame, unsigned long size) {
+  if (motion_config_.max_regions == 0) throw std::logic_error("Motion regions are only avaliable with MotionConfig::max_regions");
+  return MakeMotionResult(DetectOnFrame(frame, size));
+}
+
+MotionResult MotionDetector::DetectRegionsOnDecompressedFrame(const unsigned char* frame) {
+  if (motion_config_.max_regions == 0) throw std::logic_error("Motion regions are only avaliable with MotionConfig::max_regions");
+  return MakeMotionResult(DetectOnDecompressedFrame(frame));
+}
+
+std::vector<MotionRegion> MotionDetector::FindMotionRegions() {
+  if (motion_config_.max_regions == 0) throw std::logic_error("Motion regions are only avaliable with MotionConfig::max_regions");
+  if (native_) return MapRegions(native_->FindRegions(motion_config_.min_region_pixels));
+
+  // Queue labeling, the in order queue runs it once the last queued frame has written the difference frame
+  EnqueueLabelRegions();
+
+  // Read back number of regions, then only the slots that were used (every region has a slot, so the largest are picked after sorting)
+  unsigned int region_count = 0;
+  int error = cmd_queue_.enqueueReadBuffer(region_count_, CL_TRUE, 0, sizeof(unsigned int), static_cast<void*>(&region_count));
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to read region count from memory with error code: " + std::to_string(error));
+  region_count = std::min(region_count, region_capacity_);
+  std::vector<cl_uint> host_regions(region_count * REGION_FIELDS);
+  if (region_count > 0) {
+    error = cmd_queue_.enqueueReadBuffer(regions_, CL_TRUE, 0, host_regions.size() * sizeof(cl_uint), static_cast<void*>(host_regions.data()));
+    if (error != CL_SUCCESS) throw std::runtime_error("Failed to read regions from memory with error code: " + std::to_string(error));
+  }
+
+  // NOLINTBEGIN(readability-magic-numbers)
+  std::vector<RegionStats> stats(region_count);
+  for (unsigned int i = 0; i < region_count; i++) {
+    const cl_uint* fields = &host_regions.at(i * REGION_FIELDS);
+    stats.at(i) = {fields[0], fields[1], fields[2], fields[3], fields[4], fields[5] | (static_cast<uint64_t>(fields[6]) << 32),
+                   fields[7] | (static_cast<uint64_t>(fields[8]) << 32)};
+  }
+  // NOLINTEND(readability-magic-numbers)
+  return MapRegions(std::move(stats));
+}
+
+MotionResult MotionDetector::MakeMotionResult(bool motion) {
+  MotionResult result;
+  result.motion = motion;
+  result.changed_pixels = GetChangedPixels();
+  result.motion_score = GetMotionScore();
+  // Regions are only labeled when there is motion to find
+  if (motion) result.regions = FindMotionRegions();
+  return result;
+}
+
+std::vector<MotionRegion> MotionDetector::MapRegions(std::vector<RegionStats> stats) const {
+  // Most pixels first, ties broken by position so the order does not depend on how the device numbered them
+  std::sort(stats.begin(), stats.end(), [](const RegionStats& a, const RegionStats& b) {
+    if (a.pixels != b.pixels) return a.pixels > b.pixels;
+    if (a.min_y != b.min_y) return a.min_y < b.min_y;
+    return a.min_x < b.min_x;
+  });
+  if (stats.size() > motion_config_.max_regions) stats.resize(motion_config_.max_regions);
+
+  unsigned int scale = 0;
+  unsigned int margin = 0;
+  GetInputMapping(&scale, &margin);
+  // Last DC blocks can run past the edge of the frame
+  const unsigned int input_width = input_vid_.width * decode_scale_;
+  const unsigned int input_height = input_vid_.height * decode_scale_;
+
+  std::vector<MotionRegion> regions;
+  for (const RegionStats& region : stats) {
+    MotionRegion mapped;
+    mapped.x = margin + region.min_x * scale;
+    mapped.y = margin + region.min_y * scale;
+    mapped.width = std::min((region.max_x - region.min_x + 1) * scale, input_width - mapped.x);
+    mapped.height = std::min((region.max_y - region.min_y + 1) * scale, input_height - mapped.y);
+    mapped.pixels = region.pixels;
+    // Center of a scaled pixel is half a scaled pixel in
+    mapped.centroid_x = static_cast<float>(margin + (static_cast<double>(region.sum_x) / region.pixels + 0.5) * scale);  // NOLINT(readability-magic-numbers)
+    mapped.centroid_y = static_cast<float>(margin + (static_cast<double>(region.sum_y) / region.pixels + 0.5) * scale);  // NOLINT(readability-magic-numbers)
+    regions.push_back(mapped);
+  }
+  return regions;
+}
+
+void MotionDetector::GetInputMapping(unsigned int* scale, unsigned int* margin) const {
+  // Scaled pixel x covers input pixels margin + x * scale up to margin + (x + 1) * scale, both scales count since frames can be scaled while decompressing
+  *scale = motion_config_.scale_denominator * decode_scale_;
+  *margin = motion_config_.gaussian_size * *scale;
+  if (motion_config_.processing_mode == ProcessingMode::kDCBlocks) {
+    *scale = DC_BLOCK_SIZE;
+    *margin = 0;
+  }
+}
+
+void MotionDetector::DecompressFrame(const unsigned char* frame, unsigned long size, unsigned char* destination, unsigned long destination_size) const {
+  if (motion_config_.processing_mode == ProcessingMode::kDCBlocks) {
+    decompressor_.DecompressDCImage(frame, size, destination, destination_size);
+  } else {
+    decompressor_.DecompressImage(frame, size, destination, destination_size);
+  }
+}
+
+void MotionDetector::DecompressIntoSlot(InputSlot& slot, cl::CommandQueue& queue, const std::vector<cl::Event>* wait_for, const unsigned char* frame, unsigned long size) {
+  int error = CL_SUCCESS;
+  // Map slot into host memory, pinned host memory maps without a copy on integrated GPUs and CPUs
+  // (decode windows only write part of the slot, so the rest has to keep its contents instead of being invalidated)
+  const cl_map_flags map_flags = window_frame_.empty() ? CL_MAP_WRITE_INVALIDATE_REGION : CL_MAP_WRITE;
+  void* mapped = queue.enqueueMapBuffer(slot.frame, CL_TRUE, map_flags, 0, input_frame_buffer_size_ * sizeof(unsigned char), wait_for, nullptr, &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error mapping input frame buffer with error code: " + std::to_string(error));
+
+  // Decompress into mapped memory, slot has to be unmapped even if decompression fails
+  std::exception_ptr decompress_error = nullptr;
+  try {
+    DecompressFrame(frame, size, static_cast<unsigned char*>(mapped), input_frame_buffer_size_);
+  } catch (...) {
+    decompress_error = std::current_exception();
+  }
+
+  // Hand slot back to device
+  error = queue.enqueueUnmapMemObject(slot.frame, mapped, nullptr, &slot.uploaded);
+  if (decompress_error != nullptr) std::rethrow_exception(decompress_error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error unmapping input frame buffer with error code: " + std::to_string(error));
+}
+
+void MotionDetector::WriteInputFrame(const unsigned char* frame) {
+  // Synchronous frames always go through the first input slot, the in order queue only writes it once earlier kernels are done with it
+  int error = cmd_queue_.enqueueWriteBuffer(input_slots_.at(0).frame, CL_TRUE, 0, input_frame_buffer_size_ * sizeof(unsigned char), static_cast<const void*>(frame));
+  if (error != CL_SUCCESS) throw std::runtime_error("Error writing input frame with error code: " + std::to_string(error));
+}
+
+void MotionDetector::EnqueueProcessing(const cl::Buffer& input, const std::vector<cl::Event>* wait_for, cl::Event* input_released) {
+  if (motion_config_.processing_mode == ProcessingMode::kFused) {
+    EnqueueFused(input, wait_for, input_released);
+  } else if (motion_config_.processing_mode == ProcessingMode::kDCBlocks) {
+    EnqueueDCFrame(input, wait_for, input_released);
+    EnqueueStabilizeAndCompare();
+  } else {
+    EnqueueBlurAndScale(input, wait_for, input_released);
+    EnqueueStabilizeAndCompare();
+  }
+}
+
+void MotionDetector::EnqueueBlurAndScale(const cl::Buffer& input, const std::vector<cl::Event>* wait_for, cl::Event* input_released) {
+  int error = CL_SUCCESS;
+  // Tiled kernels need whole work groups to share local memory, regions of interest launch a work group per watched tile
+  const bool tiled = motion_config_.processing_mode == ProcessingMode::kTiled;
+  const bool roi = !motion_config_.roi.IsEmpty() && !tiled;
+  cl::NDRange vertical_global = intermediate_scaled_global_work_size_2d_;
+  cl::NDRange horizontal_global = scaled_global_work_size_2d_;
+  cl::NDRange thread_block = cl::NullRange;
+  if (tiled) {
+    vertical_global = tiled_vertical_global_work_size_2d_;
+    horizontal_global = tiled_horizontal_global_work_size_2d_;
+  } else if (roi) {
+    vertical_global = roi_vertical_global_work_size_2d_;
+    horizontal_global = roi_global_work_size_2d_;
+    thread_block = roi_thread_block_size_2d_;
+  }
+  // NOLINTBEGIN(readability-magic-numbers)
   // Vertical Scale
-  error = cmd_queue_.enqueueNDRangeKernel(bs_vertical_kernel_, cl::NullRange, intermediate_scaled_global_work_size_2d_, cl::NullRange);
+  error = bs_vertical_kernel_.setArg(4, input);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set vertical blur and scale kernel input with error code: " + std::to_string(error));
+  error = cmd_queue_.enqueueNDRangeKernel(bs_vertical_kernel_, cl::NullRange, vertical_global, tiled ? tiled_vertical_thread_block_size_2d_ : thread_block, wait_for,
+                                          input_released);
   if (error != CL_SUCCESS) throw std::runtime_error("Failed to queue OpenCL kernel with error code: " + std::to_string(error));
-  error = cmd_queue_.finish();
-  if (error != CL_SUCCESS) throw std::runtime_error("Error while running vertical blur and scale kernel with error code: " + std::to_string(error));
 
-  // Horizontal scale
-  error = cmd_queue_.enqueueNDRangeKernel(bs_horizontal_kernel_, cl::NullRange, scaled_global_work_size_2d_, cl::NullRange);
+  // Find location for newest frame in frame history, the frame already there is no longer part of either average
+  newest_frame_loc_ = (newest_frame_loc_ + 1) % history_frames_.size();
+  // Horizontal scale directly into that location
+  error = bs_horizontal_kernel_.setArg(6, history_frames_.at(newest_frame_loc_));
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set horizontal blur and scale kernel output with error code: " + std::to_string(error));
+  error = cmd_queue_.enqueueNDRangeKernel(bs_horizontal_kernel_, cl::NullRange, horizontal_global, tiled ? tiled_horizontal_thread_block_size_2d_ : thread_block);
   if (error != CL_SUCCESS) throw std::runtime_error("Failed to queue OpenCL kernel with error code: " + std::to_string(error));
-  error = cmd_queue_.finish();
-  if (error != CL_SUCCESS) throw std::runtime_error("Error while running vertical blur and scale kernel with error code: " + std::to_string(error));
+  // NOLINTEND(readability-magic-numbers)
+}
 
-  // Read newly scaled frame back to cpu
-  unsigned char* scaled_frame = new unsigned char[scaled_frame_buffer_size_];
-  error = cmd_queue_.enqueueReadBuffer(scaled_frame_, CL_TRUE, 0, scaled_frame_buffer_size_ * sizeof(unsigned char), static_cast<void*>(scaled_frame));
-  if (error != CL_SUCCESS) throw std::runtime_error("Error while reading scaled frame with error code: " + std::to_string(error));
+void MotionDetector::EnqueueDCFrame(const cl::Buffer& input, const std::vector<cl::Event>* wait_for, cl::Event* input_released) {
+  // Find location for newest frame in frame history, the frame already there is no longer part of either average
+  newest_frame_loc_ = (newest_frame_loc_ + 1) % history_frames_.size();
+  // DC image already is the scaled frame, so it only needs copying into place
+  int error = cmd_queue_.enqueueCopyBuffer(input, history_frames_.at(newest_frame_loc_), 0, 0, scaled_width_ * scaled_height_ * sizeof(unsigned char), wait_for,
+                                           input_released);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to queue DC frame copy with error code: " + std::to_string(error));
+}
+
+void MotionDetector::EnqueueStabilizeAndCompare() {
+  int error = CL_SUCCESS;
+  // Determine location of the background and movement frames to remove in frame history
+  bg_remove_loc_ = (bg_remove_loc_ + 1) % history_frames_.size();
+  mvt_remove_loc_ = (mvt_remove_loc_ + 1) % history_frames_.size();
+
+  // Point kernel at frames in frame history, they never leave the device
+  // NOLINTBEGIN(readability-magic-numbers)
+  error = stabilize_kernel_.setArg(0, history_frames_.at(bg_remove_loc_));
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set background frame to remove with error code: " + std::to_string(error));
+  error = stabilize_kernel_.setArg(1, history_frames_.at(mvt_remove_loc_));
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set movement frame to remove with error code: " + std::to_string(error));
+  error = stabilize_kernel_.setArg(2, history_frames_.at(newest_frame_loc_));
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set newest scaled frame with error code: " + std::to_string(error));
+  // NOLINTEND(readability-magic-numbers)
 
-  // Find location for newest frame and delete frame already at that location
-  newest_frame_loc_ = (newest_frame_loc_ + 1) % frames_.size();
-  delete[] frames_[newest_frame_loc_];
-  // Place newly scaled frame in that location
-  frames_[newest_frame_loc_] = scaled_frame;
+  // Work groups smaller than a word and watched tiles OR their bits into the packed mask, so it has to start empty
+  const bool roi = !motion_config_.roi.IsEmpty();
+  if (motion_config_.packed_mask && (stabilize_block_size_ < MASK_WORD_BITS || roi)) {
+    error = cmd_queue_.enqueueFillBuffer(difference_frame_, static_cast<cl_uint>(0), 0, mask_words_ * sizeof(cl_uint));
+    if (error != CL_SUCCESS) throw std::runtime_error("Error clearing difference mask with error code: " + std::to_string(error));
+  }
 
-  return scaled_frame_;
+  // Queue kernel (packed masks are balloted a work group at a time, regions of interest run a work group per watched tile)
+  if (roi) {
+    error = cmd_queue_.enqueueNDRangeKernel(stabilize_kernel_, cl::NullRange, roi_global_work_size_2d_, roi_thread_block_size_2d_);
+  } else {
+    error = cmd_queue_.enqueueNDRangeKernel(stabilize_kernel_, cl::NullRange, scaled_global_work_size_1d_,
+                                            motion_config_.packed_mask ? stabilize_thread_block_size_1d_ : cl::NullRange);
+  }
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to queue OpenCL kernel with error code: " + std::to_string(error));
 }
 
-cl::Buffer& MotionDetector::StabilizeAndCompareFrames() {
+void MotionDetector::EnqueueFused(const cl::Buffer& input, const std::vector<cl::Event>* wait_for, cl::Event* input_released) {
   int error = CL_SUCCESS;
-  // Write background frame to remove to OpenCL device
-  // Determine location of the background frame to remove in list of frames
-  bg_remove_loc_ = (bg_remove_loc_ + 1) % frames_.size();
-  // Write to device
-  error = cmd_queue_.enqueueWriteBuffer(bg_frame_to_remove_, CL_TRUE, 0, scaled_frame_buffer_size_ * sizeof(unsigned char), static_cast<void*>(frames_.at(bg_remove_loc_)));
-  if (error != CL_SUCCESS) throw std::runtime_error("Error writing background to remove buffer with error code: " + std::to_string(error));
-
-  // Write movement frame to remove to OpenCL device
-  mvt_remove_loc_ = (mvt_remove_loc_ + 1) % frames_.size();
-  // Write to device
-  error = cmd_queue_.enqueueWriteBuffer(mvt_frame_to_remove_, CL_TRUE, 0, scaled_frame_buffer_size_ * sizeof(unsigned char), static_cast<void*>(frames_.at(mvt_remove_loc_)));
-  if (error != CL_SUCCESS) throw std::runtime_error("Error writing background to remove buffer with error code: " + std::to_string(error));
+  // Move through frame history the same way EnqueueBlurAndScale() and EnqueueStabilizeAndCompare() do
+  newest_frame_loc_ = (newest_frame_loc_ + 1) % history_frames_.size();
+  bg_remove_loc_ = (bg_remove_loc_ + 1) % history_frames_.size();
+  mvt_remove_loc_ = (mvt_remove_loc_ + 1) % history_frames_.size();
+
+  // NOLINTBEGIN(readability-magic-numbers)
+  error = fused_kernel_.setArg(4, input);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set fused kernel input with error code: " + std::to_string(error));
+  error = fused_kernel_.setArg(8, history_frames_.at(newest_frame_loc_));
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set newest scaled frame with error code: " + std::to_string(error));
+  error = fused_kernel_.setArg(9, history_frames_.at(bg_remove_loc_));
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set background frame to remove with error code: " + std::to_string(error));
+  error = fused_kernel_.setArg(10, history_frames_.at(mvt_remove_loc_));
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set movement frame to remove with error code: " + std::to_string(error));
+  // NOLINTEND(readability-magic-numbers)
+
+  // Fused kernel ORs its bits into the packed mask, so it has to start empty
+  if (motion_config_.packed_mask) {
+    error = cmd_queue_.enqueueFillBuffer(difference_frame_, static_cast<cl_uint>(0), 0, mask_words_ * sizeof(cl_uint));
+    if (error != CL_SUCCESS) throw std::runtime_error("Error clearing difference mask with error code: " + std::to_string(error));
+  }
+
+  // Queue kernel (regions of interest only launch tiles with watched pixels)
+  const cl::NDRange& global = motion_config_.roi.IsEmpty() ? fused_global_work_size_2d_ : roi_global_work_size_2d_;
+  error = cmd_queue_.enqueueNDRangeKernel(fused_kernel_, cl::NullRange, global, fused_thread_block_size_2d_, wait_for, input_released);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to queue OpenCL kernel with error code: " + std::to_string(error));
+}
+
+void MotionDetector::EnqueueCountDifferences() {
+  int error = CL_SUCCESS;
+  // Reset count
+  error = cmd_queue_.enqueueFillBuffer(changed_pixels_, static_cast<unsigned int>(0), 0, sizeof(unsigned int));
+  if (error != CL_SUCCESS) throw std::runtime_error("Error resetting changed pixel count with error code: " + std::to_string(error));
 
   // Queue kernel
-  error = cmd_queue_.enqueueNDRangeKernel(stabilize_kernel_, cl::NullRange, scaled_global_work_size_1d_, cl::NullRange);
+  error = cmd_queue_.enqueueNDRangeKernel(count_kernel_, cl::NullRange, count_global_work_size_1d_, count_thread_block_size_1d_);
   if (error != CL_SUCCESS) throw std::runtime_error("Failed to queue OpenCL kernel with error code: " + std::to_string(error));
-  error = cmd_queue_.finish();
-  if (error != CL_SUCCESS) throw std::runtime_error("Error while running vertical blur and scale kernel with error code: " + std::to_string(error));
+}
 
-  return difference_frame_;
+void MotionDetector::EnqueueLabelRegions() {
+  int error = CL_SUCCESS;
+  // Reset pixels of every root and number of regions
+  error = cmd_queue_.enqueueFillBuffer(region_pixels_, static_cast<cl_uint>(0), 0, scaled_width_ * scaled_height_ * sizeof(cl_uint));
+  if (error != CL_SUCCESS) throw std::runtime_error("Error resetting region pixels with error code: " + std::to_string(error));
+  error = cmd_queue_.enqueueFillBuffer(region_count_, static_cast<cl_uint>(0), 0, sizeof(cl_uint));
+  if (error != CL_SUCCESS) throw std::runtime_error("Error resetting region count with error code: " + std::to_string(error));
+
+  // Label inside tiles, then join tiles along their edges with the same work groups so edges line up
+  error = cmd_queue_.enqueueNDRangeKernel(label_tiles_kernel_, cl::NullRange, region_global_work_size_2d_, region_thread_block_size_2d_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to queue OpenCL kernel with error code: " + std::to_string(error));
+  error = cmd_queue_.enqueueNDRangeKernel(merge_tiles_kernel_, cl::NullRange, region_global_work_size_2d_, region_thread_block_size_2d_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to queue OpenCL kernel with error code: " + std::to_string(error));
+
+  // Measure regions
+  error = cmd_queue_.enqueueNDRangeKernel(compress_labels_kernel_, cl::NullRange, region_global_work_size_2d_, region_thread_block_size_2d_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to queue OpenCL kernel with error code: " + std::to_string(error));
+  error = cmd_queue_.enqueueNDRangeKernel(count_region_pixels_kernel_, cl::NullRange, region_global_work_size_2d_, region_thread_block_size_2d_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to queue OpenCL kernel with error code: " + std::to_string(error));
+  error = cmd_queue_.enqueueNDRangeKernel(number_regions_kernel_, cl::NullRange, region_global_work_size_2d_, region_thread_block_size_2d_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to queue OpenCL kernel with error code: " + std::to_string(error));
+  error = cmd_queue_.enqueueNDRangeKernel(measure_regions_kernel_, cl::NullRange, region_global_work_size_2d_, region_thread_block_size_2d_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to queue OpenCL kernel with error code: " + std::to_string(error));
+}
+
+void CL_CALLBACK MotionDetector::OnChangedPixelsRead(cl_event, cl_int status, void* user_data) {
+  AsyncCount* count = static_cast<AsyncCount*>(user_data);
+  if (status == CL_COMPLETE) {
+    PublishChangedPixels(*count->last_changed, count->frame, count->changed_pixels);
+    count->motion.set_value(count->changed_pixels > count->diff_threshold);
+  } else {
+    count->motion.set_exception(std::make_exception_ptr(std::runtime_error("Failed to read changed pixel count with error code: " + std::to_string(status))));
+  }
+  delete count;
+}
+
+unsigned long MotionDetector::QueueFrame() {
+  std::lock_guard<std::mutex> lock(last_changed_pixels_->mutex);
+  return ++last_changed_pixels_->queued_frames;
+}
+
+void MotionDetector::PublishChangedPixels(ChangedPixels& last_changed, unsigned long frame, unsigned int changed_pixels) {
+  // Read backs can finish out of order with synchronous frames, so older frames never replace a newer count
+  std::lock_guard<std::mutex> lock(last_changed.mutex);
+  if (frame < last_changed.counted_frame) return;
+  last_changed.counted_frame = frame;
+  last_changed.count = changed_pixels;
 }
 
 void MotionDetector::ValidateSettings() const {
-  // Check if scale denominator is 0 and throw error if it is
-  if (motion_config_.scale_denominator == 0) throw std::invalid_argument("Scale denominator cannot be 0");
+  // Region of interest covers the frames as they come in
+  if (!motion_config_.roi.IsEmpty() && (motion_config_.roi.GetWidth() != input_vid_.width || motion_config_.roi.GetHeight() != input_vid_.height)) {
+    throw std::invalid_argument("Region of interest mask must be the same size as the input video");
+  }
 
-  // Check if stabilize background and movement is 0 and throw error if it is
-  if (motion_config_.bg_stabil_length == 0) throw std::invalid_argument("Background stabilization length cannot be 0");
-  if (motion_config_.motion_stabil_length == 0) throw std::invalid_argument("Movement stabilization length cannot be 0");
+  // Settings shared with MotionDetectorBatch
+  ValidateMotionConfig(input_vid_, motion_config_);
+}
 
-  // Check if miniumn changed pixels is not negative and also not greater than 1
-  if (motion_config_.min_changed_pixels < 0) throw std::invalid_argument("Minimum changed pixels cannot be negative");
-  if (motion_config_.min_changed_pixels > 1) throw std::invalid_argument("Minimum changed pixels cannot be gretaer than 1");
+void MotionDetector::InitOpenCL() {
+  // Detectors given a runtime share its context, queues and programs, others get a runtime of their own
+  if (!runtime_) runtime_ = std::make_shared<DeviceRuntime>(device_config_, info, motion_config_.program_cache_dir);
+  device_ = runtime_->GetDevice();
+  context_ = runtime_->GetContext();
+  cmd_queue_ = runtime_->GetCommandQueue();
+  transfer_queue_ = runtime_->GetTransferQueue();
+}
 
-  // Check height and width of input video and throw error if too small
+void MotionDetector::InitNative() {
+  // Same gaussian the OpenCL kernels are given
   std::vector<double> gaussian = GenerateGaussian(motion_config_.gaussian_size);
   gaussian = ScaleGaussian(gaussian, motion_config_.scale_denominator);
-  if (input_vid_.width < gaussian.size()) throw std::invalid_argument("Input video width is too small!");
-  if (input_vid_.height < gaussian.size()) throw std::invalid_argument("Input video height is too small!");
+  std::vector<float> float_gaussian(gaussian.size());
+  for (int i = 0; i < gaussian.size(); i++) float_gaussian.at(i) = static_cast<float>(gaussian.at(i));
+
+  unsigned int colors = 1;
+  if (input_vid_.frame_format == DecompFrameFormat::kRGB) colors = 3;
+  unsigned int threads = device_config_.device_choice > 0 ? static_cast<unsigned int>(device_config_.device_choice) : 0;
+
+  native_ = std::make_unique<NativePipeline>(float_gaussian, motion_config_.scale_denominator, colors, input_vid_.width, scaled_width_, scaled_height_,
+                                             motion_config_.bg_stabil_length, motion_config_.motion_stabil_length, motion_config_.min_pixel_diff, threads,
+                                             motion_config_.integer_sums, motion_config_.background_model == BackgroundModel::kExponential);
+  if (!roi_scaled_.empty()) native_->SetRoiMask(roi_scaled_);
+  *info << "Selected device: native CPU (" << native_->GetThreadCount() << " threads)" << std::endl;
 }
 
-void MotionDetector::InitOpenCL() {
-  // Select device
-  device_ = OpenCLInterface::GetDevice(device_config_);
-  *info << "Selected device: " + device_.getInfo<CL_DEVICE_NAME>() << std::endl;
-  // Create context and command queue
-  int error = CL_SUCCESS;
-  context_ = cl::Context(device_);
-  if (error != CL_SUCCESS) throw std::runtime_error("Failed to create OpenCL context with error code: " + std::to_string(error));
-  cmd_queue_ = cl::CommandQueue(context_, device_);
-  if (error != CL_SUCCESS) throw std::runtime_error("Error creating OpenCL command queue with error code: " + std::to_string(error));
+void MotionDetector::InitDecoder(const InputVideoSettings& jpeg_settings) {
+  bool dc_image = motion_config_.processing_mode == ProcessingMode::kDCBlocks;
+  decoder_ = std::make_unique<ParallelDecoder>(jpeg_settings.width, jpeg_settings.height, jpeg_settings.frame_format, motion_config_.decomp_method, decode_scale_,
+                                               dc_image, input_frame_buffer_size_, motion_config_.decode_threads,
+                                               motion_config_.decode_threads * DECODE_QUEUE_DEPTH + 1,
+                                               [this](const unsigned char* frame, std::exception_ptr error) { OnFrameDecoded(frame, error); });
+  *info << "Decode threads: " << decoder_->GetThreadCount() << std::endl;
+}
+
+void MotionDetector::OnFrameDecoded(const unsigned char* frame, std::exception_ptr error) {
+  // Frames arrive in the order they were queued, so this frame belongs to the oldest future
+  std::promise<bool> motion;
+  {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    motion = std::move(pending_motion_.front());
+    pending_motion_.pop_front();
+  }
+
+  if (error != nullptr) {
+    motion.set_exception(error);
+    return;
+  }
+  try {
+    motion.set_value(DetectOnDecompressedFrame(frame));
+  } catch (...) {
+    motion.set_exception(std::current_exception());
+  }
 }
 
 void MotionDetector::InitWorkSizes() {
@@ -171,31 +692,97 @@ void MotionDetector::InitWorkSizes() {
   scaled_global_work_size_2d_ = cl::NDRange(scaled_width_ + MEM_ALIGN - scaled_width_ % MEM_ALIGN, scaled_height_);
   // Create 1D ranges
   scaled_global_work_size_1d_ = cl::NDRange(static_cast<unsigned int>(scaled_width_ * scaled_height_ + MEM_ALIGN - (scaled_width_ * scaled_height_) % MEM_ALIGN));
+  // Packed masks are balloted a work group at a time, so stabilizing needs a whole number of thread blocks and words
+  if (motion_config_.packed_mask && stabilize_block_size_ > 0) {
+    const unsigned int block = std::max(stabilize_block_size_, static_cast<unsigned int>(MASK_WORD_BITS));
+    const unsigned int pixels = scaled_width_ * scaled_height_;
+    scaled_global_work_size_1d_ = cl::NDRange(pixels + (block - pixels % block) % block);
+    stabilize_thread_block_size_1d_ = cl::NDRange(stabilize_block_size_);
+  }
+  // Fused kernel needs a whole number of tiles
+  if (motion_config_.processing_mode == ProcessingMode::kFused) {
+    fused_global_work_size_2d_ = cl::NDRange(scaled_width_ + (fused_tile_size_ - scaled_width_ % fused_tile_size_) % fused_tile_size_,
+                                             scaled_height_ + (fused_tile_size_ - scaled_height_ % fused_tile_size_) % fused_tile_size_);
+    fused_thread_block_size_2d_ = cl::NDRange(fused_tile_size_, fused_tile_size_);
+  }
+  // Tiled kernels need a whole number of work groups, vertical work items make 4 columns each
+  if (motion_config_.processing_mode == ProcessingMode::kTiled) {
+    unsigned int vertical_items = (input_vid_.width + 3) / 4;
+    unsigned int block_x = tiled_vertical_thread_block_size_2d_.get()[0];
+    unsigned int block_y = tiled_vertical_thread_block_size_2d_.get()[1];
+    tiled_vertical_global_work_size_2d_ =
+        cl::NDRange(vertical_items + (block_x - vertical_items % block_x) % block_x, scaled_height_ + (block_y - scaled_height_ % block_y) % block_y);
+    block_x = tiled_horizontal_thread_block_size_2d_.get()[0];
+    block_y = tiled_horizontal_thread_block_size_2d_.get()[1];
+    tiled_horizontal_global_work_size_2d_ =
+        cl::NDRange(scaled_width_ + (block_x - scaled_width_ % block_x) % block_x, scaled_height_ + (block_y - scaled_height_ % block_y) % block_y);
+  }
+  // Labeling regions needs a whole number of tiles
+  if (motion_config_.max_regions > 0) {
+    region_global_work_size_2d_ = cl::NDRange(scaled_width_ + (region_tile_size_ - scaled_width_ % region_tile_size_) % region_tile_size_,
+                                              scaled_height_ + (region_tile_size_ - scaled_height_ % region_tile_size_) % region_tile_size_);
+    region_thread_block_size_2d_ = cl::NDRange(region_tile_size_, region_tile_size_);
+  }
+  // Regions of interest run one tile per work group, stacked along the second dimension
+  if (!motion_config_.roi.IsEmpty()) {
+    roi_global_work_size_2d_ = cl::NDRange(roi_tile_size_, roi_tile_size_ * roi_tile_count_);
+    roi_vertical_global_work_size_2d_ = cl::NDRange(roi_tile_size_, roi_tile_size_ * roi_vertical_tile_count_);
+    roi_thread_block_size_2d_ = cl::NDRange(roi_tile_size_, roi_tile_size_);
+  }
+  // Counting needs a whole number of thread blocks, packed masks are counted a word at a time
+  unsigned int pixels = scaled_width_ * scaled_height_;
+  if (motion_config_.packed_mask) pixels = (pixels + MASK_WORD_BITS - 1) / MASK_WORD_BITS;
+  count_global_work_size_1d_ = cl::NDRange(pixels + (count_block_size_ - pixels % count_block_size_) % count_block_size_);
+  count_thread_block_size_1d_ = cl::NDRange(count_block_size_);
 }
 
 void MotionDetector::CalculateBufferSizes() {
-  // Remove margin from image for gaussian blur
-  unsigned int width_margin_removed = input_vid_.width - (2 * motion_config_.gaussian_size * motion_config_.scale_denominator);
-  unsigned int height_margin_removed = input_vid_.height - (2 * motion_config_.gaussian_size * motion_config_.scale_denominator);
-  // Calculate scaled width and height
-  scaled_width_ = width_margin_removed / motion_config_.scale_denominator;
-  scaled_height_ = height_margin_removed / motion_config_.scale_denominator;
+  // Same sizes as every stream of MotionDetectorBatch, except DC images which have one pixel per 8x8 block and are already scaled
+  const bool dc_image = motion_config_.processing_mode == ProcessingMode::kDCBlocks;
+  DetectorSizes sizes = dc_image ? CalculateDetectorSizes(input_vid_, motion_config_, decompressor_.GetDCWidth(), decompressor_.GetDCHeight())
+                                 : CalculateDetectorSizes(input_vid_, motion_config_);
+  if (dc_image) sizes.input_frame_buffer_size = decompressor_.GetDCSize();  // Already a multiple of MEM_ALIGN
+  scaled_width_ = sizes.scaled_width;
+  scaled_height_ = sizes.scaled_height;
+  input_frame_buffer_size_ = sizes.input_frame_buffer_size;
+  intermediate_scaled_frame_buffer_size_ = sizes.intermediate_scaled_frame_buffer_size;
+  scaled_frame_buffer_size_ = sizes.scaled_frame_buffer_size;
+  stabilized_element_size_ = sizes.stabilized_element_size;
+  history_length_ = sizes.history_length;
   *info << "Scaled frame resolution: " << scaled_width_ << "x" << scaled_height_ << std::endl;
 
-  // Calculate buffer sizes
-  input_frame_buffer_size_ =
-      (input_vid_.width + 1) * (input_vid_.height + 1);  // Add one just so there is room for the possible extra height needed to ensure raspi compatibility
-  if (input_vid_.frame_format == DecompFrameFormat::kRGB) input_frame_buffer_size_ *= 3;  // If RGB frames, need 3 times the bytes
-  intermediate_scaled_frame_buffer_size_ = (input_vid_.width + 1) * (scaled_height_ + 1);
-  scaled_frame_buffer_size_ = (scaled_width_ + 1) * (scaled_height_ + 1);
+  // Packed mask has a bit for every stabilize work item, which can run up to a whole work group past the last pixel
+  const unsigned int pixels = scaled_width_ * scaled_height_;
+  mask_words_ = (pixels + MAX_WORK_GROUP_SIZE - 1) / MAX_WORK_GROUP_SIZE * (MAX_WORK_GROUP_SIZE / MASK_WORD_BITS);
 
-  // Make divisible by MEM_ALIGN to ensure aligned memory access for raspi compatability
-  input_frame_buffer_size_ += MEM_ALIGN - (input_frame_buffer_size_ % MEM_ALIGN);
-  intermediate_scaled_frame_buffer_size_ += MEM_ALIGN - (intermediate_scaled_frame_buffer_size_ % MEM_ALIGN);
-  scaled_frame_buffer_size_ += MEM_ALIGN - (scaled_frame_buffer_size_ % MEM_ALIGN);
+  // Find watched pixels
+  RasterizeRoi();
 
   // Calcualte number of pixels that need to change
-  diff_threshold_ = static_cast<unsigned int>(motion_config_.min_changed_pixels * static_cast<double>(scaled_width_ * scaled_height_));
+  diff_threshold_ = static_cast<unsigned int>(motion_config_.min_changed_pixels * static_cast<double>(watched_pixels_));
+}
+
+void MotionDetector::RasterizeRoi() {
+  watched_pixels_ = scaled_width_ * scaled_height_;
+  roi_scaled_.clear();
+  if (motion_config_.roi.IsEmpty()) return;
+
+  // Scaled pixel is watched if the input pixel at its center is, last DC blocks can run past the edge of the frame
+  unsigned int scale = 0;
+  unsigned int margin = 0;
+  GetInputMapping(&scale, &margin);
+  roi_scaled_.assign(scaled_width_ * scaled_height_, 0);
+  watched_pixels_ = 0;
+  for (unsigned int y = 0; y < scaled_height_; y++) {
+    const unsigned int input_y = std::min(margin + y * scale + scale / 2, motion_config_.roi.GetHeight() - 1);
+    for (unsigned int x = 0; x < scaled_width_; x++) {
+      const unsigned int input_x = std::min(margin + x * scale + scale / 2, motion_config_.roi.GetWidth() - 1);
+      if (!motion_config_.roi.IsWatched(input_x, input_y)) continue;
+      roi_scaled_.at(y * scaled_width_ + x) = 1;
+      watched_pixels_++;
+    }
+  }
+  if (watched_pixels_ == 0) throw std::invalid_argument("Region of interest mask does not watch any scaled pixels");
 }
 
 void MotionDetector::LoadBlurAndScaleBuffers() {
@@ -215,110 +802,71 @@ void MotionDetector::LoadBlurAndScaleBuffers() {
   // delete temp host memory
   delete[] host_gaussian;
 
-  // gaussian size
-  int* host_gaussian_size = new int[2];  // 2 instead of 1 to ensure aligned memory access for raspi compatability
-  host_gaussian_size[0] = static_cast<int>(gaussian.size());
-  // create buffer object
-  gaussian_size_ = cl::Buffer(context_, CL_MEM_READ_ONLY, 2 * sizeof(int), nullptr, &error);
-  if (error != CL_SUCCESS) throw std::runtime_error("Error creating gaussian size buffer with error code: " + std::to_string(error));
-  // write to OpenCL device
-  error = cmd_queue_.enqueueWriteBuffer(gaussian_size_, CL_TRUE, 0, 2 * sizeof(int), static_cast<void*>(host_gaussian_size));
-  if (error != CL_SUCCESS) throw std::runtime_error("Error writing gaussian size buffer with error code: " + std::to_string(error));
-  // delete temp host memory
-  delete[] host_gaussian_size;
-
-  // scale amount
-  int* host_scale = new int[2];
-  host_scale[0] = static_cast<int>(motion_config_.scale_denominator);
-  // create buffer object
-  scale_ = cl::Buffer(context_, CL_MEM_READ_ONLY, 2 * sizeof(int), nullptr, &error);
-  if (error != CL_SUCCESS) throw std::runtime_error("Error creating scale amount buffer with error code: " + std::to_string(error));
-  // write to OpenCL device
-  error = cmd_queue_.enqueueWriteBuffer(scale_, CL_TRUE, 0, 2 * sizeof(int), static_cast<void*>(host_scale));
-  if (error != CL_SUCCESS) throw std::runtime_error("Error writing scale amount buffer with error code: " + std::to_string(error));
-  // delete temp host memory
-  delete[] host_scale;
-
-  // number of colors
-  int* host_colors = new int[2];
-  host_colors[0] = static_cast<int>(1);
-  if (input_vid_.frame_format == DecompFrameFormat::kRGB) host_colors[0] = static_cast<int>(3);
-  // create buffer object
-  colors_ = cl::Buffer(context_, CL_MEM_READ_ONLY, 2 * sizeof(int), nullptr, &error);
-  if (error != CL_SUCCESS) throw std::runtime_error("Error creating gaussian kernel buffer with error code: " + std::to_string(error));
-  // write to OpenCL device
-  error = cmd_queue_.enqueueWriteBuffer(colors_, CL_TRUE, 0, 2 * sizeof(int), static_cast<void*>(host_colors));
-  if (error != CL_SUCCESS) throw std::runtime_error("Error writing gaussian kernel buffer with error code: " + std::to_string(error));
-  // delete temp host memory
-  delete[] host_colors;
-
-  // input frame
-  unsigned char* host_input_frame = new unsigned char[input_frame_buffer_size_];
-  for (int i = 0; i < input_frame_buffer_size_; i++) host_input_frame[i] = 0;  // initialize to zero
-  // create buffer object
-  input_frame_ = cl::Buffer(context_, CL_MEM_READ_ONLY, input_frame_buffer_size_ * sizeof(unsigned char), nullptr, &error);
-  if (error != CL_SUCCESS) throw std::runtime_error("Error creating input frame buffer with error code: " + std::to_string(error));
-  // write to OpenCL device
-  error = cmd_queue_.enqueueWriteBuffer(input_frame_, CL_TRUE, 0, input_frame_buffer_size_ * sizeof(unsigned char), static_cast<void*>(host_input_frame));
-  if (error != CL_SUCCESS) throw std::runtime_error("Error writing input frame buffer with error code: " + std::to_string(error));
-  // delete temp host memory
-  delete[] host_input_frame;
-
-  // input width
-  int* host_input_width = new int[2];
-  host_input_width[0] = static_cast<int>(input_vid_.width);
-  // create buffer object
-  input_width_ = cl::Buffer(context_, CL_MEM_READ_ONLY, 2 * sizeof(int), nullptr, &error);
-  if (error != CL_SUCCESS) throw std::runtime_error("Error creating input width buffer with error code: " + std::to_string(error));
-  // write to OpenCL device
-  error = cmd_queue_.enqueueWriteBuffer(input_width_, CL_TRUE, 0, 2 * sizeof(int), static_cast<void*>(host_input_width));
-  if (error != CL_SUCCESS) throw std::runtime_error("Error writing input width buffer with error code: " + std::to_string(error));
-  // delete temp host memory
-  delete[] host_input_width;
+  // configuration
+  gaussian_size_ = CreateIntBuffer(context_, cmd_queue_, static_cast<int>(gaussian.size()), "gaussian size");
+  scale_ = CreateIntBuffer(context_, cmd_queue_, static_cast<int>(motion_config_.scale_denominator), "scale amount");
+  colors_ = CreateIntBuffer(context_, cmd_queue_, input_vid_.frame_format == DecompFrameFormat::kRGB ? 3 : 1, "number of colors");
+
+  // input frames
+  input_slots_ = std::vector<InputSlot>(INPUT_FRAME_BUFFERS);
+  for (int i = 0; i < input_slots_.size(); i++) {
+    // create buffer object
+    input_slots_.at(i).frame = cl::Buffer(context_, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, input_frame_buffer_size_ * sizeof(unsigned char), nullptr, &error);
+    if (error != CL_SUCCESS) throw std::runtime_error("Error creating input frame buffer with error code: " + std::to_string(error));
+    // initialize to zero on the device
+    error = cmd_queue_.enqueueFillBuffer(input_slots_.at(i).frame, static_cast<unsigned char>(0), 0, input_frame_buffer_size_ * sizeof(unsigned char));
+    if (error != CL_SUCCESS) throw std::runtime_error("Error filling input frame buffer with error code: " + std::to_string(error));
+  }
 
-  // scaled width
-  int* host_scaled_width = new int[2];
-  host_scaled_width[0] = static_cast<int>(scaled_width_);
-  // create buffer object
-  output_width_ = cl::Buffer(context_, CL_MEM_READ_ONLY, 2 * sizeof(int), nullptr, &error);
-  if (error != CL_SUCCESS) throw std::runtime_error("Error creating scaled width buffer with error code: " + std::to_string(error));
-  // write to OpenCL device
-  error = cmd_queue_.enqueueWriteBuffer(output_width_, CL_TRUE, 0, 2 * sizeof(int), static_cast<void*>(host_scaled_width));
-  if (error != CL_SUCCESS) throw std::runtime_error("Error writing scaled width buffer with error code: " + std::to_string(error));
-  // delete temp host memory
-  delete[] host_scaled_width;
+  // input and scaled width
+  input_width_ = CreateIntBuffer(context_, cmd_queue_, static_cast<int>(input_vid_.width), "input width");
+  output_width_ = CreateIntBuffer(context_, cmd_queue_, static_cast<int>(scaled_width_), "scaled width");
+
+  // intermediate scaled frame (fused kernel keeps it in local memory instead)
+  if (motion_config_.processing_mode == ProcessingMode::kSeparable || motion_config_.processing_mode == ProcessingMode::kTiled) {
+    // create buffer object
+    intermediate_scaled_frame_ = cl::Buffer(context_, CL_MEM_READ_WRITE, intermediate_scaled_frame_buffer_size_ * sizeof(unsigned char), nullptr, &error);
+    if (error != CL_SUCCESS) throw std::runtime_error("Error creating intermediate scaled frame buffer with error code: " + std::to_string(error));
+    // initialize to zero on the device
+    error = cmd_queue_.enqueueFillBuffer(intermediate_scaled_frame_, static_cast<unsigned char>(0), 0, intermediate_scaled_frame_buffer_size_ * sizeof(unsigned char));
+    if (error != CL_SUCCESS) throw std::runtime_error("Error filling intermediate scaled frame buffer with error code: " + std::to_string(error));
+  }
 
-  // intermediate scaled frame
-  unsigned char* host_intermediate = new unsigned char[intermediate_scaled_frame_buffer_size_];
-  for (int i = 0; i < intermediate_scaled_frame_buffer_size_; i++) host_intermediate[i] = 0;  // initialize to zero
-  // create buffer object
-  intermediate_scaled_frame_ = cl::Buffer(context_, CL_MEM_READ_WRITE, intermediate_scaled_frame_buffer_size_ * sizeof(unsigned char), nullptr, &error);
-  if (error != CL_SUCCESS) throw std::runtime_error("Error creating intermediate scaled frame buffer with error code: " + std::to_string(error));
-  // write to OpenCL device
-  error = cmd_queue_.enqueueWriteBuffer(intermediate_scaled_frame_, CL_TRUE, 0, intermediate_scaled_frame_buffer_size_ * sizeof(unsigned char),
-                                        static_cast<void*>(host_intermediate));
-  if (error != CL_SUCCESS) throw std::runtime_error("Error writing intermediate scaled frame buffer with error code: " + std::to_string(error));
-  // delete temp host memory
-  delete[] host_intermediate;
+  // scaled height
+  if (motion_config_.processing_mode == ProcessingMode::kFused || motion_config_.processing_mode == ProcessingMode::kTiled || motion_config_.max_regions > 0 ||
+      !motion_config_.roi.IsEmpty()) {
+    output_height_ = CreateIntBuffer(context_, cmd_queue_, static_cast<int>(scaled_height_), "scaled height");
+  }
 
-  // scaled frame
-  unsigned char* host_scaled = new unsigned char[scaled_frame_buffer_size_];
-  for (int i = 0; i < scaled_frame_buffer_size_; i++) host_scaled[i] = 0;  // initialize to zero
+  // frame history
+  // Sub-buffers must start on the device's base address alignment, so space the frames out to that alignment
+  unsigned int base_align = device_.getInfo<CL_DEVICE_MEM_BASE_ADDR_ALIGN>() / 8;  // NOLINT(readability-magic-numbers) bits to bytes
+  if (base_align == 0) base_align = MEM_ALIGN;
+  history_frame_stride_ = scaled_frame_buffer_size_;
+  if (history_frame_stride_ % base_align != 0) history_frame_stride_ += base_align - (history_frame_stride_ % base_align);
   // create buffer object
-  scaled_frame_ = cl::Buffer(context_, CL_MEM_READ_WRITE, scaled_frame_buffer_size_ * sizeof(unsigned char), nullptr, &error);
-  if (error != CL_SUCCESS) throw std::runtime_error("Error creating scaled frame buffer with error code: " + std::to_string(error));
-  // write to OpenCL device
-  error = cmd_queue_.enqueueWriteBuffer(scaled_frame_, CL_TRUE, 0, scaled_frame_buffer_size_ * sizeof(unsigned char), static_cast<void*>(host_scaled));
-  if (error != CL_SUCCESS) throw std::runtime_error("Error writing scaled frame buffer with error code: " + std::to_string(error));
-  // delete temp host memory
-  delete[] host_scaled;
+  frame_history_ = cl::Buffer(context_, CL_MEM_READ_WRITE, history_length_ * history_frame_stride_ * sizeof(unsigned char), nullptr, &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error creating frame history buffer with error code: " + std::to_string(error));
+  // initialize to zero on the device
+  error = cmd_queue_.enqueueFillBuffer(frame_history_, static_cast<unsigned char>(0), 0, history_length_ * history_frame_stride_ * sizeof(unsigned char));
+  if (error != CL_SUCCESS) throw std::runtime_error("Error filling frame history buffer with error code: " + std::to_string(error));
+  // create a sub-buffer for every frame in the history
+  history_frames_.clear();
+  for (int i = 0; i < history_length_; i++) {
+    cl_buffer_region region = {i * history_frame_stride_ * sizeof(unsigned char), scaled_frame_buffer_size_ * sizeof(unsigned char)};
+    history_frames_.push_back(frame_history_.createSubBuffer(CL_MEM_READ_WRITE, CL_BUFFER_CREATE_TYPE_REGION, &region, &error));
+    if (error != CL_SUCCESS) throw std::runtime_error("Error creating frame history sub-buffer with error code: " + std::to_string(error));
+  }
 }
 
 void MotionDetector::LoadBlurAndScaleKernels() {
+  // Tiled kernels take the same arguments plus scaled height and local memory
+  const bool tiled = motion_config_.processing_mode == ProcessingMode::kTiled;
+
   // Load vertical kernel
   int error = CL_SUCCESS;
-  cl::Program vertical_program = LoadProgram(motion_config_.kBlurScaleVerticalFile);
-  bs_vertical_kernel_ = cl::Kernel(vertical_program, "blur_and_scale_vertical", &error);
+  cl::Program vertical_program = LoadProgram(tiled ? motion_config_.kBlurScaleVerticalTiledFile : motion_config_.kBlurScaleVerticalFile);
+  bs_vertical_kernel_ = cl::Kernel(vertical_program, tiled ? "blur_and_scale_vertical_tiled" : "blur_and_scale_vertical", &error);
   if (error != CL_SUCCESS) throw std::runtime_error("Failed to create vertical blur and scale kernel with error code: " + std::to_string(error));
 
   // NOLINTBEGIN(readability-magic-numbers)
@@ -331,7 +879,7 @@ void MotionDetector::LoadBlurAndScaleKernels() {
   if (error != CL_SUCCESS) throw std::runtime_error("Failed to set vertical blur and scale kernel argument with error code: " + std::to_string(error));
   error = bs_vertical_kernel_.setArg(3, colors_);
   if (error != CL_SUCCESS) throw std::runtime_error("Failed to set vertical blur and scale kernel argument with error code: " + std::to_string(error));
-  error = bs_vertical_kernel_.setArg(4, input_frame_);
+  error = bs_vertical_kernel_.setArg(4, input_slots_.at(0).frame);
   if (error != CL_SUCCESS) throw std::runtime_error("Failed to set vertical blur and scale kernel argument with error code: " + std::to_string(error));
   error = bs_vertical_kernel_.setArg(5, input_width_);
   if (error != CL_SUCCESS) throw std::runtime_error("Failed to set vertical blur and scale kernel argument with error code: " + std::to_string(error));
@@ -341,8 +889,8 @@ void MotionDetector::LoadBlurAndScaleKernels() {
   }
 
   // Load horizontal kernel
-  cl::Program horizontal_program = LoadProgram(motion_config_.kBlurScaleHorizontalFile);
-  bs_horizontal_kernel_ = cl::Kernel(horizontal_program, "blur_and_scale_horizontal", &error);
+  cl::Program horizontal_program = LoadProgram(tiled ? motion_config_.kBlurScaleHorizontalTiledFile : motion_config_.kBlurScaleHorizontalFile);
+  bs_horizontal_kernel_ = cl::Kernel(horizontal_program, tiled ? "blur_and_scale_horizontal_tiled" : "blur_and_scale_horizontal", &error);
   if (error != CL_SUCCESS) throw std::runtime_error("Failed to create horizontal blur and scale kernel with error code: " + std::to_string(error));
 
   // Set kernel args
@@ -358,117 +906,108 @@ void MotionDetector::LoadBlurAndScaleKernels() {
   if (error != CL_SUCCESS) throw std::runtime_error("Failed to set vertical blur and scale kernel argument with error code: " + std::to_string(error));
   error = bs_horizontal_kernel_.setArg(5, output_width_);
   if (error != CL_SUCCESS) throw std::runtime_error("Failed to set vertical blur and scale kernel argument with error code: " + std::to_string(error));
-  error = bs_horizontal_kernel_.setArg(6, scaled_frame_);
+  error = bs_horizontal_kernel_.setArg(6, history_frames_.at(newest_frame_loc_));
   if (error != CL_SUCCESS) {
     throw std::runtime_error("Failed to set vertical blur and scale kernel intermediate scaled frame argument with error code: " + std::to_string(error));
   }
   // NOLINTEND(readability-magic-numbers)
+
+  if (tiled) LoadTiledKernelArgs();
 }
 
-void MotionDetector::LoadStabilizeAndCompareBuffers() {
-  // Fill frames vector with empty frames
-  for (int i = 0; i < motion_config_.bg_stabil_length + motion_config_.motion_stabil_length + 1; i++) {
-    unsigned char* frame = new unsigned char[scaled_frame_buffer_size_];
-    frames_.push_back(frame);
-    for (int j = 0; j < scaled_frame_buffer_size_; j++) frames_.at(i)[j] = 0;  // initialize to 0
+void MotionDetector::LoadTiledKernelArgs() {
+  std::vector<double> gaussian = GenerateGaussian(motion_config_.gaussian_size);
+  gaussian = ScaleGaussian(gaussian, motion_config_.scale_denominator);
+  cl_ulong local_mem_size = device_.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+
+  // NOLINTBEGIN(readability-magic-numbers)
+  // Pick largest vertical work group that the kernel can run with and that fits in local memory, shrinking rows first
+  // Each column of work items needs the color totals of every input row under the work group
+  size_t max_block_size = bs_vertical_kernel_.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device_);
+  unsigned int block_x = 16;
+  unsigned int block_y = 16;
+  unsigned int tile_rows = 0;
+  while (true) {
+    tile_rows = (block_y - 1) * motion_config_.scale_denominator + gaussian.size();
+    if (block_x * block_y <= max_block_size && block_x * tile_rows * sizeof(cl_ushort4) <= local_mem_size) break;
+    if (block_y > 1) {
+      block_y /= 2;
+    } else if (block_x > 1) {
+      block_x /= 2;
+    } else {
+      throw std::runtime_error("Not enough local memory on device for tiled kernels, use ProcessingMode::kSeparable");
+    }
   }
-  // Create buffers
-  int error = CL_SUCCESS;
-  // background frame to remove
-  unsigned char* host_bg_to_remove = new unsigned char[scaled_frame_buffer_size_];
-  for (int i = 0; i < scaled_frame_buffer_size_; i++) host_bg_to_remove[i] = 0;  // initialize to 0
-  // create buffer object
-  bg_frame_to_remove_ = cl::Buffer(context_, CL_MEM_READ_ONLY, scaled_frame_buffer_size_ * sizeof(unsigned char), nullptr, &error);
-  if (error != CL_SUCCESS) throw std::runtime_error("Error creating background to remove buffer with error code: " + std::to_string(error));
-  // write to OpenCL device
-  error = cmd_queue_.enqueueWriteBuffer(bg_frame_to_remove_, CL_TRUE, 0, scaled_frame_buffer_size_ * sizeof(unsigned char), static_cast<void*>(host_bg_to_remove));
-  if (error != CL_SUCCESS) throw std::runtime_error("Error writing background to remove buffer with error code: " + std::to_string(error));
-  // delete temp host memory
-  delete[] host_bg_to_remove;
+  tiled_vertical_thread_block_size_2d_ = cl::NDRange(block_x, block_y);
+  int error = bs_vertical_kernel_.setArg(7, output_height_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set vertical blur and scale kernel argument with error code: " + std::to_string(error));
+  error = bs_vertical_kernel_.setArg(8, cl::Local(block_x * tile_rows * sizeof(cl_ushort4)));
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set vertical blur and scale kernel argument with error code: " + std::to_string(error));
 
-  // movement frame to remove
-  unsigned char* host_mvt_to_remove = new unsigned char[scaled_frame_buffer_size_];
-  for (int i = 0; i < scaled_frame_buffer_size_; i++) host_mvt_to_remove[i] = 0;  // initialize to 0
-  // create buffer object
-  mvt_frame_to_remove_ = cl::Buffer(context_, CL_MEM_READ_ONLY, scaled_frame_buffer_size_ * sizeof(unsigned char), nullptr, &error);
-  if (error != CL_SUCCESS) throw std::runtime_error("Error creating movement to remove buffer with error code: " + std::to_string(error));
-  // write to OpenCL device
-  error = cmd_queue_.enqueueWriteBuffer(mvt_frame_to_remove_, CL_TRUE, 0, scaled_frame_buffer_size_ * sizeof(unsigned char), static_cast<void*>(host_mvt_to_remove));
-  if (error != CL_SUCCESS) throw std::runtime_error("Error writing movement to remove buffer with error code: " + std::to_string(error));
-  // delete temp host memory
-  delete[] host_mvt_to_remove;
+  // Same for horizontal work group, each row of work items needs the input columns under it
+  max_block_size = bs_horizontal_kernel_.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device_);
+  block_x = 32;
+  block_y = 8;
+  unsigned int tile_columns = 0;
+  while (true) {
+    tile_columns = (block_x - 1) * motion_config_.scale_denominator + gaussian.size();
+    if (block_x * block_y <= max_block_size && block_y * tile_columns <= local_mem_size) break;
+    if (block_y > 1) {
+      block_y /= 2;
+    } else if (block_x > 1) {
+      block_x /= 2;
+    } else {
+      throw std::runtime_error("Not enough local memory on device for tiled kernels, use ProcessingMode::kSeparable");
+    }
+  }
+  tiled_horizontal_thread_block_size_2d_ = cl::NDRange(block_x, block_y);
+  error = bs_horizontal_kernel_.setArg(7, output_height_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set horizontal blur and scale kernel argument with error code: " + std::to_string(error));
+  error = bs_horizontal_kernel_.setArg(8, cl::Local(block_y * tile_columns * sizeof(unsigned char)));
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set horizontal blur and scale kernel argument with error code: " + std::to_string(error));
+  // NOLINTEND(readability-magic-numbers)
+}
 
-  // background length
-  float* host_bg_len = new float[2];  // 2 instead of 1 to ensure aligned memory access for raspi compatability
-  host_bg_len[0] = static_cast<float>(motion_config_.bg_stabil_length);
-  // create buffer object
-  bg_length_ = cl::Buffer(context_, CL_MEM_READ_ONLY, 2 * sizeof(float), nullptr, &error);
-  if (error != CL_SUCCESS) throw std::runtime_error("Error creating background length buffer with error code: " + std::to_string(error));
-  // write to OpenCL device
-  error = cmd_queue_.enqueueWriteBuffer(bg_length_, CL_TRUE, 0, 2 * sizeof(float), static_cast<void*>(host_bg_len));
-  if (error != CL_SUCCESS) throw std::runtime_error("Error writing background length buffer with error code: " + std::to_string(error));
-  // delete temp host memory
-  delete[] host_bg_len;
+void MotionDetector::LoadStabilizeAndCompareBuffers() {
+  // Start removing frames from the background and movement averages once they have been in them for their full length
+  // (exponential averages have a single history slot and never remove frames, the kernels ignore the frames to remove)
+  const bool exponential = motion_config_.background_model == BackgroundModel::kExponential;
+  bg_remove_loc_ = exponential ? 0 : newest_frame_loc_ + 1;
+  mvt_remove_loc_ = exponential ? 0 : history_length_ - motion_config_.motion_stabil_length;
 
-  // movement length
-  float* host_mvt_len = new float[2];
-  host_mvt_len[0] = static_cast<float>(motion_config_.motion_stabil_length);
-  // create buffer object
-  mvt_length_ = cl::Buffer(context_, CL_MEM_READ_ONLY, 2 * sizeof(float), nullptr, &error);
-  if (error != CL_SUCCESS) throw std::runtime_error("Error creating movement length buffer with error code: " + std::to_string(error));
-  // write to OpenCL device
-  error = cmd_queue_.enqueueWriteBuffer(mvt_length_, CL_TRUE, 0, 2 * sizeof(float), static_cast<void*>(host_mvt_len));
-  if (error != CL_SUCCESS) throw std::runtime_error("Error writing movement length buffer with error code: " + std::to_string(error));
-  // delete temp host memory
-  delete[] host_mvt_len;
+  // Create buffers
+  int error = CL_SUCCESS;
+  // background and movement length
+  bg_length_ = CreateFloatBuffer(context_, cmd_queue_, static_cast<float>(motion_config_.bg_stabil_length), "background length");
+  mvt_length_ = CreateFloatBuffer(context_, cmd_queue_, static_cast<float>(motion_config_.motion_stabil_length), "movement length");
 
   // stabilized background frame
-  float* host_bg = new float[scaled_frame_buffer_size_];
-  for (int i = 0; i < scaled_frame_buffer_size_; i++) host_bg[i] = 0;  // initialize to 0
   // create buffer object
-  stabilized_background_ = cl::Buffer(context_, CL_MEM_READ_WRITE, scaled_frame_buffer_size_ * sizeof(float), nullptr, &error);
+  stabilized_background_ = cl::Buffer(context_, CL_MEM_READ_WRITE, scaled_frame_buffer_size_ * stabilized_element_size_, nullptr, &error);
   if (error != CL_SUCCESS) throw std::runtime_error("Error creating stabilized background buffer with error code: " + std::to_string(error));
-  // write to OpenCL device
-  error = cmd_queue_.enqueueWriteBuffer(stabilized_background_, CL_TRUE, 0, scaled_frame_buffer_size_ * sizeof(float), static_cast<void*>(host_bg));
-  if (error != CL_SUCCESS) throw std::runtime_error("Error writing stabilized background buffer with error code: " + std::to_string(error));
-  // delete temp host memory
-  delete[] host_bg;
+  // initialize to 0 on the device
+  error = cmd_queue_.enqueueFillBuffer(stabilized_background_, static_cast<unsigned char>(0), 0, scaled_frame_buffer_size_ * stabilized_element_size_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error filling stabilized background buffer with error code: " + std::to_string(error));
 
   // stabilized movement frame
-  float* host_mvt = new float[scaled_frame_buffer_size_];
-  for (int i = 0; i < scaled_frame_buffer_size_; i++) host_mvt[i] = 0;  // initialize to 0
   // create buffer object
-  stabilized_movement_ = cl::Buffer(context_, CL_MEM_READ_WRITE, scaled_frame_buffer_size_ * sizeof(float), nullptr, &error);
+  stabilized_movement_ = cl::Buffer(context_, CL_MEM_READ_WRITE, scaled_frame_buffer_size_ * stabilized_element_size_, nullptr, &error);
   if (error != CL_SUCCESS) throw std::runtime_error("Error creating stabilized movement buffer with error code: " + std::to_string(error));
-  // write to OpenCL device
-  error = cmd_queue_.enqueueWriteBuffer(stabilized_movement_, CL_TRUE, 0, scaled_frame_buffer_size_ * sizeof(float), static_cast<void*>(host_mvt));
-  if (error != CL_SUCCESS) throw std::runtime_error("Error writing stabilized movement buffer with error code: " + std::to_string(error));
-  // delete temp host memory
-  delete[] host_mvt;
+  // initialize to 0 on the device
+  error = cmd_queue_.enqueueFillBuffer(stabilized_movement_, static_cast<unsigned char>(0), 0, scaled_frame_buffer_size_ * stabilized_element_size_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error filling stabilized movement buffer with error code: " + std::to_string(error));
 
   // pixel difference threshold
-  int* host_pix_diff_thresh = new int[2];
-  host_pix_diff_thresh[0] = static_cast<int>(motion_config_.min_pixel_diff);
-  // create buffer object
-  pixel_diff_threshold_ = cl::Buffer(context_, CL_MEM_READ_ONLY, 2 * sizeof(int), nullptr, &error);
-  if (error != CL_SUCCESS) throw std::runtime_error("Error creating pixel difference threshold buffer with error code: " + std::to_string(error));
-  // write to OpenCL device
-  error = cmd_queue_.enqueueWriteBuffer(pixel_diff_threshold_, CL_TRUE, 0, 2 * sizeof(int), static_cast<void*>(host_pix_diff_thresh));
-  if (error != CL_SUCCESS) throw std::runtime_error("Error writing pixel difference threshold buffer with error code: " + std::to_string(error));
-  // delete temp host memory
-  delete[] host_pix_diff_thresh;
+  pixel_diff_threshold_ = CreateIntBuffer(context_, cmd_queue_, static_cast<int>(motion_config_.min_pixel_diff), "pixel difference threshold");
 
-  // difference frame
-  bool* host_diff = new bool[scaled_frame_buffer_size_];
-  for (int i = 0; i < scaled_frame_buffer_size_; i++) host_diff[i] = false;  // initialize to false
+  // difference frame (a bool per pixel, or a bit per pixel with packed masks)
+  const unsigned int difference_size = motion_config_.packed_mask ? mask_words_ * sizeof(cl_uint) : scaled_frame_buffer_size_ * sizeof(bool);
   // create buffer object
-  difference_frame_ = cl::Buffer(context_, CL_MEM_WRITE_ONLY, scaled_frame_buffer_size_ * sizeof(bool), nullptr, &error);
-  if (error != CL_SUCCESS) throw std::runtime_error("Error creating stabilized movement buffer with error code: " + std::to_string(error));
-  // write to OpenCL device
-  error = cmd_queue_.enqueueWriteBuffer(difference_frame_, CL_TRUE, 0, scaled_frame_buffer_size_ * sizeof(bool), static_cast<void*>(host_diff));
-  if (error != CL_SUCCESS) throw std::runtime_error("Error writing stabilized movement buffer with error code: " + std::to_string(error));
-  // delete temp host memory
-  delete[] host_diff;
+  difference_frame_ = cl::Buffer(context_, CL_MEM_READ_WRITE, difference_size, nullptr, &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error creating difference frame buffer with error code: " + std::to_string(error));
+  // initialize to false on the device
+  error = cmd_queue_.enqueueFillBuffer(difference_frame_, static_cast<unsigned char>(0), 0, difference_size);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error filling difference frame buffer with error code: " + std::to_string(error));
 }
 
 void MotionDetector::LoadStabilizeAndCompareKernel() {
@@ -480,11 +1019,11 @@ void MotionDetector::LoadStabilizeAndCompareKernel() {
 
   // NOLINTBEGIN(readability-magic-numbers)
   // Set kernel args
-  error = stabilize_kernel_.setArg(0, bg_frame_to_remove_);
+  error = stabilize_kernel_.setArg(0, history_frames_.at(bg_remove_loc_));
   if (error != CL_SUCCESS) throw std::runtime_error("Failed to set stabilize and compare frames kernel argument with error code: " + std::to_string(error));
-  error = stabilize_kernel_.setArg(1, mvt_frame_to_remove_);
+  error = stabilize_kernel_.setArg(1, history_frames_.at(mvt_remove_loc_));
   if (error != CL_SUCCESS) throw std::runtime_error("Failed to set stabilize and compare frames kernel argument with error code: " + std::to_string(error));
-  error = stabilize_kernel_.setArg(2, scaled_frame_);
+  error = stabilize_kernel_.setArg(2, history_frames_.at(newest_frame_loc_));
   if (error != CL_SUCCESS) throw std::runtime_error("Failed to set stabilize and compare frames kernel argument with error code: " + std::to_string(error));
   error = stabilize_kernel_.setArg(3, bg_length_);
   if (error != CL_SUCCESS) throw std::runtime_error("Failed to set stabilize and compare frames kernel argument with error code: " + std::to_string(error));
@@ -499,30 +1038,366 @@ void MotionDetector::LoadStabilizeAndCompareKernel() {
   error = stabilize_kernel_.setArg(8, difference_frame_);
   if (error != CL_SUCCESS) throw std::runtime_error("Failed to set stabilize and compare frames kernel argument with error code: " + std::to_string(error));
   // NOLINTEND(readability-magic-numbers)
+  if (!motion_config_.packed_mask) return;
+
+  // Pick largest power of 2 thread block the kernel can run with, every block ballots its bits into local words
+  size_t max_block_size = stabilize_kernel_.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device_);
+  stabilize_block_size_ = 1;
+  while (stabilize_block_size_ * 2 <= max_block_size && stabilize_block_size_ * 2 <= MAX_WORK_GROUP_SIZE) stabilize_block_size_ *= 2;
 
-  bg_remove_loc_ = newest_frame_loc_ + 1;
-  mvt_remove_loc_ = frames_.size() - motion_config_.motion_stabil_length;
+  // NOLINTBEGIN(readability-magic-numbers)
+  error = stabilize_kernel_.setArg(9, pixel_count_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set stabilize and compare frames kernel argument with error code: " + std::to_string(error));
+  error = stabilize_kernel_.setArg(10, cl::Local((stabilize_block_size_ + MASK_WORD_BITS - 1) / MASK_WORD_BITS * sizeof(cl_uint)));
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set stabilize and compare frames kernel argument with error code: " + std::to_string(error));
+  // NOLINTEND(readability-magic-numbers)
 }
 
-cl::Program MotionDetector::LoadProgram(const std::string& filename) {
-  // Read the program source
-  std::ifstream ifs(filename);
-  if (!ifs.good()) throw std::runtime_error("Error while opening OpenCL kernel file: " + filename);
-  std::string source_code(std::istreambuf_iterator<char>(ifs), (std::istreambuf_iterator<char>()));
+void MotionDetector::LoadFusedKernel() {
+  // Load kernel
+  int error = CL_SUCCESS;
+  cl::Program fused_program = LoadProgram(motion_config_.kFusedFile);
+  fused_kernel_ = cl::Kernel(fused_program, "blur_scale_stabilize_fused", &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to create fused blur, scale and stabilize kernel with error code: " + std::to_string(error));
 
-  // Create OpenCL program
-  cl::Program::Sources source;
-  source.push_back({source_code.c_str(), source_code.length()});
+  // Pick largest square tile that the kernel can run with and that fits in local memory
+  // Each row of a tile needs the vertically blurred and scaled input columns under it
+  std::vector<double> gaussian = GenerateGaussian(motion_config_.gaussian_size);
+  gaussian = ScaleGaussian(gaussian, motion_config_.scale_denominator);
+  size_t max_block_size = fused_kernel_.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device_);
+  cl_ulong local_mem_size = device_.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+  unsigned int tile_columns = 0;
+  fused_tile_size_ = 8;  // NOLINT(readability-magic-numbers)
+  while (fused_tile_size_ > 1) {
+    tile_columns = (fused_tile_size_ - 1) * motion_config_.scale_denominator + gaussian.size();
+    if (fused_tile_size_ * fused_tile_size_ <= max_block_size && fused_tile_size_ * tile_columns <= local_mem_size) break;
+    fused_tile_size_ /= 2;
+  }
+  tile_columns = (fused_tile_size_ - 1) * motion_config_.scale_denominator + gaussian.size();
+  if (fused_tile_size_ * tile_columns > local_mem_size) throw std::runtime_error("Not enough local memory on device for fused kernel, use ProcessingMode::kSeparable");
+
+  // NOLINTBEGIN(readability-magic-numbers)
+  // Set kernel args
+  error = fused_kernel_.setArg(0, gaussian_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set fused kernel argument with error code: " + std::to_string(error));
+  error = fused_kernel_.setArg(1, gaussian_size_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set fused kernel argument with error code: " + std::to_string(error));
+  error = fused_kernel_.setArg(2, scale_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set fused kernel argument with error code: " + std::to_string(error));
+  error = fused_kernel_.setArg(3, colors_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set fused kernel argument with error code: " + std::to_string(error));
+  error = fused_kernel_.setArg(4, input_slots_.at(0).frame);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set fused kernel argument with error code: " + std::to_string(error));
+  error = fused_kernel_.setArg(5, input_width_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set fused kernel argument with error code: " + std::to_string(error));
+  error = fused_kernel_.setArg(6, output_width_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set fused kernel argument with error code: " + std::to_string(error));
+  error = fused_kernel_.setArg(7, output_height_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set fused kernel argument with error code: " + std::to_string(error));
+  error = fused_kernel_.setArg(8, history_frames_.at(newest_frame_loc_));
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set fused kernel argument with error code: " + std::to_string(error));
+  error = fused_kernel_.setArg(9, history_frames_.at(bg_remove_loc_));
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set fused kernel argument with error code: " + std::to_string(error));
+  error = fused_kernel_.setArg(10, history_frames_.at(mvt_remove_loc_));
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set fused kernel argument with error code: " + std::to_string(error));
+  error = fused_kernel_.setArg(11, bg_length_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set fused kernel argument with error code: " + std::to_string(error));
+  error = fused_kernel_.setArg(12, mvt_length_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set fused kernel argument with error code: " + std::to_string(error));
+  error = fused_kernel_.setArg(13, stabilized_background_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set fused kernel argument with error code: " + std::to_string(error));
+  error = fused_kernel_.setArg(14, stabilized_movement_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set fused kernel argument with error code: " + std::to_string(error));
+  error = fused_kernel_.setArg(15, pixel_diff_threshold_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set fused kernel argument with error code: " + std::to_string(error));
+  error = fused_kernel_.setArg(16, difference_frame_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set fused kernel argument with error code: " + std::to_string(error));
+  error = fused_kernel_.setArg(17, cl::Local(fused_tile_size_ * tile_columns * sizeof(unsigned char)));
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set fused kernel argument with error code: " + std::to_string(error));
+  // NOLINTEND(readability-magic-numbers)
+}
+
+void MotionDetector::LoadCountDifferenceBuffers() {
+  // Create buffers
   int error = CL_SUCCESS;
-  cl::Program program = cl::Program(context_, source, &error);
-  if (error != CL_SUCCESS) throw std::runtime_error("Failed to create OpenCL program from kernel file: " + filename);
+  // pixel count
+  pixel_count_ = CreateIntBuffer(context_, cmd_queue_, static_cast<int>(scaled_width_ * scaled_height_), "pixel count");
 
-  // Build program and throw errors if fails
-  error = program.build(OPEN_CL_COMPILE_FLAGS);
-  if (error != CL_SUCCESS) {
-    *info << "OpenCL build failed! Build Log:\n" << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device_) << std::endl;
-    throw std::runtime_error("Failed to compile OpenCL kernel file: " + filename);
+  // changed pixels (reset before every count)
+  changed_pixels_ = cl::Buffer(context_, CL_MEM_READ_WRITE, 2 * sizeof(unsigned int), nullptr, &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error creating changed pixels buffer with error code: " + std::to_string(error));
+}
+
+void MotionDetector::LoadCountDifferenceKernel() {
+  // Load kernel
+  int error = CL_SUCCESS;
+  cl::Program count_program = LoadProgram(motion_config_.kCountDifferenceFile);
+  count_kernel_ = cl::Kernel(count_program, "count_difference", &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to create count difference kernel with error code: " + std::to_string(error));
+
+  // Pick largest power of 2 thread block the kernel can run with
+  size_t max_block_size = count_kernel_.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device_);
+  count_block_size_ = 1;
+  while (count_block_size_ * 2 <= max_block_size && count_block_size_ * 2 <= MAX_WORK_GROUP_SIZE) count_block_size_ *= 2;
+
+  // Set kernel args
+  error = count_kernel_.setArg(0, difference_frame_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set count difference kernel argument with error code: " + std::to_string(error));
+  error = count_kernel_.setArg(1, pixel_count_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set count difference kernel argument with error code: " + std::to_string(error));
+  error = count_kernel_.setArg(2, changed_pixels_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set count difference kernel argument with error code: " + std::to_string(error));
+  error = count_kernel_.setArg(3, cl::Local(count_block_size_ * sizeof(unsigned int)));
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set count difference kernel argument with error code: " + std::to_string(error));
+}
+
+void MotionDetector::LoadRegionBuffers() {
+  // Create buffers
+  int error = CL_SUCCESS;
+  // fewest pixels in a region and room for regions
+  min_region_pixels_ = CreateIntBuffer(context_, cmd_queue_, static_cast<int>(motion_config_.min_region_pixels), "minimum region pixels");
+  // Room for every region the difference frame can hold, so which regions are kept does not depend on the order the device numbers them in
+  // (8-connected regions need a gap between them, so there are at most one per 2x2 block)
+  const unsigned int pixels = scaled_width_ * scaled_height_;
+  const unsigned int min_pixels = std::max(1U, motion_config_.min_region_pixels);
+  region_capacity_ = std::min((pixels + min_pixels - 1) / min_pixels, ((scaled_width_ + 1) / 2) * ((scaled_height_ + 1) / 2));
+  max_regions_ = CreateIntBuffer(context_, cmd_queue_, static_cast<int>(region_capacity_), "maximum regions");
+
+  // labels and pixels of every root (written by labeling before they are read)
+  labels_ = cl::Buffer(context_, CL_MEM_READ_WRITE, pixels * sizeof(cl_int), nullptr, &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error creating labels buffer with error code: " + std::to_string(error));
+  region_pixels_ = cl::Buffer(context_, CL_MEM_READ_WRITE, pixels * sizeof(cl_uint), nullptr, &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error creating region pixels buffer with error code: " + std::to_string(error));
+
+  // regions (reset before every labeling)
+  region_count_ = cl::Buffer(context_, CL_MEM_READ_WRITE, 2 * sizeof(cl_uint), nullptr, &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error creating region count buffer with error code: " + std::to_string(error));
+  regions_ = cl::Buffer(context_, CL_MEM_READ_WRITE, region_capacity_ * REGION_FIELDS * sizeof(cl_uint), nullptr, &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error creating regions buffer with error code: " + std::to_string(error));
+}
+
+void MotionDetector::LoadRegionKernels() {
+  // Load kernels
+  int error = CL_SUCCESS;
+  cl::Program region_program = LoadProgram(motion_config_.kLabelRegionsFile);
+  label_tiles_kernel_ = cl::Kernel(region_program, "label_tiles", &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to create label tiles kernel with error code: " + std::to_string(error));
+  merge_tiles_kernel_ = cl::Kernel(region_program, "merge_tiles", &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to create merge tiles kernel with error code: " + std::to_string(error));
+  compress_labels_kernel_ = cl::Kernel(region_program, "compress_labels", &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to create compress labels kernel with error code: " + std::to_string(error));
+  count_region_pixels_kernel_ = cl::Kernel(region_program, "count_region_pixels", &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to create count region pixels kernel with error code: " + std::to_string(error));
+  number_regions_kernel_ = cl::Kernel(region_program, "number_regions", &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to create number regions kernel with error code: " + std::to_string(error));
+  measure_regions_kernel_ = cl::Kernel(region_program, "measure_regions", &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to create measure regions kernel with error code: " + std::to_string(error));
+
+  // Pick largest square tile every region kernel can run with and that fits in local memory, bigger tiles leave fewer edges to join in global memory
+  size_t max_block_size = MAX_WORK_GROUP_SIZE;
+  for (const cl::Kernel* kernel : {&label_tiles_kernel_, &merge_tiles_kernel_, &compress_labels_kernel_, &count_region_pixels_kernel_, &number_regions_kernel_,
+                                   &measure_regions_kernel_}) {
+    max_block_size = std::min(max_block_size, kernel->getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device_));
+  }
+  cl_ulong local_mem_size = device_.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+  region_tile_size_ = 16;  // NOLINT(readability-magic-numbers)
+  while (region_tile_size_ > 1 && (region_tile_size_ * region_tile_size_ > max_block_size || region_tile_size_ * region_tile_size_ * sizeof(cl_int) > local_mem_size)) {
+    region_tile_size_ /= 2;
+  }
+
+  // NOLINTBEGIN(readability-magic-numbers)
+  // Set kernel args
+  error = label_tiles_kernel_.setArg(0, difference_frame_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set label tiles kernel argument with error code: " + std::to_string(error));
+  error = label_tiles_kernel_.setArg(1, output_width_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set label tiles kernel argument with error code: " + std::to_string(error));
+  error = label_tiles_kernel_.setArg(2, output_height_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set label tiles kernel argument with error code: " + std::to_string(error));
+  error = label_tiles_kernel_.setArg(3, labels_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set label tiles kernel argument with error code: " + std::to_string(error));
+  error = label_tiles_kernel_.setArg(4, cl::Local(region_tile_size_ * region_tile_size_ * sizeof(cl_int)));
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set label tiles kernel argument with error code: " + std::to_string(error));
+
+  // Every other region kernel starts with the frame size and labels
+  for (cl::Kernel* kernel : {&merge_tiles_kernel_, &compress_labels_kernel_, &count_region_pixels_kernel_, &number_regions_kernel_, &measure_regions_kernel_}) {
+    error = kernel->setArg(0, output_width_);
+    if (error != CL_SUCCESS) throw std::runtime_error("Failed to set region kernel argument with error code: " + std::to_string(error));
+    error = kernel->setArg(1, output_height_);
+    if (error != CL_SUCCESS) throw std::runtime_error("Failed to set region kernel argument with error code: " + std::to_string(error));
+    error = kernel->setArg(2, labels_);
+    if (error != CL_SUCCESS) throw std::runtime_error("Failed to set region kernel argument with error code: " + std::to_string(error));
+  }
+
+  error = count_region_pixels_kernel_.setArg(3, region_pixels_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set count region pixels kernel argument with error code: " + std::to_string(error));
+
+  error = number_regions_kernel_.setArg(3, region_pixels_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set number regions kernel argument with error code: " + std::to_string(error));
+  error = number_regions_kernel_.setArg(4, min_region_pixels_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set number regions kernel argument with error code: " + std::to_string(error));
+  error = number_regions_kernel_.setArg(5, max_regions_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set number regions kernel argument with error code: " + std::to_string(error));
+  error = number_regions_kernel_.setArg(6, region_count_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set number regions kernel argument with error code: " + std::to_string(error));
+  error = number_regions_kernel_.setArg(7, regions_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set number regions kernel argument with error code: " + std::to_string(error));
+
+  error = measure_regions_kernel_.setArg(3, region_pixels_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set measure regions kernel argument with error code: " + std::to_string(error));
+  error = measure_regions_kernel_.setArg(4, regions_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set measure regions kernel argument with error code: " + std::to_string(error));
+  // NOLINTEND(readability-magic-numbers)
+}
+
+void MotionDetector::InitDecodeWindow() {
+  // DC images are read from every block's coefficients, which have to be entropy decoded either way
+  if (motion_config_.processing_mode == ProcessingMode::kDCBlocks) return;
+
+  // Bounding box of watched scaled pixels
+  unsigned int min_x = scaled_width_;
+  unsigned int min_y = scaled_height_;
+  unsigned int max_x = 0;
+  unsigned int max_y = 0;
+  for (unsigned int y = 0; y < scaled_height_; y++) {
+    for (unsigned int x = 0; x < scaled_width_; x++) {
+      if (roi_scaled_.at(y * scaled_width_ + x) == 0) continue;
+      min_x = std::min(min_x, x);
+      min_y = std::min(min_y, y);
+      max_x = std::max(max_x, x);
+      max_y = std::max(max_y, y);
+    }
+  }
+
+  // Scaled pixel x blurs decompressed columns x * scale up to x * scale + gaussian size, the same goes for rows
+  std::vector<double> gaussian = GenerateGaussian(motion_config_.gaussian_size);
+  gaussian = ScaleGaussian(gaussian, motion_config_.scale_denominator);
+  const unsigned int window_x = min_x * motion_config_.scale_denominator;
+  const unsigned int window_y = min_y * motion_config_.scale_denominator;
+  const unsigned int window_end_x = std::min(max_x * motion_config_.scale_denominator + static_cast<unsigned int>(gaussian.size()), input_vid_.width);
+  const unsigned int window_end_y = std::min(max_y * motion_config_.scale_denominator + static_cast<unsigned int>(gaussian.size()), input_vid_.height);
+  // Whole frames keep decompressing in strips
+  if (window_x == 0 && window_y == 0 && window_end_x == input_vid_.width && window_end_y == input_vid_.height) return;
+
+  decompressor_.SetDecodeWindow(window_x, window_y, window_end_x - window_x, window_end_y - window_y);
+  if (decoder_) decoder_->SetDecodeWindow(window_x, window_y, window_end_x - window_x, window_end_y - window_y);
+  // Rest of the frame stays blank
+  window_frame_ = std::vector<unsigned char>(input_frame_buffer_size_, 0);
+  *info << "Decode window: " << window_end_x - window_x << "x" << window_end_y - window_y << " at " << window_x << "," << window_y << std::endl;
+}
+
+void MotionDetector::LoadRoiTiles() {
+  int error = CL_SUCCESS;
+  const bool separable = motion_config_.processing_mode == ProcessingMode::kSeparable;
+  const bool fused = motion_config_.processing_mode == ProcessingMode::kFused;
+
+  // Fused kernel already picked its tiles, others get the largest square tile every kernel launched over tiles can run with
+  if (fused) {
+    roi_tile_size_ = fused_tile_size_;
+  } else {
+    size_t max_block_size = std::min(static_cast<size_t>(MAX_WORK_GROUP_SIZE), stabilize_kernel_.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device_));
+    if (separable) {
+      max_block_size = std::min(max_block_size, bs_vertical_kernel_.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device_));
+      max_block_size = std::min(max_block_size, bs_horizontal_kernel_.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device_));
+    }
+    roi_tile_size_ = 16;  // NOLINT(readability-magic-numbers)
+    while (roi_tile_size_ > 1 && roi_tile_size_ * roi_tile_size_ > max_block_size) roi_tile_size_ /= 2;
   }
-  *info << "Successfully compiled OpenCL kernel file: " + filename << std::endl;
-  return program;
+
+  // Scaled tiles with at least one watched pixel
+  const unsigned int tile = roi_tile_size_;
+  const unsigned int tiles_x = (scaled_width_ + tile - 1) / tile;
+  const unsigned int tiles_y = (scaled_height_ + tile - 1) / tile;
+  std::vector<cl_int> tiles;
+  // Blocks of tile input columns by tile scaled rows the horizontal pass of watched tiles reads
+  std::vector<double> gaussian = GenerateGaussian(motion_config_.gaussian_size);
+  gaussian = ScaleGaussian(gaussian, motion_config_.scale_denominator);
+  const unsigned int column_blocks = (input_vid_.width + tile - 1) / tile;
+  std::vector<bool> vertical_blocks(separable ? column_blocks * tiles_y : 0, false);
+  for (unsigned int tile_y = 0; tile_y < tiles_y; tile_y++) {
+    for (unsigned int tile_x = 0; tile_x < tiles_x; tile_x++) {
+      const unsigned int end_x = std::min((tile_x + 1) * tile, scaled_width_);
+      const unsigned int end_y = std::min((tile_y + 1) * tile, scaled_height_);
+      bool watched = false;
+      for (unsigned int y = tile_y * tile; y < end_y && !watched; y++) {
+        for (unsigned int x = tile_x * tile; x < end_x && !watched; x++) watched = roi_scaled_.at(y * scaled_width_ + x) != 0;
+      }
+      if (!watched) continue;
+      tiles.push_back(static_cast<cl_int>(tile_x));
+      tiles.push_back(static_cast<cl_int>(tile_y));
+      if (!separable) continue;
+      // Scaled pixel x reads vertically scaled columns x * scale up to x * scale + gaussian size
+      const unsigned int first_column = tile_x * tile * motion_config_.scale_denominator;
+      const unsigned int last_column = std::min((end_x - 1) * motion_config_.scale_denominator + static_cast<unsigned int>(gaussian.size()) - 1, input_vid_.width - 1);
+      for (unsigned int block = first_column / tile; block <= last_column / tile; block++) vertical_blocks.at(tile_y * column_blocks + block) = true;
+    }
+  }
+  std::vector<cl_int> vertical_tiles;
+  for (unsigned int i = 0; i < vertical_blocks.size(); i++) {
+    if (!vertical_blocks.at(i)) continue;
+    vertical_tiles.push_back(static_cast<cl_int>(i % column_blocks));
+    vertical_tiles.push_back(static_cast<cl_int>(i / column_blocks));
+  }
+  roi_tile_count_ = tiles.size() / 2;
+  roi_vertical_tile_count_ = vertical_tiles.size() / 2;
+  *info << "Region of interest tiles: " << roi_tile_count_ << " of " << tiles_x * tiles_y << std::endl;
+
+  // Create buffers, RasterizeRoi() made sure there is at least one watched tile
+  roi_mask_ = cl::Buffer(context_, CL_MEM_READ_ONLY, roi_scaled_.size() * sizeof(unsigned char), nullptr, &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error creating region of interest mask buffer with error code: " + std::to_string(error));
+  error = cmd_queue_.enqueueWriteBuffer(roi_mask_, CL_TRUE, 0, roi_scaled_.size() * sizeof(unsigned char), static_cast<const void*>(roi_scaled_.data()));
+  if (error != CL_SUCCESS) throw std::runtime_error("Error writing region of interest mask buffer with error code: " + std::to_string(error));
+  roi_tiles_ = cl::Buffer(context_, CL_MEM_READ_ONLY, tiles.size() * sizeof(cl_int), nullptr, &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error creating region of interest tiles buffer with error code: " + std::to_string(error));
+  error = cmd_queue_.enqueueWriteBuffer(roi_tiles_, CL_TRUE, 0, tiles.size() * sizeof(cl_int), static_cast<const void*>(tiles.data()));
+  if (error != CL_SUCCESS) throw std::runtime_error("Error writing region of interest tiles buffer with error code: " + std::to_string(error));
+  if (separable) {
+    roi_vertical_tiles_ = cl::Buffer(context_, CL_MEM_READ_ONLY, vertical_tiles.size() * sizeof(cl_int), nullptr, &error);
+    if (error != CL_SUCCESS) throw std::runtime_error("Error creating region of interest vertical tiles buffer with error code: " + std::to_string(error));
+    error = cmd_queue_.enqueueWriteBuffer(roi_vertical_tiles_, CL_TRUE, 0, vertical_tiles.size() * sizeof(cl_int), static_cast<const void*>(vertical_tiles.data()));
+    if (error != CL_SUCCESS) throw std::runtime_error("Error writing region of interest vertical tiles buffer with error code: " + std::to_string(error));
+  }
+
+  // NOLINTBEGIN(readability-magic-numbers)
+  // Set kernel args, tiles come after every other argument
+  if (fused) {
+    error = fused_kernel_.setArg(18, roi_tiles_);
+    if (error != CL_SUCCESS) throw std::runtime_error("Failed to set fused kernel region of interest argument with error code: " + std::to_string(error));
+    error = fused_kernel_.setArg(19, roi_mask_);
+    if (error != CL_SUCCESS) throw std::runtime_error("Failed to set fused kernel region of interest argument with error code: " + std::to_string(error));
+    // NOLINTEND(readability-magic-numbers)
+    return;
+  }
+  const unsigned int stabilize_arg = motion_config_.packed_mask ? 11 : 9;
+  error = stabilize_kernel_.setArg(stabilize_arg, roi_tiles_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set stabilize and compare frames kernel argument with error code: " + std::to_string(error));
+  error = stabilize_kernel_.setArg(stabilize_arg + 1, roi_mask_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set stabilize and compare frames kernel argument with error code: " + std::to_string(error));
+  error = stabilize_kernel_.setArg(stabilize_arg + 2, output_width_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set stabilize and compare frames kernel argument with error code: " + std::to_string(error));
+  error = stabilize_kernel_.setArg(stabilize_arg + 3, output_height_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set stabilize and compare frames kernel argument with error code: " + std::to_string(error));
+  // Tiled blur and scale kernels share local memory across their own work groups and stay dense
+  if (separable) {
+    error = bs_vertical_kernel_.setArg(7, roi_vertical_tiles_);
+    if (error != CL_SUCCESS) throw std::runtime_error("Failed to set vertical blur and scale kernel argument with error code: " + std::to_string(error));
+    error = bs_vertical_kernel_.setArg(8, output_height_);
+    if (error != CL_SUCCESS) throw std::runtime_error("Failed to set vertical blur and scale kernel argument with error code: " + std::to_string(error));
+    error = bs_horizontal_kernel_.setArg(7, roi_tiles_);
+    if (error != CL_SUCCESS) throw std::runtime_error("Failed to set horizontal blur and scale kernel argument with error code: " + std::to_string(error));
+    error = bs_horizontal_kernel_.setArg(8, output_height_);
+    if (error != CL_SUCCESS) throw std::runtime_error("Failed to set horizontal blur and scale kernel argument with error code: " + std::to_string(error));
+  }
+  // NOLINTEND(readability-magic-numbers)
+}
+
+void MotionDetector::InitKernelDefines() {
+  DetectorSizes sizes = {scaled_width_, scaled_height_, input_frame_buffer_size_, intermediate_scaled_frame_buffer_size_, scaled_frame_buffer_size_,
+                         stabilized_element_size_, history_length_};
+  kernel_defines_ = MakeKernelDefines(input_vid_, motion_config_, sizes);
+  // Packed masks change the type of the difference frame, so they are compiled in either way
+  if (motion_config_.packed_mask) kernel_defines_ += " -DPACKED_MASK";
+  // So do regions of interest, which launch work groups from a list of tiles
+  if (!motion_config_.roi.IsEmpty()) kernel_defines_ += " -DROI_TILES";
 }
+
+cl::Program MotionDetector::LoadProgram(const std::string& filename) { return runtime_->GetProgram(filename, OPEN_CL_COMPILE_FLAGS + kernel_defines_); }
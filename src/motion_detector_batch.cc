@@ -0,0 +1,386 @@
+#include "motion_detector_batch.hpp"
+
+#include <CL/opencl.h>
+
+#include <CL/cl2.hpp>
+#include <exception>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "detector_setup.hpp"
+#include "device_runtime.hpp"
+#include "generate_gaussian.hpp"
+#include "jpeg_decompressor.hpp"
+#include "motion_detector.hpp"
+#include "open_cl_interface.hpp"
+#include "thread_pool.hpp"
+
+MotionDetectorBatch::MotionDetectorBatch(InputVideoSettings input_vid_settings, MotionConfig motion_config, unsigned int streams, DeviceConfig device_config,
+                                         std::ostream* output)
+    : MotionDetectorBatch(input_vid_settings, motion_config, streams, device_config, nullptr, output) {}
+
+MotionDetectorBatch::MotionDetectorBatch(InputVideoSettings input_vid_settings, MotionConfig motion_config, unsigned int streams, std::shared_ptr<DeviceRuntime> runtime,
+                                         std::ostream* output)
+    : MotionDetectorBatch(input_vid_settings, motion_config, streams,
+                          runtime ? runtime->GetDeviceConfig() : throw std::invalid_argument("DeviceRuntime can not be null"), runtime, output) {}
+
+MotionDetectorBatch::MotionDetectorBatch(InputVideoSettings input_vid_settings, MotionConfig motion_config, unsigned int streams, DeviceConfig device_config,
+                                         std::shared_ptr<DeviceRuntime> runtime, std::ostream* output)
+    : streams_(streams), runtime_(std::move(runtime)), input_vid_(input_vid_settings), motion_config_(motion_config), device_config_(device_config) {
+  info = output;
+
+  // Check settings
+  ValidateSettings();
+
+  // Streams decompressed on decode threads get a decompressor each, and are not split into strips since every thread already has a stream
+  // (streams decompressed on the calling thread share one decompressor, and with it one set of strip threads)
+  if (motion_config_.dct_scaling) decode_scale_ = JpegDecompressor::LargestDecodeScale(motion_config_.scale_denominator);
+  const unsigned int decompressors = motion_config_.decode_threads > 0 ? streams_ : 1;
+  const unsigned int strip_threads = motion_config_.decode_threads > 0 ? 1 : motion_config_.strip_threads;
+  for (unsigned int i = 0; i < decompressors; i++) {
+    decompressors_.push_back(std::make_unique<JpegDecompressor>(input_vid_settings.width, input_vid_settings.height, input_vid_settings.frame_format,
+                                                                motion_config_.decomp_method, decode_scale_, strip_threads));
+  }
+  if (motion_config_.decode_threads > 0) decode_pool_ = std::make_unique<ThreadPool>(motion_config_.decode_threads);
+  // Decompressor scales frames down by the decode scale, the device only does the rest
+  if (decode_scale_ > 1) {
+    input_vid_.width = decompressors_.at(0)->GetDecompressedWidth();
+    input_vid_.height = decompressors_.at(0)->GetDecompressedHeight();
+    motion_config_.scale_denominator /= decode_scale_;
+    *info << "Decode scale: 1/" << decode_scale_ << std::endl;
+  }
+  // Calculate Buffer Sizes
+  CalculateBufferSizes();
+
+  // Detectors given a runtime share its context, queue and programs, others get a runtime of their own
+  if (!runtime_) runtime_ = std::make_shared<DeviceRuntime>(device_config_, info, motion_config_.program_cache_dir);
+  device_ = runtime_->GetDevice();
+  context_ = runtime_->GetContext();
+  cmd_queue_ = runtime_->GetCommandQueue();
+
+  // Load Buffers
+  LoadBuffers();
+  int error = cmd_queue_.finish();
+  if (error != CL_SUCCESS) throw std::runtime_error("Error initializing buffers with error code: " + std::to_string(error));
+  // -D options for the kernels, with the configuration built in unless argument buffers were asked for
+  InitKernelDefines();
+  // Load kernels
+  LoadKernels();
+
+  // Create work sizes
+  InitWorkSizes();
+  *info << "Batched streams: " << streams_ << std::endl;
+}
+
+MotionDetectorBatch::~MotionDetectorBatch() {
+  // Let queued kernels finish before buffers are released
+  try {
+    cmd_queue_.finish();
+  } catch (...) {
+  }
+}
+
+std::vector<bool> MotionDetectorBatch::DetectOnFrames(const std::vector<std::pair<const unsigned char*, unsigned long>>& frames) {
+  if (frames.size() != streams_) throw std::invalid_argument("Expected " + std::to_string(streams_) + " frames, got " + std::to_string(frames.size()));
+
+  int error = CL_SUCCESS;
+  // Map stacked input into host memory, the in order queue only maps it once the last batch's kernels are done with it
+  void* mapped = cmd_queue_.enqueueMapBuffer(input_frames_, CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION, 0, streams_ * input_frame_buffer_size_ * sizeof(unsigned char),
+                                             nullptr, nullptr, &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error mapping input frames buffer with error code: " + std::to_string(error));
+
+  // Decompress every stream's frame into its place in mapped memory, input has to be unmapped even if decompression fails
+  std::exception_ptr decompress_error = nullptr;
+  try {
+    auto decompress = [&](unsigned int stream) {
+      unsigned char* destination = static_cast<unsigned char*>(mapped) + stream * input_frame_buffer_size_;
+      decompressors_.at(decode_pool_ ? stream : 0)->DecompressImage(frames.at(stream).first, frames.at(stream).second, destination, input_frame_buffer_size_);
+    };
+    if (decode_pool_) {
+      decode_pool_->RunTasks(streams_, decompress);
+    } else {
+      for (unsigned int i = 0; i < streams_; i++) decompress(i);
+    }
+  } catch (...) {
+    decompress_error = std::current_exception();
+  }
+
+  // Hand input back to device
+  error = cmd_queue_.enqueueUnmapMemObject(input_frames_, mapped);
+  if (decompress_error != nullptr) std::rethrow_exception(decompress_error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error unmapping input frames buffer with error code: " + std::to_string(error));
+
+  return ProcessBatch();
+}
+
+std::vector<bool> MotionDetectorBatch::DetectOnDecompressedFrames(const std::vector<const unsigned char*>& frames) {
+  if (frames.size() != streams_) throw std::invalid_argument("Expected " + std::to_string(streams_) + " frames, got " + std::to_string(frames.size()));
+
+  // Write every stream's frame to its place in the stacked input, only the last write needs to block
+  for (unsigned int i = 0; i < streams_; i++) {
+    int error = cmd_queue_.enqueueWriteBuffer(input_frames_, i + 1 == streams_ ? CL_TRUE : CL_FALSE, i * input_frame_buffer_size_ * sizeof(unsigned char),
+                                              input_frame_buffer_size_ * sizeof(unsigned char), static_cast<const void*>(frames.at(i)));
+    if (error != CL_SUCCESS) throw std::runtime_error("Error writing input frame with error code: " + std::to_string(error));
+  }
+
+  return ProcessBatch();
+}
+
+unsigned int MotionDetectorBatch::GetStreamCount() const { return streams_; }
+
+unsigned int MotionDetectorBatch::GetChangedPixels(unsigned int stream) const { return last_changed_pixels_.at(stream); }
+
+float MotionDetectorBatch::GetMotionScore(unsigned int stream) const {
+  return static_cast<float>(last_changed_pixels_.at(stream)) / static_cast<float>(scaled_width_ * scaled_height_);
+}
+
+unsigned int MotionDetectorBatch::GetDecodeScale() const { return decode_scale_; }
+
+std::vector<bool> MotionDetectorBatch::ProcessBatch() {
+  int error = CL_SUCCESS;
+  // Move through frame history the same way MotionDetector does, each slot holds a frame of every stream
+  newest_frame_loc_ = (newest_frame_loc_ + 1) % history_frames_.size();
+  bg_remove_loc_ = (bg_remove_loc_ + 1) % history_frames_.size();
+  mvt_remove_loc_ = (mvt_remove_loc_ + 1) % history_frames_.size();
+
+  // NOLINTBEGIN(readability-magic-numbers)
+  // Vertical Scale
+  error = cmd_queue_.enqueueNDRangeKernel(bs_vertical_kernel_, cl::NullRange, vertical_global_work_size_3d_, cl::NullRange);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to queue OpenCL kernel with error code: " + std::to_string(error));
+
+  // Horizontal scale directly into newest history slot
+  error = bs_horizontal_kernel_.setArg(6, history_frames_.at(newest_frame_loc_));
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set horizontal blur and scale kernel output with error code: " + std::to_string(error));
+  error = cmd_queue_.enqueueNDRangeKernel(bs_horizontal_kernel_, cl::NullRange, horizontal_global_work_size_3d_, cl::NullRange);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to queue OpenCL kernel with error code: " + std::to_string(error));
+
+  // Stabilize and compare, streams are stacked the same way in every buffer so one 1D range covers them all
+  error = stabilize_kernel_.setArg(0, history_frames_.at(bg_remove_loc_));
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set background frame to remove with error code: " + std::to_string(error));
+  error = stabilize_kernel_.setArg(1, history_frames_.at(mvt_remove_loc_));
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set movement frame to remove with error code: " + std::to_string(error));
+  error = stabilize_kernel_.setArg(2, history_frames_.at(newest_frame_loc_));
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set newest scaled frame with error code: " + std::to_string(error));
+  error = cmd_queue_.enqueueNDRangeKernel(stabilize_kernel_, cl::NullRange, stabilize_global_work_size_1d_, cl::NullRange);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to queue OpenCL kernel with error code: " + std::to_string(error));
+  // NOLINTEND(readability-magic-numbers)
+
+  // Reset counts and count every stream
+  error = cmd_queue_.enqueueFillBuffer(changed_pixels_, static_cast<unsigned int>(0), 0, streams_ * sizeof(unsigned int));
+  if (error != CL_SUCCESS) throw std::runtime_error("Error resetting changed pixel counts with error code: " + std::to_string(error));
+  error = cmd_queue_.enqueueNDRangeKernel(count_kernel_, cl::NullRange, count_global_work_size_2d_, count_thread_block_size_2d_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to queue OpenCL kernel with error code: " + std::to_string(error));
+
+  // One read brings back every stream's count
+  error = cmd_queue_.enqueueReadBuffer(changed_pixels_, CL_TRUE, 0, streams_ * sizeof(unsigned int), static_cast<void*>(last_changed_pixels_.data()));
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to read changed pixel counts from memory with error code: " + std::to_string(error));
+
+  std::vector<bool> motion(streams_);
+  for (unsigned int i = 0; i < streams_; i++) motion.at(i) = last_changed_pixels_.at(i) > diff_threshold_;
+  return motion;
+}
+
+void MotionDetectorBatch::ValidateSettings() const {
+  // Check if there is a stream to process
+  if (streams_ == 0) throw std::invalid_argument("Batch needs at least 1 stream");
+
+  // DC images skip the blur and scale kernels the batch is built around
+  if (motion_config_.processing_mode == ProcessingMode::kDCBlocks) throw std::invalid_argument("ProcessingMode::kDCBlocks is not supported by MotionDetectorBatch");
+  // Streams' masks would have to start on word boundaries of the stacked mask
+  if (motion_config_.packed_mask) throw std::invalid_argument("MotionConfig::packed_mask is not supported by MotionDetectorBatch");
+  // Labeling works on one frame at a time
+  if (motion_config_.max_regions > 0) throw std::invalid_argument("MotionConfig::max_regions is not supported by MotionDetectorBatch");
+  // Streams are stacked into one frame, so their tiles all have to be launched
+  if (!motion_config_.roi.IsEmpty()) throw std::invalid_argument("MotionConfig::roi is not supported by MotionDetectorBatch");
+
+  // Settings shared with MotionDetector
+  ValidateMotionConfig(input_vid_, motion_config_);
+}
+
+void MotionDetectorBatch::CalculateBufferSizes() {
+  // Same sizes as MotionDetector so every stream's part stays aligned
+  const DetectorSizes sizes = CalculateDetectorSizes(input_vid_, motion_config_);
+  scaled_width_ = sizes.scaled_width;
+  scaled_height_ = sizes.scaled_height;
+  input_frame_buffer_size_ = sizes.input_frame_buffer_size;
+  intermediate_scaled_frame_buffer_size_ = sizes.intermediate_scaled_frame_buffer_size;
+  scaled_frame_buffer_size_ = sizes.scaled_frame_buffer_size;
+  stabilized_element_size_ = sizes.stabilized_element_size;
+  history_length_ = sizes.history_length;
+  *info << "Scaled frame resolution: " << scaled_width_ << "x" << scaled_height_ << std::endl;
+
+  // Calcualte number of pixels that need to change
+  diff_threshold_ = static_cast<unsigned int>(motion_config_.min_changed_pixels * static_cast<double>(scaled_width_ * scaled_height_));
+  last_changed_pixels_ = std::vector<unsigned int>(streams_, 0);
+}
+
+void MotionDetectorBatch::LoadBuffers() {
+  int error = CL_SUCCESS;
+  // gaussian
+  std::vector<double> gaussian = GenerateGaussian(motion_config_.gaussian_size);
+  gaussian = ScaleGaussian(gaussian, motion_config_.scale_denominator);
+  std::vector<float> host_gaussian(gaussian.size() + (gaussian.size() % 2), 0.0F);  // round size so that it is even for raspi compatability
+  for (int i = 0; i < gaussian.size(); i++) host_gaussian.at(i) = static_cast<float>(gaussian.at(i));
+  // create buffer object
+  gaussian_ = cl::Buffer(context_, CL_MEM_READ_ONLY, host_gaussian.size() * sizeof(float), nullptr, &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error creating gaussian kernel buffer with error code: " + std::to_string(error));
+  // write to OpenCL device
+  error = cmd_queue_.enqueueWriteBuffer(gaussian_, CL_TRUE, 0, host_gaussian.size() * sizeof(float), static_cast<void*>(host_gaussian.data()));
+  if (error != CL_SUCCESS) throw std::runtime_error("Error writing gaussian kernel buffer with error code: " + std::to_string(error));
+
+  // configuration
+  gaussian_size_ = CreateIntBuffer(context_, cmd_queue_, static_cast<int>(gaussian.size()), "gaussian size");
+  scale_ = CreateIntBuffer(context_, cmd_queue_, static_cast<int>(motion_config_.scale_denominator), "scale amount");
+  colors_ = CreateIntBuffer(context_, cmd_queue_, input_vid_.frame_format == DecompFrameFormat::kRGB ? 3 : 1, "number of colors");
+  input_width_ = CreateIntBuffer(context_, cmd_queue_, static_cast<int>(input_vid_.width), "input width");
+  output_width_ = CreateIntBuffer(context_, cmd_queue_, static_cast<int>(scaled_width_), "scaled width");
+  input_stride_ = CreateIntBuffer(context_, cmd_queue_, static_cast<int>(input_frame_buffer_size_), "input stride");
+  intermediate_stride_ = CreateIntBuffer(context_, cmd_queue_, static_cast<int>(intermediate_scaled_frame_buffer_size_), "intermediate stride");
+  scaled_stride_ = CreateIntBuffer(context_, cmd_queue_, static_cast<int>(scaled_frame_buffer_size_), "scaled stride");
+  bg_length_ = CreateFloatBuffer(context_, cmd_queue_, static_cast<float>(motion_config_.bg_stabil_length), "background length");
+  mvt_length_ = CreateFloatBuffer(context_, cmd_queue_, static_cast<float>(motion_config_.motion_stabil_length), "movement length");
+  pixel_diff_threshold_ = CreateIntBuffer(context_, cmd_queue_, static_cast<int>(motion_config_.min_pixel_diff), "pixel difference threshold");
+  pixel_count_ = CreateIntBuffer(context_, cmd_queue_, static_cast<int>(scaled_width_ * scaled_height_), "pixel count");
+
+  // input frames, pinned host memory maps without a copy on integrated GPUs and CPUs
+  input_frames_ = cl::Buffer(context_, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, streams_ * input_frame_buffer_size_ * sizeof(unsigned char), nullptr, &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error creating input frames buffer with error code: " + std::to_string(error));
+  error = cmd_queue_.enqueueFillBuffer(input_frames_, static_cast<unsigned char>(0), 0, streams_ * input_frame_buffer_size_ * sizeof(unsigned char));
+  if (error != CL_SUCCESS) throw std::runtime_error("Error filling input frames buffer with error code: " + std::to_string(error));
+
+  // intermediate scaled frames
+  intermediate_scaled_frames_ = cl::Buffer(context_, CL_MEM_READ_WRITE, streams_ * intermediate_scaled_frame_buffer_size_ * sizeof(unsigned char), nullptr, &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error creating intermediate scaled frames buffer with error code: " + std::to_string(error));
+  error = cmd_queue_.enqueueFillBuffer(intermediate_scaled_frames_, static_cast<unsigned char>(0), 0,
+                                       streams_ * intermediate_scaled_frame_buffer_size_ * sizeof(unsigned char));
+  if (error != CL_SUCCESS) throw std::runtime_error("Error filling intermediate scaled frames buffer with error code: " + std::to_string(error));
+
+  // frame history, every slot holds a scaled frame of every stream
+  // Sub-buffers must start on the device's base address alignment, so space the slots out to that alignment
+  const unsigned int slot_size = streams_ * scaled_frame_buffer_size_;
+  unsigned int base_align = device_.getInfo<CL_DEVICE_MEM_BASE_ADDR_ALIGN>() / 8;  // NOLINT(readability-magic-numbers) bits to bytes
+  if (base_align == 0) base_align = MEM_ALIGN;
+  history_slot_stride_ = slot_size;
+  if (history_slot_stride_ % base_align != 0) history_slot_stride_ += base_align - (history_slot_stride_ % base_align);
+  frame_history_ = cl::Buffer(context_, CL_MEM_READ_WRITE, history_length_ * history_slot_stride_ * sizeof(unsigned char), nullptr, &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error creating frame history buffer with error code: " + std::to_string(error));
+  error = cmd_queue_.enqueueFillBuffer(frame_history_, static_cast<unsigned char>(0), 0, history_length_ * history_slot_stride_ * sizeof(unsigned char));
+  if (error != CL_SUCCESS) throw std::runtime_error("Error filling frame history buffer with error code: " + std::to_string(error));
+  history_frames_.clear();
+  for (int i = 0; i < history_length_; i++) {
+    cl_buffer_region region = {i * history_slot_stride_ * sizeof(unsigned char), slot_size * sizeof(unsigned char)};
+    history_frames_.push_back(frame_history_.createSubBuffer(CL_MEM_READ_WRITE, CL_BUFFER_CREATE_TYPE_REGION, &region, &error));
+    if (error != CL_SUCCESS) throw std::runtime_error("Error creating frame history sub-buffer with error code: " + std::to_string(error));
+  }
+  // Start removing frames from the background and movement averages once they have been in them for their full length
+  // (exponential averages have a single history slot and never remove frames, the kernels ignore the frames to remove)
+  const bool exponential = motion_config_.background_model == BackgroundModel::kExponential;
+  bg_remove_loc_ = exponential ? 0 : newest_frame_loc_ + 1;
+  mvt_remove_loc_ = exponential ? 0 : history_length_ - motion_config_.motion_stabil_length;
+
+  // stabilized background and movement frames
+  stabilized_background_ = cl::Buffer(context_, CL_MEM_READ_WRITE, slot_size * stabilized_element_size_, nullptr, &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error creating stabilized background buffer with error code: " + std::to_string(error));
+  error = cmd_queue_.enqueueFillBuffer(stabilized_background_, static_cast<unsigned char>(0), 0, slot_size * stabilized_element_size_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error filling stabilized background buffer with error code: " + std::to_string(error));
+  stabilized_movement_ = cl::Buffer(context_, CL_MEM_READ_WRITE, slot_size * stabilized_element_size_, nullptr, &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error creating stabilized movement buffer with error code: " + std::to_string(error));
+  error = cmd_queue_.enqueueFillBuffer(stabilized_movement_, static_cast<unsigned char>(0), 0, slot_size * stabilized_element_size_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error filling stabilized movement buffer with error code: " + std::to_string(error));
+
+  // difference frames
+  difference_frames_ = cl::Buffer(context_, CL_MEM_READ_WRITE, slot_size * sizeof(bool), nullptr, &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error creating difference frames buffer with error code: " + std::to_string(error));
+  error = cmd_queue_.enqueueFillBuffer(difference_frames_, static_cast<unsigned char>(0), 0, slot_size * sizeof(bool));
+  if (error != CL_SUCCESS) throw std::runtime_error("Error filling difference frames buffer with error code: " + std::to_string(error));
+
+  // changed pixels of every stream (reset before every count, rounded to an even size for raspi compatability)
+  changed_pixels_ = cl::Buffer(context_, CL_MEM_READ_WRITE, (streams_ + streams_ % 2) * sizeof(unsigned int), nullptr, &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Error creating changed pixels buffer with error code: " + std::to_string(error));
+}
+
+void MotionDetectorBatch::InitKernelDefines() {
+  const DetectorSizes sizes = {scaled_width_, scaled_height_, input_frame_buffer_size_, intermediate_scaled_frame_buffer_size_, scaled_frame_buffer_size_,
+                               stabilized_element_size_, history_length_};
+  kernel_defines_ = MakeKernelDefines(input_vid_, motion_config_, sizes);
+  if (!motion_config_.specialize_kernels) return;
+
+  // Distances between streams are only known to the batch kernels
+  std::ostringstream defines;
+  defines << " -DINPUT_STRIDE=" << input_frame_buffer_size_;
+  defines << " -DINTERMEDIATE_STRIDE=" << intermediate_scaled_frame_buffer_size_;
+  defines << " -DSCALED_STRIDE=" << scaled_frame_buffer_size_;
+  kernel_defines_ += defines.str();
+}
+
+void MotionDetectorBatch::LoadKernels() {
+  int error = CL_SUCCESS;
+  const std::string options = OPEN_CL_COMPILE_FLAGS + kernel_defines_;
+
+  // NOLINTBEGIN(readability-magic-numbers)
+  // Vertical blur and scale, input never moves so every argument is set once
+  bs_vertical_kernel_ = cl::Kernel(runtime_->GetProgram(motion_config_.kBlurScaleVerticalBatchFile, options), "blur_and_scale_vertical_batch", &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to create vertical blur and scale kernel with error code: " + std::to_string(error));
+  const std::vector<cl::Buffer> vertical_args = {gaussian_, gaussian_size_, scale_, colors_, input_frames_, input_width_, intermediate_scaled_frames_, input_stride_,
+                                                 intermediate_stride_};
+  for (int i = 0; i < vertical_args.size(); i++) {
+    error = bs_vertical_kernel_.setArg(i, vertical_args.at(i));
+    if (error != CL_SUCCESS) throw std::runtime_error("Failed to set vertical blur and scale kernel argument with error code: " + std::to_string(error));
+  }
+
+  // Horizontal blur and scale, output is pointed at the newest history slot every batch
+  bs_horizontal_kernel_ = cl::Kernel(runtime_->GetProgram(motion_config_.kBlurScaleHorizontalBatchFile, options), "blur_and_scale_horizontal_batch", &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to create horizontal blur and scale kernel with error code: " + std::to_string(error));
+  const std::vector<cl::Buffer> horizontal_args = {gaussian_, gaussian_size_, scale_, intermediate_scaled_frames_, input_width_, output_width_,
+                                                   history_frames_.at(newest_frame_loc_), intermediate_stride_, scaled_stride_};
+  for (int i = 0; i < horizontal_args.size(); i++) {
+    error = bs_horizontal_kernel_.setArg(i, horizontal_args.at(i));
+    if (error != CL_SUCCESS) throw std::runtime_error("Failed to set horizontal blur and scale kernel argument with error code: " + std::to_string(error));
+  }
+
+  // Stabilize and compare works on one pixel at a time, so the single stream kernel runs over the stacked buffers as is
+  stabilize_kernel_ = cl::Kernel(runtime_->GetProgram(motion_config_.kStabilizeFile, options), "stabilize_bg_mvt", &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to create stabilize background and movement kernel with error code: " + std::to_string(error));
+  const std::vector<cl::Buffer> stabilize_args = {history_frames_.at(bg_remove_loc_), history_frames_.at(mvt_remove_loc_), history_frames_.at(newest_frame_loc_),
+                                                  bg_length_, mvt_length_, stabilized_background_, stabilized_movement_, pixel_diff_threshold_, difference_frames_};
+  for (int i = 0; i < stabilize_args.size(); i++) {
+    error = stabilize_kernel_.setArg(i, stabilize_args.at(i));
+    if (error != CL_SUCCESS) throw std::runtime_error("Failed to set stabilize and compare frames kernel argument with error code: " + std::to_string(error));
+  }
+
+  // Count every stream's changed pixels
+  count_kernel_ = cl::Kernel(runtime_->GetProgram(motion_config_.kCountDifferenceBatchFile, options), "count_difference_batch", &error);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to create count difference kernel with error code: " + std::to_string(error));
+  // Pick largest power of 2 thread block the kernel can run with
+  size_t max_block_size = count_kernel_.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device_);
+  count_block_size_ = 1;
+  while (count_block_size_ * 2 <= max_block_size && count_block_size_ * 2 <= MAX_WORK_GROUP_SIZE) count_block_size_ *= 2;
+  error = count_kernel_.setArg(0, difference_frames_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set count difference kernel argument with error code: " + std::to_string(error));
+  error = count_kernel_.setArg(1, pixel_count_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set count difference kernel argument with error code: " + std::to_string(error));
+  error = count_kernel_.setArg(2, changed_pixels_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set count difference kernel argument with error code: " + std::to_string(error));
+  error = count_kernel_.setArg(3, cl::Local(count_block_size_ * sizeof(unsigned int)));
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set count difference kernel argument with error code: " + std::to_string(error));
+  error = count_kernel_.setArg(4, scaled_stride_);
+  if (error != CL_SUCCESS) throw std::runtime_error("Failed to set count difference kernel argument with error code: " + std::to_string(error));
+  // NOLINTEND(readability-magic-numbers)
+}
+
+void MotionDetectorBatch::InitWorkSizes() {
+  // Create 3D ranges, streams are the third dimension
+  vertical_global_work_size_3d_ = cl::NDRange(input_vid_.width + MEM_ALIGN - input_vid_.width % MEM_ALIGN, scaled_height_, streams_);  // Width needs to be mem aligned
+  horizontal_global_work_size_3d_ = cl::NDRange(scaled_width_ + MEM_ALIGN - scaled_width_ % MEM_ALIGN, scaled_height_, streams_);
+  // Create 1D range over every stream's scaled frame, padding between streams is compared too but never counted
+  stabilize_global_work_size_1d_ = cl::NDRange(streams_ * scaled_frame_buffer_size_);
+  // Counting needs a whole number of thread blocks per stream
+  unsigned int pixels = scaled_width_ * scaled_height_;
+  count_global_work_size_2d_ = cl::NDRange(pixels + (count_block_size_ - pixels % count_block_size_) % count_block_size_, streams_);
+  count_thread_block_size_2d_ = cl::NDRange(count_block_size_, 1);
+}
@@ -0,0 +1,88 @@
+#include "motion_detector_cascade.hpp"
+
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <utility>
+
+#include "device_runtime.hpp"
+#include "motion_detector.hpp"
+
+MotionDetectorCascade::MotionDetectorCascade(InputVideoSettings input_vid_settings, MotionConfig motion_config, CascadeConfig cascade_config,
+                                             DeviceConfig device_config, std::ostream* output)
+    : MotionDetectorCascade(input_vid_settings, motion_config, cascade_config, device_config, nullptr, output) {}
+
+MotionDetectorCascade::MotionDetectorCascade(InputVideoSettings input_vid_settings, MotionConfig motion_config, CascadeConfig cascade_config,
+                                             std::shared_ptr<DeviceRuntime> runtime, std::ostream* output)
+    : MotionDetectorCascade(input_vid_settings, motion_config, cascade_config,
+                            runtime ? runtime->GetDeviceConfig() : throw std::invalid_argument("DeviceRuntime can not be null"), runtime, output) {}
+
+MotionDetectorCascade::MotionDetectorCascade(InputVideoSettings input_vid_settings, MotionConfig motion_config, CascadeConfig cascade_config,
+                                             DeviceConfig device_config, std::shared_ptr<DeviceRuntime> runtime, std::ostream* output)
+    : cascade_config_(cascade_config) {
+  // Check settings
+  ValidateSettings(motion_config);
+
+  // Frames are handed to both models one at a time
+  motion_config.decode_threads = 0;
+
+  // Coarse model is the fine model scaled down further, decompressed with IDCT scaling and only counting changes
+  MotionConfig coarse_config = motion_config;
+  coarse_config.scale_denominator = cascade_config_.coarse_scale_denominator;
+  coarse_config.dct_scaling = true;
+  coarse_config.min_changed_pixels = cascade_config_.pre_trigger;
+  coarse_config.max_regions = 0;
+
+  // Both models share a runtime on OpenCL devices, the native device needs none
+  if (!runtime && device_config.device_type != DeviceType::kNative) runtime = std::make_shared<DeviceRuntime>(device_config, output, motion_config.program_cache_dir);
+  if (runtime) {
+    coarse_ = std::make_unique<MotionDetector>(input_vid_settings, coarse_config, runtime, output);
+    fine_ = std::make_unique<MotionDetector>(input_vid_settings, motion_config, runtime, output);
+  } else {
+    coarse_ = std::make_unique<MotionDetector>(input_vid_settings, coarse_config, device_config, output);
+    fine_ = std::make_unique<MotionDetector>(input_vid_settings, motion_config, device_config, output);
+  }
+}
+
+bool MotionDetectorCascade::DetectOnFrame(const unsigned char* frame, unsigned long size) {
+  frame_count_++;
+  // Coarse model sees every frame, crossing the pre-trigger escalates this frame and the next hold_frames
+  const bool suspected = coarse_->DetectOnFrame(frame, size);
+  escalated_ = suspected || hold_remaining_ > 0;
+  if (suspected) {
+    hold_remaining_ = cascade_config_.hold_frames;
+  } else if (hold_remaining_ > 0) {
+    hold_remaining_--;
+  }
+
+  // Idle fine model still sees every warm_interval'th frame, so its background and movement are recent once it is escalated to
+  frames_since_fine_++;
+  if (!escalated_ && frames_since_fine_ < cascade_config_.warm_interval) return false;
+  frames_since_fine_ = 0;
+  fine_frame_count_++;
+  return fine_->DetectOnFrame(frame, size);
+}
+
+bool MotionDetectorCascade::WasEscalated() const { return escalated_; }
+
+float MotionDetectorCascade::GetMotionScore() const { return fine_->GetMotionScore(); }
+
+float MotionDetectorCascade::GetCoarseMotionScore() const { return coarse_->GetMotionScore(); }
+
+unsigned long MotionDetectorCascade::GetFrameCount() const { return frame_count_; }
+
+unsigned long MotionDetectorCascade::GetFineFrameCount() const { return fine_frame_count_; }
+
+void MotionDetectorCascade::ValidateSettings(const MotionConfig& motion_config) const {
+  // Coarse model has to be cheaper than the fine model
+  if (cascade_config_.coarse_scale_denominator <= motion_config.scale_denominator) {
+    throw std::invalid_argument("Coarse scale denominator must be greater than scale denominator");
+  }
+
+  // Check if pre-trigger is not negative and also not greater than 1
+  if (cascade_config_.pre_trigger < 0) throw std::invalid_argument("Pre-trigger cannot be negative");
+  if (cascade_config_.pre_trigger > 1) throw std::invalid_argument("Pre-trigger cannot be greater than 1");
+
+  // Fine model has to see some frames while idle
+  if (cascade_config_.warm_interval == 0) throw std::invalid_argument("Warm interval cannot be 0");
+}
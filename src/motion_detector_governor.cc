@@ -0,0 +1,150 @@
+#include "motion_detector_governor.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <utility>
+
+#include "device_runtime.hpp"
+#include "motion_detector.hpp"
+
+#define TIME_SMOOTHING 0.25F  // Weight of newest processed frame in average processing time
+#define MAX_FEED_GAP 2        // Decimations a detector can go without a frame before its averages are no longer recent
+
+MotionDetectorGovernor::MotionDetectorGovernor(InputVideoSettings input_vid_settings, MotionConfig motion_config, GovernorConfig governor_config,
+                                               DeviceConfig device_config, std::ostream* output)
+    : MotionDetectorGovernor(input_vid_settings, motion_config, governor_config, device_config, nullptr, output) {}
+
+MotionDetectorGovernor::MotionDetectorGovernor(InputVideoSettings input_vid_settings, MotionConfig motion_config, GovernorConfig governor_config,
+                                               std::shared_ptr<DeviceRuntime> runtime, std::ostream* output)
+    : MotionDetectorGovernor(input_vid_settings, motion_config, governor_config,
+                             runtime ? runtime->GetDeviceConfig() : throw std::invalid_argument("DeviceRuntime can not be null"), runtime, output) {}
+
+MotionDetectorGovernor::MotionDetectorGovernor(InputVideoSettings input_vid_settings, MotionConfig motion_config, GovernorConfig governor_config,
+                                               DeviceConfig device_config, std::shared_ptr<DeviceRuntime> runtime, std::ostream* output)
+    : governor_config_(governor_config) {
+  info = output;
+
+  // Check settings
+  ValidateSettings();
+
+  // Frames are handed to one detector at a time
+  motion_config.decode_threads = 0;
+
+  // Decimations double up to max_decimation
+  for (unsigned int decimation = 1; decimation < governor_config_.max_decimation; decimation *= 2) decimations_.push_back(decimation);
+  decimations_.push_back(governor_config_.max_decimation);
+
+  // Every decimation's detector shares a runtime on OpenCL devices, the native device needs none
+  if (!runtime && device_config.device_type != DeviceType::kNative) runtime = std::make_shared<DeviceRuntime>(device_config, output, motion_config.program_cache_dir);
+  for (unsigned int decimation : decimations_) {
+    // Averages over fewer processed frames so they cover the same time as without decimation
+    MotionConfig level_config = motion_config;
+    level_config.bg_stabil_length = std::max(1U, (motion_config.bg_stabil_length + decimation / 2) / decimation);
+    level_config.motion_stabil_length = std::max(1U, (motion_config.motion_stabil_length + decimation / 2) / decimation);
+    settle_lengths_.push_back(level_config.bg_stabil_length + level_config.motion_stabil_length);
+
+    if (runtime) {
+      detectors_.push_back(std::make_unique<MotionDetector>(input_vid_settings, level_config, runtime, output));
+    } else {
+      detectors_.push_back(std::make_unique<MotionDetector>(input_vid_settings, level_config, device_config, output));
+    }
+  }
+  last_fed_ = std::vector<unsigned long>(decimations_.size(), 0);
+  warm_frames_ = std::vector<unsigned int>(decimations_.size(), 0);
+}
+
+bool MotionDetectorGovernor::DetectOnFrame(const unsigned char* frame, unsigned long size) {
+  frame_count_++;
+  // Skipped frames are never decompressed, so they take no time
+  processed_ = skip_remaining_ == 0;
+  if (!processed_) {
+    skip_remaining_--;
+    dropped_frames_++;
+    return false;
+  }
+
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  bool motion = FeedLevel(level_, frame, size);
+  // Next decimation up gets its share of processed frames, so stepping up under load does not have to refill its averages
+  const unsigned int next = level_ + 1;
+  if (next < decimations_.size() && frame_count_ - last_fed_.at(next) >= decimations_.at(next)) FeedLevel(next, frame, size);
+  const float elapsed = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+  average_ms_ = processed_frames_ == 0 ? elapsed : average_ms_ + (elapsed - average_ms_) * TIME_SMOOTHING;
+  processed_frames_++;
+
+  // Detector compares against frames from before it was selected until its averages are refilled
+  if (settle_remaining_ > 0) {
+    settle_remaining_--;
+    suppressed_frames_++;
+    motion = false;
+  }
+
+  AdjustDecimation();
+  skip_remaining_ = decimations_.at(level_) - 1;
+  return motion;
+}
+
+void MotionDetectorGovernor::SetLatencyBudget(float latency_budget_ms) {
+  if (latency_budget_ms <= 0) throw std::invalid_argument("Latency budget must be greater than 0");
+  governor_config_.latency_budget_ms = latency_budget_ms;
+}
+
+bool MotionDetectorGovernor::WasProcessed() const { return processed_; }
+
+bool MotionDetectorGovernor::IsSettling() const { return settle_remaining_ > 0; }
+
+unsigned int MotionDetectorGovernor::GetDecimation() const { return decimations_.at(level_); }
+
+float MotionDetectorGovernor::GetAverageProcessingTime() const { return average_ms_; }
+
+float MotionDetectorGovernor::GetMotionScore() const { return detectors_.at(level_)->GetMotionScore(); }
+
+unsigned long MotionDetectorGovernor::GetProcessedFrames() const { return processed_frames_; }
+
+unsigned long MotionDetectorGovernor::GetDroppedFrames() const { return dropped_frames_; }
+
+unsigned long MotionDetectorGovernor::GetSuppressedFrames() const { return suppressed_frames_; }
+
+void MotionDetectorGovernor::AdjustDecimation() {
+  // Shed load as soon as the average time per incoming frame is over the budget
+  if (average_ms_ / static_cast<float>(decimations_.at(level_)) > governor_config_.latency_budget_ms) {
+    if (level_ + 1 < decimations_.size()) SelectLevel(level_ + 1);
+    return;
+  }
+
+  // Only recover once the current detector is settled and the lower decimation fits well within the budget
+  if (level_ == 0 || settle_remaining_ > 0) return;
+  if (average_ms_ / static_cast<float>(decimations_.at(level_ - 1)) < governor_config_.latency_budget_ms * governor_config_.recover_ratio) SelectLevel(level_ - 1);
+}
+
+void MotionDetectorGovernor::SelectLevel(unsigned int level) {
+  level_ = level;
+  // Detector that was kept warm is ready straight away, others have to refill what their averages are missing
+  const unsigned int warm = GetWarmFrames(level_);
+  settle_remaining_ = warm >= settle_lengths_.at(level_) ? 0 : settle_lengths_.at(level_) - warm;
+  *info << "Decimation: 1/" << decimations_.at(level_) << std::endl;
+}
+
+bool MotionDetectorGovernor::FeedLevel(unsigned int level, const unsigned char* frame, unsigned long size) {
+  warm_frames_.at(level) = GetWarmFrames(level) + 1;
+  last_fed_.at(level) = frame_count_;
+  return detectors_.at(level)->DetectOnFrame(frame, size);
+}
+
+unsigned int MotionDetectorGovernor::GetWarmFrames(unsigned int level) const {
+  // Averages are only recent if the detector has kept getting frames at about its decimation
+  if (frame_count_ - last_fed_.at(level) > MAX_FEED_GAP * decimations_.at(level)) return 0;
+  return warm_frames_.at(level);
+}
+
+void MotionDetectorGovernor::ValidateSettings() const {
+  if (governor_config_.latency_budget_ms <= 0) throw std::invalid_argument("Latency budget must be greater than 0");
+  if (governor_config_.max_decimation == 0) throw std::invalid_argument("Max decimation cannot be 0");
+
+  // Check if recover ratio is greater than 0 and also not greater than 1
+  if (governor_config_.recover_ratio <= 0) throw std::invalid_argument("Recover ratio must be greater than 0");
+  if (governor_config_.recover_ratio > 1) throw std::invalid_argument("Recover ratio cannot be greater than 1");
+}
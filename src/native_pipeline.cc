@@ -0,0 +1,464 @@
+#include "native_pipeline.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "motion_region.hpp"
+#include "thread_pool.hpp"
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+/**
+ * MultiplyAdd() - Adds values multiplied by weight to sum, as a separate multiply and add like the OpenCL kernels
+ *
+ * sum:       running sums
+ * values:    values to multiply by weight
+ * weight:    weight to multiply by
+ * count:     number of values
+ */
+void MultiplyAdd(float* sum, const float* values, float weight, unsigned int count) {
+  unsigned int i = 0;
+#if defined(__AVX2__)
+  const __m256 weight_8 = _mm256_set1_ps(weight);
+  for (; i + 8 <= count; i += 8) {
+    _mm256_storeu_ps(sum + i, _mm256_add_ps(_mm256_loadu_ps(sum + i), _mm256_mul_ps(_mm256_loadu_ps(values + i), weight_8)));
+  }
+#elif defined(__SSE4_1__)
+  const __m128 weight_4 = _mm_set1_ps(weight);
+  for (; i + 4 <= count; i += 4) {
+    _mm_storeu_ps(sum + i, _mm_add_ps(_mm_loadu_ps(sum + i), _mm_mul_ps(_mm_loadu_ps(values + i), weight_4)));
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  const float32x4_t weight_4 = vdupq_n_f32(weight);
+  for (; i + 4 <= count; i += 4) {
+    vst1q_f32(sum + i, vaddq_f32(vld1q_f32(sum + i), vmulq_f32(vld1q_f32(values + i), weight_4)));
+  }
+#endif
+  for (; i < count; i++) sum[i] += values[i] * weight;
+}
+
+/**
+ * StabilizeAndCompare() - Updates background and movement averages and compares them, same math as stabilize_bg_mvt.cl
+ *
+ * bg_remove:     frame leaving background average
+ * mvt_remove:    frame leaving movement average (and joining background average)
+ * newest:        frame joining movement average
+ * bg_length:     length of background
+ * mvt_length:    length of movement
+ * threshold:     amount pixel needs to be different by to be different
+ * background:    stabilized background
+ * movement:      stabilized movement
+ * difference:    difference frame
+ * count:         number of pixels
+ */
+void StabilizeAndCompare(const unsigned char* bg_remove, const unsigned char* mvt_remove, const unsigned char* newest, float bg_length, float mvt_length, float threshold,
+                         float* background, float* movement, bool* difference, unsigned int count) {
+  unsigned int i = 0;
+#if defined(__AVX2__)
+  const __m256 bg_length_8 = _mm256_set1_ps(bg_length);
+  const __m256 mvt_length_8 = _mm256_set1_ps(mvt_length);
+  const __m256 threshold_8 = _mm256_set1_ps(threshold);
+  const __m256 sign_8 = _mm256_set1_ps(-0.0F);
+  for (; i + 8 <= count; i += 8) {
+    const __m256 bg_out = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(bg_remove + i))));
+    const __m256 mvt_out = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(mvt_remove + i))));
+    const __m256 mvt_in = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(newest + i))));
+    // Calculate the change in average
+    const __m256 bg_change = _mm256_sub_ps(_mm256_div_ps(mvt_out, bg_length_8), _mm256_div_ps(bg_out, bg_length_8));
+    const __m256 mvt_change = _mm256_sub_ps(_mm256_div_ps(mvt_in, mvt_length_8), _mm256_div_ps(mvt_out, mvt_length_8));
+    // Change average
+    const __m256 bg = _mm256_add_ps(_mm256_loadu_ps(background + i), bg_change);
+    const __m256 mvt = _mm256_add_ps(_mm256_loadu_ps(movement + i), mvt_change);
+    _mm256_storeu_ps(background + i, bg);
+    _mm256_storeu_ps(movement + i, mvt);
+    // Check if the difference is above the threshold
+    const int mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_andnot_ps(sign_8, _mm256_sub_ps(bg, mvt)), threshold_8, _CMP_GE_OQ));
+    for (int j = 0; j < 8; j++) difference[i + j] = ((mask >> j) & 1) != 0;
+  }
+#elif defined(__SSE4_1__)
+  const __m128 bg_length_4 = _mm_set1_ps(bg_length);
+  const __m128 mvt_length_4 = _mm_set1_ps(mvt_length);
+  const __m128 threshold_4 = _mm_set1_ps(threshold);
+  const __m128 sign_4 = _mm_set1_ps(-0.0F);
+  for (; i + 4 <= count; i += 4) {
+    int packed[3];
+    std::memcpy(&packed[0], bg_remove + i, 4);
+    std::memcpy(&packed[1], mvt_remove + i, 4);
+    std::memcpy(&packed[2], newest + i, 4);
+    const __m128 bg_out = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed[0])));
+    const __m128 mvt_out = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed[1])));
+    const __m128 mvt_in = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed[2])));
+    // Calculate the change in average
+    const __m128 bg_change = _mm_sub_ps(_mm_div_ps(mvt_out, bg_length_4), _mm_div_ps(bg_out, bg_length_4));
+    const __m128 mvt_change = _mm_sub_ps(_mm_div_ps(mvt_in, mvt_length_4), _mm_div_ps(mvt_out, mvt_length_4));
+    // Change average
+    const __m128 bg = _mm_add_ps(_mm_loadu_ps(background + i), bg_change);
+    const __m128 mvt = _mm_add_ps(_mm_loadu_ps(movement + i), mvt_change);
+    _mm_storeu_ps(background + i, bg);
+    _mm_storeu_ps(movement + i, mvt);
+    // Check if the difference is above the threshold
+    const int mask = _mm_movemask_ps(_mm_cmpge_ps(_mm_andnot_ps(sign_4, _mm_sub_ps(bg, mvt)), threshold_4));
+    for (int j = 0; j < 4; j++) difference[i + j] = ((mask >> j) & 1) != 0;
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  const float32x4_t bg_length_4 = vdupq_n_f32(bg_length);
+  const float32x4_t mvt_length_4 = vdupq_n_f32(mvt_length);
+  const float32x4_t threshold_4 = vdupq_n_f32(threshold);
+  for (; i + 8 <= count; i += 8) {
+    const uint16x8_t bg_out_16 = vmovl_u8(vld1_u8(bg_remove + i));
+    const uint16x8_t mvt_out_16 = vmovl_u8(vld1_u8(mvt_remove + i));
+    const uint16x8_t mvt_in_16 = vmovl_u8(vld1_u8(newest + i));
+    for (int half = 0; half < 2; half++) {
+      const float32x4_t bg_out = vcvtq_f32_u32(vmovl_u16(half == 0 ? vget_low_u16(bg_out_16) : vget_high_u16(bg_out_16)));
+      const float32x4_t mvt_out = vcvtq_f32_u32(vmovl_u16(half == 0 ? vget_low_u16(mvt_out_16) : vget_high_u16(mvt_out_16)));
+      const float32x4_t mvt_in = vcvtq_f32_u32(vmovl_u16(half == 0 ? vget_low_u16(mvt_in_16) : vget_high_u16(mvt_in_16)));
+      const unsigned int loc = i + half * 4;
+      // Calculate the change in average
+      const float32x4_t bg_change = vsubq_f32(vdivq_f32(mvt_out, bg_length_4), vdivq_f32(bg_out, bg_length_4));
+      const float32x4_t mvt_change = vsubq_f32(vdivq_f32(mvt_in, mvt_length_4), vdivq_f32(mvt_out, mvt_length_4));
+      // Change average
+      const float32x4_t bg = vaddq_f32(vld1q_f32(background + loc), bg_change);
+      const float32x4_t mvt = vaddq_f32(vld1q_f32(movement + loc), mvt_change);
+      vst1q_f32(background + loc, bg);
+      vst1q_f32(movement + loc, mvt);
+      // Check if the difference is above the threshold
+      uint32_t mask[4];
+      vst1q_u32(mask, vcgeq_f32(vabsq_f32(vsubq_f32(bg, mvt)), threshold_4));
+      for (int j = 0; j < 4; j++) difference[loc + j] = mask[j] != 0;
+    }
+  }
+#endif
+  for (; i < count; i++) {
+    // Calculate the change in average
+    const float bg_change = (mvt_remove[i] / bg_length) - (bg_remove[i] / bg_length);
+    const float mvt_change = (newest[i] / mvt_length) - (mvt_remove[i] / mvt_length);
+    // Change average
+    background[i] += bg_change;
+    movement[i] += mvt_change;
+    // Check if the difference is above the threshold
+    const float diff = background[i] - movement[i];
+    difference[i] = (diff < 0 ? -diff : diff) >= threshold;
+  }
+}
+
+/**
+ * StabilizeAndCompareSums() - Updates background and movement window sums and compares them, same math as stabilize_bg_mvt.cl with INTEGER_SUMS
+ *
+ * bg_remove:     frame leaving background sum
+ * mvt_remove:    frame leaving movement sum (and joining background sum)
+ * newest:        frame joining movement sum
+ * bg_length:     length of background
+ * mvt_length:    length of movement
+ * threshold:     amount pixel needs to be different by to be different
+ * background:    background sum
+ * movement:      movement sum
+ * difference:    difference frame
+ * count:         number of pixels
+ */
+void StabilizeAndCompareSums(const unsigned char* bg_remove, const unsigned char* mvt_remove, const unsigned char* newest, int32_t bg_length, int32_t mvt_length,
+                             int32_t threshold, uint32_t* background, uint32_t* movement, bool* difference, unsigned int count) {
+  // Comparing the averages multiplied through by both lengths, so nothing is divided
+  const int32_t scaled_threshold = threshold * bg_length * mvt_length;
+  for (unsigned int i = 0; i < count; i++) {
+    background[i] += mvt_remove[i] - bg_remove[i];
+    movement[i] += newest[i] - mvt_remove[i];
+    const int32_t diff = static_cast<int32_t>(background[i]) * mvt_length - static_cast<int32_t>(movement[i]) * bg_length;
+    difference[i] = (diff < 0 ? -diff : diff) >= scaled_threshold;
+  }
+}
+
+/**
+ * StabilizeAndCompareExponential() - Updates background and movement exponential moving averages and compares them,
+ *                                    same math as stabilize_bg_mvt.cl with EXPONENTIAL_AVERAGE
+ *
+ * newest:        frame joining movement average
+ * bg_length:     length of background
+ * mvt_length:    length of movement
+ * threshold:     amount pixel needs to be different by to be different
+ * background:    stabilized background
+ * movement:      stabilized movement
+ * difference:    difference frame
+ * count:         number of pixels
+ */
+void StabilizeAndCompareExponential(const unsigned char* newest, float bg_length, float mvt_length, float threshold, float* background, float* movement,
+                                    bool* difference, unsigned int count) {
+  // Same average age as windows of these lengths
+  const float bg_alpha = 2.0F / (bg_length + 1.0F);
+  const float mvt_alpha = 2.0F / (mvt_length + 1.0F);
+  for (unsigned int i = 0; i < count; i++) {
+    // Background follows movement from before this frame
+    const float previous_movement = movement[i];
+    background[i] += (previous_movement - background[i]) * bg_alpha;
+    movement[i] = previous_movement + (newest[i] - previous_movement) * mvt_alpha;
+    // Check if the difference is above the threshold
+    const float diff = background[i] - movement[i];
+    difference[i] = (diff < 0 ? -diff : diff) >= threshold;
+  }
+}
+
+}  // namespace
+
+NativePipeline::NativePipeline(const std::vector<float>& gaussian, unsigned int scale, unsigned int colors, unsigned int input_width, unsigned int scaled_width,
+                               unsigned int scaled_height, unsigned int bg_length, unsigned int mvt_length, unsigned int pixel_diff_threshold, unsigned int threads,
+                               bool integer_sums, bool exponential_average)
+    : gaussian_(gaussian),
+      scale_(scale),
+      colors_(colors),
+      input_width_(input_width),
+      scaled_width_(scaled_width),
+      scaled_height_(scaled_height),
+      bg_length_(static_cast<float>(bg_length)),
+      mvt_length_(static_cast<float>(mvt_length)),
+      pixel_diff_threshold_(static_cast<float>(pixel_diff_threshold)),
+      integer_sums_(integer_sums),
+      exponential_average_(exponential_average),
+      pool_(threads) {
+  // Frame history holds enough frames to remove the oldest from both the background and movement averages
+  unsigned int history_length = bg_length + mvt_length + 1;
+  // Exponential averages never remove a frame, so only the newest one is kept
+  if (exponential_average_) history_length = 1;
+  history_.assign(history_length, std::vector<unsigned char>(scaled_width_ * scaled_height_, 0));
+  // Start removing frames from the background and movement averages once they have been in them for their full length
+  bg_remove_loc_ = exponential_average_ ? 0 : newest_frame_loc_ + 1;
+  mvt_remove_loc_ = exponential_average_ ? 0 : history_length - mvt_length;
+
+  if (integer_sums_) {
+    background_sum_.assign(scaled_width_ * scaled_height_, 0);
+    movement_sum_.assign(scaled_width_ * scaled_height_, 0);
+  } else {
+    stabilized_background_.assign(scaled_width_ * scaled_height_, 0);
+    stabilized_movement_.assign(scaled_width_ * scaled_height_, 0);
+  }
+  difference_frame_ = std::unique_ptr<bool[]>(new bool[scaled_width_ * scaled_height_]());
+
+  // One band per thread, but never more bands than rows
+  bands_ = std::max(1U, std::min(pool_.GetThreadCount(), scaled_height_));
+  band_counts_.assign(bands_, 0);
+
+  // Horizontal pass reads pixel x * scale + i, which is pixel x + i / scale of the run for offset i % scale
+  phase_length_ = scaled_width_ + (gaussian_.size() - 1) / scale_ + 1;
+  scratch_.resize(bands_);
+  for (int i = 0; i < bands_; i++) {
+    scratch_.at(i).color_totals.assign(input_width_, 0);
+    scratch_.at(i).vertical_sum.assign(input_width_, 0);
+    scratch_.at(i).vertical.assign(input_width_, 0);
+    scratch_.at(i).phases.assign(phase_length_ * scale_, 0);
+    scratch_.at(i).horizontal_sum.assign(scaled_width_, 0);
+  }
+}
+
+const unsigned char* NativePipeline::BlurAndScale(const unsigned char* frame) {
+  // Find location for newest frame in frame history, the frame already there is no longer part of either average
+  newest_frame_loc_ = (newest_frame_loc_ + 1) % history_.size();
+
+  pool_.RunTasks(bands_, [this, frame](unsigned int band) {
+    unsigned int start = 0;
+    unsigned int end = 0;
+    BandRange(band, scaled_height_, &start, &end);
+    BlurAndScaleRows(frame, band, start, end);
+  });
+
+  return history_.at(newest_frame_loc_).data();
+}
+
+const unsigned char* NativePipeline::SetScaledFrame(const unsigned char* scaled) {
+  // Find location for newest frame in frame history, the frame already there is no longer part of either average
+  newest_frame_loc_ = (newest_frame_loc_ + 1) % history_.size();
+  std::memcpy(history_.at(newest_frame_loc_).data(), scaled, history_.at(newest_frame_loc_).size());
+
+  return history_.at(newest_frame_loc_).data();
+}
+
+const bool* NativePipeline::StabilizeAndCompareFrames() {
+  // Determine location of the background and movement frames to remove in frame history
+  bg_remove_loc_ = (bg_remove_loc_ + 1) % history_.size();
+  mvt_remove_loc_ = (mvt_remove_loc_ + 1) % history_.size();
+
+  pool_.RunTasks(bands_, [this](unsigned int band) {
+    unsigned int start = 0;
+    unsigned int end = 0;
+    BandRange(band, scaled_width_ * scaled_height_, &start, &end);
+    StabilizeAndCompareRange(start, end);
+  });
+
+  return difference_frame_.get();
+}
+
+unsigned int NativePipeline::CountDifferences() {
+  pool_.RunTasks(bands_, [this](unsigned int band) {
+    unsigned int start = 0;
+    unsigned int end = 0;
+    BandRange(band, scaled_width_ * scaled_height_, &start, &end);
+    unsigned int changed_pixels = 0;
+    for (unsigned int i = start; i < end; i++) changed_pixels += difference_frame_[i] ? 1 : 0;
+    band_counts_.at(band) = changed_pixels;
+  });
+
+  unsigned int changed_pixels = 0;
+  for (int i = 0; i < band_counts_.size(); i++) changed_pixels += band_counts_.at(i);
+  return changed_pixels;
+}
+
+void NativePipeline::PackDifferenceMask(uint32_t* mask) const {
+  const unsigned int pixels = scaled_width_ * scaled_height_;
+  for (unsigned int word = 0; word * 32 < pixels; word++) {
+    uint32_t bits = 0;
+    for (unsigned int bit = 0; bit < 32 && word * 32 + bit < pixels; bit++) bits |= static_cast<uint32_t>(difference_frame_[word * 32 + bit]) << bit;
+    mask[word] = bits;
+  }
+}
+
+void NativePipeline::SetRoiMask(const std::vector<unsigned char>& mask) {
+  roi_ = mask;
+  roi_rows_.assign(scaled_height_, false);
+  for (unsigned int y = 0; y < scaled_height_; y++) {
+    roi_rows_.at(y) = std::any_of(roi_.begin() + y * scaled_width_, roi_.begin() + (y + 1) * scaled_width_, [](unsigned char watched) { return watched != 0; });
+  }
+}
+
+std::vector<RegionStats> NativePipeline::FindRegions(unsigned int min_pixels) const {
+  const int width = static_cast<int>(scaled_width_);
+  const int pixels = width * static_cast<int>(scaled_height_);
+
+  // Union find where every parent is before its child, the same trees the label_regions kernels build
+  std::vector<int> labels(pixels, -1);
+  auto find_root = [&labels](int loc) {
+    while (labels.at(loc) != loc) loc = labels.at(loc);
+    return loc;
+  };
+  auto join = [&labels, &find_root](int a, int b) {
+    a = find_root(a);
+    b = find_root(b);
+    if (a < b) labels.at(b) = a;
+    if (b < a) labels.at(a) = b;
+  };
+
+  // Join every changed pixel to the changed neighbours before it (8 connected)
+  for (int loc = 0; loc < pixels; loc++) {
+    if (!difference_frame_[loc]) continue;
+    labels.at(loc) = loc;
+    const int x = loc % width;
+    if (x > 0 && labels.at(loc - 1) >= 0) join(loc, loc - 1);
+    if (loc < width) continue;
+    const int up = loc - width;
+    if (x > 0 && labels.at(up - 1) >= 0) join(loc, up - 1);
+    if (labels.at(up) >= 0) join(loc, up);
+    if (x < width - 1 && labels.at(up + 1) >= 0) join(loc, up + 1);
+  }
+
+  // Measure every region, indexed by its root
+  std::vector<RegionStats> regions;
+  std::vector<int> region_of_root(pixels, -1);
+  for (int loc = 0; loc < pixels; loc++) {
+    if (labels.at(loc) < 0) continue;
+    const int root = find_root(loc);
+    if (region_of_root.at(root) < 0) {
+      region_of_root.at(root) = static_cast<int>(regions.size());
+      regions.push_back({0, UINT32_MAX, 0, UINT32_MAX, 0, 0, 0});
+    }
+    RegionStats& region = regions.at(region_of_root.at(root));
+    const unsigned int x = loc % width;
+    const unsigned int y = loc / width;
+    region.pixels++;
+    region.min_x = std::min(region.min_x, x);
+    region.max_x = std::max(region.max_x, x);
+    region.min_y = std::min(region.min_y, y);
+    region.max_y = std::max(region.max_y, y);
+    region.sum_x += x;
+    region.sum_y += y;
+  }
+
+  regions.erase(std::remove_if(regions.begin(), regions.end(), [min_pixels](const RegionStats& region) { return region.pixels < min_pixels; }), regions.end());
+  return regions;
+}
+
+unsigned int NativePipeline::GetThreadCount() const { return pool_.GetThreadCount(); }
+
+void NativePipeline::BlurAndScaleRows(const unsigned char* frame, unsigned int band, unsigned int start_row, unsigned int end_row) {
+  BandScratch& scratch = scratch_.at(band);
+  // Only the columns the horizontal pass reads need to be scaled vertically
+  const unsigned int vertical_width = std::min(input_width_, static_cast<unsigned int>((scaled_width_ - 1) * scale_ + gaussian_.size()));
+  unsigned char* scaled = history_.at(newest_frame_loc_).data();
+
+  for (unsigned int y = start_row; y < end_row; y++) {
+    // Rows outside the region of interest are never compared, so they keep whatever was in the frame history slot
+    if (!roi_rows_.empty() && !roi_rows_[y]) continue;
+    // Vertical pass, one gaussian row at a time so every pixel adds its terms in the same order as blur_and_scale_vertical.cl
+    std::fill(scratch.vertical_sum.begin(), scratch.vertical_sum.begin() + vertical_width, 0.0F);
+    for (int i = 0; i < gaussian_.size(); i++) {
+      const unsigned char* row = frame + static_cast<size_t>(y * scale_ + i) * input_width_ * colors_;
+      // Add up all the colors
+      if (colors_ == 1) {
+        for (unsigned int x = 0; x < vertical_width; x++) scratch.color_totals[x] = row[x];
+      } else {
+        for (unsigned int x = 0; x < vertical_width; x++) {
+          int color_total = 0;
+          for (unsigned int c = 0; c < colors_; c++) color_total += row[x * colors_ + c];
+          scratch.color_totals[x] = static_cast<float>(color_total);
+        }
+      }
+      // Multiply by gaussian
+      MultiplyAdd(scratch.vertical_sum.data(), scratch.color_totals.data(), gaussian_[i], vertical_width);
+    }
+    // Divide by the number of colors to normalize
+    const float colors = static_cast<float>(colors_);
+    for (unsigned int x = 0; x < vertical_width; x++) scratch.vertical[x] = static_cast<unsigned char>(scratch.vertical_sum[x] / colors);
+
+    // Split row into runs of every scale'th pixel so each gaussian term of the horizontal pass reads contiguous memory
+    for (unsigned int offset = 0; offset < scale_; offset++) {
+      float* phase = scratch.phases.data() + offset * phase_length_;
+      for (unsigned int k = 0; k < phase_length_; k++) {
+        const unsigned int x = k * scale_ + offset;
+        phase[k] = x < vertical_width ? scratch.vertical[x] : 0.0F;
+      }
+    }
+
+    // Horizontal pass, again adding terms in the same order as blur_and_scale_horizontal.cl
+    std::fill(scratch.horizontal_sum.begin(), scratch.horizontal_sum.end(), 0.0F);
+    for (int i = 0; i < gaussian_.size(); i++) {
+      const float* phase = scratch.phases.data() + (i % scale_) * phase_length_ + i / scale_;
+      MultiplyAdd(scratch.horizontal_sum.data(), phase, gaussian_[i], scaled_width_);
+    }
+    unsigned char* scaled_row = scaled + static_cast<size_t>(y) * scaled_width_;
+    for (unsigned int x = 0; x < scaled_width_; x++) scaled_row[x] = static_cast<unsigned char>(scratch.horizontal_sum[x]);
+  }
+}
+
+void NativePipeline::StabilizeAndCompareRange(unsigned int start, unsigned int end) {
+  StabilizeAndCompareModel(start, end);
+  // Pixels outside the region of interest never count as changed
+  if (!roi_.empty()) {
+    for (unsigned int i = start; i < end; i++) difference_frame_[i] = difference_frame_[i] && roi_[i] != 0;
+  }
+}
+
+void NativePipeline::StabilizeAndCompareModel(unsigned int start, unsigned int end) {
+  if (integer_sums_) {
+    StabilizeAndCompareSums(history_.at(bg_remove_loc_).data() + start, history_.at(mvt_remove_loc_).data() + start, history_.at(newest_frame_loc_).data() + start,
+                            static_cast<int32_t>(bg_length_), static_cast<int32_t>(mvt_length_), static_cast<int32_t>(pixel_diff_threshold_),
+                            background_sum_.data() + start, movement_sum_.data() + start, difference_frame_.get() + start, end - start);
+    return;
+  }
+  if (exponential_average_) {
+    StabilizeAndCompareExponential(history_.at(newest_frame_loc_).data() + start, bg_length_, mvt_length_, pixel_diff_threshold_, stabilized_background_.data() + start,
+                                   stabilized_movement_.data() + start, difference_frame_.get() + start, end - start);
+    return;
+  }
+  StabilizeAndCompare(history_.at(bg_remove_loc_).data() + start, history_.at(mvt_remove_loc_).data() + start, history_.at(newest_frame_loc_).data() + start, bg_length_,
+                      mvt_length_, pixel_diff_threshold_, stabilized_background_.data() + start, stabilized_movement_.data() + start, difference_frame_.get() + start,
+                      end - start);
+}
+
+void NativePipeline::BandRange(unsigned int band, unsigned int count, unsigned int* start, unsigned int* end) const {
+  *start = static_cast<unsigned int>(static_cast<unsigned long>(count) * band / bands_);
+  *end = static_cast<unsigned int>(static_cast<unsigned long>(count) * (band + 1) / bands_);
+}
@@ -4,6 +4,7 @@
 
 #include <CL/cl2.hpp>
 #include <iostream>
+#include <stdexcept>
 #include <vector>
 
 std::vector<cl::Device> OpenCLInterface::ListDevices(cl_device_type device_type) {
@@ -49,6 +50,9 @@ cl::Device OpenCLInterface::GetDevice(DeviceConfig device_config) {
       device = avaliable_devices.at(device_config.device_choice);
       break;
     }
+    case (DeviceType::kNative): {
+      throw std::invalid_argument("Native device does not use an OpenCL device");
+    }
   }
   return device;
 }
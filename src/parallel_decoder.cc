@@ -0,0 +1,129 @@
+#include "parallel_decoder.hpp"
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "jpeg_decompressor.hpp"
+
+ParallelDecoder::ParallelDecoder(unsigned int width, unsigned int height, DecompFrameFormat frame_format, DecompFrameMethod decomp_method, unsigned int decode_scale,
+                                 bool dc_image, unsigned long frame_size, unsigned int threads, unsigned int queue_depth, FrameSink sink)
+    : dc_image_(dc_image), sink_(std::move(sink)) {
+  if (threads == 0) threads = std::thread::hardware_concurrency();
+  if (threads == 0) threads = 1;
+  // Every thread needs a frame to work on, and one more can be waiting to be delivered
+  if (queue_depth < threads + 1) throw std::invalid_argument("Queue depth must be more than the number of decode threads");
+
+  slots_ = std::vector<Slot>(queue_depth);
+  for (int i = 0; i < slots_.size(); i++) slots_.at(i).frame = std::vector<unsigned char>(frame_size);
+
+  // Create decompressors before any thread starts so a failure leaves nothing to join
+  for (int i = 0; i < threads; i++) {
+    decompressors_.push_back(std::make_unique<JpegDecompressor>(width, height, frame_format, decomp_method, decode_scale));
+  }
+  for (int i = 0; i < decompressors_.size(); i++) {
+    decoders_.emplace_back(&ParallelDecoder::DecodeLoop, this, decompressors_.at(i).get());
+  }
+  deliverer_ = std::thread(&ParallelDecoder::DeliverLoop, this);
+}
+
+ParallelDecoder::~ParallelDecoder() {
+  Finish();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  frame_queued_.notify_all();
+  frame_decoded_.notify_all();
+  for (int i = 0; i < decoders_.size(); i++) decoders_.at(i).join();
+  deliverer_.join();
+}
+
+void ParallelDecoder::Submit(const unsigned char* frame, unsigned long size) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  // Wait for the slot's last frame to be delivered
+  Slot& slot = slots_.at(next_submit_ % slots_.size());
+  slot_freed_.wait(lock, [&slot]() { return slot.state == SlotState::kFree; });
+
+  // Copying into the slot's existing memory only allocates when a frame is bigger than any before it
+  slot.jpeg.assign(frame, frame + size);
+  slot.error = nullptr;
+  slot.state = SlotState::kQueued;
+  next_submit_++;
+  frame_queued_.notify_one();
+}
+
+void ParallelDecoder::Finish() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  slot_freed_.wait(lock, [this]() { return next_deliver_ == next_submit_; });
+}
+
+void ParallelDecoder::SetDecodeWindow(unsigned int x, unsigned int y, unsigned int width, unsigned int height) {
+  // Decode threads only touch their decompressor while they hold a frame, so wait until none do
+  Finish();
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (int i = 0; i < decompressors_.size(); i++) decompressors_.at(i)->SetDecodeWindow(x, y, width, height);
+}
+
+unsigned int ParallelDecoder::GetThreadCount() const { return decoders_.size(); }
+
+void ParallelDecoder::DecodeLoop(JpegDecompressor* decompressor) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    // Wait for a frame to decompress, frames are taken in the order they were submitted
+    frame_queued_.wait(lock, [this]() { return stopping_ || next_decode_ < next_submit_; });
+    if (stopping_) return;
+    Slot& slot = slots_.at(next_decode_ % slots_.size());
+    next_decode_++;
+    slot.state = SlotState::kDecoding;
+
+    // Decompress without holding the lock so other threads can work on other frames
+    lock.unlock();
+    try {
+      if (dc_image_) {
+        decompressor->DecompressDCImage(slot.jpeg.data(), slot.jpeg.size(), slot.frame.data(), slot.frame.size());
+      } else {
+        decompressor->DecompressImage(slot.jpeg.data(), slot.jpeg.size(), slot.frame.data(), slot.frame.size());
+      }
+    } catch (...) {
+      slot.error = std::current_exception();
+    }
+    lock.lock();
+
+    slot.state = SlotState::kDecoded;
+    frame_decoded_.notify_one();
+  }
+}
+
+void ParallelDecoder::DeliverLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    // Wait for the next frame in order, frames decompressed ahead of it stay in their slots
+    Slot& slot = slots_.at(next_deliver_ % slots_.size());
+    frame_decoded_.wait(lock, [this, &slot]() { return stopping_ || (next_deliver_ < next_submit_ && slot.state == SlotState::kDecoded); });
+    if (stopping_) return;
+
+    // Run sink without holding the lock so decode threads can keep going
+    lock.unlock();
+    try {
+      if (slot.error != nullptr) {
+        sink_(nullptr, slot.error);
+      } else {
+        sink_(slot.frame.data(), nullptr);
+      }
+    } catch (...) {
+      // Sink has nowhere to report to, dropping the exception keeps later frames flowing
+    }
+    lock.lock();
+
+    slot.state = SlotState::kFree;
+    next_deliver_++;
+    slot_freed_.notify_all();
+  }
+}
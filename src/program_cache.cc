@@ -0,0 +1,199 @@
+#include "program_cache.hpp"
+
+#include <CL/opencl.h>
+
+#include <CL/cl2.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#define CACHE_ENTRY_MAGIC "MJPGCLB1"  // First bytes of every cache entry (bump when the entry layout changes)
+#define CACHE_ENTRY_MAGIC_SIZE 8
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+namespace {
+/**
+ * Hash() - 64 bit FNV-1a hash of bytes
+ *
+ * data:      bytes to hash
+ * size:      number of bytes
+ * returns:   uint64_t - hash of bytes
+ */
+uint64_t Hash(const unsigned char* data, size_t size) {
+  uint64_t hash = FNV_OFFSET_BASIS;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= data[i];
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+/**
+ * Hash() - 64 bit FNV-1a hash of a string
+ *
+ * text:      string to hash
+ * returns:   uint64_t - hash of string
+ */
+uint64_t Hash(const std::string& text) { return Hash(reinterpret_cast<const unsigned char*>(text.data()), text.size()); }
+
+/**
+ * ToHex() - Formats a hash as 16 hex digits
+ *
+ * hash:      hash to format
+ * returns:   std::string - hash in hex
+ */
+std::string ToHex(uint64_t hash) {
+  std::ostringstream hex;
+  hex << std::hex << std::setw(16) << std::setfill('0') << hash;  // NOLINT(readability-magic-numbers) 16 hex digits in 64 bits
+  return hex.str();
+}
+
+/**
+ * ReadValue() - Reads a 64 bit value from a cache entry
+ *
+ * ifs:       cache entry
+ * value:     set to value read
+ * returns:   bool - if the value could be read
+ */
+bool ReadValue(std::ifstream& ifs, uint64_t* value) {
+  ifs.read(reinterpret_cast<char*>(value), sizeof(uint64_t));
+  return ifs.good();
+}
+
+/**
+ * ReadEntry() - Reads the program binary from a cache entry, checking it is complete and belongs to identity
+ *
+ * path:      cache entry
+ * identity:  identity of program binary wanted
+ * binary:    set to program binary
+ * returns:   bool - if the entry is valid
+ */
+bool ReadEntry(const std::filesystem::path& path, const std::string& identity, std::vector<unsigned char>* binary) {
+  std::ifstream ifs(path, std::ios::binary);
+  if (!ifs.good()) return false;
+  std::error_code fs_error;
+  const uintmax_t file_size = std::filesystem::file_size(path, fs_error);
+  if (fs_error) return false;
+
+  // Layout: magic, identity size, identity, binary size, binary hash, binary
+  char magic[CACHE_ENTRY_MAGIC_SIZE];
+  ifs.read(magic, CACHE_ENTRY_MAGIC_SIZE);
+  if (!ifs.good() || std::string(magic, CACHE_ENTRY_MAGIC_SIZE) != CACHE_ENTRY_MAGIC) return false;
+
+  uint64_t identity_size = 0;
+  if (!ReadValue(ifs, &identity_size) || identity_size != identity.size()) return false;
+  std::string stored_identity(identity_size, '\0');
+  ifs.read(stored_identity.data(), static_cast<std::streamsize>(identity_size));
+  if (!ifs.good() || stored_identity != identity) return false;
+
+  // Sizes are checked against the file before allocating, so a corrupt size can not ask for a huge buffer
+  uint64_t binary_size = 0;
+  uint64_t binary_hash = 0;
+  if (!ReadValue(ifs, &binary_size) || !ReadValue(ifs, &binary_hash)) return false;
+  if (binary_size == 0 || static_cast<uintmax_t>(ifs.tellg()) + binary_size != file_size) return false;
+  binary->resize(binary_size);
+  ifs.read(reinterpret_cast<char*>(binary->data()), static_cast<std::streamsize>(binary_size));
+  if (!ifs.good()) return false;
+  return Hash(binary->data(), binary->size()) == binary_hash;
+}
+}  // namespace
+
+ProgramCache::ProgramCache(std::string directory) : directory_(std::move(directory)) {}
+
+bool ProgramCache::Find(const cl::Context& context, const cl::Device& device, const std::string& source, const std::string& options, cl::Program* program) const {
+  const std::string identity = Identity(device, source, options);
+  const std::filesystem::path path = GetEntryPath(device, source, options);
+  std::error_code fs_error;
+  if (!std::filesystem::exists(path, fs_error)) return false;
+
+  // Delete bad entries so the program built from source can take their place
+  std::vector<unsigned char> binary;
+  if (!ReadEntry(path, identity, &binary)) {
+    std::filesystem::remove(path, fs_error);
+    return false;
+  }
+
+  // Driver can still reject a binary (for example one written by a different build of the same driver version)
+  std::vector<cl_int> binary_status;
+  int error = CL_SUCCESS;
+  cl::Program cached = cl::Program(context, {device}, {binary}, &binary_status, &error);
+  if (error != CL_SUCCESS || binary_status.empty() || binary_status.at(0) != CL_SUCCESS) {
+    std::filesystem::remove(path, fs_error);
+    return false;
+  }
+  error = cached.build({device}, options.c_str());
+  if (error != CL_SUCCESS) {
+    std::filesystem::remove(path, fs_error);
+    return false;
+  }
+
+  *program = cached;
+  return true;
+}
+
+bool ProgramCache::Store(const cl::Device& device, const std::string& source, const std::string& options, const cl::Program& program) const {
+  int error = CL_SUCCESS;
+  std::vector<std::vector<unsigned char>> binaries = program.getInfo<CL_PROGRAM_BINARIES>(&error);
+  if (error != CL_SUCCESS || binaries.size() != 1 || binaries.at(0).empty()) return false;
+  const std::vector<unsigned char>& binary = binaries.at(0);
+
+  std::error_code fs_error;
+  std::filesystem::create_directories(directory_, fs_error);
+  if (fs_error) return false;
+
+  // Write to a file no one else is using, then rename it into place so readers never see a partly written entry
+  const std::string identity = Identity(device, source, options);
+  const std::filesystem::path path = GetEntryPath(device, source, options);
+  std::filesystem::path temp_path = path;
+  temp_path += ".tmp" + std::to_string(std::random_device()());
+  {
+    std::ofstream ofs(temp_path, std::ios::binary | std::ios::trunc);
+    const uint64_t identity_size = identity.size();
+    const uint64_t binary_size = binary.size();
+    const uint64_t binary_hash = Hash(binary.data(), binary.size());
+    ofs.write(CACHE_ENTRY_MAGIC, CACHE_ENTRY_MAGIC_SIZE);
+    ofs.write(reinterpret_cast<const char*>(&identity_size), sizeof(uint64_t));
+    ofs.write(identity.data(), static_cast<std::streamsize>(identity.size()));
+    ofs.write(reinterpret_cast<const char*>(&binary_size), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(&binary_hash), sizeof(uint64_t));
+    ofs.write(reinterpret_cast<const char*>(binary.data()), static_cast<std::streamsize>(binary.size()));
+    ofs.flush();
+    if (!ofs.good()) {
+      ofs.close();
+      std::filesystem::remove(temp_path, fs_error);
+      return false;
+    }
+  }
+  std::filesystem::rename(temp_path, path, fs_error);
+  if (fs_error) {
+    std::filesystem::remove(temp_path, fs_error);
+    return false;
+  }
+  return true;
+}
+
+std::string ProgramCache::GetEntryPath(const cl::Device& device, const std::string& source, const std::string& options) const {
+  return (std::filesystem::path(directory_) / (ToHex(Hash(Identity(device, source, options))) + ".bin")).string();
+}
+
+std::string ProgramCache::Identity(const cl::Device& device, const std::string& source, const std::string& options) {
+  std::string identity;
+  identity.append(device.getInfo<CL_DEVICE_NAME>());
+  identity.append("\n");
+  identity.append(device.getInfo<CL_DEVICE_VERSION>());
+  identity.append("\n");
+  identity.append(device.getInfo<CL_DRIVER_VERSION>());
+  identity.append("\n");
+  identity.append(options);
+  identity.append("\n");
+  identity.append(ToHex(Hash(source)));
+  return identity;
+}
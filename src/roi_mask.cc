@@ -0,0 +1,50 @@
+#include "roi_mask.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#define PIXEL_CENTER 0.5F  // Distance from the corner of a pixel to its center
+
+RoiMask::RoiMask(unsigned int width, unsigned int height, bool watched) : width_(width), height_(height), mask_(width * height, watched ? 1 : 0) {
+  if (width == 0 || height == 0) throw std::invalid_argument("ROI mask width and height cannot be 0");
+}
+
+RoiMask::RoiMask(unsigned int width, unsigned int height, const unsigned char* bitmap) : RoiMask(width, height, false) {
+  for (unsigned int i = 0; i < width * height; i++) mask_.at(i) = bitmap[i] != 0 ? 1 : 0;
+}
+
+void RoiMask::AddPolygon(const std::vector<RoiPoint>& polygon, bool watched) {
+  if (polygon.size() < 3) throw std::invalid_argument("ROI polygon needs at least 3 points");
+  if (IsEmpty()) throw std::logic_error("Polygons can only be added to a ROI mask with a size");
+
+  // Fill between pairs of edge crossings along the center of every row
+  std::vector<float> crossings;
+  for (unsigned int y = 0; y < height_; y++) {
+    const float center_y = static_cast<float>(y) + PIXEL_CENTER;
+    crossings.clear();
+    for (size_t i = 0; i < polygon.size(); i++) {
+      const RoiPoint& a = polygon.at(i);
+      const RoiPoint& b = polygon.at((i + 1) % polygon.size());
+      // Half open on y so a corner on the row is only crossed once
+      if ((a.y <= center_y) != (b.y <= center_y)) crossings.push_back(a.x + (center_y - a.y) * (b.x - a.x) / (b.y - a.y));
+    }
+    std::sort(crossings.begin(), crossings.end());
+
+    // Pixels whose centers are from one crossing up to the next
+    for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+      const int start = std::max(0, static_cast<int>(std::ceil(crossings.at(i) - PIXEL_CENTER)));
+      const int end = std::min(static_cast<int>(width_), static_cast<int>(std::ceil(crossings.at(i + 1) - PIXEL_CENTER)));
+      for (int x = start; x < end; x++) mask_.at(y * width_ + x) = watched ? 1 : 0;
+    }
+  }
+}
+
+bool RoiMask::IsEmpty() const { return mask_.empty(); }
+
+bool RoiMask::IsWatched(unsigned int x, unsigned int y) const { return IsEmpty() || mask_.at(y * width_ + x) != 0; }
+
+unsigned int RoiMask::GetWidth() const { return width_; }
+
+unsigned int RoiMask::GetHeight() const { return height_; }
@@ -0,0 +1,80 @@
+#include "thread_pool.hpp"
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+ThreadPool::ThreadPool(unsigned int threads) {
+  if (threads == 0) threads = std::thread::hardware_concurrency();
+  if (threads == 0) threads = 1;
+
+  // Calling thread also runs tasks, so it needs one less worker
+  for (int i = 0; i < threads - 1; i++) {
+    workers_.emplace_back(&ThreadPool::WorkerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_ready_.notify_all();
+  for (int i = 0; i < workers_.size(); i++) workers_.at(i).join();
+}
+
+void ThreadPool::RunTasks(unsigned int tasks, const std::function<void(unsigned int)>& task) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  // Start batch
+  task_ = &task;
+  task_count_ = tasks;
+  next_task_ = 0;
+  tasks_done_ = 0;
+  error_ = nullptr;
+  batch_++;
+  work_ready_.notify_all();
+
+  // Help out, then wait for tasks still running on workers
+  RunAvailableTasks(lock);
+  work_done_.wait(lock, [this] { return tasks_done_ == task_count_; });
+  task_ = nullptr;
+
+  if (error_) std::rethrow_exception(error_);
+}
+
+unsigned int ThreadPool::GetThreadCount() const { return workers_.size() + 1; }
+
+void ThreadPool::WorkerLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  unsigned long last_batch = batch_;
+  while (true) {
+    work_ready_.wait(lock, [this, last_batch] { return stopping_ || batch_ != last_batch; });
+    if (stopping_) return;
+    last_batch = batch_;
+    RunAvailableTasks(lock);
+  }
+}
+
+void ThreadPool::RunAvailableTasks(std::unique_lock<std::mutex>& lock) {
+  while (task_ != nullptr && next_task_ < task_count_) {
+    unsigned int index = next_task_++;
+    const std::function<void(unsigned int)>* task = task_;
+
+    // Run task without holding lock
+    lock.unlock();
+    std::exception_ptr error = nullptr;
+    try {
+      (*task)(index);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    lock.lock();
+
+    if (error && !error_) error_ = error;
+    tasks_done_++;
+    if (tasks_done_ == task_count_) work_done_.notify_all();
+  }
+}
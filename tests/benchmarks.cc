@@ -2,9 +2,17 @@
 #include <catch2/catch_all.hpp>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <ostream>
+#include <utility>
+#include <vector>
 
+#include "device_runtime.hpp"
 #include "motion_detector.hpp"
+#include "motion_detector_batch.hpp"
+#include "motion_detector_cascade.hpp"
+#include "motion_detector_governor.hpp"
+#include "parallel_decoder.hpp"
 
 const int kDevice = 0;  // OpenCL device to run tests on
 
@@ -17,7 +25,7 @@ struct Configs {
 
 // NOLINTBEGIN(readability-*)
 std::vector<std::pair<unsigned int, unsigned int>> resolutions = {{640, 480}, {1280, 720}, {1920, 1080}};
-std::vector<DecompFrameFormat> frame_formats = {DecompFrameFormat::kRGB};
+std::vector<DecompFrameFormat> frame_formats = {DecompFrameFormat::kRGB, DecompFrameFormat::kGray};
 std::vector<DecompFrameMethod> decomp_methods = {DecompFrameMethod::kAccurate};
 std::vector<unsigned int> gaussian_sizes = {0, 1, 2};
 std::vector<unsigned int> scale_denominators = {10, 5, 1};
@@ -103,7 +111,176 @@ TEST_CASE("Benchmark Motion Detection") {
     // NOLINTEND(readability-magic-numbers)
 
     BENCHMARK(std::string(name)) { return motion.DetectOnFrame(jpeg_frame.data, jpeg_frame.filesize); };
+    // Sustained throughput when decompression overlaps device work (waits on uploads once all input slots are in use)
+    BENCHMARK(std::string(name) + "Async") { return motion.DetectOnFrameAsync(jpeg_frame.data, jpeg_frame.filesize); };
+
+    // Decompression split across decode threads (waits once the decode queue is full)
+    MotionConfig threaded_config = configs.at(i).motion;
+    threaded_config.decode_threads = 4;
+    MotionDetector threaded = MotionDetector(configs.at(i).video, threaded_config, {DeviceType::kSpecific, kDevice}, empty_output);
+    BENCHMARK(std::string(name) + "Async 4 Decode Threads") { return threaded.DetectOnFrameAsync(jpeg_frame.data, jpeg_frame.filesize); };
+
+    // Blur and scale staged in local memory
+    MotionConfig tiled_config = configs.at(i).motion;
+    tiled_config.processing_mode = ProcessingMode::kTiled;
+    MotionDetector tiled = MotionDetector(configs.at(i).video, tiled_config, {DeviceType::kSpecific, kDevice}, empty_output);
+    BENCHMARK(std::string(name) + "Tiled") { return tiled.DetectOnFrame(jpeg_frame.data, jpeg_frame.filesize); };
+
+    // Configuration read from argument buffers instead of compiled into the kernels
+    MotionConfig buffer_config = configs.at(i).motion;
+    buffer_config.specialize_kernels = false;
+    MotionDetector buffers = MotionDetector(configs.at(i).video, buffer_config, {DeviceType::kSpecific, kDevice}, empty_output);
+    BENCHMARK(std::string(name) + "Argument Buffers") { return buffers.DetectOnFrame(jpeg_frame.data, jpeg_frame.filesize); };
+
+    // Integer window sums instead of float averages
+    MotionConfig sums_config = configs.at(i).motion;
+    sums_config.integer_sums = true;
+    MotionDetector sums = MotionDetector(configs.at(i).video, sums_config, {DeviceType::kSpecific, kDevice}, empty_output);
+    BENCHMARK(std::string(name) + "Integer Sums") { return sums.DetectOnFrame(jpeg_frame.data, jpeg_frame.filesize); };
+
+    // Difference frame packed 32 pixels to a word and counted with popcount
+    MotionConfig packed_config = configs.at(i).motion;
+    packed_config.packed_mask = true;
+    MotionDetector packed = MotionDetector(configs.at(i).video, packed_config, {DeviceType::kSpecific, kDevice}, empty_output);
+    BENCHMARK(std::string(name) + "Packed Mask") { return packed.DetectOnFrame(jpeg_frame.data, jpeg_frame.filesize); };
+
+    // Exponential moving averages with no frame history
+    MotionConfig exponential_config = configs.at(i).motion;
+    exponential_config.background_model = BackgroundModel::kExponential;
+    MotionDetector exponential = MotionDetector(configs.at(i).video, exponential_config, {DeviceType::kSpecific, kDevice}, empty_output);
+    BENCHMARK(std::string(name) + "Exponential Background") { return exponential.DetectOnFrame(jpeg_frame.data, jpeg_frame.filesize); };
+
+    // Labeling and measuring motion regions, the first frame differs from the blank background everywhere it is not black
+    MotionConfig region_config = configs.at(i).motion;
+    region_config.max_regions = 16;
+    MotionDetector regions = MotionDetector(configs.at(i).video, region_config, {DeviceType::kSpecific, kDevice}, empty_output);
+    regions.DetectOnFrame(jpeg_frame.data, jpeg_frame.filesize);
+    BENCHMARK(std::string(name) + "Motion Regions") { return regions.FindMotionRegions().size(); };
+
+    // Only the lower half of the frame watched, so only its tiles are launched
+    MotionConfig roi_config = configs.at(i).motion;
+    roi_config.roi = RoiMask(configs.at(i).video.width, configs.at(i).video.height, false);
+    const float half_height = static_cast<float>(configs.at(i).video.height) / 2;
+    const float full_width = static_cast<float>(configs.at(i).video.width);
+    roi_config.roi.AddPolygon({{0, half_height}, {full_width, half_height}, {full_width, half_height * 2}, {0, half_height * 2}}, true);
+    MotionDetector roi = MotionDetector(configs.at(i).video, roi_config, {DeviceType::kSpecific, kDevice}, empty_output);
+    BENCHMARK(std::string(name) + "Region Of Interest") { return roi.DetectOnFrame(jpeg_frame.data, jpeg_frame.filesize); };
+
+    // Same frames on the CPU without OpenCL
+    MotionDetector native = MotionDetector(configs.at(i).video, configs.at(i).motion, {DeviceType::kNative, 0}, empty_output);
+    BENCHMARK(std::string(name) + "Native") { return native.DetectOnFrame(jpeg_frame.data, jpeg_frame.filesize); };
+
+    // Block averages straight from the DC coefficients
+    MotionConfig dc_config = configs.at(i).motion;
+    dc_config.processing_mode = ProcessingMode::kDCBlocks;
+    MotionDetector dc = MotionDetector(configs.at(i).video, dc_config, {DeviceType::kSpecific, kDevice}, empty_output);
+    BENCHMARK(std::string(name) + "DC Blocks") { return dc.DetectOnFrame(jpeg_frame.data, jpeg_frame.filesize); };
+
+    // Scale down while decompressing when the scale allows it
+    if (JpegDecompressor::LargestDecodeScale(configs.at(i).motion.scale_denominator) > 1) {
+      MotionConfig dct_config = configs.at(i).motion;
+      dct_config.dct_scaling = true;
+      MotionDetector dct = MotionDetector(configs.at(i).video, dct_config, {DeviceType::kSpecific, kDevice}, empty_output);
+      BENCHMARK(std::string(name) + "DCT Scaled") { return dct.DetectOnFrame(jpeg_frame.data, jpeg_frame.filesize); };
+    }
+
+    // Still frames after the first only run the coarse model, plus every warm_interval'th frame on the full one
+    if (configs.at(i).motion.scale_denominator < CascadeConfig().coarse_scale_denominator) {
+      MotionDetectorCascade cascade = MotionDetectorCascade(configs.at(i).video, configs.at(i).motion, CascadeConfig(), {DeviceType::kSpecific, kDevice}, empty_output);
+      BENCHMARK(std::string(name) + "Cascade") { return cascade.DetectOnFrame(jpeg_frame.data, jpeg_frame.filesize); };
+    }
+
+    // Skips frames once processing takes longer than a 30 fps frame interval
+    MotionDetectorGovernor governor = MotionDetectorGovernor(configs.at(i).video, configs.at(i).motion, GovernorConfig(), {DeviceType::kSpecific, kDevice}, empty_output);
+    BENCHMARK(std::string(name) + "Governor") { return governor.DetectOnFrame(jpeg_frame.data, jpeg_frame.filesize); };
+
+    delete[] jpeg_frame.data;
+  }
+}
+
+TEST_CASE("Benchmark Parallel Decode") {
+  std::vector<std::string> jpg_names = {"../test-images/640x480-test-image.jpg", "../test-images/1280x720-test-image.jpg", "../test-images/1920x1080-test-image.jpg"};
+  for (int i = 0; i < resolutions.size(); i++) {
+    std::string name = std::to_string(resolutions.at(i).first) + "x" + std::to_string(resolutions.at(i).second) + " (RGB) Decode";
+    JpegFile jpeg_frame = ReadJpeg(jpg_names.at(i));
+
+    // Single TurboJPEG handle on the calling thread
+    JpegDecompressor decompressor = JpegDecompressor(resolutions.at(i).first, resolutions.at(i).second, DecompFrameFormat::kRGB, DecompFrameMethod::kAccurate);
+    std::vector<unsigned char> frame(decompressor.GetDecompressedSize());
+    BENCHMARK(name + " 1 Thread") { decompressor.DecompressImage(jpeg_frame.data, jpeg_frame.filesize, frame.data(), frame.size()); };
+
+    // Strip an eighth of the frame tall across the middle, like a doorway camera watching one band
+    JpegDecompressor window_decompressor = JpegDecompressor(resolutions.at(i).first, resolutions.at(i).second, DecompFrameFormat::kRGB, DecompFrameMethod::kAccurate);
+    window_decompressor.SetDecodeWindow(0, resolutions.at(i).second / 2, resolutions.at(i).first, resolutions.at(i).second / 8);
+    BENCHMARK(name + " Window") { window_decompressor.DecompressImage(jpeg_frame.data, jpeg_frame.filesize, frame.data(), frame.size()); };
+
+    // Sustained throughput with a handle per thread (waits once the queue is full)
+    std::vector<unsigned int> threads = {2, 4};
+    for (int j = 0; j < threads.size(); j++) {
+      ParallelDecoder decoder = ParallelDecoder(resolutions.at(i).first, resolutions.at(i).second, DecompFrameFormat::kRGB, DecompFrameMethod::kAccurate, 1, false,
+                                                decompressor.GetDecompressedSize(), threads.at(j), threads.at(j) * 2 + 1,
+                                                [](const unsigned char* frame, std::exception_ptr error) {});
+      BENCHMARK(name + " " + std::to_string(threads.at(j)) + " Threads") { decoder.Submit(jpeg_frame.data, jpeg_frame.filesize); };
+    }
+
+    // One frame split between restart markers across threads (lowers latency of a single frame)
+    if (resolutions.at(i).first == 1920) {
+      JpegFile restart_frame = ReadJpeg("../test-images/1920x1080-test-image-restart.jpg");
+      JpegDecompressor strip_decompressor =
+          JpegDecompressor(resolutions.at(i).first, resolutions.at(i).second, DecompFrameFormat::kRGB, DecompFrameMethod::kAccurate, 1, 4);
+      BENCHMARK(name + " Restart Markers 1 Thread") { decompressor.DecompressImage(restart_frame.data, restart_frame.filesize, frame.data(), frame.size()); };
+      BENCHMARK(name + " Restart Markers 4 Strips") { strip_decompressor.DecompressImage(restart_frame.data, restart_frame.filesize, frame.data(), frame.size()); };
+      delete[] restart_frame.data;
+    }
 
     delete[] jpeg_frame.data;
   }
+}
+
+TEST_CASE("Benchmark Detector Startup") {
+  InputVideoSettings video = {1920, 1080, DecompFrameFormat::kGray};
+  MotionConfig motion = {1, 5, 10, 2, 1, 0.1, DecompFrameMethod::kAccurate};
+
+  // Context, queues and programs created for every detector
+  BENCHMARK("1920x1080 (Grayscale) Startup") { return MotionDetector(video, motion, {DeviceType::kSpecific, kDevice}, empty_output).GetDecodeScale(); };
+
+  // Detectors after the first reuse the runtime's context, queues and programs
+  std::shared_ptr<DeviceRuntime> runtime = std::make_shared<DeviceRuntime>(DeviceConfig{DeviceType::kSpecific, kDevice}, empty_output);
+  BENCHMARK("1920x1080 (Grayscale) Startup Shared Runtime") { return MotionDetector(video, motion, runtime, empty_output).GetDecodeScale(); };
+}
+
+TEST_CASE("Benchmark Batched Detection") {
+  // NOLINTBEGIN(readability-magic-numbers)
+  InputVideoSettings video = {640, 480, DecompFrameFormat::kGray};
+  MotionConfig motion = {1, 5, 10, 2, 1, 0.1, DecompFrameMethod::kAccurate};
+  JpegFile jpeg_frame = ReadJpeg("../test-images/640x480-test-image.jpg");
+  std::shared_ptr<DeviceRuntime> runtime = std::make_shared<DeviceRuntime>(DeviceConfig{DeviceType::kSpecific, kDevice}, empty_output);
+
+  std::vector<unsigned int> stream_counts = {4, 16};
+  for (int i = 0; i < stream_counts.size(); i++) {
+    const std::string name = "640x480 (Grayscale) " + std::to_string(stream_counts.at(i)) + " Streams";
+
+    // Launches, syncs and readbacks for every stream
+    std::vector<std::unique_ptr<MotionDetector>> detectors;
+    for (int j = 0; j < stream_counts.at(i); j++) detectors.push_back(std::make_unique<MotionDetector>(video, motion, runtime, empty_output));
+    BENCHMARK(name + " Separate Detectors") {
+      unsigned int motion_count = 0;
+      for (int j = 0; j < detectors.size(); j++) motion_count += detectors.at(j)->DetectOnFrame(jpeg_frame.data, jpeg_frame.filesize) ? 1 : 0;
+      return motion_count;
+    };
+
+    // One launch per step and one readback for every stream
+    MotionDetectorBatch batch = MotionDetectorBatch(video, motion, stream_counts.at(i), runtime, empty_output);
+    std::vector<std::pair<const unsigned char*, unsigned long>> frames(stream_counts.at(i), {jpeg_frame.data, jpeg_frame.filesize});
+    BENCHMARK(name + " Batch") { return batch.DetectOnFrames(frames); };
+
+    // Decompressing the batch in parallel
+    MotionConfig threaded_config = motion;
+    threaded_config.decode_threads = 4;
+    MotionDetectorBatch threaded = MotionDetectorBatch(video, threaded_config, stream_counts.at(i), runtime, empty_output);
+    BENCHMARK(name + " Batch 4 Decode Threads") { return threaded.DetectOnFrames(frames); };
+  }
+
+  delete[] jpeg_frame.data;
+  // NOLINTEND(readability-magic-numbers)
 }
\ No newline at end of file
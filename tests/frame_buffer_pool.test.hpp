@@ -0,0 +1,74 @@
+// NOLINTBEGIN(readability-*)
+#include <catch2/catch_all.hpp>
+#include <thread>
+#include <vector>
+
+#include "frame_buffer_pool.hpp"
+
+TEST_CASE("Frame Buffer Pool") {
+  SECTION("Reuses Buffers Of The Same Size") {
+    FrameBufferPool pool = FrameBufferPool();
+    unsigned char* first_data;
+    {
+      FrameBufferPool::Buffer first = pool.Acquire(640 * 480);
+      REQUIRE(first.GetSize() == 640 * 480);
+      first_data = first.GetData();
+      first_data[0] = 42;
+    }
+    REQUIRE(pool.GetFreeBuffers() == 1);
+
+    // Same size gets the same memory back, a different size does not
+    FrameBufferPool::Buffer other_size = pool.Acquire(320 * 240);
+    REQUIRE(other_size.GetData() != first_data);
+    FrameBufferPool::Buffer same_size = pool.Acquire(640 * 480);
+    REQUIRE(same_size.GetData() == first_data);
+    REQUIRE(pool.GetFreeBuffers() == 0);
+  }
+
+  SECTION("Moves Ownership Between Buffers") {
+    FrameBufferPool pool = FrameBufferPool();
+    FrameBufferPool::Buffer moved;
+    REQUIRE(moved.GetData() == nullptr);
+    {
+      FrameBufferPool::Buffer original = pool.Acquire(64);
+      unsigned char* data = original.GetData();
+      moved = std::move(original);
+      REQUIRE(moved.GetData() == data);
+      REQUIRE(original.GetData() == nullptr);
+    }
+    // Moved from buffer has nothing to return
+    REQUIRE(pool.GetFreeBuffers() == 0);
+  }
+
+  SECTION("Keeps A Limited Number Of Free Buffers") {
+    FrameBufferPool pool = FrameBufferPool(2);
+    {
+      std::vector<FrameBufferPool::Buffer> buffers;
+      for (int i = 0; i < 4; i++) buffers.push_back(pool.Acquire(64));
+    }
+    REQUIRE(pool.GetFreeBuffers() == 2);
+  }
+
+  SECTION("Shared Between Threads") {
+    FrameBufferPool& pool = FrameBufferPool::Shared();
+    std::vector<std::thread> threads;
+    std::vector<int> mismatches = std::vector<int>(4, 0);  // Catch assertions are not thread safe, so threads only count
+    for (int i = 0; i < 4; i++) {
+      threads.emplace_back([&pool, &mismatches, i]() {
+        for (int j = 0; j < 100; j++) {
+          // No other thread should be writing into a borrowed buffer
+          FrameBufferPool::Buffer buffer = pool.Acquire(1024);
+          for (int k = 0; k < 1024; k++) buffer.GetData()[k] = static_cast<unsigned char>(i);
+          std::this_thread::yield();
+          for (int k = 0; k < 1024; k++) {
+            if (buffer.GetData()[k] != static_cast<unsigned char>(i)) mismatches.at(i)++;
+          }
+        }
+      });
+    }
+    for (int i = 0; i < threads.size(); i++) threads.at(i).join();
+    for (int i = 0; i < mismatches.size(); i++) REQUIRE(mismatches.at(i) == 0);
+    REQUIRE(pool.GetFreeBuffers() >= 1);
+  }
+}
+// NOLINTEND(readability-*)
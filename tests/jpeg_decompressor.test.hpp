@@ -166,4 +166,289 @@ TEST_CASE("Decode RGB JPEG") {
     REQUIRE(CompareDecodedRGB(ppm, decompressed));
   }
 }
+TEST_CASE("Decode Into Destination") {
+  JpegFile jpeg = ReadJpeg("../test-images/640x480-test-image.jpg");
+  JpegDecompressor decompressor = JpegDecompressor(640, 480, DecompFrameFormat::kRGB, DecompFrameMethod::kAccurate);
+  unsigned char* allocated = decompressor.DecompressImage(jpeg.data, jpeg.filesize);
+
+  // Decompressing into a caller's buffer should give the same image as decompressing into a new one
+  unsigned char* destination = new unsigned char[decompressor.GetDecompressedSize()];
+  decompressor.DecompressImage(jpeg.data, jpeg.filesize, destination, decompressor.GetDecompressedSize());
+  for (int i = 0; i < 640 * 480 * 3; i++) REQUIRE(destination[i] == allocated[i]);
+
+  // Destination too small to hold image
+  REQUIRE_THROWS(decompressor.DecompressImage(jpeg.data, jpeg.filesize, destination, decompressor.GetDecompressedSize() - 1));
+  REQUIRE_THROWS(decompressor.DecompressDCImage(jpeg.data, jpeg.filesize, destination, decompressor.GetDCSize() - 1));
+
+  delete[] allocated;
+  delete[] destination;
+  delete[] jpeg.data;
+}
+TEST_CASE("Decode Strips Between Restart Markers") {
+  // Same image losslessly re-encoded with a restart marker after every MCU row
+  JpegFile jpeg = ReadJpeg("../test-images/1920x1080-test-image.jpg");
+  JpegFile restart_jpeg = ReadJpeg("../test-images/1920x1080-test-image-restart.jpg");
+
+  SECTION("To Grayscale") {
+    std::vector<unsigned int> decode_scales = {1, 2, 8};
+    std::vector<unsigned int> strip_threads = {2, 3, 4, 7};
+    for (int i = 0; i < decode_scales.size(); i++) {
+      JpegDecompressor decompressor = JpegDecompressor(1920, 1080, DecompFrameFormat::kGray, DecompFrameMethod::kAccurate, decode_scales.at(i));
+      unsigned char* expected = decompressor.DecompressImage(jpeg.data, jpeg.filesize);
+      unsigned int pixels = decompressor.GetDecompressedWidth() * decompressor.GetDecompressedHeight();
+
+      for (int j = 0; j < strip_threads.size(); j++) {
+        JpegDecompressor strip_decompressor =
+            JpegDecompressor(1920, 1080, DecompFrameFormat::kGray, DecompFrameMethod::kAccurate, decode_scales.at(i), strip_threads.at(j));
+
+        // Luma does not depend on neighbouring rows, so strips should match exactly
+        unsigned char* strips = strip_decompressor.DecompressImage(restart_jpeg.data, restart_jpeg.filesize);
+        for (int k = 0; k < pixels; k++) REQUIRE(strips[k] == expected[k]);
+        delete[] strips;
+
+        // No restart markers, so decompressed on one thread
+        unsigned char* fallback = strip_decompressor.DecompressImage(jpeg.data, jpeg.filesize);
+        for (int k = 0; k < pixels; k++) REQUIRE(fallback[k] == expected[k]);
+        delete[] fallback;
+      }
+      delete[] expected;
+    }
+  }
+
+  SECTION("To RGB") {
+    JpegDecompressor decompressor = JpegDecompressor(1920, 1080, DecompFrameFormat::kRGB, DecompFrameMethod::kAccurate);
+    JpegDecompressor strip_decompressor = JpegDecompressor(1920, 1080, DecompFrameFormat::kRGB, DecompFrameMethod::kAccurate, 1, 4);
+    unsigned char* expected = decompressor.DecompressImage(jpeg.data, jpeg.filesize);
+    unsigned char* strips = strip_decompressor.DecompressImage(restart_jpeg.data, restart_jpeg.filesize);
+
+    // Only chroma next to the 3 splits can differ
+    int different = 0;
+    for (int i = 0; i < 1920 * 1080 * 3; i++) {
+      if (strips[i] != expected[i]) different++;
+    }
+    REQUIRE(different < 1920 * 3 * 4 * 3);
+
+    delete[] expected;
+    delete[] strips;
+  }
+
+  SECTION("With Truncated Or Corrupted Frames") {
+    JpegDecompressor strip_decompressor = JpegDecompressor(1920, 1080, DecompFrameFormat::kGray, DecompFrameMethod::kAccurate, 1, 2);
+    unsigned char* destination = new unsigned char[strip_decompressor.GetDecompressedSize()];
+
+    // Frames are copied into buffers of exactly their size, so reading past one is caught by sanitizers
+    auto decompress = [&](const std::vector<unsigned char>& frame) {
+      try {
+        strip_decompressor.DecompressImage(frame.data(), frame.size(), destination, strip_decompressor.GetDecompressedSize());
+      } catch (const std::exception&) {
+        // Rejecting the frame is fine, reading past it is not
+      }
+    };
+
+    // Walk header segments to find start of frame, define restart interval and start of scan
+    unsigned long sof = 0;
+    unsigned long dri = 0;
+    unsigned long sos = 0;
+    for (unsigned long i = 2; i + 4 <= restart_jpeg.filesize && sos == 0; i += 2 + (restart_jpeg.data[i + 2] << 8 | restart_jpeg.data[i + 3])) {
+      if (restart_jpeg.data[i + 1] == 0xC0) sof = i;
+      if (restart_jpeg.data[i + 1] == 0xDD) dri = i;
+      if (restart_jpeg.data[i + 1] == 0xDA) sos = i;
+    }
+    REQUIRE(sof != 0);
+    REQUIRE(dri != 0);
+    REQUIRE(sos != 0);
+
+    // Cut off inside every header segment and inside the entropy coded data
+    for (unsigned long size = 4; size < sos + 16; size++) decompress(std::vector<unsigned char>(restart_jpeg.data, restart_jpeg.data + size));
+    decompress(std::vector<unsigned char>(restart_jpeg.data, restart_jpeg.data + restart_jpeg.filesize / 2));
+
+    // Start of frame claiming more components than its segment holds
+    std::vector<unsigned char> frame(restart_jpeg.data, restart_jpeg.data + restart_jpeg.filesize);
+    frame.at(sof + 9) = 255;
+    decompress(frame);
+
+    // Start of frame and define restart interval segments too short for their fields
+    frame.assign(restart_jpeg.data, restart_jpeg.data + restart_jpeg.filesize);
+    frame.at(sof + 2) = 0;
+    frame.at(sof + 3) = 4;
+    decompress(frame);
+    frame.assign(restart_jpeg.data, restart_jpeg.data + restart_jpeg.filesize);
+    frame.at(dri + 2) = 0;
+    frame.at(dri + 3) = 2;
+    decompress(frame);
+
+    // Decompressor still works on a good frame afterwards
+    unsigned char* expected = JpegDecompressor(1920, 1080, DecompFrameFormat::kGray, DecompFrameMethod::kAccurate).DecompressImage(jpeg.data, jpeg.filesize);
+    strip_decompressor.DecompressImage(restart_jpeg.data, restart_jpeg.filesize, destination, strip_decompressor.GetDecompressedSize());
+    for (int i = 0; i < 1920 * 1080; i++) REQUIRE(destination[i] == expected[i]);
+
+    delete[] expected;
+    delete[] destination;
+  }
+
+  delete[] jpeg.data;
+  delete[] restart_jpeg.data;
+}
+TEST_CASE("Decode Luma Only") {
+  JpegFile jpeg = ReadJpeg("../test-images/640x480-test-image.jpg");
+
+  unsigned char* rgb = JpegDecompressor(640, 480, DecompFrameFormat::kRGB, DecompFrameMethod::kAccurate).DecompressImage(jpeg.data, jpeg.filesize);
+  unsigned char* gray = JpegDecompressor(640, 480, DecompFrameFormat::kGray, DecompFrameMethod::kAccurate).DecompressImage(jpeg.data, jpeg.filesize);
+
+  // Grayscale frame should be the luma of the RGB frame
+  double total_error = 0;
+  for (int i = 0; i < 640 * 480; i++) {
+    double luma = 0.299 * rgb[i * 3] + 0.587 * rgb[i * 3 + 1] + 0.114 * rgb[i * 3 + 2];
+    total_error += std::abs(luma - gray[i]);
+  }
+  REQUIRE(total_error / (640 * 480) < JPEG_ALLOWABLE_ERROR);
+
+  delete[] rgb;
+  delete[] gray;
+  delete[] jpeg.data;
+}
+
+TEST_CASE("Decode DC Coefficients") {
+  JpegFile jpeg = ReadJpeg("../test-images/640x480-test-image.jpg");
+
+  JpegDecompressor decompressor = JpegDecompressor(640, 480, DecompFrameFormat::kGray, DecompFrameMethod::kAccurate);
+  REQUIRE(decompressor.GetDCWidth() == 80);
+  REQUIRE(decompressor.GetDCHeight() == 60);
+
+  unsigned char* full = decompressor.DecompressImage(jpeg.data, jpeg.filesize);
+  unsigned char* dc = decompressor.DecompressDCImage(jpeg.data, jpeg.filesize);
+
+  // DC image should be the average of every 8x8 block of the full image
+  double total_error = 0;
+  for (unsigned int y = 0; y < 60; y++) {
+    for (unsigned int x = 0; x < 80; x++) {
+      double average = 0;
+      for (unsigned int j = 0; j < 8; j++) {
+        for (unsigned int k = 0; k < 8; k++) average += full[(y * 8 + j) * 640 + x * 8 + k];
+      }
+      total_error += std::abs(average / 64 - dc[y * 80 + x]);
+    }
+  }
+  REQUIRE(total_error / (80 * 60) < 1.0);
+
+  // Truncated image should throw instead of exiting
+  REQUIRE_THROWS(decompressor.DecompressDCImage(jpeg.data, 100));
+
+  delete[] full;
+  delete[] dc;
+  delete[] jpeg.data;
+}
+
+TEST_CASE("Decode With IDCT Scaling") {
+  JpegFile jpeg = ReadJpeg("../test-images/640x480-test-image.jpg");
+
+  SECTION("Picks Largest Decode Scale") {
+    REQUIRE(JpegDecompressor::LargestDecodeScale(1) == 1);
+    REQUIRE(JpegDecompressor::LargestDecodeScale(3) == 1);
+    REQUIRE(JpegDecompressor::LargestDecodeScale(6) == 2);
+    REQUIRE(JpegDecompressor::LargestDecodeScale(12) == 4);
+    REQUIRE(JpegDecompressor::LargestDecodeScale(16) == 8);
+  }
+
+  SECTION("Decodes At Reduced Size") {
+    unsigned char* full = JpegDecompressor(640, 480, DecompFrameFormat::kGray, DecompFrameMethod::kAccurate).DecompressImage(jpeg.data, jpeg.filesize);
+
+    std::vector<unsigned int> decode_scales = {2, 4, 8};
+    for (int i = 0; i < decode_scales.size(); i++) {
+      unsigned int scale = decode_scales.at(i);
+      JpegDecompressor decompressor = JpegDecompressor(640, 480, DecompFrameFormat::kGray, DecompFrameMethod::kAccurate, scale);
+      REQUIRE(decompressor.GetDecompressedWidth() == 640 / scale);
+      REQUIRE(decompressor.GetDecompressedHeight() == 480 / scale);
+      REQUIRE(decompressor.GetDecompressedSize() == (640 / scale + 1) * (480 / scale + 1));
+
+      // Scaled pixels should be close to the average of the full size pixels they cover
+      unsigned char* scaled = decompressor.DecompressImage(jpeg.data, jpeg.filesize);
+      double total_error = 0;
+      for (unsigned int y = 0; y < 480 / scale; y++) {
+        for (unsigned int x = 0; x < 640 / scale; x++) {
+          double average = 0;
+          for (unsigned int j = 0; j < scale; j++) {
+            for (unsigned int k = 0; k < scale; k++) average += full[(y * scale + j) * 640 + x * scale + k];
+          }
+          average /= scale * scale;
+          total_error += std::abs(average - scaled[y * (640 / scale) + x]);
+        }
+      }
+      REQUIRE(total_error / ((640 / scale) * (480 / scale)) < JPEG_ALLOWABLE_ERROR);
+      delete[] scaled;
+    }
+    delete[] full;
+  }
+
+  SECTION("With Unsupported Decode Scale") { REQUIRE_THROWS(JpegDecompressor(640, 480, DecompFrameFormat::kGray, DecompFrameMethod::kAccurate, 3)); }
+
+  delete[] jpeg.data;
+}
+
+TEST_CASE("Decode Window") {
+  JpegFile jpeg = ReadJpeg("../test-images/640x480-test-image.jpg");
+
+  SECTION("To Grayscale") {
+    std::vector<unsigned int> decode_scales = {1, 2};
+    for (int i = 0; i < decode_scales.size(); i++) {
+      const unsigned int scale = decode_scales.at(i);
+      const unsigned int width = 640 / scale;
+      JpegDecompressor decompressor = JpegDecompressor(640, 480, DecompFrameFormat::kGray, DecompFrameMethod::kAccurate, scale);
+      unsigned char* expected = decompressor.DecompressImage(jpeg.data, jpeg.filesize);
+
+      // Window starts partway through an MCU column and row
+      const unsigned int x = 100 / scale;
+      const unsigned int y = 130 / scale;
+      const unsigned int w = 200 / scale;
+      const unsigned int h = 90 / scale;
+      decompressor.SetDecodeWindow(x, y, w, h);
+      std::vector<unsigned char> window(decompressor.GetDecompressedSize(), 77);
+      decompressor.DecompressImage(jpeg.data, jpeg.filesize, window.data(), window.size());
+
+      // Luma does not depend on neighbouring blocks, so the window should match exactly
+      for (unsigned int row = y; row < y + h; row++) {
+        for (unsigned int col = x; col < x + w; col++) REQUIRE(window.at(row * width + col) == expected[row * width + col]);
+      }
+      // Rows above and below and columns left of the window are never written
+      int untouched = 0;
+      for (unsigned int col = 0; col < width; col++) {
+        if (window.at(col) == 77 && window.at((y + h + 16) * width + col) == 77) untouched++;
+      }
+      REQUIRE(untouched == width);
+      for (unsigned int row = y; row < y + h; row++) REQUIRE(window.at(row * width) == 77);
+
+      // Empty window decompresses whole images again
+      decompressor.SetDecodeWindow(0, 0, 0, 0);
+      decompressor.DecompressImage(jpeg.data, jpeg.filesize, window.data(), window.size());
+      for (unsigned int j = 0; j < width * (480 / scale); j++) REQUIRE(window.at(j) == expected[j]);
+      delete[] expected;
+    }
+  }
+
+  SECTION("To RGB") {
+    JpegDecompressor decompressor = JpegDecompressor(640, 480, DecompFrameFormat::kRGB, DecompFrameMethod::kAccurate);
+    unsigned char* expected = decompressor.DecompressImage(jpeg.data, jpeg.filesize);
+    decompressor.SetDecodeWindow(100, 130, 200, 90);
+    unsigned char* window = decompressor.DecompressImage(jpeg.data, jpeg.filesize);
+
+    // Only chroma at the edges of the window can differ
+    double total_error = 0;
+    for (unsigned int row = 130; row < 220; row++) {
+      for (unsigned int col = 100 * 3; col < 300 * 3; col++) total_error += std::abs(window[row * 640 * 3 + col] - expected[row * 640 * 3 + col]);
+    }
+    REQUIRE(total_error / (200 * 90 * 3) < JPEG_ALLOWABLE_ERROR);
+
+    delete[] expected;
+    delete[] window;
+  }
+
+  SECTION("With Invalid Window") {
+    JpegDecompressor decompressor = JpegDecompressor(640, 480, DecompFrameFormat::kGray, DecompFrameMethod::kAccurate, 2);
+    REQUIRE_THROWS_AS(decompressor.SetDecodeWindow(300, 0, 40, 10), std::invalid_argument);
+    REQUIRE_THROWS_AS(decompressor.SetDecodeWindow(0, 200, 10, 40), std::invalid_argument);
+    REQUIRE_THROWS_AS(decompressor.SetDecodeWindow(0, 0, 10, 0), std::invalid_argument);
+  }
+
+  delete[] jpeg.data;
+}
 // NOLINTEND(misc-definitions-in-headers)
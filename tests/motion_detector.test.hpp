@@ -1,8 +1,15 @@
 // NOLINTBEGIN(readability-*)
+#include <algorithm>
+#include <bitset>
 #include <catch2/catch_all.hpp>
 #include <cmath>
+#include <future>
 #include <limits>
+#include <memory>
 #include <ostream>
+#include <stdexcept>
+#include <turbojpeg.h>
+#include <vector>
 
 #define private public  // To test steps of motion detection
 #include "motion_detector.hpp"
@@ -12,6 +19,49 @@ const int kErrorMarginAllowed = 3;  // How different pixel values are allowed to
 
 std::ostream* empty_output = new std::ostream(0);
 
+/**
+ * BlurAndScaleStep() - Runs the blur and scale step on the OpenCL or native device and reads back the scaled frame
+ *
+ * motion_detector:   detector to run step on
+ * frame:             decompressed frame
+ * size:              number of bytes to read back (0 past the scaled frame)
+ * returns:           std::vector<unsigned char> - scaled frame
+ */
+std::vector<unsigned char> BlurAndScaleStep(MotionDetector& motion_detector, const unsigned char* frame, unsigned int size = 0) {
+  std::vector<unsigned char> pixels(size, 0);
+  const unsigned int scaled = std::min(size, motion_detector.scaled_width_ * motion_detector.scaled_height_);
+  if (motion_detector.native_) {
+    const unsigned char* native_pixels = motion_detector.native_->BlurAndScale(frame);
+    std::copy(native_pixels, native_pixels + scaled, pixels.begin());
+  } else {
+    cl::Buffer& blurred = motion_detector.BlurAndScale(frame);
+    if (scaled > 0) motion_detector.cmd_queue_.enqueueReadBuffer(blurred, CL_TRUE, 0, scaled * sizeof(unsigned char), static_cast<void*>(pixels.data()));
+  }
+  return pixels;
+}
+
+/**
+ * StabilizeAndCompareStep() - Runs the stabilize and compare step on the OpenCL or native device and reads back the difference frame
+ *
+ * motion_detector:   detector to run step on
+ * size:              number of pixels to read back (false past the scaled frame)
+ * returns:           std::vector<bool> - difference frame
+ */
+std::vector<bool> StabilizeAndCompareStep(MotionDetector& motion_detector, unsigned int size = 0) {
+  std::vector<bool> differences(size, false);
+  const unsigned int scaled = std::min(size, motion_detector.scaled_width_ * motion_detector.scaled_height_);
+  if (motion_detector.native_) {
+    const bool* native_differences = motion_detector.native_->StabilizeAndCompareFrames();
+    std::copy(native_differences, native_differences + scaled, differences.begin());
+  } else {
+    cl::Buffer& difference_frame = motion_detector.StabilizeAndCompareFrames();
+    std::vector<unsigned char> read(std::max(scaled, 1U));
+    if (scaled > 0) motion_detector.cmd_queue_.enqueueReadBuffer(difference_frame, CL_TRUE, 0, scaled * sizeof(bool), static_cast<void*>(read.data()));
+    for (unsigned int i = 0; i < scaled; i++) differences[i] = read.at(i) != 0;
+  }
+  return differences;
+}
+
 TEST_CASE("Construct Detector") {
   SECTION("With Valid Input") {
     InputVideoSettings input_vid_set_sol = {640, 480, DecompFrameFormat::kRGB};
@@ -81,6 +131,9 @@ TEST_CASE("Construct Detector") {
 }
 
 TEST_CASE("Blur and Scale Step On RGB Frames") {
+  // Every step should give the same results on the OpenCL and native devices
+  DeviceConfig device_config_sol = GENERATE(DeviceConfig{DeviceType::kSpecific, kDevice}, DeviceConfig{DeviceType::kNative, 0});
+
   // Smaller image
   PpmFile ppm0 = ReadPpm("../test-images/3x3-color-pixels-rgb.ppm");
   unsigned char* data0 = new unsigned char[32];  // Little bit extra for aligned memory access for raspi compatability
@@ -97,14 +150,10 @@ TEST_CASE("Blur and Scale Step On RGB Frames") {
   SECTION("With No Blur") {
     InputVideoSettings input_vid_set_sol = {3, 3, DecompFrameFormat::kRGB};
     MotionConfig motion_config_sol = {0, 1, 10, 2, 0, 0.0};
-    DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
     MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
 
-    cl::Buffer blurred = motion_detector.BlurAndScale(data0);
-
-    unsigned char* pixels = new unsigned char[16];
-    motion_detector.cmd_queue_.enqueueReadBuffer(blurred, CL_TRUE, 0, 16 * sizeof(unsigned char), static_cast<void*>(pixels));
+    std::vector<unsigned char> pixels = BlurAndScaleStep(motion_detector, data0, 16);
 
     REQUIRE(abs(static_cast<int>(pixels[0]) - 255) < kErrorMarginAllowed);
     REQUIRE(abs(static_cast<int>(pixels[1]) - 170) < kErrorMarginAllowed);
@@ -115,64 +164,44 @@ TEST_CASE("Blur and Scale Step On RGB Frames") {
     REQUIRE(abs(static_cast<int>(pixels[6]) - 85) < kErrorMarginAllowed);
     REQUIRE(abs(static_cast<int>(pixels[7]) - 0) < kErrorMarginAllowed);
     REQUIRE(abs(static_cast<int>(pixels[8]) - 255) < kErrorMarginAllowed);
-    delete[] pixels;
   }
 
   SECTION("With 3x3 Blur") {
     InputVideoSettings input_vid_set_sol = {3, 3, DecompFrameFormat::kRGB};
     MotionConfig motion_config_sol = {1, 1, 10, 2, 0, 0.0};
-    DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
     MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
-    cl::Buffer blurred = motion_detector.BlurAndScale(data0);
-
-    unsigned char* pixels = new unsigned char[8];
-    motion_detector.cmd_queue_.enqueueReadBuffer(blurred, CL_TRUE, 0, 8 * sizeof(unsigned char), static_cast<void*>(pixels));
+    std::vector<unsigned char> pixels = BlurAndScaleStep(motion_detector, data0, 8);
 
     REQUIRE(abs(static_cast<int>(pixels[0]) - 127) < kErrorMarginAllowed);
-    delete[] pixels;
   }
 
   SECTION("With 1/2x Scale") {
     InputVideoSettings input_vid_set_sol = {3, 3, DecompFrameFormat::kRGB};
     MotionConfig motion_config_sol = {0, 2, 10, 2, 0, 0.0};
-    DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
     MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
-    cl::Buffer blurred = motion_detector.BlurAndScale(data0);
-
-    unsigned char* pixels = new unsigned char[8];
-    motion_detector.cmd_queue_.enqueueReadBuffer(blurred, CL_TRUE, 0, 8 * sizeof(unsigned char), static_cast<void*>(pixels));
+    std::vector<unsigned char> pixels = BlurAndScaleStep(motion_detector, data0, 8);
 
     REQUIRE(abs(static_cast<int>(pixels[0]) - 170) < kErrorMarginAllowed);
-    delete[] pixels;
   }
 
   SECTION("With 1/3x Scale") {
     InputVideoSettings input_vid_set_sol = {3, 3, DecompFrameFormat::kRGB};
     MotionConfig motion_config_sol = {0, 3, 10, 2, 0, 0.0};
-    DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
     MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
-    cl::Buffer blurred = motion_detector.BlurAndScale(data0);
-
-    unsigned char* pixels = new unsigned char[8];
-    motion_detector.cmd_queue_.enqueueReadBuffer(blurred, CL_TRUE, 0, 8 * sizeof(unsigned char), static_cast<void*>(pixels));
+    std::vector<unsigned char> pixels = BlurAndScaleStep(motion_detector, data0, 8);
 
     REQUIRE(abs(static_cast<int>(pixels[0]) - 142) < kErrorMarginAllowed);
-    delete[] pixels;
   }
 
   SECTION("With 1/2x Scale On Larger Image") {
     InputVideoSettings input_vid_set_sol = {9, 9, DecompFrameFormat::kRGB};
     MotionConfig motion_config_sol = {0, 2, 10, 2, 0, 0.0};
-    DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
     MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
-    cl::Buffer blurred = motion_detector.BlurAndScale(data1);
-
-    unsigned char* pixels = new unsigned char[16];
-    motion_detector.cmd_queue_.enqueueReadBuffer(blurred, CL_TRUE, 0, 16 * sizeof(unsigned char), static_cast<void*>(pixels));
+    std::vector<unsigned char> pixels = BlurAndScaleStep(motion_detector, data1, 16);
 
     REQUIRE(abs(static_cast<int>(pixels[0]) - 170) < kErrorMarginAllowed);
     REQUIRE(abs(static_cast<int>(pixels[1]) - 170) < kErrorMarginAllowed);
@@ -190,19 +219,14 @@ TEST_CASE("Blur and Scale Step On RGB Frames") {
     REQUIRE(abs(static_cast<int>(pixels[13]) - 170) < kErrorMarginAllowed);
     REQUIRE(abs(static_cast<int>(pixels[14]) - 127) < kErrorMarginAllowed);
     REQUIRE(abs(static_cast<int>(pixels[15]) - 170) < kErrorMarginAllowed);
-    delete[] pixels;
   }
 
   SECTION("With 1/3x Scale On Larger Image") {
     InputVideoSettings input_vid_set_sol = {9, 9, DecompFrameFormat::kRGB};
     MotionConfig motion_config_sol = {0, 3, 10, 2, 0, 0.0};
-    DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
     MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
-    cl::Buffer blurred = motion_detector.BlurAndScale(data1);
-
-    unsigned char* pixels = new unsigned char[16];
-    motion_detector.cmd_queue_.enqueueReadBuffer(blurred, CL_TRUE, 0, 16 * sizeof(unsigned char), static_cast<void*>(pixels));
+    std::vector<unsigned char> pixels = BlurAndScaleStep(motion_detector, data1, 16);
 
     REQUIRE(abs(static_cast<int>(pixels[0]) - 142) < kErrorMarginAllowed);
     REQUIRE(abs(static_cast<int>(pixels[1]) - 142) < kErrorMarginAllowed);
@@ -213,52 +237,37 @@ TEST_CASE("Blur and Scale Step On RGB Frames") {
     REQUIRE(abs(static_cast<int>(pixels[6]) - 142) < kErrorMarginAllowed);
     REQUIRE(abs(static_cast<int>(pixels[7]) - 142) < kErrorMarginAllowed);
     REQUIRE(abs(static_cast<int>(pixels[8]) - 142) < kErrorMarginAllowed);
-    delete[] pixels;
   }
 
   SECTION("With 1/2x Scale and 3x3 Blur On Larger Image") {
     InputVideoSettings input_vid_set_sol = {9, 9, DecompFrameFormat::kRGB};
     MotionConfig motion_config_sol = {1, 2, 10, 2, 0, 0.0};
-    DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
     MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
-    cl::Buffer blurred = motion_detector.BlurAndScale(data1);
-
-    unsigned char* pixels = new unsigned char[8];
-    motion_detector.cmd_queue_.enqueueReadBuffer(blurred, CL_TRUE, 0, 8 * sizeof(unsigned char), static_cast<void*>(pixels));
+    std::vector<unsigned char> pixels = BlurAndScaleStep(motion_detector, data1, 8);
 
     REQUIRE(abs(static_cast<int>(pixels[0]) - 150) < kErrorMarginAllowed);
     REQUIRE(abs(static_cast<int>(pixels[1]) - 142) < kErrorMarginAllowed);
     REQUIRE(abs(static_cast<int>(pixels[2]) - 142) < kErrorMarginAllowed);
     REQUIRE(abs(static_cast<int>(pixels[3]) - 134) < kErrorMarginAllowed);
-    delete[] pixels;
   }
 
   SECTION("With 1/3x Scale and 3x3 Blur On Larger Image") {
     InputVideoSettings input_vid_set_sol = {9, 9, DecompFrameFormat::kRGB};
     MotionConfig motion_config_sol = {1, 3, 10, 2, 0, 0.0};
-    DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
     MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
-    cl::Buffer blurred = motion_detector.BlurAndScale(data1);
-
-    unsigned char* pixels = new unsigned char[8];
-    motion_detector.cmd_queue_.enqueueReadBuffer(blurred, CL_TRUE, 0, 8 * sizeof(unsigned char), static_cast<void*>(pixels));
+    std::vector<unsigned char> pixels = BlurAndScaleStep(motion_detector, data1, 8);
 
     REQUIRE(abs(static_cast<int>(pixels[0]) - 142) < kErrorMarginAllowed);
-    delete[] pixels;
   }
 
   SECTION("With No Scale and 3x3 Blur On Larger Image") {
     InputVideoSettings input_vid_set_sol = {9, 9, DecompFrameFormat::kRGB};
     MotionConfig motion_config_sol = {1, 1, 10, 2, 0, 0.0};
-    DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
     MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
-    cl::Buffer blurred = motion_detector.BlurAndScale(data1);
-
-    unsigned char* pixels = new unsigned char[56];
-    motion_detector.cmd_queue_.enqueueReadBuffer(blurred, CL_TRUE, 0, 56 * sizeof(unsigned char), static_cast<void*>(pixels));
+    std::vector<unsigned char> pixels = BlurAndScaleStep(motion_detector, data1, 56);
 
     std::vector<int> expected = {127, 139, 142, 127, 139, 142, 127, 124, 144, 139, 124, 144, 139, 124, 142, 154, 157, 142, 154, 157, 142, 127, 139, 142, 127,
                                  139, 142, 127, 124, 144, 139, 124, 144, 139, 124, 142, 154, 157, 142, 154, 157, 142, 127, 139, 142, 127, 139, 142, 127};
@@ -266,7 +275,6 @@ TEST_CASE("Blur and Scale Step On RGB Frames") {
       REQUIRE(abs(static_cast<int>(pixels[i]) - expected.at(i)) < kErrorMarginAllowed);
     }
 
-    delete[] pixels;
   }
 
   delete[] data0;
@@ -274,6 +282,9 @@ TEST_CASE("Blur and Scale Step On RGB Frames") {
 }
 
 TEST_CASE("Blur and Scale Step On Grayscale Frames") {
+  // Every step should give the same results on the OpenCL and native devices
+  DeviceConfig device_config_sol = GENERATE(DeviceConfig{DeviceType::kSpecific, kDevice}, DeviceConfig{DeviceType::kNative, 0});
+
   // Smaller image
   PpmFile ppm0 = ReadPpm("../test-images/3x3-color-pixels-grayscale.ppm");
   unsigned char* data0 = new unsigned char[16];
@@ -290,14 +301,10 @@ TEST_CASE("Blur and Scale Step On Grayscale Frames") {
   SECTION("With No Blur") {
     InputVideoSettings input_vid_set_sol = {3, 3, DecompFrameFormat::kGray};
     MotionConfig motion_config_sol = {0, 1, 10, 2, 0, 0.0, DecompFrameMethod::kAccurate};
-    DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
     MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
 
-    cl::Buffer blurred = motion_detector.BlurAndScale(data0);
-
-    unsigned char* pixels = new unsigned char[16];
-    motion_detector.cmd_queue_.enqueueReadBuffer(blurred, CL_TRUE, 0, 16 * sizeof(unsigned char), static_cast<void*>(pixels));
+    std::vector<unsigned char> pixels = BlurAndScaleStep(motion_detector, data0, 16);
 
     REQUIRE(abs(static_cast<int>(pixels[0]) - 255) < kErrorMarginAllowed);
     REQUIRE(abs(static_cast<int>(pixels[1]) - 227) < kErrorMarginAllowed);
@@ -308,64 +315,44 @@ TEST_CASE("Blur and Scale Step On Grayscale Frames") {
     REQUIRE(abs(static_cast<int>(pixels[6]) - 28) < kErrorMarginAllowed);
     REQUIRE(abs(static_cast<int>(pixels[7]) - 0) < kErrorMarginAllowed);
     REQUIRE(abs(static_cast<int>(pixels[8]) - 255) < kErrorMarginAllowed);
-    delete[] pixels;
   }
 
   SECTION("With 3x3 Blur") {
     InputVideoSettings input_vid_set_sol = {3, 3, DecompFrameFormat::kGray};
     MotionConfig motion_config_sol = {1, 1, 10, 2, 0, 0.0, DecompFrameMethod::kAccurate};
-    DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
     MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
-    cl::Buffer blurred = motion_detector.BlurAndScale(data0);
-
-    unsigned char* pixels = new unsigned char[8];
-    motion_detector.cmd_queue_.enqueueReadBuffer(blurred, CL_TRUE, 0, 8 * sizeof(unsigned char), static_cast<void*>(pixels));
+    std::vector<unsigned char> pixels = BlurAndScaleStep(motion_detector, data0, 8);
 
     REQUIRE(abs(static_cast<int>(pixels[0]) - 133) < kErrorMarginAllowed);
-    delete[] pixels;
   }
 
   SECTION("With 1/2x Scale") {
     InputVideoSettings input_vid_set_sol = {3, 3, DecompFrameFormat::kGray};
     MotionConfig motion_config_sol = {0, 2, 10, 2, 0, 0.0};
-    DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
     MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
-    cl::Buffer blurred = motion_detector.BlurAndScale(data0);
-
-    unsigned char* pixels = new unsigned char[8];
-    motion_detector.cmd_queue_.enqueueReadBuffer(blurred, CL_TRUE, 0, 8 * sizeof(unsigned char), static_cast<void*>(pixels));
+    std::vector<unsigned char> pixels = BlurAndScaleStep(motion_detector, data0, 8);
 
     REQUIRE(abs(static_cast<int>(pixels[0]) - 185) < kErrorMarginAllowed);
-    delete[] pixels;
   }
 
   SECTION("With 1/3x Scale") {
     InputVideoSettings input_vid_set_sol = {3, 3, DecompFrameFormat::kGray};
     MotionConfig motion_config_sol = {0, 3, 10, 2, 0, 0.0, DecompFrameMethod::kAccurate};
-    DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
     MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
-    cl::Buffer blurred = motion_detector.BlurAndScale(data0);
-
-    unsigned char* pixels = new unsigned char[8];
-    motion_detector.cmd_queue_.enqueueReadBuffer(blurred, CL_TRUE, 0, 8 * sizeof(unsigned char), static_cast<void*>(pixels));
+    std::vector<unsigned char> pixels = BlurAndScaleStep(motion_detector, data0, 8);
 
     REQUIRE(abs(static_cast<int>(pixels[0]) - 142) < kErrorMarginAllowed);
-    delete[] pixels;
   }
 
   SECTION("With 1/2x Scale On Larger Image") {
     InputVideoSettings input_vid_set_sol = {9, 9, DecompFrameFormat::kGray};
     MotionConfig motion_config_sol = {0, 2, 10, 2, 0, 0.0, DecompFrameMethod::kAccurate};
-    DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
     MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
-    cl::Buffer blurred = motion_detector.BlurAndScale(data1);
-
-    unsigned char* pixels = new unsigned char[16];
-    motion_detector.cmd_queue_.enqueueReadBuffer(blurred, CL_TRUE, 0, 16 * sizeof(unsigned char), static_cast<void*>(pixels));
+    std::vector<unsigned char> pixels = BlurAndScaleStep(motion_detector, data1, 16);
 
     REQUIRE(abs(static_cast<int>(pixels[0]) - 185) < kErrorMarginAllowed);
     REQUIRE(abs(static_cast<int>(pixels[1]) - 172) < kErrorMarginAllowed);
@@ -383,19 +370,14 @@ TEST_CASE("Blur and Scale Step On Grayscale Frames") {
     REQUIRE(abs(static_cast<int>(pixels[13]) - 172) < kErrorMarginAllowed);
     REQUIRE(abs(static_cast<int>(pixels[14]) - 140) < kErrorMarginAllowed);
     REQUIRE(abs(static_cast<int>(pixels[15]) - 185) < kErrorMarginAllowed);
-    delete[] pixels;
   }
 
   SECTION("With 1/3x Scale On Larger Image") {
     InputVideoSettings input_vid_set_sol = {9, 9, DecompFrameFormat::kGray};
     MotionConfig motion_config_sol = {0, 3, 10, 2, 0, 0.0, DecompFrameMethod::kAccurate};
-    DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
     MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
-    cl::Buffer blurred = motion_detector.BlurAndScale(data1);
-
-    unsigned char* pixels = new unsigned char[16];
-    motion_detector.cmd_queue_.enqueueReadBuffer(blurred, CL_TRUE, 0, 16 * sizeof(unsigned char), static_cast<void*>(pixels));
+    std::vector<unsigned char> pixels = BlurAndScaleStep(motion_detector, data1, 16);
 
     REQUIRE(abs(static_cast<int>(pixels[0]) - 142) < kErrorMarginAllowed);
     REQUIRE(abs(static_cast<int>(pixels[1]) - 142) < kErrorMarginAllowed);
@@ -406,52 +388,37 @@ TEST_CASE("Blur and Scale Step On Grayscale Frames") {
     REQUIRE(abs(static_cast<int>(pixels[6]) - 142) < kErrorMarginAllowed);
     REQUIRE(abs(static_cast<int>(pixels[7]) - 142) < kErrorMarginAllowed);
     REQUIRE(abs(static_cast<int>(pixels[8]) - 142) < kErrorMarginAllowed);
-    delete[] pixels;
   }
 
   SECTION("With 1/2x Scale and 3x3 Blur On Larger Image") {
     InputVideoSettings input_vid_set_sol = {9, 9, DecompFrameFormat::kGray};
     MotionConfig motion_config_sol = {1, 2, 10, 2, 0, 0.0, DecompFrameMethod::kAccurate};
-    DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
     MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
-    cl::Buffer blurred = motion_detector.BlurAndScale(data1);
-
-    unsigned char* pixels = new unsigned char[4];
-    motion_detector.cmd_queue_.enqueueReadBuffer(blurred, CL_TRUE, 0, 4 * sizeof(unsigned char), static_cast<void*>(pixels));
+    std::vector<unsigned char> pixels = BlurAndScaleStep(motion_detector, data1, 4);
 
     REQUIRE(abs(static_cast<int>(pixels[0]) - 146) < kErrorMarginAllowed);
     REQUIRE(abs(static_cast<int>(pixels[1]) - 142) < kErrorMarginAllowed);
     REQUIRE(abs(static_cast<int>(pixels[2]) - 141) < kErrorMarginAllowed);
     REQUIRE(abs(static_cast<int>(pixels[3]) - 136) < kErrorMarginAllowed);
-    delete[] pixels;
   }
 
   SECTION("With 1/3x Scale and 3x3 Blur On Larger Image") {
     InputVideoSettings input_vid_set_sol = {9, 9, DecompFrameFormat::kGray};
     MotionConfig motion_config_sol = {1, 3, 10, 2, 0, 0.0, DecompFrameMethod::kAccurate};
-    DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
     MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
-    cl::Buffer blurred = motion_detector.BlurAndScale(data1);
-
-    unsigned char* pixels = new unsigned char[8];
-    motion_detector.cmd_queue_.enqueueReadBuffer(blurred, CL_TRUE, 0, 8 * sizeof(unsigned char), static_cast<void*>(pixels));
+    std::vector<unsigned char> pixels = BlurAndScaleStep(motion_detector, data1, 8);
 
     REQUIRE(abs(static_cast<int>(pixels[0]) - 142) < kErrorMarginAllowed);
-    delete[] pixels;
   }
 
   SECTION("With No Scale and 3x3 Blur On Larger Image") {
     InputVideoSettings input_vid_set_sol = {9, 9, DecompFrameFormat::kGray};
     MotionConfig motion_config_sol = {1, 1, 10, 2, 0, 0.0, DecompFrameMethod::kAccurate};
-    DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
     MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
-    cl::Buffer blurred = motion_detector.BlurAndScale(data1);
-
-    unsigned char* pixels = new unsigned char[56];
-    motion_detector.cmd_queue_.enqueueReadBuffer(blurred, CL_TRUE, 0, 56 * sizeof(unsigned char), static_cast<void*>(pixels));
+    std::vector<unsigned char> pixels = BlurAndScaleStep(motion_detector, data1, 56);
 
     std::vector<int> expected = {132, 144, 143, 132, 144, 143, 132, 124, 142, 132, 124, 142, 132, 124, 145, 151, 154, 145, 151, 154, 145, 132, 144, 143, 132,
                                  144, 143, 132, 124, 142, 132, 124, 142, 132, 124, 145, 151, 154, 145, 151, 154, 145, 132, 144, 143, 132, 144, 143, 132};
@@ -459,7 +426,6 @@ TEST_CASE("Blur and Scale Step On Grayscale Frames") {
       REQUIRE(abs(static_cast<int>(pixels[i]) - expected.at(i)) < kErrorMarginAllowed);
     }
 
-    delete[] pixels;
   }
 
   delete[] data0;
@@ -467,6 +433,9 @@ TEST_CASE("Blur and Scale Step On Grayscale Frames") {
 }
 
 TEST_CASE("Stabilize And Compare Frames Step") {
+  // Every step should give the same results on the OpenCL and native devices
+  DeviceConfig device_config_sol = GENERATE(DeviceConfig{DeviceType::kSpecific, kDevice}, DeviceConfig{DeviceType::kNative, 0});
+
   // Fully white frame
   unsigned char* data0 = new unsigned char[32];
   for (int i = 0; i < 27; i++) {
@@ -486,23 +455,18 @@ TEST_CASE("Stabilize And Compare Frames Step") {
   SECTION("Compare Difference On The Same Frames") {
     InputVideoSettings input_vid_set_sol = {3, 3, DecompFrameFormat::kRGB};
     MotionConfig motion_config_sol = {0, 1, 1, 1, kErrorMarginAllowed, 0.0, DecompFrameMethod::kAccurate};
-    DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
     MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
 
     // Fill with 2 white frames
-    motion_detector.BlurAndScale(data0);
-    motion_detector.StabilizeAndCompareFrames();
-    motion_detector.BlurAndScale(data0);
-
-    cl::Buffer& difference_frame = motion_detector.StabilizeAndCompareFrames();
+    BlurAndScaleStep(motion_detector, data0);
+    StabilizeAndCompareStep(motion_detector);
+    BlurAndScaleStep(motion_detector, data0);
 
-    bool* differences = new bool[16];
-    motion_detector.cmd_queue_.enqueueReadBuffer(difference_frame, CL_TRUE, 0, 16 * sizeof(bool), static_cast<void*>(differences));
+    std::vector<bool> differences = StabilizeAndCompareStep(motion_detector, 16);
 
     // Should be no differences
     for (int i = 0; i < 9; i++) REQUIRE(differences[i] == false);
-    delete[] differences;
   }
 
   SECTION("Compare Difference On The Different Frames") {
@@ -510,46 +474,36 @@ TEST_CASE("Stabilize And Compare Frames Step") {
       InputVideoSettings input_vid_set_sol = {3, 3, DecompFrameFormat::kRGB};
       MotionConfig motion_config_sol = {
           0, 1, 1, 1, (127 - kErrorMarginAllowed), 0.0, DecompFrameMethod::kAccurate};  // Check that difference is above the expected value (127) within margin
-      DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
       MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
 
       // Fill with 1 black and 1 grey frame
-      motion_detector.BlurAndScale(data1);
-      motion_detector.StabilizeAndCompareFrames();
-      motion_detector.BlurAndScale(data2);
-
-      cl::Buffer& difference_frame = motion_detector.StabilizeAndCompareFrames();
+      BlurAndScaleStep(motion_detector, data1);
+      StabilizeAndCompareStep(motion_detector);
+      BlurAndScaleStep(motion_detector, data2);
 
-      bool* differences = new bool[16];
-      motion_detector.cmd_queue_.enqueueReadBuffer(difference_frame, CL_TRUE, 0, 16 * sizeof(bool), static_cast<void*>(differences));
+      std::vector<bool> differences = StabilizeAndCompareStep(motion_detector, 16);
 
       // Should have differences
       for (int i = 0; i < 9; i++) REQUIRE(differences[i] == true);
-      delete[] differences;
     }
 
     {  // Do the same thing but with a higher threshold so there should be no change
       InputVideoSettings input_vid_set_sol = {3, 3, DecompFrameFormat::kRGB};
       MotionConfig motion_config_sol = {
           0, 1, 1, 1, (127 + kErrorMarginAllowed), 0.0, DecompFrameMethod::kAccurate};  // Check that difference is above the expected value (127) within margin
-      DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
       MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
 
       // Fill with 1 black and 1 grey frame
-      motion_detector.BlurAndScale(data1);
-      motion_detector.StabilizeAndCompareFrames();
-      motion_detector.BlurAndScale(data2);
-
-      cl::Buffer& difference_frame = motion_detector.StabilizeAndCompareFrames();
+      BlurAndScaleStep(motion_detector, data1);
+      StabilizeAndCompareStep(motion_detector);
+      BlurAndScaleStep(motion_detector, data2);
 
-      bool* differences = new bool[16];
-      motion_detector.cmd_queue_.enqueueReadBuffer(difference_frame, CL_TRUE, 0, 16 * sizeof(bool), static_cast<void*>(differences));
+      std::vector<bool> differences = StabilizeAndCompareStep(motion_detector, 16);
 
       // Should have differences
       for (int i = 0; i < 9; i++) REQUIRE(differences[i] == false);
-      delete[] differences;
     }
   }
 
@@ -558,50 +512,40 @@ TEST_CASE("Stabilize And Compare Frames Step") {
       InputVideoSettings input_vid_set_sol = {3, 3, DecompFrameFormat::kRGB};
       MotionConfig motion_config_sol = {
           0, 1, 10, 1, (25 - kErrorMarginAllowed), 0.0, DecompFrameMethod::kAccurate};  // Check that difference is above the expected value (25) within margin
-      DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
       MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
 
       // Fill with 1 black and 10 white frames
-      motion_detector.BlurAndScale(data1);
+      BlurAndScaleStep(motion_detector, data1);
       for (int i = 0; i < 10; i++) {
-        motion_detector.StabilizeAndCompareFrames();
-        motion_detector.BlurAndScale(data0);
+        StabilizeAndCompareStep(motion_detector);
+        BlurAndScaleStep(motion_detector, data0);
       }
 
-      cl::Buffer& difference_frame = motion_detector.StabilizeAndCompareFrames();
-
-      bool* differences = new bool[16];
-      motion_detector.cmd_queue_.enqueueReadBuffer(difference_frame, CL_TRUE, 0, 16 * sizeof(bool), static_cast<void*>(differences));
+      std::vector<bool> differences = StabilizeAndCompareStep(motion_detector, 16);
 
       // Should have differences
       for (int i = 0; i < 9; i++) REQUIRE(differences[i] == true);
-      delete[] differences;
     }
 
     {  // Do the same thing but with a higher threshold so there should be no change
       InputVideoSettings input_vid_set_sol = {3, 3, DecompFrameFormat::kRGB};
       MotionConfig motion_config_sol = {
           0, 1, 10, 1, (25 + kErrorMarginAllowed), 0.0, DecompFrameMethod::kAccurate};  // Check that difference is above the expected value (25) within margin
-      DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
       MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
 
       // Fill with 1 black and 10 white frames
-      motion_detector.BlurAndScale(data1);
+      BlurAndScaleStep(motion_detector, data1);
       for (int i = 0; i < 10; i++) {
-        motion_detector.StabilizeAndCompareFrames();
-        motion_detector.BlurAndScale(data0);
+        StabilizeAndCompareStep(motion_detector);
+        BlurAndScaleStep(motion_detector, data0);
       }
 
-      cl::Buffer& difference_frame = motion_detector.StabilizeAndCompareFrames();
-
-      bool* differences = new bool[16];
-      motion_detector.cmd_queue_.enqueueReadBuffer(difference_frame, CL_TRUE, 0, 16 * sizeof(bool), static_cast<void*>(differences));
+      std::vector<bool> differences = StabilizeAndCompareStep(motion_detector, 16);
 
       // Should have differences
       for (int i = 0; i < 9; i++) REQUIRE(differences[i] == false);
-      delete[] differences;
     }
   }
 
@@ -610,50 +554,40 @@ TEST_CASE("Stabilize And Compare Frames Step") {
       InputVideoSettings input_vid_set_sol = {3, 3, DecompFrameFormat::kRGB};
       MotionConfig motion_config_sol = {
           0, 1, 1, 10, (25 - kErrorMarginAllowed), 0.0, DecompFrameMethod::kAccurate};  // Check that difference is above the expected value (25) within margin
-      DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
       MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
 
       // Fill with 10 black and 1 white frame
       for (int i = 0; i < 10; i++) {
-        motion_detector.BlurAndScale(data1);
-        motion_detector.StabilizeAndCompareFrames();
+        BlurAndScaleStep(motion_detector, data1);
+        StabilizeAndCompareStep(motion_detector);
       }
-      motion_detector.BlurAndScale(data0);
-
-      cl::Buffer& difference_frame = motion_detector.StabilizeAndCompareFrames();
+      BlurAndScaleStep(motion_detector, data0);
 
-      bool* differences = new bool[16];
-      motion_detector.cmd_queue_.enqueueReadBuffer(difference_frame, CL_TRUE, 0, 16 * sizeof(bool), static_cast<void*>(differences));
+      std::vector<bool> differences = StabilizeAndCompareStep(motion_detector, 16);
 
       // Should have differences
       for (int i = 0; i < 9; i++) REQUIRE(differences[i] == true);
-      delete[] differences;
     }
 
     {  // Do the same thing but with a higher threshold so there should be no change
       InputVideoSettings input_vid_set_sol = {3, 3, DecompFrameFormat::kRGB};
       MotionConfig motion_config_sol = {
           0, 1, 1, 10, (25 + kErrorMarginAllowed), 0.0, DecompFrameMethod::kAccurate};  // Check that difference is above the expected value (25) within margin
-      DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
       MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
 
       // Fill with 10 black and 1 white frame
       for (int i = 0; i < 10; i++) {
-        motion_detector.BlurAndScale(data1);
-        motion_detector.StabilizeAndCompareFrames();
+        BlurAndScaleStep(motion_detector, data1);
+        StabilizeAndCompareStep(motion_detector);
       }
-      motion_detector.BlurAndScale(data0);
-
-      cl::Buffer& difference_frame = motion_detector.StabilizeAndCompareFrames();
+      BlurAndScaleStep(motion_detector, data0);
 
-      bool* differences = new bool[16];
-      motion_detector.cmd_queue_.enqueueReadBuffer(difference_frame, CL_TRUE, 0, 16 * sizeof(bool), static_cast<void*>(differences));
+      std::vector<bool> differences = StabilizeAndCompareStep(motion_detector, 16);
 
       // Should have differences
       for (int i = 0; i < 9; i++) REQUIRE(differences[i] == false);
-      delete[] differences;
     }
   }
 
@@ -662,7 +596,681 @@ TEST_CASE("Stabilize And Compare Frames Step") {
   delete[] data2;
 }
 
+TEST_CASE("Fused Processing Mode") {
+  PpmFile ppm = ReadPpm("../test-images/9x9-color-pixels-rgb.ppm");
+  unsigned char* data0 = new unsigned char[304];  // Size of input frame buffer for 9x9 RGB frames
+  unsigned char* data1 = new unsigned char[304];  // Inverted image so that there are differences
+  for (int i = 0; i < ppm.data.size(); i++) {
+    data0[i] = ppm.data.at(i);
+    data1[i] = 255 - ppm.data.at(i);
+  }
+
+  std::vector<std::pair<unsigned int, unsigned int>> blur_scales = {{0, 1}, {1, 1}, {0, 2}, {1, 2}, {1, 3}};
+  for (int i = 0; i < blur_scales.size(); i++) {
+    InputVideoSettings input_vid_set_sol = {9, 9, DecompFrameFormat::kRGB};
+    MotionConfig separable_config = {blur_scales.at(i).first, blur_scales.at(i).second, 3, 1, 10, 0.0, DecompFrameMethod::kAccurate};
+    MotionConfig fused_config = separable_config;
+    fused_config.processing_mode = ProcessingMode::kFused;
+    DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
+
+    MotionDetector separable = MotionDetector(input_vid_set_sol, separable_config, device_config_sol, empty_output);
+    MotionDetector fused = MotionDetector(input_vid_set_sol, fused_config, device_config_sol, empty_output);
+
+    // Should produce the same difference frames as the separate kernels
+    std::vector<unsigned char*> sequence = {data0, data0, data1, data1, data0, data1};
+    for (int j = 0; j < sequence.size(); j++) {
+      bool separable_motion = separable.DetectOnDecompressedFrame(sequence.at(j));
+      bool fused_motion = fused.DetectOnDecompressedFrame(sequence.at(j));
+      REQUIRE(separable_motion == fused_motion);
+      REQUIRE(separable.GetChangedPixels() == fused.GetChangedPixels());
+
+      unsigned int pixels = separable.scaled_width_ * separable.scaled_height_;
+      bool* separable_diff = new bool[pixels];
+      bool* fused_diff = new bool[pixels];
+      separable.cmd_queue_.enqueueReadBuffer(separable.difference_frame_, CL_TRUE, 0, pixels * sizeof(bool), static_cast<void*>(separable_diff));
+      fused.cmd_queue_.enqueueReadBuffer(fused.difference_frame_, CL_TRUE, 0, pixels * sizeof(bool), static_cast<void*>(fused_diff));
+      for (int k = 0; k < pixels; k++) REQUIRE(separable_diff[k] == fused_diff[k]);
+      delete[] separable_diff;
+      delete[] fused_diff;
+    }
+  }
+
+  delete[] data0;
+  delete[] data1;
+}
+
+TEST_CASE("Tiled Processing Mode") {
+  PpmFile ppm = ReadPpm("../test-images/9x9-color-pixels-rgb.ppm");
+  unsigned char* data0 = new unsigned char[304];  // Size of input frame buffer for 9x9 RGB frames
+  unsigned char* data1 = new unsigned char[304];  // Inverted image so that there are differences
+  for (int i = 0; i < ppm.data.size(); i++) {
+    data0[i] = ppm.data.at(i);
+    data1[i] = 255 - ppm.data.at(i);
+  }
+  JpegFile jpeg = ReadJpeg("../test-images/640x480-test-image.jpg");
+  unsigned char* gray = JpegDecompressor(640, 480, DecompFrameFormat::kGray, DecompFrameMethod::kAccurate).DecompressImage(jpeg.data, jpeg.filesize);
+
+  SECTION("Small RGB Frames") {
+    std::vector<std::pair<unsigned int, unsigned int>> blur_scales = {{0, 1}, {1, 1}, {0, 2}, {1, 2}, {1, 3}};
+    for (int i = 0; i < blur_scales.size(); i++) {
+      InputVideoSettings input_vid_set_sol = {9, 9, DecompFrameFormat::kRGB};
+      MotionConfig separable_config = {blur_scales.at(i).first, blur_scales.at(i).second, 3, 1, 10, 0.0, DecompFrameMethod::kAccurate};
+      MotionConfig tiled_config = separable_config;
+      tiled_config.processing_mode = ProcessingMode::kTiled;
+      DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
+
+      MotionDetector separable = MotionDetector(input_vid_set_sol, separable_config, device_config_sol, empty_output);
+      MotionDetector tiled = MotionDetector(input_vid_set_sol, tiled_config, device_config_sol, empty_output);
+
+      // Should produce the same scaled frames and changed pixels as the reference kernels
+      std::vector<unsigned char*> sequence = {data0, data0, data1, data1, data0, data1};
+      for (int j = 0; j < sequence.size(); j++) {
+        unsigned int pixels = separable.scaled_width_ * separable.scaled_height_;
+        unsigned char* separable_scaled = new unsigned char[pixels];
+        unsigned char* tiled_scaled = new unsigned char[pixels];
+        separable.cmd_queue_.enqueueReadBuffer(separable.BlurAndScale(sequence.at(j)), CL_TRUE, 0, pixels, static_cast<void*>(separable_scaled));
+        tiled.cmd_queue_.enqueueReadBuffer(tiled.BlurAndScale(sequence.at(j)), CL_TRUE, 0, pixels, static_cast<void*>(tiled_scaled));
+        for (int k = 0; k < pixels; k++) REQUIRE(abs(static_cast<int>(separable_scaled[k]) - static_cast<int>(tiled_scaled[k])) < kErrorMarginAllowed);
+        delete[] separable_scaled;
+        delete[] tiled_scaled;
+
+        separable.StabilizeAndCompareFrames();
+        tiled.StabilizeAndCompareFrames();
+        REQUIRE(separable.CountDifferences() == tiled.CountDifferences());
+      }
+    }
+  }
+
+  SECTION("Large Grayscale Frames") {
+    // Larger blurs and scales need more than one work group and a halo around each one
+    std::vector<std::pair<unsigned int, unsigned int>> blur_scales = {{0, 1}, {2, 3}, {1, 5}, {2, 10}};
+    for (int i = 0; i < blur_scales.size(); i++) {
+      InputVideoSettings input_vid_set_sol = {640, 480, DecompFrameFormat::kGray};
+      MotionConfig separable_config = {blur_scales.at(i).first, blur_scales.at(i).second, 3, 1, 10, 0.0, DecompFrameMethod::kAccurate};
+      MotionConfig tiled_config = separable_config;
+      tiled_config.processing_mode = ProcessingMode::kTiled;
+      DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
+
+      MotionDetector separable = MotionDetector(input_vid_set_sol, separable_config, device_config_sol, empty_output);
+      MotionDetector tiled = MotionDetector(input_vid_set_sol, tiled_config, device_config_sol, empty_output);
+
+      unsigned int pixels = separable.scaled_width_ * separable.scaled_height_;
+      unsigned char* separable_scaled = new unsigned char[pixels];
+      unsigned char* tiled_scaled = new unsigned char[pixels];
+      separable.cmd_queue_.enqueueReadBuffer(separable.BlurAndScale(gray), CL_TRUE, 0, pixels, static_cast<void*>(separable_scaled));
+      tiled.cmd_queue_.enqueueReadBuffer(tiled.BlurAndScale(gray), CL_TRUE, 0, pixels, static_cast<void*>(tiled_scaled));
+      for (int k = 0; k < pixels; k++) REQUIRE(abs(static_cast<int>(separable_scaled[k]) - static_cast<int>(tiled_scaled[k])) < kErrorMarginAllowed);
+      delete[] separable_scaled;
+      delete[] tiled_scaled;
+    }
+  }
+
+  delete[] gray;
+  delete[] jpeg.data;
+  delete[] data0;
+  delete[] data1;
+}
+
+TEST_CASE("Specialized Kernels") {
+  PpmFile ppm = ReadPpm("../test-images/9x9-color-pixels-rgb.ppm");
+  unsigned char* data0 = new unsigned char[304];  // Size of input frame buffer for 9x9 RGB frames
+  unsigned char* data1 = new unsigned char[304];  // Inverted image so that there are differences
+  for (int i = 0; i < ppm.data.size(); i++) {
+    data0[i] = ppm.data.at(i);
+    data1[i] = 255 - ppm.data.at(i);
+  }
+
+  std::vector<ProcessingMode> modes = {ProcessingMode::kSeparable, ProcessingMode::kFused, ProcessingMode::kTiled};
+  std::vector<std::pair<unsigned int, unsigned int>> blur_scales = {{0, 1}, {1, 1}, {1, 2}, {1, 3}};
+  for (int m = 0; m < modes.size(); m++) {
+    for (int i = 0; i < blur_scales.size(); i++) {
+      InputVideoSettings input_vid_set_sol = {9, 9, DecompFrameFormat::kRGB};
+      MotionConfig buffer_config = {blur_scales.at(i).first, blur_scales.at(i).second, 3, 1, 10, 0.0, DecompFrameMethod::kAccurate, modes.at(m)};
+      buffer_config.specialize_kernels = false;
+      MotionConfig specialized_config = buffer_config;
+      specialized_config.specialize_kernels = true;
+      DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
+
+      MotionDetector buffers = MotionDetector(input_vid_set_sol, buffer_config, device_config_sol, empty_output);
+      MotionDetector specialized = MotionDetector(input_vid_set_sol, specialized_config, device_config_sol, empty_output);
+      REQUIRE(buffers.kernel_defines_.empty());
+      REQUIRE(specialized.kernel_defines_.find("-DGAUSSIAN_WEIGHTS=") != std::string::npos);
+
+      // Should produce the same difference frames as kernels reading their configuration from argument buffers
+      std::vector<unsigned char*> sequence = {data0, data0, data1, data1, data0, data1};
+      for (int j = 0; j < sequence.size(); j++) {
+        REQUIRE(buffers.DetectOnDecompressedFrame(sequence.at(j)) == specialized.DetectOnDecompressedFrame(sequence.at(j)));
+        REQUIRE(buffers.GetChangedPixels() == specialized.GetChangedPixels());
+      }
+    }
+  }
+
+  delete[] data0;
+  delete[] data1;
+}
+
+TEST_CASE("Integer Sums") {
+  PpmFile ppm = ReadPpm("../test-images/9x9-color-pixels-rgb.ppm");
+  unsigned char* data0 = new unsigned char[304];  // Size of input frame buffer for 9x9 RGB frames
+  unsigned char* data1 = new unsigned char[304];  // Inverted image so that there are differences
+  for (int i = 0; i < ppm.data.size(); i++) {
+    data0[i] = ppm.data.at(i);
+    data1[i] = 255 - ppm.data.at(i);
+  }
+  InputVideoSettings input_vid_set_sol = {9, 9, DecompFrameFormat::kRGB};
+
+  SECTION("Matches Native Device") {
+    std::vector<ProcessingMode> modes = {ProcessingMode::kSeparable, ProcessingMode::kFused};
+    std::vector<bool> specialize = {true, false};
+    for (int m = 0; m < modes.size(); m++) {
+      for (int s = 0; s < specialize.size(); s++) {
+        MotionConfig motion_config_sol = {1, 1, 3, 1, 10, 0.0, DecompFrameMethod::kAccurate, modes.at(m)};
+        motion_config_sol.specialize_kernels = specialize.at(s);
+        motion_config_sol.integer_sums = true;
+
+        MotionDetector open_cl = MotionDetector(input_vid_set_sol, motion_config_sol, {DeviceType::kSpecific, kDevice}, empty_output);
+        MotionDetector native = MotionDetector(input_vid_set_sol, motion_config_sol, {DeviceType::kNative, 0}, empty_output);
+        REQUIRE(open_cl.stabilized_element_size_ == sizeof(cl_ushort));
+        REQUIRE(open_cl.kernel_defines_.find("-DINTEGER_SUMS -DSUM_TYPE=ushort") != std::string::npos);
+
+        std::vector<unsigned char*> sequence = {data0, data0, data1, data1, data0, data1, data1, data1};
+        for (int j = 0; j < sequence.size(); j++) {
+          REQUIRE(open_cl.DetectOnDecompressedFrame(sequence.at(j)) == native.DetectOnDecompressedFrame(sequence.at(j)));
+          REQUIRE(open_cl.GetChangedPixels() == native.GetChangedPixels());
+        }
+      }
+    }
+  }
+
+  SECTION("Sums Do Not Drift") {
+    std::vector<unsigned int> bg_lengths = {10, 300};  // 300 frames of 255 do not fit in 16 bits
+    for (int i = 0; i < bg_lengths.size(); i++) {
+      MotionConfig motion_config_sol = {0, 1, bg_lengths.at(i), 3, 10, 0.0, DecompFrameMethod::kAccurate};
+      motion_config_sol.integer_sums = true;
+      MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, {DeviceType::kSpecific, kDevice}, empty_output);
+      REQUIRE(motion_detector.stabilized_element_size_ == (i == 0 ? sizeof(cl_ushort) : sizeof(cl_uint)));
+
+      // Alternate frames for a long time, then hold one frame until it fills both windows
+      for (int j = 0; j < 1000; j++) motion_detector.DetectOnDecompressedFrame(j % 3 == 0 ? data0 : data1);
+      for (int j = 0; j < bg_lengths.at(i) + 3 + 1; j++) motion_detector.DetectOnDecompressedFrame(data0);
+      REQUIRE(motion_detector.GetChangedPixels() == 0);
+
+      // Sums are exactly the held frame times the window lengths
+      unsigned int pixels = motion_detector.scaled_width_ * motion_detector.scaled_height_;
+      std::vector<unsigned char> scaled(pixels);
+      std::vector<unsigned char> background(pixels * motion_detector.stabilized_element_size_);
+      std::vector<unsigned char> movement(pixels * motion_detector.stabilized_element_size_);
+      motion_detector.cmd_queue_.enqueueReadBuffer(motion_detector.history_frames_.at(motion_detector.newest_frame_loc_), CL_TRUE, 0, pixels, scaled.data());
+      motion_detector.cmd_queue_.enqueueReadBuffer(motion_detector.stabilized_background_, CL_TRUE, 0, background.size(), background.data());
+      motion_detector.cmd_queue_.enqueueReadBuffer(motion_detector.stabilized_movement_, CL_TRUE, 0, movement.size(), movement.data());
+      for (int k = 0; k < pixels; k++) {
+        unsigned int background_sum = i == 0 ? reinterpret_cast<cl_ushort*>(background.data())[k] : reinterpret_cast<cl_uint*>(background.data())[k];
+        unsigned int movement_sum = i == 0 ? reinterpret_cast<cl_ushort*>(movement.data())[k] : reinterpret_cast<cl_uint*>(movement.data())[k];
+        REQUIRE(background_sum == scaled.at(k) * bg_lengths.at(i));
+        REQUIRE(movement_sum == scaled.at(k) * 3);
+      }
+    }
+  }
+
+  SECTION("With Invalid Input") {
+    MotionConfig motion_config_sol = {0, 1, 100000, 1000, 10, 0.0, DecompFrameMethod::kAccurate};
+    motion_config_sol.integer_sums = true;
+    REQUIRE_THROWS_AS(MotionDetector(input_vid_set_sol, motion_config_sol, {DeviceType::kSpecific, kDevice}, empty_output), std::invalid_argument);
+  }
+
+  delete[] data0;
+  delete[] data1;
+}
+
+TEST_CASE("Packed Mask") {
+  PpmFile ppm = ReadPpm("../test-images/9x9-color-pixels-rgb.ppm");
+  unsigned char* data0 = new unsigned char[304];  // Size of input frame buffer for 9x9 RGB frames
+  unsigned char* data1 = new unsigned char[304];  // Inverted image so that there are differences
+  for (int i = 0; i < ppm.data.size(); i++) {
+    data0[i] = ppm.data.at(i);
+    data1[i] = 255 - ppm.data.at(i);
+  }
+
+  SECTION("Matches Unpacked Difference Frame") {
+    std::vector<ProcessingMode> modes = {ProcessingMode::kSeparable, ProcessingMode::kFused, ProcessingMode::kTiled};
+    std::vector<bool> specialize = {true, false};
+    for (int m = 0; m < modes.size(); m++) {
+      for (int s = 0; s < specialize.size(); s++) {
+        InputVideoSettings input_vid_set_sol = {9, 9, DecompFrameFormat::kRGB};
+        MotionConfig unpacked_config = {1, 1, 3, 1, 10, 0.0, DecompFrameMethod::kAccurate, modes.at(m)};
+        unpacked_config.specialize_kernels = specialize.at(s);
+        MotionConfig packed_config = unpacked_config;
+        packed_config.packed_mask = true;
+
+        MotionDetector unpacked = MotionDetector(input_vid_set_sol, unpacked_config, {DeviceType::kSpecific, kDevice}, empty_output);
+        MotionDetector packed = MotionDetector(input_vid_set_sol, packed_config, {DeviceType::kSpecific, kDevice}, empty_output);
+        MotionDetector native = MotionDetector(input_vid_set_sol, packed_config, {DeviceType::kNative, 0}, empty_output);
+        REQUIRE(packed.kernel_defines_.find("-DPACKED_MASK") != std::string::npos);
+
+        std::vector<unsigned char*> sequence = {data0, data0, data1, data1, data0, data1};
+        for (int j = 0; j < sequence.size(); j++) {
+          REQUIRE(unpacked.DetectOnDecompressedFrame(sequence.at(j)) == packed.DetectOnDecompressedFrame(sequence.at(j)));
+          native.DetectOnDecompressedFrame(sequence.at(j));
+          REQUIRE(unpacked.GetChangedPixels() == packed.GetChangedPixels());
+
+          // Every bit should match the bool of the unpacked difference frame
+          unsigned int pixels = unpacked.scaled_width_ * unpacked.scaled_height_;
+          bool* unpacked_diff = new bool[pixels];
+          unpacked.cmd_queue_.enqueueReadBuffer(unpacked.difference_frame_, CL_TRUE, 0, pixels * sizeof(bool), static_cast<void*>(unpacked_diff));
+          std::vector<uint32_t> mask = packed.GetDifferenceMask();
+          REQUIRE(mask.size() == (pixels + 31) / 32);
+          REQUIRE(native.GetDifferenceMask() == mask);
+          for (int k = 0; k < pixels; k++) REQUIRE(((mask.at(k / 32) >> (k % 32)) & 1) == (unpacked_diff[k] ? 1 : 0));
+          if (pixels % 32 != 0) REQUIRE((mask.back() >> (pixels % 32)) == 0);
+          delete[] unpacked_diff;
+        }
+      }
+    }
+  }
+
+  SECTION("Counts Large Frames") {
+    JpegFile jpeg = ReadJpeg("../test-images/640x480-test-image.jpg");
+    unsigned char* blank = new unsigned char[640 * 480];
+    for (int i = 0; i < 640 * 480; i++) blank[i] = 0;
+
+    // Many work groups and words, with a partial word at the end (158 x 118 scaled pixels)
+    InputVideoSettings input_vid_set_sol = {640, 480, DecompFrameFormat::kGray};
+    std::vector<ProcessingMode> modes = {ProcessingMode::kSeparable, ProcessingMode::kFused};
+    for (int m = 0; m < modes.size(); m++) {
+      MotionConfig unpacked_config = {1, 4, 3, 1, 5, 0.01, DecompFrameMethod::kAccurate, modes.at(m)};
+      MotionConfig packed_config = unpacked_config;
+      packed_config.packed_mask = true;
+      MotionDetector unpacked = MotionDetector(input_vid_set_sol, unpacked_config, {DeviceType::kSpecific, kDevice}, empty_output);
+      MotionDetector packed = MotionDetector(input_vid_set_sol, packed_config, {DeviceType::kSpecific, kDevice}, empty_output);
+
+      unpacked.DetectOnDecompressedFrame(blank);
+      packed.DetectOnDecompressedFrame(blank);
+      for (int f = 0; f < 3; f++) {
+        REQUIRE(unpacked.DetectOnFrame(jpeg.data, jpeg.filesize) == packed.DetectOnFrame(jpeg.data, jpeg.filesize));
+        REQUIRE(unpacked.GetChangedPixels() == packed.GetChangedPixels());
+
+        unsigned int mask_pixels = 0;
+        std::vector<uint32_t> mask = packed.GetDifferenceMask();
+        for (int k = 0; k < mask.size(); k++) mask_pixels += std::bitset<32>(mask.at(k)).count();
+        REQUIRE(mask_pixels == packed.GetChangedPixels());
+      }
+      REQUIRE(packed.GetChangedPixels() > 0);
+    }
+
+    delete[] blank;
+    delete[] jpeg.data;
+  }
+
+  SECTION("With Invalid Input") {
+    InputVideoSettings input_vid_set_sol = {9, 9, DecompFrameFormat::kRGB};
+    MotionConfig motion_config_sol = {0, 1, 3, 1, 10, 0.0, DecompFrameMethod::kAccurate};
+    MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, {DeviceType::kSpecific, kDevice}, empty_output);
+    REQUIRE_THROWS_AS(motion_detector.GetDifferenceMask(), std::logic_error);
+  }
+
+  delete[] data0;
+  delete[] data1;
+}
+
+TEST_CASE("Exponential Background") {
+  PpmFile ppm = ReadPpm("../test-images/9x9-color-pixels-rgb.ppm");
+  unsigned char* data0 = new unsigned char[304];  // Size of input frame buffer for 9x9 RGB frames
+  unsigned char* data1 = new unsigned char[304];  // Inverted image so that there are differences
+  for (int i = 0; i < ppm.data.size(); i++) {
+    data0[i] = ppm.data.at(i);
+    data1[i] = 255 - ppm.data.at(i);
+  }
+  InputVideoSettings input_vid_set_sol = {9, 9, DecompFrameFormat::kRGB};
+
+  SECTION("Matches Native Device") {
+    std::vector<ProcessingMode> modes = {ProcessingMode::kSeparable, ProcessingMode::kFused};
+    std::vector<bool> specialize = {true, false};
+    for (int m = 0; m < modes.size(); m++) {
+      for (int s = 0; s < specialize.size(); s++) {
+        MotionConfig motion_config_sol = {1, 1, 3, 1, 10, 0.0, DecompFrameMethod::kAccurate, modes.at(m)};
+        motion_config_sol.specialize_kernels = specialize.at(s);
+        motion_config_sol.background_model = BackgroundModel::kExponential;
+
+        MotionDetector open_cl = MotionDetector(input_vid_set_sol, motion_config_sol, {DeviceType::kSpecific, kDevice}, empty_output);
+        MotionDetector native = MotionDetector(input_vid_set_sol, motion_config_sol, {DeviceType::kNative, 0}, empty_output);
+        REQUIRE(open_cl.kernel_defines_.find("-DEXPONENTIAL_AVERAGE") != std::string::npos);
+
+        std::vector<unsigned char*> sequence = {data0, data0, data1, data1, data0, data1, data1, data1};
+        for (int j = 0; j < sequence.size(); j++) {
+          REQUIRE(open_cl.DetectOnDecompressedFrame(sequence.at(j)) == native.DetectOnDecompressedFrame(sequence.at(j)));
+          REQUIRE(open_cl.GetChangedPixels() == native.GetChangedPixels());
+        }
+      }
+    }
+  }
+
+  SECTION("Keeps Only The Newest Frame") {
+    MotionConfig motion_config_sol = {0, 1, 300, 2, 10, 0.0, DecompFrameMethod::kAccurate};
+    motion_config_sol.background_model = BackgroundModel::kExponential;
+    MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, {DeviceType::kSpecific, kDevice}, empty_output);
+    REQUIRE(motion_detector.history_frames_.size() == 1);
+
+    // Still scene settles, a new scene is motion until the background catches up with it
+    for (int j = 0; j < 2000; j++) motion_detector.DetectOnDecompressedFrame(data0);
+    REQUIRE(motion_detector.GetChangedPixels() == 0);
+    REQUIRE(motion_detector.DetectOnDecompressedFrame(data1) == true);
+    for (int j = 0; j < 2000; j++) motion_detector.DetectOnDecompressedFrame(data1);
+    REQUIRE(motion_detector.GetChangedPixels() == 0);
+  }
+
+  SECTION("With Invalid Input") {
+    MotionConfig motion_config_sol = {0, 1, 3, 1, 10, 0.0, DecompFrameMethod::kAccurate};
+    motion_config_sol.background_model = BackgroundModel::kExponential;
+    motion_config_sol.integer_sums = true;
+    REQUIRE_THROWS_AS(MotionDetector(input_vid_set_sol, motion_config_sol, {DeviceType::kSpecific, kDevice}, empty_output), std::invalid_argument);
+  }
+
+  delete[] data0;
+  delete[] data1;
+}
+
+TEST_CASE("Motion Regions") {
+  // 64x48 grayscale frames, blank and with shapes drawn on it
+  const unsigned int width = 64;
+  std::vector<unsigned char> blank(3192, 0);  // Size of input frame buffer for 64x48 gray frames
+  std::vector<unsigned char> shapes = blank;
+  auto draw = [&shapes, width](unsigned int x, unsigned int y) { shapes.at(y * width + x) = 255; };
+  for (int y = 4; y <= 9; y++) {
+    for (int x = 10; x <= 25; x++) draw(x, y);  // Rectangle across a tile edge
+  }
+  for (int y = 14; y <= 33; y++) {
+    for (int x = 40; x <= 44; x++) draw(x, y);  // Taller rectangle across two tile edges
+  }
+  for (int y = 30; y <= 40; y++) {
+    draw(2, y);  // U that is only joined at the bottom
+    draw(6, y);
+  }
+  for (int x = 3; x <= 5; x++) draw(x, 40);
+  draw(47, 31);  // Diagonal through a tile corner
+  draw(48, 32);
+  draw(49, 33);
+  draw(31, 40);  // Anti-diagonal across a tile edge
+  draw(32, 39);
+  InputVideoSettings input_vid_set_sol = {64, 48, DecompFrameFormat::kGray};
+
+  auto require_region = [](const MotionRegion& region, unsigned int x, unsigned int y, unsigned int w, unsigned int h, unsigned int pixels, float cx, float cy) {
+    REQUIRE(region.x == x);
+    REQUIRE(region.y == y);
+    REQUIRE(region.width == w);
+    REQUIRE(region.height == h);
+    REQUIRE(region.pixels == pixels);
+    REQUIRE(region.centroid_x == Approx(cx));
+    REQUIRE(region.centroid_y == Approx(cy));
+  };
+
+  SECTION("Finds Every Region") {
+    std::vector<ProcessingMode> modes = {ProcessingMode::kSeparable, ProcessingMode::kFused, ProcessingMode::kTiled};
+    std::vector<bool> packed = {false, true};
+    std::vector<DeviceConfig> devices = {{DeviceType::kSpecific, kDevice}, {DeviceType::kNative, 0}};
+    for (int m = 0; m < modes.size(); m++) {
+      for (int p = 0; p < packed.size(); p++) {
+        for (int d = 0; d < devices.size(); d++) {
+          // No blur or scale, so scaled pixels are input pixels
+          MotionConfig motion_config_sol = {0, 1, 1, 1, 10, 0.0, DecompFrameMethod::kAccurate, modes.at(m)};
+          motion_config_sol.packed_mask = packed.at(p);
+          motion_config_sol.max_regions = 8;
+          MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, devices.at(d), empty_output);
+
+          MotionResult still = motion_detector.DetectRegionsOnDecompressedFrame(blank.data());
+          REQUIRE(still.motion == false);
+          REQUIRE(still.regions.empty());
+
+          MotionResult result = motion_detector.DetectRegionsOnDecompressedFrame(shapes.data());
+          REQUIRE(result.motion == true);
+          REQUIRE(result.changed_pixels == 226);
+          REQUIRE(result.motion_score == Approx(226.0 / (64 * 48)));
+          REQUIRE(result.regions.size() == 5);
+          require_region(result.regions.at(0), 40, 14, 5, 20, 100, 42.5, 24.0);
+          require_region(result.regions.at(1), 10, 4, 16, 6, 96, 18.0, 7.0);
+          require_region(result.regions.at(2), 2, 30, 5, 11, 25, 4.5, 36.1);
+          require_region(result.regions.at(3), 47, 31, 3, 3, 3, 48.5, 32.5);
+          require_region(result.regions.at(4), 31, 39, 2, 2, 2, 32.0, 40.0);
+        }
+      }
+    }
+  }
+
+  SECTION("Leaves Out Small Regions") {
+    MotionConfig motion_config_sol = {0, 1, 1, 1, 10, 0.0, DecompFrameMethod::kAccurate};
+    motion_config_sol.max_regions = 8;
+    motion_config_sol.min_region_pixels = 3;
+    MotionDetector open_cl = MotionDetector(input_vid_set_sol, motion_config_sol, {DeviceType::kSpecific, kDevice}, empty_output);
+    MotionDetector native = MotionDetector(input_vid_set_sol, motion_config_sol, {DeviceType::kNative, 0}, empty_output);
+    open_cl.DetectOnDecompressedFrame(blank.data());
+    native.DetectOnDecompressedFrame(blank.data());
+    REQUIRE(open_cl.DetectRegionsOnDecompressedFrame(shapes.data()).regions.size() == 4);
+    REQUIRE(native.DetectRegionsOnDecompressedFrame(shapes.data()).regions.size() == 4);
+
+    // Only the largest are kept when there are too many, however the device numbers them
+    std::vector<unsigned char> dotted = shapes;
+    for (int x = 0; x < width; x += 4) {
+      dotted.at(x) = 255;               // Single pixels along the top row
+      dotted.at(44 * width + x) = 255;  // and along a row below the shapes
+    }
+    std::vector<DeviceConfig> devices = {{DeviceType::kSpecific, kDevice}, {DeviceType::kNative, 0}};
+    for (int d = 0; d < devices.size(); d++) {
+      std::vector<unsigned int> min_pixels = {3, 1};
+      for (int i = 0; i < min_pixels.size(); i++) {
+        motion_config_sol.max_regions = 2;
+        motion_config_sol.min_region_pixels = min_pixels.at(i);
+        MotionDetector limited = MotionDetector(input_vid_set_sol, motion_config_sol, devices.at(d), empty_output);
+        limited.DetectOnDecompressedFrame(blank.data());
+        std::vector<MotionRegion> regions = limited.DetectRegionsOnDecompressedFrame(dotted.data()).regions;
+        REQUIRE(regions.size() == 2);
+        REQUIRE(regions.at(0).pixels == 100);
+        REQUIRE(regions.at(1).pixels == 96);
+      }
+    }
+  }
+
+  SECTION("Maps Back Through Scale And Blur") {
+    std::vector<unsigned char> square = blank;
+    for (int y = 12; y <= 27; y++) {
+      for (int x = 20; x <= 35; x++) square.at(y * width + x) = 255;
+    }
+
+    // 2 pixel margin and 2x scale (30 x 22 scaled pixels)
+    MotionConfig motion_config_sol = {1, 2, 1, 1, 10, 0.0, DecompFrameMethod::kAccurate};
+    motion_config_sol.max_regions = 8;
+    MotionDetector open_cl = MotionDetector(input_vid_set_sol, motion_config_sol, {DeviceType::kSpecific, kDevice}, empty_output);
+    MotionDetector native = MotionDetector(input_vid_set_sol, motion_config_sol, {DeviceType::kNative, 0}, empty_output);
+    open_cl.DetectOnDecompressedFrame(blank.data());
+    native.DetectOnDecompressedFrame(blank.data());
+    std::vector<MotionRegion> regions = open_cl.DetectRegionsOnDecompressedFrame(square.data()).regions;
+    std::vector<MotionRegion> native_regions = native.DetectRegionsOnDecompressedFrame(square.data()).regions;
+
+    // Blur spreads the square, so its box has to cover the square and be centered on it
+    REQUIRE(regions.size() == 1);
+    REQUIRE(regions.at(0).x <= 20);
+    REQUIRE(regions.at(0).y <= 12);
+    REQUIRE(regions.at(0).x + regions.at(0).width >= 36);
+    REQUIRE(regions.at(0).y + regions.at(0).height >= 28);
+    REQUIRE(regions.at(0).x + regions.at(0).width <= 64);
+    REQUIRE(regions.at(0).y + regions.at(0).height <= 48);
+    REQUIRE(regions.at(0).x % 2 == 0);
+    REQUIRE(regions.at(0).width % 2 == 0);
+    REQUIRE(regions.at(0).centroid_x == Approx(28.0).margin(2.0));
+    REQUIRE(regions.at(0).centroid_y == Approx(20.0).margin(2.0));
+
+    REQUIRE(native_regions.size() == 1);
+    require_region(native_regions.at(0), regions.at(0).x, regions.at(0).y, regions.at(0).width, regions.at(0).height, regions.at(0).pixels,
+                   regions.at(0).centroid_x, regions.at(0).centroid_y);
+  }
+
+  SECTION("With Invalid Input") {
+    MotionConfig motion_config_sol = {0, 1, 1, 1, 10, 0.0, DecompFrameMethod::kAccurate};
+    MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, {DeviceType::kSpecific, kDevice}, empty_output);
+    REQUIRE_THROWS_AS(motion_detector.DetectRegionsOnDecompressedFrame(shapes.data()), std::logic_error);
+    REQUIRE_THROWS_AS(motion_detector.FindMotionRegions(), std::logic_error);
+  }
+}
+
+TEST_CASE("Region Of Interest") {
+  // 64x48 grayscale frames, blank and with a square in each half
+  const unsigned int width = 64;
+  std::vector<unsigned char> blank(3192, 0);  // Size of input frame buffer for 64x48 gray frames
+  std::vector<unsigned char> squares = blank;
+  for (int y = 4; y <= 11; y++) {
+    for (int x = 4; x <= 11; x++) squares.at(y * width + x) = 255;  // 64 pixels in the watched left half
+  }
+  for (int y = 20; y <= 35; y++) {
+    for (int x = 40; x <= 55; x++) squares.at(y * width + x) = 255;  // 256 pixels in the excluded right half
+  }
+  InputVideoSettings input_vid_set_sol = {64, 48, DecompFrameFormat::kGray};
+  RoiMask left_half = RoiMask(64, 48, true);
+  left_half.AddPolygon({{32, 0}, {64, 0}, {64, 48}, {32, 48}}, false);
+
+  SECTION("Ignores Changes Outside Mask") {
+    std::vector<ProcessingMode> modes = {ProcessingMode::kSeparable, ProcessingMode::kFused, ProcessingMode::kTiled};
+    std::vector<bool> packed = {false, true};
+    std::vector<DeviceConfig> devices = {{DeviceType::kSpecific, kDevice}, {DeviceType::kNative, 0}};
+    for (int m = 0; m < modes.size(); m++) {
+      for (int p = 0; p < packed.size(); p++) {
+        for (int d = 0; d < devices.size(); d++) {
+          // No blur or scale, so scaled pixels are input pixels
+          MotionConfig motion_config_sol = {0, 1, 1, 1, 10, 0.0, DecompFrameMethod::kAccurate, modes.at(m)};
+          motion_config_sol.packed_mask = packed.at(p);
+          motion_config_sol.roi = left_half;
+          MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, devices.at(d), empty_output);
+
+          REQUIRE(motion_detector.DetectOnDecompressedFrame(blank.data()) == false);
+          REQUIRE(motion_detector.DetectOnDecompressedFrame(squares.data()) == true);
+          REQUIRE(motion_detector.GetChangedPixels() == 64);
+          REQUIRE(motion_detector.GetMotionScore() == Approx(64.0 / (32 * 48)));
+          if (motion_config_sol.packed_mask) {
+            std::vector<uint32_t> mask = motion_detector.GetDifferenceMask();
+            REQUIRE(std::bitset<32>(mask.at((4 * width) / 32)).count() == 8);
+            REQUIRE(mask.at((20 * width + 32) / 32) == 0);
+          }
+        }
+      }
+    }
+  }
+
+  SECTION("Threshold Is Percentage Of Watched Pixels") {
+    // 3% of watched pixels is 46, 3% of the whole frame would be 92
+    MotionConfig motion_config_sol = {0, 1, 1, 1, 10, 0.03, DecompFrameMethod::kAccurate};
+    motion_config_sol.roi = left_half;
+    MotionDetector open_cl = MotionDetector(input_vid_set_sol, motion_config_sol, {DeviceType::kSpecific, kDevice}, empty_output);
+    MotionDetector native = MotionDetector(input_vid_set_sol, motion_config_sol, {DeviceType::kNative, 0}, empty_output);
+    REQUIRE(open_cl.diff_threshold_ == 46);
+    open_cl.DetectOnDecompressedFrame(blank.data());
+    native.DetectOnDecompressedFrame(blank.data());
+    REQUIRE(open_cl.DetectOnDecompressedFrame(squares.data()) == true);
+    REQUIRE(native.DetectOnDecompressedFrame(squares.data()) == true);
+  }
+
+  SECTION("Only Launches Watched Tiles") {
+    // 2 pixel margin and 2x scale (30 x 22 scaled pixels), only the left 15 scaled columns have their centers in the left half
+    MotionConfig motion_config_sol = {1, 2, 1, 1, 10, 0.0, DecompFrameMethod::kAccurate};
+    motion_config_sol.roi = left_half;
+    MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, {DeviceType::kSpecific, kDevice}, empty_output);
+    REQUIRE(motion_detector.watched_pixels_ == 15 * 22);
+    const unsigned int tile = motion_detector.roi_tile_size_;
+    REQUIRE(motion_detector.roi_tile_count_ == ((15 + tile - 1) / tile) * ((22 + tile - 1) / tile));
+    REQUIRE(motion_detector.roi_tile_count_ < ((30 + tile - 1) / tile) * ((22 + tile - 1) / tile));
+
+    // Same result as the native pipeline, which blurs every watched row
+    MotionDetector native = MotionDetector(input_vid_set_sol, motion_config_sol, {DeviceType::kNative, 0}, empty_output);
+    motion_detector.DetectOnDecompressedFrame(blank.data());
+    native.DetectOnDecompressedFrame(blank.data());
+    motion_detector.DetectOnDecompressedFrame(squares.data());
+    native.DetectOnDecompressedFrame(squares.data());
+    REQUIRE(motion_detector.GetChangedPixels() > 0);
+    REQUIRE(motion_detector.GetChangedPixels() == native.GetChangedPixels());
+  }
+
+  SECTION("Only Decompresses Window") {
+    JpegFile jpeg = ReadJpeg("../test-images/640x480-test-image.jpg");
+    InputVideoSettings jpeg_vid_set_sol = {640, 480, DecompFrameFormat::kGray};
+    RoiMask strip = RoiMask(640, 480, false);
+    strip.AddPolygon({{100, 200}, {300, 200}, {300, 260}, {100, 260}}, true);
+
+    // Same changes as a whole decompressed frame, with and without scaling while decompressing
+    std::vector<bool> dct_scaling = {false, true};
+    std::vector<DeviceConfig> devices = {{DeviceType::kSpecific, kDevice}, {DeviceType::kNative, 0}};
+    for (int s = 0; s < dct_scaling.size(); s++) {
+      for (int d = 0; d < devices.size(); d++) {
+        MotionConfig motion_config_sol = {1, 4, 1, 1, 10, 0.0, DecompFrameMethod::kAccurate};
+        motion_config_sol.dct_scaling = dct_scaling.at(s);
+        motion_config_sol.roi = strip;
+        MotionDetector windowed = MotionDetector(jpeg_vid_set_sol, motion_config_sol, devices.at(d), empty_output);
+        MotionDetector whole = MotionDetector(jpeg_vid_set_sol, motion_config_sol, devices.at(d), empty_output);
+
+        const unsigned int decode_scale = windowed.GetDecodeScale();
+        unsigned char* decompressed =
+            JpegDecompressor(640, 480, DecompFrameFormat::kGray, DecompFrameMethod::kAccurate, decode_scale).DecompressImage(jpeg.data, jpeg.filesize);
+        std::vector<unsigned char> frame(windowed.input_frame_buffer_size_, 0);
+        std::copy(decompressed, decompressed + (640 / decode_scale) * (480 / decode_scale), frame.begin());
+        std::vector<unsigned char> blank(windowed.input_frame_buffer_size_, 0);
+
+        windowed.DetectOnDecompressedFrame(blank.data());
+        whole.DetectOnDecompressedFrame(blank.data());
+        REQUIRE(windowed.DetectOnFrame(jpeg.data, jpeg.filesize) == true);
+        REQUIRE(whole.DetectOnDecompressedFrame(frame.data()) == true);
+        REQUIRE(windowed.GetChangedPixels() == whole.GetChangedPixels());
+        delete[] decompressed;
+      }
+    }
+    delete[] jpeg.data;
+  }
+
+  SECTION("Leaves Rest Of Frame Blank") {
+    JpegFile jpeg = ReadJpeg("../test-images/640x480-test-image.jpg");
+    InputVideoSettings jpeg_vid_set_sol = {640, 480, DecompFrameFormat::kGray};
+    MotionConfig motion_config_sol = {1, 4, 1, 1, 10, 0.0, DecompFrameMethod::kAccurate};
+    MotionConfig roi_config_sol = motion_config_sol;
+    roi_config_sol.roi = RoiMask(640, 480, false);
+    roi_config_sol.roi.AddPolygon({{100, 200}, {300, 200}, {300, 260}, {100, 260}}, true);
+
+    // Another native detector leaves a whole frame in the shared buffer pool first
+    MotionDetector whole = MotionDetector(jpeg_vid_set_sol, motion_config_sol, {DeviceType::kNative, 0}, empty_output);
+    whole.DetectOnFrame(jpeg.data, jpeg.filesize);
+    MotionDetector native = MotionDetector(jpeg_vid_set_sol, roi_config_sol, {DeviceType::kNative, 0}, empty_output);
+    for (int i = 0; i < 3; i++) native.DetectOnFrame(jpeg.data, jpeg.filesize);
+    // Window starts at the first row the watched scaled pixels blur from
+    unsigned int first_row = 0;
+    while (std::find(native.roi_scaled_.begin() + first_row * native.scaled_width_, native.roi_scaled_.begin() + (first_row + 1) * native.scaled_width_, 1) ==
+           native.roi_scaled_.begin() + (first_row + 1) * native.scaled_width_) {
+      first_row++;
+    }
+    const unsigned int window_start = first_row * 4 * 640;  // Pixels above the window
+    REQUIRE(window_start > 0);
+    for (int i = 0; i < window_start; i++) REQUIRE(native.window_frame_.at(i) == 0);
+
+    // Input slots keep the blank rows they were created with
+    MotionDetector open_cl = MotionDetector(jpeg_vid_set_sol, roi_config_sol, {DeviceType::kSpecific, kDevice}, empty_output);
+    open_cl.DetectOnFrame(jpeg.data, jpeg.filesize);
+    std::vector<std::future<bool>> async_motion;
+    for (int i = 0; i < open_cl.input_slots_.size(); i++) async_motion.push_back(open_cl.DetectOnFrameAsync(jpeg.data, jpeg.filesize));
+    for (int i = 0; i < async_motion.size(); i++) async_motion.at(i).get();
+    for (int i = 0; i < open_cl.input_slots_.size(); i++) {
+      std::vector<unsigned char> slot(window_start);
+      open_cl.cmd_queue_.enqueueReadBuffer(open_cl.input_slots_.at(i).frame, CL_TRUE, 0, slot.size(), static_cast<void*>(slot.data()));
+      for (int j = 0; j < slot.size(); j++) REQUIRE(slot.at(j) == 0);
+    }
+    delete[] jpeg.data;
+  }
+
+  SECTION("With Invalid Input") {
+    MotionConfig motion_config_sol = {0, 1, 1, 1, 10, 0.0, DecompFrameMethod::kAccurate};
+    motion_config_sol.roi = RoiMask(32, 48, true);
+    REQUIRE_THROWS_AS(MotionDetector(input_vid_set_sol, motion_config_sol, {DeviceType::kSpecific, kDevice}, empty_output), std::invalid_argument);
+    motion_config_sol.roi = RoiMask(64, 48, false);
+    REQUIRE_THROWS_AS(MotionDetector(input_vid_set_sol, motion_config_sol, {DeviceType::kSpecific, kDevice}, empty_output), std::invalid_argument);
+    REQUIRE_THROWS_AS(MotionDetector(input_vid_set_sol, motion_config_sol, {DeviceType::kNative, 0}, empty_output), std::invalid_argument);
+  }
+}
+
 TEST_CASE("Detect On Frame") {
+  // Every step should give the same results on the OpenCL and native devices
+  DeviceConfig device_config_sol = GENERATE(DeviceConfig{DeviceType::kSpecific, kDevice}, DeviceConfig{DeviceType::kNative, 0});
+
   // Fully white frame
   unsigned char* data0 = new unsigned char[16];
   for (int i = 0; i < 9; i++) {
@@ -681,7 +1289,6 @@ TEST_CASE("Detect On Frame") {
     {
       InputVideoSettings input_vid_set_sol = {3, 3, DecompFrameFormat::kGray};
       MotionConfig motion_config_sol = {0, 1, 1, 1, 5, 0.5, DecompFrameMethod::kAccurate};
-      DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
       MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
 
@@ -694,7 +1301,6 @@ TEST_CASE("Detect On Frame") {
     {  // Same thing again with difference threshold to ensure threshold is checked
       InputVideoSettings input_vid_set_sol = {3, 3, DecompFrameFormat::kGray};
       MotionConfig motion_config_sol = {0, 1, 1, 1, 5, 0.6, DecompFrameMethod::kAccurate};
-      DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
 
       MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
 
@@ -705,7 +1311,265 @@ TEST_CASE("Detect On Frame") {
     }
   }
 
+  SECTION("Counting Changed Pixels On Device") {
+    InputVideoSettings input_vid_set_sol = {3, 3, DecompFrameFormat::kGray};
+    MotionConfig motion_config_sol = {0, 1, 1, 1, 5, 0.5, DecompFrameMethod::kAccurate};
+
+    MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
+
+    motion_detector.DetectOnDecompressedFrame(data0);
+    motion_detector.DetectOnDecompressedFrame(data0);
+    REQUIRE(motion_detector.GetChangedPixels() == 0);
+
+    motion_detector.DetectOnDecompressedFrame(data1);
+    REQUIRE(motion_detector.GetChangedPixels() == 5);
+    REQUIRE(std::abs(motion_detector.GetMotionScore() - 5.0 / 9.0) < 0.001);
+  }
+
   delete[] data0;
   delete[] data1;
 }
+
+TEST_CASE("Detect With DCT Scaling") {
+  JpegFile jpeg = ReadJpeg("../test-images/640x480-test-image.jpg");
+  unsigned char* blank = new unsigned char[640 * 480 * 3];
+  for (int i = 0; i < 640 * 480 * 3; i++) blank[i] = 0;
+
+  std::vector<unsigned int> scales = {1, 2, 3, 4, 8, 12};
+  for (int i = 0; i < scales.size(); i++) {
+    InputVideoSettings input_vid_set_sol = {640, 480, DecompFrameFormat::kRGB};
+    MotionConfig full_config = {1, scales.at(i), 3, 1, 5, 0.01, DecompFrameMethod::kAccurate};
+    MotionConfig dct_config = full_config;
+    dct_config.dct_scaling = true;
+    DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
+
+    MotionDetector full = MotionDetector(input_vid_set_sol, full_config, device_config_sol, empty_output);
+    MotionDetector dct = MotionDetector(input_vid_set_sol, dct_config, device_config_sol, empty_output);
+
+    // Decode scale takes over as much of the scale as it can, leaving the scaled frame the same size
+    REQUIRE(dct.GetDecodeScale() == JpegDecompressor::LargestDecodeScale(scales.at(i)));
+    REQUIRE(dct.motion_config_.scale_denominator * dct.GetDecodeScale() == scales.at(i));
+    REQUIRE(abs(static_cast<int>(dct.scaled_width_) - static_cast<int>(full.scaled_width_)) <= 1);
+    REQUIRE(abs(static_cast<int>(dct.scaled_height_) - static_cast<int>(full.scaled_height_)) <= 1);
+
+    // Image appearing after a blank background should be motion, the same image again should settle
+    full.DetectOnDecompressedFrame(blank);
+    dct.DetectOnDecompressedFrame(blank);
+    REQUIRE(full.DetectOnFrame(jpeg.data, jpeg.filesize) == dct.DetectOnFrame(jpeg.data, jpeg.filesize));
+    REQUIRE(std::abs(full.GetMotionScore() - dct.GetMotionScore()) < 0.05);
+  }
+
+  delete[] blank;
+  delete[] jpeg.data;
+}
+
+TEST_CASE("DC Block Processing Mode") {
+  JpegFile jpeg = ReadJpeg("../test-images/640x480-test-image.jpg");
+  unsigned char* blank = new unsigned char[80 * 60];
+  for (int i = 0; i < 80 * 60; i++) blank[i] = 0;
+
+  InputVideoSettings input_vid_set_sol = {640, 480, DecompFrameFormat::kGray};
+  MotionConfig motion_config_sol = {1, 4, 3, 1, 5, 0.01, DecompFrameMethod::kAccurate};
+  motion_config_sol.processing_mode = ProcessingMode::kDCBlocks;
+
+  MotionDetector open_cl = MotionDetector(input_vid_set_sol, motion_config_sol, {DeviceType::kSpecific, kDevice}, empty_output);
+  MotionDetector native = MotionDetector(input_vid_set_sol, motion_config_sol, {DeviceType::kNative, 0}, empty_output);
+
+  // One scaled pixel per 8x8 block
+  REQUIRE(open_cl.scaled_width_ == 80);
+  REQUIRE(open_cl.scaled_height_ == 60);
+
+  // Image appearing after a blank background should be motion
+  open_cl.DetectOnDecompressedFrame(blank);
+  native.DetectOnDecompressedFrame(blank);
+  REQUIRE(open_cl.DetectOnFrame(jpeg.data, jpeg.filesize) == true);
+  REQUIRE(native.DetectOnFrame(jpeg.data, jpeg.filesize) == true);
+  REQUIRE(open_cl.GetChangedPixels() == native.GetChangedPixels());
+
+  // Asynchronous frames should go through the same path
+  std::future<bool> async_motion = open_cl.DetectOnFrameAsync(jpeg.data, jpeg.filesize);
+  REQUIRE(async_motion.get() == native.DetectOnFrame(jpeg.data, jpeg.filesize));
+
+  delete[] blank;
+  delete[] jpeg.data;
+}
+
+TEST_CASE("Detect On Frame Async") {
+  JpegFile jpeg = ReadJpeg("../test-images/640x480-test-image.jpg");
+
+  // Compress a blank frame so the stream can alternate between different frames
+  std::vector<unsigned char> blank(640 * 480 * 3, 0);
+  tjhandle compressor = tjInitCompress();
+  unsigned char* blank_jpeg = nullptr;
+  unsigned long blank_size = 0;
+  REQUIRE(tjCompress2(compressor, blank.data(), 640, 0, 480, TJPF_RGB, &blank_jpeg, &blank_size, TJSAMP_420, 90, 0) == 0);
+  tjDestroy(compressor);
+
+  InputVideoSettings input_vid_set_sol = {640, 480, DecompFrameFormat::kRGB};
+  MotionConfig motion_config_sol = {1, 4, 3, 1, 5, 0.01, DecompFrameMethod::kAccurate};
+  DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
+
+  MotionDetector sync_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
+  MotionDetector async_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
+
+  // Blank, then the image until it settles into the background, then blank until that settles too
+  std::vector<bool> shows_image = {false, false, false, true, true, true, true, false, false, false, false};
+  std::vector<bool> sync_motion;
+  for (int i = 0; i < shows_image.size(); i++) {
+    if (shows_image.at(i)) sync_motion.push_back(sync_detector.DetectOnFrame(jpeg.data, jpeg.filesize));
+    else sync_motion.push_back(sync_detector.DetectOnFrame(blank_jpeg, blank_size));
+  }
+  REQUIRE(std::count(sync_motion.begin(), sync_motion.end(), true) > 0);
+  REQUIRE(std::count(sync_motion.begin(), sync_motion.end(), false) > 0);
+
+  // Queue more frames than there are input slots before collecting any results
+  std::vector<std::future<bool>> async_motion;
+  for (int i = 0; i < shows_image.size(); i++) {
+    if (shows_image.at(i)) async_motion.push_back(async_detector.DetectOnFrameAsync(jpeg.data, jpeg.filesize));
+    else async_motion.push_back(async_detector.DetectOnFrameAsync(blank_jpeg, blank_size));
+  }
+
+  // Results should come back in order and match synchronous detection of the same frame
+  for (int i = 0; i < async_motion.size(); i++) REQUIRE(async_motion.at(i).get() == sync_motion.at(i));
+
+  // Changed pixels should follow the last asynchronous frame once its future is collected
+  REQUIRE(async_detector.GetChangedPixels() == sync_detector.GetChangedPixels());
+  REQUIRE(async_detector.GetMotionScore() == sync_detector.GetMotionScore());
+
+  // A synchronous frame after asynchronous ones replaces their count
+  async_motion.push_back(async_detector.DetectOnFrameAsync(jpeg.data, jpeg.filesize));
+  sync_detector.DetectOnFrame(jpeg.data, jpeg.filesize);
+  async_detector.DetectOnFrame(blank_jpeg, blank_size);
+  sync_detector.DetectOnFrame(blank_jpeg, blank_size);
+  async_motion.back().get();
+  REQUIRE(async_detector.GetChangedPixels() == sync_detector.GetChangedPixels());
+
+  tjFree(blank_jpeg);
+  delete[] jpeg.data;
+}
+
+TEST_CASE("Detect On Frame Decompressed Into Input Buffer") {
+  JpegFile jpeg = ReadJpeg("../test-images/640x480-test-image.jpg");
+  JpegDecompressor decompressor = JpegDecompressor(640, 480, DecompFrameFormat::kGray, DecompFrameMethod::kAccurate);
+  unsigned char* decompressed = decompressor.DecompressImage(jpeg.data, jpeg.filesize);
+
+  InputVideoSettings input_vid_set_sol = {640, 480, DecompFrameFormat::kGray};
+  MotionConfig motion_config_sol = {1, 4, 3, 1, 5, 0.01, DecompFrameMethod::kAccurate};
+  DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
+
+  MotionDetector mapped = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
+  MotionDetector written = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
+
+  // Frames decompressed straight into the mapped input buffer should match frames written from host memory
+  for (int i = 0; i < 4; i++) {
+    REQUIRE(mapped.DetectOnFrame(jpeg.data, jpeg.filesize) == written.DetectOnDecompressedFrame(decompressed));
+    REQUIRE(mapped.GetChangedPixels() == written.GetChangedPixels());
+  }
+
+  // Failed decompression should leave input buffer unmapped and the detector usable
+  REQUIRE_THROWS(mapped.DetectOnFrame(jpeg.data, 16));
+  REQUIRE(mapped.DetectOnFrame(jpeg.data, jpeg.filesize) == written.DetectOnDecompressedFrame(decompressed));
+
+  delete[] decompressed;
+  delete[] jpeg.data;
+}
+
+TEST_CASE("Detect On Frame Async With Decode Threads") {
+  JpegFile jpeg = ReadJpeg("../test-images/640x480-test-image.jpg");
+
+  std::vector<DeviceConfig> device_configs = {{DeviceType::kSpecific, kDevice}, {DeviceType::kNative, 0}};
+  for (int i = 0; i < device_configs.size(); i++) {
+    InputVideoSettings input_vid_set_sol = {640, 480, DecompFrameFormat::kRGB};
+    MotionConfig sync_config = {1, 4, 3, 1, 5, 0.01, DecompFrameMethod::kAccurate};
+    MotionConfig threaded_config = sync_config;
+    threaded_config.decode_threads = 3;
+
+    MotionDetector sync_detector = MotionDetector(input_vid_set_sol, sync_config, device_configs.at(i), empty_output);
+    MotionDetector threaded_detector = MotionDetector(input_vid_set_sol, threaded_config, device_configs.at(i), empty_output);
+
+    // Queue more frames than the decode queue holds before collecting any results, with a bad frame part way through
+    std::vector<std::future<bool>> async_motion;
+    for (int j = 0; j < 12; j++) async_motion.push_back(threaded_detector.DetectOnFrameAsync(jpeg.data, j == 5 ? 16 : jpeg.filesize));
+
+    // Results should come back in order and match synchronous detection
+    for (int j = 0; j < async_motion.size(); j++) {
+      if (j == 5) {
+        REQUIRE_THROWS(async_motion.at(j).get());
+        continue;
+      }
+      bool sync_motion = sync_detector.DetectOnFrame(jpeg.data, jpeg.filesize);
+      REQUIRE(async_motion.at(j).get() == sync_motion);
+    }
+
+    // Synchronous frames wait for queued frames
+    threaded_detector.DetectOnFrameAsync(jpeg.data, jpeg.filesize);
+    REQUIRE(threaded_detector.DetectOnFrame(jpeg.data, jpeg.filesize) == false);
+  }
+
+  delete[] jpeg.data;
+}
+
+TEST_CASE("Device Runtime") {
+  InputVideoSettings input_vid_set_sol = {640, 480, DecompFrameFormat::kGray};
+  MotionConfig motion_config_sol = {1, 2, 3, 1, 10, 0.0, DecompFrameMethod::kAccurate};
+  DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
+  JpegFile jpeg = ReadJpeg("../test-images/640x480-test-image.jpg");
+  unsigned char* frame0 = JpegDecompressor(640, 480, DecompFrameFormat::kGray, DecompFrameMethod::kAccurate).DecompressImage(jpeg.data, jpeg.filesize);
+  unsigned char* frame1 = new unsigned char[640 * 480];
+  for (int i = 0; i < 640 * 480; i++) frame1[i] = 255 - frame0[i];
+
+  SECTION("Shares Programs Between Detectors") {
+    std::shared_ptr<DeviceRuntime> runtime = std::make_shared<DeviceRuntime>(device_config_sol, empty_output);
+    MotionDetector first = MotionDetector(input_vid_set_sol, motion_config_sol, runtime, empty_output);
+    REQUIRE(runtime->GetProgramCount() == 4);
+
+    // Same configuration builds nothing new
+    MotionDetector second = MotionDetector(input_vid_set_sol, motion_config_sol, runtime, empty_output);
+    REQUIRE(runtime->GetProgramCount() == 4);
+
+    // Kernels reading configuration from argument buffers are the same for every configuration
+    MotionConfig buffer_config = motion_config_sol;
+    buffer_config.specialize_kernels = false;
+    MotionDetector third = MotionDetector(input_vid_set_sol, buffer_config, runtime, empty_output);
+    buffer_config.scale_denominator = 4;
+    MotionDetector fourth = MotionDetector(input_vid_set_sol, buffer_config, runtime, empty_output);
+    REQUIRE(runtime->GetProgramCount() == 8);
+  }
+
+  SECTION("Detectors Sharing A Runtime Keep Their Own State") {
+    std::shared_ptr<DeviceRuntime> runtime = std::make_shared<DeviceRuntime>(device_config_sol, empty_output);
+    MotionDetector shared0 = MotionDetector(input_vid_set_sol, motion_config_sol, runtime, empty_output);
+    MotionDetector shared1 = MotionDetector(input_vid_set_sol, motion_config_sol, runtime, empty_output);
+    MotionDetector separate0 = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
+    MotionDetector separate1 = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
+
+    // Interleave different sequences on the shared detectors, each should match a detector with a device of its own
+    std::vector<unsigned char*> sequence0 = {frame0, frame0, frame1, frame1, frame0, frame0};
+    std::vector<unsigned char*> sequence1 = {frame1, frame0, frame0, frame1, frame1, frame0};
+    for (int i = 0; i < sequence0.size(); i++) {
+      REQUIRE(shared0.DetectOnDecompressedFrame(sequence0.at(i)) == separate0.DetectOnDecompressedFrame(sequence0.at(i)));
+      REQUIRE(shared1.DetectOnDecompressedFrame(sequence1.at(i)) == separate1.DetectOnDecompressedFrame(sequence1.at(i)));
+      REQUIRE(shared0.GetChangedPixels() == separate0.GetChangedPixels());
+      REQUIRE(shared1.GetChangedPixels() == separate1.GetChangedPixels());
+    }
+
+    // Asynchronous frames from both detectors go through the same queues
+    std::vector<std::future<bool>> results0;
+    std::vector<std::future<bool>> results1;
+    for (int i = 0; i < 6; i++) {
+      results0.push_back(shared0.DetectOnFrameAsync(jpeg.data, jpeg.filesize));
+      results1.push_back(shared1.DetectOnFrameAsync(jpeg.data, jpeg.filesize));
+    }
+    for (int i = 0; i < results0.size(); i++) REQUIRE(results0.at(i).get() == results1.at(i).get());
+  }
+
+  SECTION("Rejects Native Device") {
+    REQUIRE_THROWS_AS(DeviceRuntime({DeviceType::kNative, 0}, empty_output), std::invalid_argument);
+    REQUIRE_THROWS_AS(MotionDetector(input_vid_set_sol, motion_config_sol, std::shared_ptr<DeviceRuntime>(), empty_output), std::invalid_argument);
+  }
+
+  delete[] frame0;
+  delete[] frame1;
+  delete[] jpeg.data;
+}
 // NOLINTEND(readability-*)
@@ -0,0 +1,126 @@
+// NOLINTBEGIN(readability-*)
+#include <catch2/catch_all.hpp>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "motion_detector_batch.hpp"
+
+TEST_CASE("Batched Detection") {
+  PpmFile ppm = ReadPpm("../test-images/9x9-color-pixels-rgb.ppm");
+  unsigned char* data0 = new unsigned char[304];  // Size of input frame buffer for 9x9 RGB frames
+  unsigned char* data1 = new unsigned char[304];  // Inverted image so that there are differences
+  for (int i = 0; i < ppm.data.size(); i++) {
+    data0[i] = ppm.data.at(i);
+    data1[i] = 255 - ppm.data.at(i);
+  }
+  JpegFile jpeg = ReadJpeg("../test-images/640x480-test-image.jpg");
+  DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
+
+  SECTION("Matches A Detector Per Stream") {
+    std::vector<std::pair<unsigned int, unsigned int>> blur_scales = {{0, 1}, {1, 1}, {1, 2}, {1, 3}};
+    std::vector<bool> specialize = {true, false};
+    std::vector<BackgroundModel> models = {BackgroundModel::kWindow, BackgroundModel::kExponential};
+    for (int b = 0; b < models.size(); b++) {
+      for (int s = 0; s < specialize.size(); s++) {
+        for (int i = 0; i < blur_scales.size(); i++) {
+          InputVideoSettings input_vid_set_sol = {9, 9, DecompFrameFormat::kRGB};
+          MotionConfig motion_config_sol = {blur_scales.at(i).first, blur_scales.at(i).second, 3, 1, 10, 0.0, DecompFrameMethod::kAccurate};
+          motion_config_sol.specialize_kernels = specialize.at(s);
+          motion_config_sol.background_model = models.at(b);
+
+          std::shared_ptr<DeviceRuntime> runtime = std::make_shared<DeviceRuntime>(device_config_sol, empty_output);
+          MotionDetectorBatch batch = MotionDetectorBatch(input_vid_set_sol, motion_config_sol, 3, runtime, empty_output);
+          std::vector<std::unique_ptr<MotionDetector>> detectors;
+          for (int j = 0; j < 3; j++) detectors.push_back(std::make_unique<MotionDetector>(input_vid_set_sol, motion_config_sol, runtime, empty_output));
+
+          // Every stream gets a different sequence, each should match a detector of its own
+          std::vector<std::vector<const unsigned char*>> sequences = {
+              {data0, data0, data1, data1, data0, data1}, {data1, data0, data0, data1, data1, data0}, {data0, data1, data0, data1, data0, data1}};
+          for (int f = 0; f < sequences.at(0).size(); f++) {
+            std::vector<const unsigned char*> frames = {sequences.at(0).at(f), sequences.at(1).at(f), sequences.at(2).at(f)};
+            std::vector<bool> motion = batch.DetectOnDecompressedFrames(frames);
+            REQUIRE(motion.size() == 3);
+            for (int j = 0; j < 3; j++) {
+              REQUIRE(motion.at(j) == detectors.at(j)->DetectOnDecompressedFrame(frames.at(j)));
+              REQUIRE(batch.GetChangedPixels(j) == detectors.at(j)->GetChangedPixels());
+            }
+          }
+        }
+      }
+    }
+  }
+
+  SECTION("Matches A Detector Per Stream On JPEG Frames") {
+    unsigned char* blank = new unsigned char[640 * 480];
+    for (int i = 0; i < 640 * 480; i++) blank[i] = 0;
+
+    std::vector<unsigned int> decode_threads = {0, 2};
+    for (int t = 0; t < decode_threads.size(); t++) {
+      InputVideoSettings input_vid_set_sol = {640, 480, DecompFrameFormat::kGray};
+      MotionConfig motion_config_sol = {1, 4, 3, 1, 5, 0.01, DecompFrameMethod::kAccurate};
+      motion_config_sol.decode_threads = decode_threads.at(t);
+      motion_config_sol.strip_threads = 2;
+
+      // Decode threads work on a stream each, without them every stream shares one decompressor and its strip threads
+      MotionDetectorBatch batch = MotionDetectorBatch(input_vid_set_sol, motion_config_sol, 2, device_config_sol, empty_output);
+      REQUIRE(batch.decompressors_.size() == (decode_threads.at(t) > 0 ? 2 : 1));
+      MotionConfig single_config = motion_config_sol;
+      single_config.decode_threads = 0;
+      MotionDetector single0 = MotionDetector(input_vid_set_sol, single_config, device_config_sol, empty_output);
+      MotionDetector single1 = MotionDetector(input_vid_set_sol, single_config, device_config_sol, empty_output);
+
+      // Image appearing after a blank background should be motion on every stream, the same image again should settle
+      single0.DetectOnDecompressedFrame(blank);
+      single1.DetectOnDecompressedFrame(blank);
+      batch.DetectOnDecompressedFrames({blank, blank});
+      std::vector<std::pair<const unsigned char*, unsigned long>> frames = {{jpeg.data, jpeg.filesize}, {jpeg.data, jpeg.filesize}};
+      for (int f = 0; f < 3; f++) {
+        std::vector<bool> motion = batch.DetectOnFrames(frames);
+        REQUIRE(motion.at(0) == single0.DetectOnFrame(jpeg.data, jpeg.filesize));
+        REQUIRE(motion.at(1) == single1.DetectOnFrame(jpeg.data, jpeg.filesize));
+        REQUIRE(batch.GetChangedPixels(0) == single0.GetChangedPixels());
+        REQUIRE(batch.GetChangedPixels(1) == single1.GetChangedPixels());
+      }
+
+      // Failed decompression should leave the batch unchanged and usable
+      REQUIRE_THROWS(batch.DetectOnFrames({{jpeg.data, jpeg.filesize}, {jpeg.data, 16}}));
+      std::vector<bool> motion = batch.DetectOnFrames(frames);
+      REQUIRE(motion.at(0) == single0.DetectOnFrame(jpeg.data, jpeg.filesize));
+      REQUIRE(motion.at(1) == single1.DetectOnFrame(jpeg.data, jpeg.filesize));
+    }
+
+    delete[] blank;
+  }
+
+  SECTION("With Invalid Input") {
+    InputVideoSettings input_vid_set_sol = {9, 9, DecompFrameFormat::kRGB};
+    MotionConfig motion_config_sol = {0, 1, 3, 1, 10, 0.0, DecompFrameMethod::kAccurate};
+
+    REQUIRE_THROWS_AS(MotionDetectorBatch(input_vid_set_sol, motion_config_sol, 0, device_config_sol, empty_output), std::invalid_argument);
+    REQUIRE_THROWS_AS(MotionDetectorBatch(input_vid_set_sol, motion_config_sol, 2, std::shared_ptr<DeviceRuntime>(), empty_output), std::invalid_argument);
+    MotionConfig dc_config = motion_config_sol;
+    dc_config.processing_mode = ProcessingMode::kDCBlocks;
+    REQUIRE_THROWS_AS(MotionDetectorBatch(input_vid_set_sol, dc_config, 2, device_config_sol, empty_output), std::invalid_argument);
+    MotionConfig packed_config = motion_config_sol;
+    packed_config.packed_mask = true;
+    REQUIRE_THROWS_AS(MotionDetectorBatch(input_vid_set_sol, packed_config, 2, device_config_sol, empty_output), std::invalid_argument);
+    MotionConfig region_config = motion_config_sol;
+    region_config.max_regions = 8;
+    REQUIRE_THROWS_AS(MotionDetectorBatch(input_vid_set_sol, region_config, 2, device_config_sol, empty_output), std::invalid_argument);
+    MotionConfig roi_config = motion_config_sol;
+    roi_config.roi = RoiMask(9, 9, true);
+    REQUIRE_THROWS_AS(MotionDetectorBatch(input_vid_set_sol, roi_config, 2, device_config_sol, empty_output), std::invalid_argument);
+
+    // Every batch needs exactly one frame per stream
+    MotionDetectorBatch batch = MotionDetectorBatch(input_vid_set_sol, motion_config_sol, 2, device_config_sol, empty_output);
+    REQUIRE_THROWS_AS(batch.DetectOnDecompressedFrames({data0}), std::invalid_argument);
+    REQUIRE_THROWS_AS(batch.DetectOnDecompressedFrames({data0, data0, data0}), std::invalid_argument);
+  }
+
+  delete[] jpeg.data;
+  delete[] data0;
+  delete[] data1;
+}
+// NOLINTEND(readability-*)
@@ -0,0 +1,75 @@
+// NOLINTBEGIN(readability-*)
+#include <catch2/catch_all.hpp>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "device_runtime.hpp"
+#include "motion_detector.hpp"
+#include "motion_detector_cascade.hpp"
+
+TEST_CASE("Motion Detector Cascade") {
+  JpegFile jpeg = ReadJpeg("../test-images/640x480-test-image.jpg");
+  InputVideoSettings input_vid_set_sol = {640, 480, DecompFrameFormat::kGray};
+  MotionConfig motion_config_sol = {1, 2, 1, 1, 10, 0.0, DecompFrameMethod::kAccurate};
+  CascadeConfig cascade_config_sol;
+  cascade_config_sol.coarse_scale_denominator = 16;
+  cascade_config_sol.pre_trigger = 0.0;
+  cascade_config_sol.warm_interval = 8;
+  cascade_config_sol.hold_frames = 4;
+
+  SECTION("Escalates Only On Suspected Motion") {
+    std::vector<DeviceConfig> devices = {{DeviceType::kSpecific, kDevice}, {DeviceType::kNative, 0}};
+    for (int d = 0; d < devices.size(); d++) {
+      MotionDetectorCascade cascade = MotionDetectorCascade(input_vid_set_sol, motion_config_sol, cascade_config_sol, devices.at(d), empty_output);
+
+      // First frame differs from the empty background, so both models see it
+      REQUIRE(cascade.DetectOnFrame(jpeg.data, jpeg.filesize) == true);
+      REQUIRE(cascade.WasEscalated() == true);
+      REQUIRE(cascade.GetCoarseMotionScore() > 0.0);
+
+      // Same frame again, fine model keeps running for the 4 hold frames
+      for (int i = 0; i < 4; i++) {
+        REQUIRE(cascade.DetectOnFrame(jpeg.data, jpeg.filesize) == false);
+        REQUIRE(cascade.WasEscalated() == true);
+      }
+      REQUIRE(cascade.GetFineFrameCount() == 5);
+
+      // Then only every 8th frame keeps the fine model warm
+      for (int i = 0; i < 24; i++) {
+        REQUIRE(cascade.DetectOnFrame(jpeg.data, jpeg.filesize) == false);
+        REQUIRE(cascade.WasEscalated() == false);
+        REQUIRE(cascade.GetCoarseMotionScore() == 0.0);
+      }
+      REQUIRE(cascade.GetFrameCount() == 29);
+      REQUIRE(cascade.GetFineFrameCount() == 8);
+    }
+  }
+
+  SECTION("Shares Runtime") {
+    std::shared_ptr<DeviceRuntime> runtime = std::make_shared<DeviceRuntime>(DeviceConfig{DeviceType::kSpecific, kDevice}, empty_output);
+    MotionDetectorCascade cascade = MotionDetectorCascade(input_vid_set_sol, motion_config_sol, cascade_config_sol, runtime, empty_output);
+    REQUIRE(cascade.DetectOnFrame(jpeg.data, jpeg.filesize) == true);
+    REQUIRE(cascade.DetectOnFrame(jpeg.data, jpeg.filesize) == false);
+  }
+
+  SECTION("With Invalid Input") {
+    DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
+    CascadeConfig invalid = cascade_config_sol;
+    invalid.coarse_scale_denominator = 2;
+    REQUIRE_THROWS_AS(MotionDetectorCascade(input_vid_set_sol, motion_config_sol, invalid, device_config_sol, empty_output), std::invalid_argument);
+    invalid = cascade_config_sol;
+    invalid.pre_trigger = -0.1;
+    REQUIRE_THROWS_AS(MotionDetectorCascade(input_vid_set_sol, motion_config_sol, invalid, device_config_sol, empty_output), std::invalid_argument);
+    invalid.pre_trigger = 1.5;
+    REQUIRE_THROWS_AS(MotionDetectorCascade(input_vid_set_sol, motion_config_sol, invalid, device_config_sol, empty_output), std::invalid_argument);
+    invalid = cascade_config_sol;
+    invalid.warm_interval = 0;
+    REQUIRE_THROWS_AS(MotionDetectorCascade(input_vid_set_sol, motion_config_sol, invalid, device_config_sol, empty_output), std::invalid_argument);
+    REQUIRE_THROWS_AS(MotionDetectorCascade(input_vid_set_sol, motion_config_sol, cascade_config_sol, std::shared_ptr<DeviceRuntime>(), empty_output),
+                      std::invalid_argument);
+  }
+
+  delete[] jpeg.data;
+}
+// NOLINTEND(readability-*)
@@ -0,0 +1,109 @@
+// NOLINTBEGIN(readability-*)
+#include <catch2/catch_all.hpp>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "device_runtime.hpp"
+#include "motion_detector.hpp"
+#include "motion_detector_governor.hpp"
+
+TEST_CASE("Motion Detector Governor") {
+  JpegFile jpeg = ReadJpeg("../test-images/640x480-test-image.jpg");
+  InputVideoSettings input_vid_set_sol = {640, 480, DecompFrameFormat::kGray};
+  MotionConfig motion_config_sol = {1, 2, 3, 1, 10, 0.0, DecompFrameMethod::kAccurate};
+  GovernorConfig governor_config_sol;
+  governor_config_sol.latency_budget_ms = 1000000.0;
+  governor_config_sol.max_decimation = 4;
+  governor_config_sol.recover_ratio = 0.5;
+
+  SECTION("Processes Every Frame Within Budget") {
+    MotionDetectorGovernor governor = MotionDetectorGovernor(input_vid_set_sol, motion_config_sol, governor_config_sol, {DeviceType::kSpecific, kDevice}, empty_output);
+    REQUIRE(governor.DetectOnFrame(jpeg.data, jpeg.filesize) == true);
+    for (int i = 0; i < 9; i++) {
+      REQUIRE(governor.DetectOnFrame(jpeg.data, jpeg.filesize) == false);
+      REQUIRE(governor.WasProcessed() == true);
+    }
+    REQUIRE(governor.GetDecimation() == 1);
+    REQUIRE(governor.GetProcessedFrames() == 10);
+    REQUIRE(governor.GetDroppedFrames() == 0);
+    REQUIRE(governor.GetSuppressedFrames() == 0);
+    REQUIRE(governor.GetAverageProcessingTime() > 0.0);
+  }
+
+  SECTION("Sheds Load Over Budget And Recovers") {
+    std::vector<DeviceConfig> devices = {{DeviceType::kSpecific, kDevice}, {DeviceType::kNative, 0}};
+    for (int d = 0; d < devices.size(); d++) {
+      GovernorConfig governor_config = governor_config_sol;
+      governor_config.latency_budget_ms = 0.000001;
+      MotionDetectorGovernor governor = MotionDetectorGovernor(input_vid_set_sol, motion_config_sol, governor_config, devices.at(d), empty_output);
+
+      // Every processed frame is over budget, so decimation doubles up to 4 and stays there
+      // (nothing is warm yet, so the 2 and 4 detectors settle for 3 processed frames between them)
+      REQUIRE(governor.DetectOnFrame(jpeg.data, jpeg.filesize) == true);
+      REQUIRE(governor.GetDecimation() == 2);
+      REQUIRE(governor.IsSettling() == true);
+      for (int i = 0; i < 18; i++) REQUIRE(governor.DetectOnFrame(jpeg.data, jpeg.filesize) == false);
+      REQUIRE(governor.GetDecimation() == 4);
+      REQUIRE(governor.WasProcessed() == true);
+      REQUIRE(governor.IsSettling() == false);
+      REQUIRE(governor.GetProcessedFrames() == 6);
+      REQUIRE(governor.GetDroppedFrames() == 13);
+      REQUIRE(governor.GetSuppressedFrames() == 3);
+
+      // Decimation steps back down once each detector has refilled its averages, the lower ones were not kept warm
+      governor.SetLatencyBudget(1000000.0);
+      for (int i = 0; i < 4; i++) REQUIRE(governor.DetectOnFrame(jpeg.data, jpeg.filesize) == false);
+      REQUIRE(governor.GetDecimation() == 2);
+      REQUIRE(governor.IsSettling() == true);
+      for (int i = 0; i < 17; i++) REQUIRE(governor.DetectOnFrame(jpeg.data, jpeg.filesize) == false);
+      REQUIRE(governor.GetDecimation() == 1);
+      REQUIRE(governor.IsSettling() == false);
+      REQUIRE(governor.GetProcessedFrames() + governor.GetDroppedFrames() == 40);
+      REQUIRE(governor.GetSuppressedFrames() == 10);
+    }
+  }
+
+  SECTION("Steps Up Into Warm Detector") {
+    MotionDetectorGovernor governor = MotionDetectorGovernor(input_vid_set_sol, motion_config_sol, governor_config_sol, {DeviceType::kNative, 0}, empty_output);
+    for (int i = 0; i < 20; i++) governor.DetectOnFrame(jpeg.data, jpeg.filesize);
+    REQUIRE(governor.GetDecimation() == 1);
+
+    // Decimation 2 detector was given every other frame, so stepping up to it does not suppress anything
+    governor.SetLatencyBudget(0.000001);
+    REQUIRE(governor.DetectOnFrame(jpeg.data, jpeg.filesize) == false);
+    REQUIRE(governor.GetDecimation() == 2);
+    REQUIRE(governor.IsSettling() == false);
+
+    // Decimation 4 detector only starts getting frames once decimation 2 is current
+    REQUIRE(governor.DetectOnFrame(jpeg.data, jpeg.filesize) == false);
+    REQUIRE(governor.WasProcessed() == false);
+    REQUIRE(governor.DetectOnFrame(jpeg.data, jpeg.filesize) == false);
+    REQUIRE(governor.GetDecimation() == 4);
+    REQUIRE(governor.IsSettling() == true);
+    REQUIRE(governor.GetSuppressedFrames() == 0);
+  }
+
+  SECTION("With Invalid Input") {
+    DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
+    GovernorConfig invalid = governor_config_sol;
+    invalid.latency_budget_ms = 0.0;
+    REQUIRE_THROWS_AS(MotionDetectorGovernor(input_vid_set_sol, motion_config_sol, invalid, device_config_sol, empty_output), std::invalid_argument);
+    invalid = governor_config_sol;
+    invalid.max_decimation = 0;
+    REQUIRE_THROWS_AS(MotionDetectorGovernor(input_vid_set_sol, motion_config_sol, invalid, device_config_sol, empty_output), std::invalid_argument);
+    invalid = governor_config_sol;
+    invalid.recover_ratio = 0.0;
+    REQUIRE_THROWS_AS(MotionDetectorGovernor(input_vid_set_sol, motion_config_sol, invalid, device_config_sol, empty_output), std::invalid_argument);
+    invalid.recover_ratio = 1.5;
+    REQUIRE_THROWS_AS(MotionDetectorGovernor(input_vid_set_sol, motion_config_sol, invalid, device_config_sol, empty_output), std::invalid_argument);
+    REQUIRE_THROWS_AS(MotionDetectorGovernor(input_vid_set_sol, motion_config_sol, governor_config_sol, std::shared_ptr<DeviceRuntime>(), empty_output),
+                      std::invalid_argument);
+
+    MotionDetectorGovernor governor = MotionDetectorGovernor(input_vid_set_sol, motion_config_sol, governor_config_sol, device_config_sol, empty_output);
+    REQUIRE_THROWS_AS(governor.SetLatencyBudget(0.0), std::invalid_argument);
+  }
+
+  delete[] jpeg.data;
+}
+// NOLINTEND(readability-*)
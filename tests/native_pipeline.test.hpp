@@ -0,0 +1,75 @@
+// NOLINTBEGIN(readability-*)
+#include <catch2/catch_all.hpp>
+#include <cmath>
+#include <ostream>
+
+#define private public  // To test steps of motion detection
+#include "motion_detector.hpp"
+#include "native_pipeline.hpp"
+
+TEST_CASE("Native Device") {
+  PpmFile ppm0 = ReadPpm("../test-images/3x3-color-pixels-rgb.ppm");
+  unsigned char* data0 = new unsigned char[32];
+  for (int i = 0; i < ppm0.data.size(); i++) {
+    data0[i] = ppm0.data.at(i);
+  }
+  PpmFile ppm1 = ReadPpm("../test-images/9x9-color-pixels-rgb.ppm");
+  unsigned char* data1 = new unsigned char[304];  // Size of input frame buffer for 9x9 RGB frames
+  unsigned char* data2 = new unsigned char[304];  // Inverted image so that there are differences
+  for (int i = 0; i < ppm1.data.size(); i++) {
+    data1[i] = ppm1.data.at(i);
+    data2[i] = 255 - ppm1.data.at(i);
+  }
+
+  SECTION("OpenCL Buffers Do Not Exist") {
+    InputVideoSettings input_vid_set_sol = {3, 3, DecompFrameFormat::kRGB};
+    MotionConfig motion_config_sol = {0, 1, 10, 2, 0, 0.0};
+    DeviceConfig device_config_sol = {DeviceType::kNative, 0};
+
+    MotionDetector motion_detector = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
+
+    REQUIRE_THROWS(motion_detector.BlurAndScale(data0));
+    REQUIRE_THROWS(motion_detector.StabilizeAndCompareFrames());
+  }
+
+  SECTION("Matches OpenCL Device") {
+    std::vector<std::pair<unsigned int, unsigned int>> blur_scales = {{0, 1}, {1, 1}, {0, 2}, {1, 2}, {1, 3}};
+    std::vector<unsigned int> threads = {1, 2, 0};
+    for (int i = 0; i < blur_scales.size(); i++) {
+      InputVideoSettings input_vid_set_sol = {9, 9, DecompFrameFormat::kRGB};
+      MotionConfig motion_config_sol = {blur_scales.at(i).first, blur_scales.at(i).second, 3, 1, 10, 0.0, DecompFrameMethod::kAccurate};
+      DeviceConfig open_cl_config = {DeviceType::kSpecific, kDevice};
+      DeviceConfig native_config = {DeviceType::kNative, static_cast<int>(threads.at(i % threads.size()))};
+
+      MotionDetector open_cl = MotionDetector(input_vid_set_sol, motion_config_sol, open_cl_config, empty_output);
+      MotionDetector native = MotionDetector(input_vid_set_sol, motion_config_sol, native_config, empty_output);
+
+      // Should produce the same difference frames as the OpenCL kernels, with scaled frames within rounding of -cl-fast-relaxed-math
+      std::vector<unsigned char*> sequence = {data1, data1, data2, data2, data1, data2};
+      for (int j = 0; j < sequence.size(); j++) {
+        unsigned int pixels = open_cl.scaled_width_ * open_cl.scaled_height_;
+
+        cl::Buffer& open_cl_scaled = open_cl.BlurAndScale(sequence.at(j));
+        const unsigned char* native_scaled = native.native_->BlurAndScale(sequence.at(j));
+        unsigned char* scaled = new unsigned char[pixels];
+        open_cl.cmd_queue_.enqueueReadBuffer(open_cl_scaled, CL_TRUE, 0, pixels * sizeof(unsigned char), static_cast<void*>(scaled));
+        for (int k = 0; k < pixels; k++) REQUIRE(abs(static_cast<int>(scaled[k]) - static_cast<int>(native_scaled[k])) < kErrorMarginAllowed);
+        delete[] scaled;
+
+        cl::Buffer& open_cl_diff = open_cl.StabilizeAndCompareFrames();
+        const bool* native_diff = native.native_->StabilizeAndCompareFrames();
+        bool* diff = new bool[pixels];
+        open_cl.cmd_queue_.enqueueReadBuffer(open_cl_diff, CL_TRUE, 0, pixels * sizeof(bool), static_cast<void*>(diff));
+        for (int k = 0; k < pixels; k++) REQUIRE(diff[k] == native_diff[k]);
+        delete[] diff;
+
+        REQUIRE(open_cl.CountDifferences() == native.CountDifferences());
+      }
+    }
+  }
+
+  delete[] data0;
+  delete[] data1;
+  delete[] data2;
+}
+// NOLINTEND(readability-*)
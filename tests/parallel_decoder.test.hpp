@@ -0,0 +1,54 @@
+// NOLINTBEGIN(readability-*)
+#include <catch2/catch_all.hpp>
+#include <vector>
+
+#include "jpeg_decompressor.hpp"
+#include "parallel_decoder.hpp"
+
+TEST_CASE("Parallel Decoder") {
+  JpegFile jpeg = ReadJpeg("../test-images/640x480-test-image.jpg");
+  JpegDecompressor decompressor = JpegDecompressor(640, 480, DecompFrameFormat::kGray, DecompFrameMethod::kAccurate);
+  unsigned char* expected = decompressor.DecompressImage(jpeg.data, jpeg.filesize);
+
+  SECTION("Delivers Frames In Order") {
+    // Mix of good and truncated frames, so the order errors arrive in shows the order frames arrive in
+    std::vector<bool> truncated;
+    for (int i = 0; i < 40; i++) truncated.push_back(i % 3 == 0 || i % 7 == 0);
+
+    std::vector<unsigned int> threads = {1, 2, 4};
+    for (int i = 0; i < threads.size(); i++) {
+      std::vector<bool> failed;
+      int mismatched_frames = 0;
+      {
+        ParallelDecoder decoder = ParallelDecoder(640, 480, DecompFrameFormat::kGray, DecompFrameMethod::kAccurate, 1, false, decompressor.GetDecompressedSize(),
+                                                  threads.at(i), threads.at(i) + 1, [&](const unsigned char* frame, std::exception_ptr error) {
+                                                    failed.push_back(error != nullptr);
+                                                    if (error == nullptr) {
+                                                      for (int j = 0; j < 640 * 480; j++) {
+                                                        if (frame[j] != expected[j]) {
+                                                          mismatched_frames++;
+                                                          break;
+                                                        }
+                                                      }
+                                                    }
+                                                  });
+        REQUIRE(decoder.GetThreadCount() == threads.at(i));
+        for (int j = 0; j < truncated.size(); j++) decoder.Submit(jpeg.data, truncated.at(j) ? 16 : jpeg.filesize);
+        decoder.Finish();
+        REQUIRE(failed.size() == truncated.size());
+      }
+      REQUIRE(failed == truncated);
+      REQUIRE(mismatched_frames == 0);
+    }
+  }
+
+  SECTION("With Invalid Queue Depth") {
+    // Queue needs room for a frame on every thread plus one waiting to be delivered
+    REQUIRE_THROWS(ParallelDecoder(640, 480, DecompFrameFormat::kGray, DecompFrameMethod::kAccurate, 1, false, decompressor.GetDecompressedSize(), 4, 4,
+                                   [](const unsigned char* frame, std::exception_ptr error) {}));
+  }
+
+  delete[] expected;
+  delete[] jpeg.data;
+}
+// NOLINTEND(readability-*)
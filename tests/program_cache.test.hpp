@@ -0,0 +1,101 @@
+// NOLINTBEGIN(readability-*)
+#include <catch2/catch_all.hpp>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "motion_detector.hpp"
+#include "open_cl_interface.hpp"
+#include "program_cache.hpp"
+
+/**
+ * CountCacheEntries() - Counts program binaries in a cache directory
+ */
+int CountCacheEntries(const std::filesystem::path& directory) {
+  int entries = 0;
+  for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(directory)) {
+    if (entry.path().extension() == ".bin") entries++;
+  }
+  return entries;
+}
+
+TEST_CASE("Program Cache") {
+  const std::filesystem::path directory = std::filesystem::temp_directory_path() / "mjpeg-motion-detector-program-cache-test";
+  std::filesystem::remove_all(directory);
+
+  InputVideoSettings input_vid_set_sol = {640, 480, DecompFrameFormat::kGray};
+  MotionConfig motion_config_sol = {1, 2, 3, 1, 10, 0.0, DecompFrameMethod::kAccurate};
+  motion_config_sol.program_cache_dir = directory.string();
+  DeviceConfig device_config_sol = {DeviceType::kSpecific, kDevice};
+  JpegFile jpeg = ReadJpeg("../test-images/640x480-test-image.jpg");
+
+  // Detector without a cache to compare against
+  MotionConfig uncached_config = motion_config_sol;
+  uncached_config.program_cache_dir = "";
+  MotionDetector uncached = MotionDetector(input_vid_set_sol, uncached_config, device_config_sol, empty_output);
+  uncached.DetectOnFrame(jpeg.data, jpeg.filesize);
+  unsigned int expected_changed_pixels = uncached.GetChangedPixels();
+
+  SECTION("Stores And Loads Program Binaries") {
+    // First detector compiles its 4 kernels from source and stores them
+    std::ostringstream first_output;
+    MotionDetector first = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, &first_output);
+    REQUIRE(CountCacheEntries(directory) == 4);
+    REQUIRE(first_output.str().find("Loaded cached OpenCL kernel file") == std::string::npos);
+
+    // Second detector loads them and gives the same results
+    std::ostringstream second_output;
+    MotionDetector second = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, &second_output);
+    REQUIRE(second_output.str().find("Successfully compiled OpenCL kernel file") == std::string::npos);
+    second.DetectOnFrame(jpeg.data, jpeg.filesize);
+    REQUIRE(second.GetChangedPixels() == expected_changed_pixels);
+
+    // Different configuration compiles different kernels, so it gets its own entries
+    MotionConfig scaled_config = motion_config_sol;
+    scaled_config.scale_denominator = 4;
+    MotionDetector scaled = MotionDetector(input_vid_set_sol, scaled_config, device_config_sol, empty_output);
+    REQUIRE(CountCacheEntries(directory) == 8);
+  }
+
+  SECTION("Replaces Corrupt Entries") {
+    MotionDetector first = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, empty_output);
+
+    // Truncate one entry and overwrite the rest with garbage
+    bool truncated = false;
+    for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(directory)) {
+      if (!truncated) {
+        std::filesystem::resize_file(entry.path(), std::filesystem::file_size(entry.path()) / 2);
+        truncated = true;
+      } else {
+        std::ofstream ofs(entry.path(), std::ios::binary | std::ios::trunc);
+        ofs << "not a program binary";
+      }
+    }
+
+    // Corrupt entries are compiled from source again and replaced
+    std::ostringstream second_output;
+    MotionDetector second = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, &second_output);
+    REQUIRE(second_output.str().find("Loaded cached OpenCL kernel file") == std::string::npos);
+    second.DetectOnFrame(jpeg.data, jpeg.filesize);
+    REQUIRE(second.GetChangedPixels() == expected_changed_pixels);
+    REQUIRE(CountCacheEntries(directory) == 4);
+
+    std::ostringstream third_output;
+    MotionDetector third = MotionDetector(input_vid_set_sol, motion_config_sol, device_config_sol, &third_output);
+    REQUIRE(third_output.str().find("Successfully compiled OpenCL kernel file") == std::string::npos);
+  }
+
+  SECTION("Keys Entries By Source And Options") {
+    cl::Device device = OpenCLInterface::GetDevice(device_config_sol);
+    ProgramCache cache = ProgramCache(directory.string());
+    std::string path = cache.GetEntryPath(device, "kernel void a() {}", "-w");
+    REQUIRE(path == cache.GetEntryPath(device, "kernel void a() {}", "-w"));
+    REQUIRE(path != cache.GetEntryPath(device, "kernel void b() {}", "-w"));
+    REQUIRE(path != cache.GetEntryPath(device, "kernel void a() {}", "-w -DSCALE=2"));
+  }
+
+  delete[] jpeg.data;
+  std::filesystem::remove_all(directory);
+}
+// NOLINTEND(readability-*)
@@ -0,0 +1,85 @@
+// NOLINTBEGIN(readability-*)
+#include <catch2/catch_all.hpp>
+#include <stdexcept>
+#include <vector>
+
+#include "roi_mask.hpp"
+
+/**
+ * CountWatched() - Counts watched pixels of a mask
+ */
+unsigned int CountWatched(const RoiMask& mask) {
+  unsigned int watched = 0;
+  for (unsigned int y = 0; y < mask.GetHeight(); y++) {
+    for (unsigned int x = 0; x < mask.GetWidth(); x++) watched += mask.IsWatched(x, y) ? 1 : 0;
+  }
+  return watched;
+}
+
+TEST_CASE("Roi Mask") {
+  SECTION("Empty Mask Watches Everything") {
+    RoiMask mask;
+    REQUIRE(mask.IsEmpty());
+    REQUIRE(mask.GetWidth() == 0);
+    REQUIRE(mask.GetHeight() == 0);
+    REQUIRE(mask.IsWatched(100, 100));
+  }
+
+  SECTION("From Bitmap") {
+    std::vector<unsigned char> bitmap = {0, 1, 0, 255, 0, 7};
+    RoiMask mask = RoiMask(3, 2, bitmap.data());
+    REQUIRE_FALSE(mask.IsEmpty());
+    REQUIRE_FALSE(mask.IsWatched(0, 0));
+    REQUIRE(mask.IsWatched(1, 0));
+    REQUIRE_FALSE(mask.IsWatched(2, 0));
+    REQUIRE(mask.IsWatched(0, 1));
+    REQUIRE_FALSE(mask.IsWatched(1, 1));
+    REQUIRE(mask.IsWatched(2, 1));
+  }
+
+  SECTION("Fills Polygons By Pixel Centers") {
+    // Rectangle on pixel edges covers exactly the pixels inside it
+    RoiMask mask = RoiMask(16, 12, false);
+    mask.AddPolygon({{2, 3}, {10, 3}, {10, 8}, {2, 8}}, true);
+    REQUIRE(CountWatched(mask) == 8 * 5);
+    REQUIRE(mask.IsWatched(2, 3));
+    REQUIRE(mask.IsWatched(9, 7));
+    REQUIRE_FALSE(mask.IsWatched(10, 7));
+    REQUIRE_FALSE(mask.IsWatched(9, 8));
+    REQUIRE_FALSE(mask.IsWatched(1, 3));
+
+    // Triangle only covers pixels whose centers are inside it
+    RoiMask triangle = RoiMask(8, 8, false);
+    triangle.AddPolygon({{0, 0}, {8, 0}, {0, 8}}, true);
+    REQUIRE(triangle.IsWatched(0, 0));
+    REQUIRE(triangle.IsWatched(6, 0));
+    REQUIRE_FALSE(triangle.IsWatched(7, 0));
+    REQUIRE(triangle.IsWatched(0, 6));
+    REQUIRE_FALSE(triangle.IsWatched(0, 7));
+    REQUIRE(CountWatched(triangle) == 28);
+  }
+
+  SECTION("Excludes Polygons In Order") {
+    RoiMask mask = RoiMask(16, 12, true);
+    mask.AddPolygon({{0, 0}, {8, 0}, {8, 12}, {0, 12}}, false);
+    mask.AddPolygon({{2, 2}, {4, 2}, {4, 4}, {2, 4}}, true);
+    REQUIRE(CountWatched(mask) == 8 * 12 + 4);
+    REQUIRE(mask.IsWatched(3, 3));
+    REQUIRE_FALSE(mask.IsWatched(5, 5));
+    REQUIRE(mask.IsWatched(8, 0));
+
+    // Polygons can run past the edges of the frame
+    mask.AddPolygon({{-10, -10}, {100, -10}, {100, 100}, {-10, 100}}, false);
+    REQUIRE(CountWatched(mask) == 0);
+  }
+
+  SECTION("With Invalid Input") {
+    REQUIRE_THROWS_AS(RoiMask(0, 10, true), std::invalid_argument);
+    REQUIRE_THROWS_AS(RoiMask(10, 0, true), std::invalid_argument);
+    RoiMask mask = RoiMask(10, 10, true);
+    REQUIRE_THROWS_AS(mask.AddPolygon({{0, 0}, {5, 5}}, false), std::invalid_argument);
+    RoiMask empty;
+    REQUIRE_THROWS_AS(empty.AddPolygon({{0, 0}, {5, 0}, {5, 5}}, false), std::logic_error);
+  }
+}
+// NOLINTEND(readability-*)
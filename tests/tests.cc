@@ -4,6 +4,14 @@
 
 #include <catch2/catch_all.hpp>
 
+#include "frame_buffer_pool.test.hpp"
 #include "generate_gaussian.test.hpp"
 #include "jpeg_decompressor.test.hpp"
-#include "motion_detector.test.hpp"
\ No newline at end of file
+#include "motion_detector.test.hpp"
+#include "motion_detector_batch.test.hpp"
+#include "motion_detector_cascade.test.hpp"
+#include "motion_detector_governor.test.hpp"
+#include "native_pipeline.test.hpp"
+#include "parallel_decoder.test.hpp"
+#include "program_cache.test.hpp"
+#include "roi_mask.test.hpp"
\ No newline at end of file